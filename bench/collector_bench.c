@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+#include "../src/git_stats.h"
+#include "../src/analysis/hotspots.h"
+#include "../src/analysis/activity.h"
+#include "../src/output/json_writer.h"
+#include "../src/version.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Per-collector timings over one or more repositories
+ *
+ * Usage: collector_bench [--iterations N] [--jobs N] [--cache] REPO...
+ * Runs every collector on a fresh GitStats in each repository and writes
+ * the minimum, median and mean wall time of each as JSON on stdout.
+ * The history cache is off unless --cache is given, so history-walking
+ * collectors measure the walk itself.
+ */
+
+/* Default: best-of and median over 5 runs */
+#define DEFAULT_ITERATIONS 5
+#define MAX_ITERATIONS 1000
+
+/**
+ * Collector under test
+ */
+typedef struct {
+    const char *name;
+    int (*collect)(GitStats *stats);
+} BenchCollector;
+
+static const BenchCollector COLLECTORS[] = {
+    { "get_commit_stats", get_commit_stats },
+    { "get_author_stats", get_author_stats },
+    { "get_branch_stats", get_branch_stats },
+    { "get_file_stats", get_file_stats },
+    { "get_hotspot_stats", get_hotspot_stats },
+    { "get_activity_stats", get_activity_stats },
+};
+
+#define COLLECTOR_COUNT ((int)(sizeof(COLLECTORS) / sizeof(COLLECTORS[0])))
+
+/**
+ * Monotonic clock in seconds
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Ascending order for qsort
+ */
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Time one collector, recording its result sizes from the last run
+ * @return 0 on success, -1 if the collector failed
+ */
+static int time_collector(const BenchCollector *collector, const CollectOptions *options,
+                          int iterations, double *samples, GitStats *last) {
+    for (int i = 0; i < iterations; i++) {
+        GitStats stats;
+        init_git_stats(&stats);
+        stats.options = *options;
+
+        double start = now_seconds();
+        int result = collector->collect(&stats);
+        samples[i] = now_seconds() - start;
+
+        if (result != 0) {
+            free_git_stats(&stats);
+            return -1;
+        }
+        if (i == iterations - 1) {
+            *last = stats;
+        } else {
+            free_git_stats(&stats);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Write the timings of every collector for the current directory
+ */
+static void bench_repository(JsonWriter *json, const char *path, const CollectOptions *options,
+                             int iterations) {
+    double samples[MAX_ITERATIONS];
+
+    json_writer_begin_object(json);
+    json_writer_key(json, "path");
+    json_writer_string(json, path);
+    json_writer_key(json, "collectors");
+    json_writer_begin_array(json);
+
+    for (int c = 0; c < COLLECTOR_COUNT; c++) {
+        GitStats last;
+        int failed = time_collector(&COLLECTORS[c], options, iterations, samples, &last) != 0;
+
+        json_writer_begin_object(json);
+        json_writer_key(json, "name");
+        json_writer_string(json, COLLECTORS[c].name);
+        if (failed) {
+            fprintf(stderr, "Warning: %s failed in %s\n", COLLECTORS[c].name, path);
+            json_writer_key(json, "error");
+            json_writer_bool(json, 1);
+            json_writer_end_object(json);
+            continue;
+        }
+
+        double total = 0.0;
+        for (int i = 0; i < iterations; i++) total += samples[i];
+        qsort(samples, (size_t)iterations, sizeof(double), compare_doubles);
+
+        json_writer_key(json, "min_ms");
+        json_writer_fixed(json, samples[0] * 1e3, 3);
+        json_writer_key(json, "median_ms");
+        json_writer_fixed(json, samples[iterations / 2] * 1e3, 3);
+        json_writer_key(json, "mean_ms");
+        json_writer_fixed(json, total / iterations * 1e3, 3);
+
+        /* Result sizes tie a timing to the work it covered */
+        json_writer_key(json, "commits");
+        json_writer_int(json, last.total_commits);
+        json_writer_key(json, "authors");
+        json_writer_int(json, last.total_authors);
+        json_writer_key(json, "branches");
+        json_writer_int(json, last.total_branches);
+        json_writer_key(json, "files");
+        json_writer_int(json, last.total_files);
+        json_writer_key(json, "hotspots");
+        json_writer_int(json, last.hotspot_count);
+        json_writer_key(json, "activities");
+        json_writer_int(json, last.activity_count);
+        json_writer_end_object(json);
+        free_git_stats(&last);
+
+        fprintf(stderr, "  %-20s %10.2f ms (median of %d)\n", COLLECTORS[c].name,
+                samples[iterations / 2] * 1e3, iterations);
+    }
+
+    json_writer_end_array(json);
+    json_writer_end_object(json);
+}
+
+int main(int argc, char *argv[]) {
+    CollectOptions options;
+    memset(&options, 0, sizeof(options));
+    options.limit = LIMIT_DEFAULT;
+    int iterations = DEFAULT_ITERATIONS;
+    int first_repo = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            options.jobs = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            options.use_cache = 1;
+        } else if (argv[i][0] != '-') {
+            first_repo = i;
+            break;
+        } else {
+            first_repo = argc;
+            break;
+        }
+    }
+
+    if (first_repo >= argc || iterations < 1 || iterations > MAX_ITERATIONS ||
+        options.jobs < 0 || options.jobs > MAX_JOBS) {
+        fprintf(stderr, "Usage: %s [--iterations 1-%d] [--jobs N] [--cache] REPO...\n",
+                argv[0], MAX_ITERATIONS);
+        return 1;
+    }
+
+    char start_dir[MAX_PATH_LENGTH];
+    if (getcwd(start_dir, sizeof(start_dir)) == NULL) {
+        perror("getcwd");
+        return 1;
+    }
+
+    JsonWriter json;
+    if (json_writer_init(&json, stdout, 0) != 0) {
+        return 1;
+    }
+
+    json_writer_begin_object(&json);
+    json_writer_key(&json, "version");
+    json_writer_string(&json, VERSION_STRING);
+    json_writer_key(&json, "timestamp");
+    json_writer_int(&json, (long long)time(NULL));
+    json_writer_key(&json, "iterations");
+    json_writer_int(&json, iterations);
+    json_writer_key(&json, "jobs");
+    json_writer_int(&json, options.jobs);
+    json_writer_key(&json, "use_cache");
+    json_writer_bool(&json, options.use_cache);
+    json_writer_key(&json, "repositories");
+    json_writer_begin_array(&json);
+
+    int status = 0;
+    for (int i = first_repo; i < argc; i++) {
+        if (chdir(start_dir) != 0 || chdir(argv[i]) != 0 || !is_git_repository()) {
+            fprintf(stderr, "Error: %s is not a git repository\n", argv[i]);
+            status = 1;
+            continue;
+        }
+        fprintf(stderr, "%s\n", argv[i]);
+        bench_repository(&json, argv[i], &options, iterations);
+    }
+
+    json_writer_end_array(&json);
+    json_writer_end_object(&json);
+    if (json_writer_finish(&json) != 0) {
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+#include "../src/utils/line_count.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Microbenchmark for count_file_lines() against the previous fgetc loop
+ *
+ * Usage: line_count_bench [size-in-MiB] [iterations]
+ * Writes a synthetic source-like file to a temporary path, checks that both
+ * implementations agree and reports the best time and throughput of each.
+ */
+
+/* Defaults: 64 MiB file, best of 5 runs */
+#define DEFAULT_SIZE_MIB 64
+#define DEFAULT_ITERATIONS 5
+
+/**
+ * Reference implementation: the original byte-at-a-time loop
+ */
+static long count_lines_fgetc(const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    long lines = 0;
+    int ch;
+    while ((ch = fgetc(file)) != EOF) {
+        if (ch == '\n') {
+            lines++;
+        }
+    }
+
+    fclose(file);
+    return lines;
+}
+
+/**
+ * Monotonic clock in seconds
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Write size bytes of lines with varying lengths (0-119 characters)
+ */
+static int write_sample_file(const char *path, size_t size) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    unsigned int seed = 12345;
+    char line[128];
+    size_t written = 0;
+    while (written < size) {
+        seed = seed * 1103515245u + 12345u;
+        size_t length = (seed >> 16) % 120;
+        for (size_t i = 0; i < length; i++) {
+            line[i] = (char)('a' + (i + written) % 26);
+        }
+        line[length] = '\n';
+        size_t chunk = (length + 1 < size - written) ? length + 1 : size - written;
+        if (fwrite(line, 1, chunk, file) != chunk) {
+            fclose(file);
+            return -1;
+        }
+        written += chunk;
+    }
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+/**
+ * Time one implementation, returning the best of several runs
+ */
+static double time_best(long (*count)(const char *), const char *path, int iterations, long *lines) {
+    double best = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        double start = now_seconds();
+        *lines = count(path);
+        double elapsed = now_seconds() - start;
+        if (i == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    long size_mib = (argc > 1) ? strtol(argv[1], NULL, 10) : DEFAULT_SIZE_MIB;
+    int iterations = (argc > 2) ? (int)strtol(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+    if (size_mib < 1 || iterations < 1) {
+        fprintf(stderr, "Usage: %s [size-in-MiB] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    char path[] = "/tmp/git-stat-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    size_t size = (size_t)size_mib * 1024 * 1024;
+    if (write_sample_file(path, size) != 0) {
+        fprintf(stderr, "Error: Failed to write %s\n", path);
+        unlink(path);
+        return 1;
+    }
+
+    /* Warm the page cache so both runs measure counting, not disk */
+    long expected = count_lines_fgetc(path);
+
+    long old_lines, new_lines;
+    double old_time = time_best(count_lines_fgetc, path, iterations, &old_lines);
+    double new_time = time_best(count_file_lines, path, iterations, &new_lines);
+    unlink(path);
+
+    if (old_lines != expected || new_lines != expected) {
+        fprintf(stderr, "Error: Line counts differ (fgetc %ld, %s %ld)\n",
+                old_lines, newline_kernel_name(), new_lines);
+        return 1;
+    }
+
+    double mib = (double)size / (1024.0 * 1024.0);
+    printf("File: %ld MiB, %ld lines, best of %d\n", size_mib, expected, iterations);
+    printf("  fgetc          %8.2f ms  %8.1f MiB/s\n", old_time * 1e3, mib / old_time);
+    printf("  %-14s %8.2f ms  %8.1f MiB/s\n", newline_kernel_name(), new_time * 1e3, mib / new_time);
+    printf("  speedup        %8.1fx\n", old_time / new_time);
+    return 0;
+}
@@ -0,0 +1,344 @@
+#define _GNU_SOURCE
+#include "../src/utils/subprocess.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Deterministic synthetic repository generator
+ *
+ * Usage: repo_gen [--commits N] [--authors N] [--files N] [--branches N]
+ *                 [--file-lines N] [--seed N] DIR
+ * Creates DIR with `git init`, writes the whole history through
+ * `git fast-import` and checks out main. The same options always produce
+ * the same commit ids. Authors and edited files follow a skewed
+ * distribution, so a few of each dominate as in real projects; roughly
+ * one commit in five lands on a side branch forked from main.
+ */
+
+/* Defaults: a mid-sized project */
+#define DEFAULT_COMMITS 2000
+#define DEFAULT_AUTHORS 25
+#define DEFAULT_FILES 500
+#define DEFAULT_BRANCHES 8
+#define DEFAULT_FILE_LINES 200
+#define DEFAULT_SEED 1
+
+/* Commit dates start here and advance about an hour per commit */
+#define START_TIME 1600000000L
+
+/* Files touched by one commit after the initial import */
+#define MAX_FILES_PER_COMMIT 4
+
+static const char *const EXTENSIONS[] = {"c", "h", "py", "js", "go", "md", "json", "txt"};
+#define EXTENSION_COUNT ((int)(sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0])))
+
+/**
+ * Generator settings
+ */
+typedef struct {
+    long commits;
+    long authors;
+    long files;
+    long branches;
+    long file_lines;
+    unsigned long seed;
+    const char *dir;
+} RepoShape;
+
+/**
+ * Growable byte buffer for blob contents
+ */
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} Blob;
+
+/**
+ * xorshift64* step
+ */
+static unsigned long long next_random(unsigned long long *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+/**
+ * Pick from [0, count) with low indexes much more likely (cubed uniform)
+ */
+static long skewed_pick(unsigned long long *state, long count) {
+    double u = (double)(next_random(state) >> 11) / 9007199254740992.0;
+    long pick = (long)(u * u * u * (double)count);
+    return (pick < count) ? pick : count - 1;
+}
+
+/**
+ * Append formatted text to a blob
+ */
+static int blob_append(Blob *blob, const char *text, size_t length) {
+    if (blob->size + length > blob->capacity) {
+        size_t capacity = (blob->capacity > 0) ? blob->capacity * 2 : 4096;
+        while (capacity < blob->size + length) capacity *= 2;
+        char *grown = realloc(blob->data, capacity);
+        if (grown == NULL) return -1;
+        blob->data = grown;
+        blob->capacity = capacity;
+    }
+    memcpy(blob->data + blob->size, text, length); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    blob->size += length;
+    return 0;
+}
+
+/**
+ * Build version `version` of file `file`
+ * Each version rewrites about one line in seven and grows or shrinks the
+ * file a little, so numstat reports realistic churn.
+ */
+static int build_contents(Blob *blob, const RepoShape *shape, long file, long version) {
+    blob->size = 0;
+
+    unsigned long long state = shape->seed * 1000003ULL + (unsigned long long)file * 7919ULL + 1;
+    long lines = shape->file_lines / 2 + (long)(next_random(&state) % (unsigned long long)shape->file_lines);
+    lines += (version % 5) * 3;
+
+    for (long j = 0; j < lines; j++) {
+        char line[160];
+        int length;
+        unsigned long long width = (next_random(&state) % 60) + 8;
+        if ((j + version) % 7 == 0 && version > 0) {
+            length = snprintf(line, sizeof(line), "    value_%ld = compute(%ld, %ld); /* rev %ld */\n",
+                              j, file, j * version, version);
+        } else {
+            length = snprintf(line, sizeof(line), "    %.*s%ld\n", (int)width,
+                              "statement_of_synthetic_code_for_benchmarks_with_enough_width_here", j);
+        }
+        if (length < 0 || length >= (int)sizeof(line) || blob_append(blob, line, (size_t)length) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Path of a generated file, spread over a few directories
+ */
+static void file_path(char *path, size_t size, long file) {
+    snprintf(path, size, "src/module%02ld/file%05ld.%s", file % 16, file,
+             EXTENSIONS[file % EXTENSION_COUNT]);
+}
+
+/**
+ * Write one fast-import file modification with inline data
+ */
+static int write_file_change(FILE *out, const RepoShape *shape, Blob *blob, long file, long version) {
+    char path[64];
+    file_path(path, sizeof(path), file);
+    if (build_contents(blob, shape, file, version) != 0) {
+        return -1;
+    }
+    fprintf(out, "M 100644 inline %s\ndata %zu\n", path, blob->size);
+    fwrite(blob->data, 1, blob->size, out);
+    fputc('\n', out);
+    return 0;
+}
+
+/**
+ * Write the whole history as a fast-import stream
+ */
+static int write_history(FILE *out, const RepoShape *shape) {
+    unsigned long long state = shape->seed * 2654435761ULL + 17;
+    long *versions = calloc((size_t)shape->files, sizeof(long));
+    long *branch_marks = calloc((size_t)shape->branches + 1, sizeof(long));
+    Blob blob = {NULL, 0, 0};
+    if (versions == NULL || branch_marks == NULL) {
+        free(versions);
+        free(branch_marks);
+        return -1;
+    }
+
+    long main_mark = 0;
+    int result = 0;
+
+    for (long i = 0; i < shape->commits && result == 0; i++) {
+        long mark = i + 1;
+        long branch = -1;
+        if (i > 0 && shape->branches > 0 && next_random(&state) % 5 == 0) {
+            branch = (long)(next_random(&state) % (unsigned long long)shape->branches);
+        }
+
+        long author = skewed_pick(&state, shape->authors);
+        long when = START_TIME + i * 3600 + (long)(next_random(&state) % 1800);
+
+        if (branch < 0) {
+            fprintf(out, "commit refs/heads/main\n");
+        } else {
+            fprintf(out, "commit refs/heads/feature/%02ld\n", branch);
+        }
+        fprintf(out, "mark :%ld\n", mark);
+        fprintf(out, "author Author %03ld <author%03ld@example.com> %ld +0000\n", author, author, when);
+        fprintf(out, "committer Author %03ld <author%03ld@example.com> %ld +0000\n", author, author, when);
+        fprintf(out, "data <<EOF\nSynthetic commit %ld\nEOF\n", i);
+
+        /* A side branch starts from the current main tip */
+        if (branch >= 0 && branch_marks[branch] == 0) {
+            fprintf(out, "from :%ld\n", main_mark);
+        }
+
+        if (i == 0) {
+            for (long f = 0; f < shape->files && result == 0; f++) {
+                result = write_file_change(out, shape, &blob, f, 0);
+            }
+        } else {
+            long touched = 1 + (long)(next_random(&state) % MAX_FILES_PER_COMMIT);
+            for (long k = 0; k < touched && result == 0; k++) {
+                long file = skewed_pick(&state, shape->files);
+                result = write_file_change(out, shape, &blob, file, ++versions[file]);
+            }
+        }
+        fputc('\n', out);
+
+        if (branch < 0) {
+            main_mark = mark;
+        } else {
+            branch_marks[branch] = mark;
+        }
+    }
+
+    free(blob.data);
+    free(versions);
+    free(branch_marks);
+    return (result == 0 && !ferror(out)) ? 0 : -1;
+}
+
+/**
+ * Record callback that ignores git's output
+ */
+static int discard_output(char *record, size_t length, void *ctx) {
+    (void)record;
+    (void)length;
+    (void)ctx;
+    return 0;
+}
+
+/**
+ * Run a git command to completion
+ */
+static int run_git(const char *const argv[]) {
+    return subprocess_stream(argv, NULL, 0, '\n', discard_output, NULL);
+}
+
+/**
+ * Parse a positive count for an option
+ */
+static int parse_count(const char *option, const char *value, long minimum, long *out) {
+    char *end;
+    long parsed = (value != NULL) ? strtol(value, &end, 10) : -1;
+    if (value == NULL || end == value || *end != '\0' || parsed < minimum) {
+        fprintf(stderr, "Error: %s expects a number >= %ld\n", option, minimum);
+        return -1;
+    }
+    *out = parsed;
+    return 0;
+}
+
+/**
+ * Read the generator options and target directory
+ */
+static int parse_shape(int argc, char *argv[], RepoShape *shape) {
+    shape->commits = DEFAULT_COMMITS;
+    shape->authors = DEFAULT_AUTHORS;
+    shape->files = DEFAULT_FILES;
+    shape->branches = DEFAULT_BRANCHES;
+    shape->file_lines = DEFAULT_FILE_LINES;
+    shape->seed = DEFAULT_SEED;
+    shape->dir = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        long parsed;
+        int status = 0;
+
+        if (strcmp(argv[i], "--commits") == 0) {
+            status = parse_count(argv[i], value, 1, &shape->commits);
+        } else if (strcmp(argv[i], "--authors") == 0) {
+            status = parse_count(argv[i], value, 1, &shape->authors);
+        } else if (strcmp(argv[i], "--files") == 0) {
+            status = parse_count(argv[i], value, 1, &shape->files);
+        } else if (strcmp(argv[i], "--branches") == 0) {
+            status = parse_count(argv[i], value, 0, &shape->branches);
+        } else if (strcmp(argv[i], "--file-lines") == 0) {
+            status = parse_count(argv[i], value, 1, &shape->file_lines);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            status = parse_count(argv[i], value, 0, &parsed);
+            shape->seed = (unsigned long)parsed;
+        } else if (argv[i][0] != '-' && shape->dir == NULL) {
+            shape->dir = argv[i];
+            continue;
+        } else {
+            fprintf(stderr, "Error: Unknown argument '%s'\n", argv[i]);
+            return -1;
+        }
+
+        if (status != 0) return -1;
+        i++;
+    }
+
+    if (shape->dir == NULL) {
+        fprintf(stderr, "Usage: %s [--commits N] [--authors N] [--files N] [--branches N]\n"
+                        "       [--file-lines N] [--seed N] DIR\n", argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    RepoShape shape;
+    if (parse_shape(argc, argv, &shape) != 0) {
+        return 1;
+    }
+
+    if (access(shape.dir, F_OK) == 0) {
+        fprintf(stderr, "Error: %s already exists\n", shape.dir);
+        return 1;
+    }
+
+    const char *const init[] = {"git", "init", "-q", shape.dir, NULL};
+    if (run_git(init) != 0) {
+        fprintf(stderr, "Error: git init %s failed\n", shape.dir);
+        return 1;
+    }
+
+    const char *const import[] = {"git", "-C", shape.dir, "fast-import", "--quiet", NULL};
+    Subprocess proc;
+    if (subprocess_start(&proc, import, SUBPROCESS_STDIN) != 0) {
+        fprintf(stderr, "Error: Cannot start git fast-import\n");
+        return 1;
+    }
+    close(proc.output_fd);
+
+    FILE *stream = fdopen(proc.input_fd, "w");
+    int result = (stream != NULL) ? write_history(stream, &shape) : -1;
+    if (stream != NULL) {
+        if (fclose(stream) != 0) result = -1;
+    } else {
+        close(proc.input_fd);
+    }
+    if (subprocess_wait(&proc) != 0 || result != 0) {
+        fprintf(stderr, "Error: git fast-import failed\n");
+        return 1;
+    }
+
+    const char *const head[] = {"git", "-C", shape.dir, "symbolic-ref", "HEAD", "refs/heads/main", NULL};
+    const char *const checkout[] = {"git", "-C", shape.dir, "reset", "-q", "--hard", NULL};
+    if (run_git(head) != 0 || run_git(checkout) != 0) {
+        fprintf(stderr, "Error: Cannot check out main in %s\n", shape.dir);
+        return 1;
+    }
+
+    printf("%s: %ld commits, up to %ld authors, %ld files, up to %ld side branches\n", shape.dir,
+           shape.commits, shape.authors, shape.files, shape.branches);
+    return 0;
+}
@@ -1,146 +1,271 @@
 #define _GNU_SOURCE
 #include "activity.h"
 #include "../utils/string_utils.h"
-#include "../utils/git_commands.h"
+#include "../utils/log_stream.h"
+#include "../utils/string_pool.h"
+#include "../utils/top_k.h"
+#include "../utils/vector.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <math.h>
 
+/**
+ * Tally and derived columns being ranked
+ */
+typedef struct {
+    const ActivityTally *tally;
+    int *days_since_last;
+    double *scores;
+} ActivityRanking;
+
 /* Forward declarations */
-static double calculate_activity_score(int commits, int days_since_last, int lines_changed);
-static int compare_activities_by_score(const void* a, const void* b);
+static void score_activities(ActivityRanking *ranking);
+static int activity_ranks_before(int a, int b, void *ctx);
+static int store_ranked_activities(GitStats *stats, const ActivityRanking *ranking, int ranked);
+
+/**
+ * Attribute a commit to its author's activity row
+ */
+static void on_activity_commit(const LogCommit *commit, void *ctx) {
+    activity_tally_commit((ActivityTally *)ctx, commit->author, commit->date);
+}
+
+/**
+ * Add a numstat line to the author of the current commit
+ */
+static void on_activity_file(const LogFileChange *change, void *ctx) {
+    activity_tally_lines((ActivityTally *)ctx, change->lines_added, change->lines_deleted);
+}
 
 /**
  * Get author activity statistics over time
+ * Dates and line changes for every author are collected in one history pass.
+ * Only the rows that will be displayed are ranked: a bounded heap picks
+ * them, and the remaining entries follow unordered.
  */
 int get_activity_stats(GitStats *stats) {
     assert(stats != NULL);
 
-    FILE *fp = popen("git log --pretty=format:'%an|%ad|%s' --date=short --all 2>/dev/null", "r");
-    if (fp == NULL) {
+    stats->activity_count = 0;
+
+    string_pool_free(&stats->activity_names);
+    if (string_pool_init(&stats->activity_names, 0) != 0) {
         return -1;
     }
 
-    char line[MAX_LINE_LENGTH];
-    stats->activity_count = 0;
+    ActivityTally tally;
+    activity_tally_init(&tally, &stats->activity_names);
+
+    LogStreamHandler handler = { on_activity_commit, on_activity_file, &tally };
+    int result = stream_git_log(&handler, &stats->options, LOG_SCOPE_ALL);
+
+    hash_map_debug_report(&stats->activity_names.index, "activity");
+
+    if (result == 0) {
+        int ranked = display_row_count(&stats->options, tally.count, MAX_ACTIVITY_DISPLAY);
+        result = activity_tally_rank(&tally, stats, ranked);
+    }
 
-    /* Parse commit log for author activity */
-    while (fgets(line, sizeof(line), fp) != NULL) {
-        remove_trailing_newline(line);
-
-        /* Parse format: author|date|subject */
-        const char *author = strtok(line, "|");
-        const char *date = strtok(NULL, "|");
-
-        if (author == NULL || date == NULL) continue;
-
-        /* Find or create activity entry */
-        int found = 0;
-        for (int i = 0; i < stats->activity_count; i++) {
-            if (strcmp(stats->activities[i].name, author) == 0) {
-                stats->activities[i].commit_count++;
-
-                /* Update first commit date (earliest) */
-                if (strlen(stats->activities[i].first_commit_date) == 0 ||
-                    strcmp(date, stats->activities[i].first_commit_date) < 0) {
-                    safe_string_copy(stats->activities[i].first_commit_date, date,
-                                   sizeof(stats->activities[i].first_commit_date));
-                }
-
-                /* Update last commit date (latest) */
-                if (strlen(stats->activities[i].last_commit_date) == 0 ||
-                    strcmp(date, stats->activities[i].last_commit_date) > 0) {
-                    safe_string_copy(stats->activities[i].last_commit_date, date,
-                                   sizeof(stats->activities[i].last_commit_date));
-                }
-
-                found = 1;
-                break;
-            }
-        }
-
-        if (!found && stats->activity_count < MAX_AUTHORS) {
-            safe_string_copy(stats->activities[stats->activity_count].name, author,
-                           sizeof(stats->activities[stats->activity_count].name));
-            stats->activities[stats->activity_count].commit_count = 1;
-            safe_string_copy(stats->activities[stats->activity_count].first_commit_date, date,
-                           sizeof(stats->activities[stats->activity_count].first_commit_date));
-            safe_string_copy(stats->activities[stats->activity_count].last_commit_date, date,
-                           sizeof(stats->activities[stats->activity_count].last_commit_date));
-            stats->activities[stats->activity_count].lines_added = 0;
-            stats->activities[stats->activity_count].lines_deleted = 0;
-            stats->activity_count++;
-        }
+    activity_tally_free(&tally);
+    return result;
+}
+
+/**
+ * Start an empty tally
+ */
+void activity_tally_init(ActivityTally *tally, StringPool *names) {
+    assert(tally != NULL && names != NULL);
+
+    memset(tally, 0, sizeof(ActivityTally));
+    tally->names = names;
+    tally->current = -1;
+}
+
+/**
+ * Attribute a commit to its author's row
+ */
+void activity_tally_commit(ActivityTally *tally, const char *author, const char *date) {
+    assert(tally != NULL);
+    assert(author != NULL && date != NULL);
+
+    /* Name ids are dense, so a name's id is its row in the columns */
+    int needed = tally->count + 1;
+    tally->current = -1;
+    if (VECTOR_RESERVE(tally->commits, tally->commits_capacity, needed) != 0 ||
+        VECTOR_RESERVE(tally->lines_added, tally->added_capacity, needed) != 0 ||
+        VECTOR_RESERVE(tally->lines_deleted, tally->deleted_capacity, needed) != 0 ||
+        VECTOR_RESERVE(tally->dates, tally->dates_capacity, needed) != 0) {
+        return;
     }
-    pclose(fp);
-
-    /* Get line change statistics and calculate activity metrics */
-    for (int i = 0; i < stats->activity_count; i++) {
-        /* Get line statistics for this author */
-        char command[MAX_COMMAND_LENGTH];
-        int ret = snprintf(command, sizeof(command),
-                "git log --author=\"%s\" --pretty=tformat: --numstat 2>/dev/null | "
-                "awk '{add+=$1; del+=$2} END {print add\" \"del}'",
-                stats->activities[i].name);
-
-        if (ret > 0 && ret < (int)sizeof(command)) {
-            char *result = execute_git_command(command);
-            if (result != NULL) {
-                sscanf(result, "%d %d", &stats->activities[i].lines_added,
-                       &stats->activities[i].lines_deleted);
-                free(result);
-            }
-        }
-
-        /* Calculate days since last commit */
-        stats->activities[i].days_since_last_commit =
-            calculate_days_since_commit(stats->activities[i].last_commit_date);
-
-        /* Determine if author is active (committed within last 90 days) */
-        stats->activities[i].is_active = (stats->activities[i].days_since_last_commit <= 90) ? 1 : 0;
-
-        /* Calculate activity score */
-        stats->activities[i].activity_score = calculate_activity_score(
-            stats->activities[i].commit_count,
-            stats->activities[i].days_since_last_commit,
-            stats->activities[i].lines_added + stats->activities[i].lines_deleted
-        );
+
+    StringId name;
+    int inserted = string_pool_intern(tally->names, author, &name);
+    if (inserted < 0) {
+        return;
     }
 
-    /* Sort activities by score */
-    qsort(stats->activities, stats->activity_count, sizeof(AuthorActivity),
-          compare_activities_by_score);
+    ActivityDates *dates = &tally->dates[name];
+    if (inserted) {
+        tally->commits[name] = 0;
+        tally->lines_added[name] = 0;
+        tally->lines_deleted[name] = 0;
+        safe_string_copy(dates->first, date, sizeof(dates->first));
+        safe_string_copy(dates->last, date, sizeof(dates->last));
+        tally->count++;
+    }
 
-    return 0;
+    tally->commits[name]++;
+
+    /* Widen the date range; YYYY-MM-DD compares as text */
+    if (dates->first[0] == '\0' || strcmp(date, dates->first) < 0) {
+        safe_string_copy(dates->first, date, sizeof(dates->first));
+    }
+    if (dates->last[0] == '\0' || strcmp(date, dates->last) > 0) {
+        safe_string_copy(dates->last, date, sizeof(dates->last));
+    }
+
+    tally->current = (int)name;
 }
 
 /**
- * Calculate activity score based on commits, recency, and line changes
+ * Add a numstat line to the author of the last commit fed
  */
-static double calculate_activity_score(int commits, int days_since_last, int lines_changed) {
-    if (commits <= 0) return 0.0;
+void activity_tally_lines(ActivityTally *tally, int lines_added, int lines_deleted) {
+    assert(tally != NULL);
+    if (tally->current < 0) return;
 
-    /* Recency factor: more recent activity gets higher weight */
-    double recency_factor = 10000.0 / (double)(days_since_last + 1);
+    tally->lines_added[tally->current] += lines_added;
+    tally->lines_deleted[tally->current] += lines_deleted;
+}
 
-    /* Line change factor: log scale to prevent huge commits from dominating */
-    double lines_factor = log((double)(lines_changed + 1));
+/**
+ * Score the tally and store it in stats->activities
+ * Only the first `ranked` rows are ordered: a bounded heap picks them.
+ */
+int activity_tally_rank(const ActivityTally *tally, GitStats *stats, int ranked) {
+    assert(tally != NULL && stats != NULL);
+    assert(tally->names == &stats->activity_names);
+
+    stats->activity_count = 0;
+    if (tally->count == 0) {
+        return 0;
+    }
+
+    ActivityRanking ranking;
+    ranking.tally = tally;
+    ranking.days_since_last = malloc(sizeof(int) * (size_t)tally->count);
+    ranking.scores = malloc(sizeof(double) * (size_t)tally->count);
+
+    int result = -1;
+    if (ranking.days_since_last != NULL && ranking.scores != NULL) {
+        score_activities(&ranking);
+        result = store_ranked_activities(stats, &ranking, ranked);
+    }
+
+    free(ranking.days_since_last);
+    free(ranking.scores);
+    return result;
+}
 
-    /* Score = commits * recency_factor * lines_factor */
-    return (double)commits * recency_factor * lines_factor;
+/**
+ * Release a tally (not its pool)
+ */
+void activity_tally_free(ActivityTally *tally) {
+    assert(tally != NULL);
+
+    free(tally->commits);
+    free(tally->lines_added);
+    free(tally->lines_deleted);
+    free(tally->dates);
+    memset(tally, 0, sizeof(ActivityTally));
+    tally->current = -1;
 }
 
 /**
- * Comparison function for sorting activities by score
+ * Score every author: commits * (10000 / (days since last + 1)) * log(lines + 1)
+ * Recent activity weighs more, and the log scale keeps huge commits from
+ * dominating. Recency is derived per author first; the scoring loop then
+ * runs branch-free over the columns.
  */
-static int compare_activities_by_score(const void* a, const void* b) {
-    const AuthorActivity* activity_a = (const AuthorActivity*)a;
-    const AuthorActivity* activity_b = (const AuthorActivity*)b;
+static void score_activities(ActivityRanking *ranking) {
+    const ActivityTally *tally = ranking->tally;
+    for (int i = 0; i < tally->count; i++) {
+        ranking->days_since_last[i] = calculate_days_since_commit(tally->dates[i].last);
+    }
+
+    const int *commits = tally->commits;
+    const int *lines_added = tally->lines_added;
+    const int *lines_deleted = tally->lines_deleted;
+    const int *days_since_last = ranking->days_since_last;
+    double *scores = ranking->scores;
+
+    for (int i = 0; i < tally->count; i++) {
+        double recency_factor = 10000.0 / (double)(days_since_last[i] + 1);
+        double lines_factor = log((double)(lines_added[i] + lines_deleted[i] + 1));
+        scores[i] = (double)commits[i] * recency_factor * lines_factor;
+    }
+}
+
+/**
+ * Ranking for top-K selection: higher score first, ties by name
+ */
+static int activity_ranks_before(int a, int b, void *ctx) {
+    const ActivityRanking *ranking = (const ActivityRanking *)ctx;
+
+    if (ranking->scores[a] != ranking->scores[b]) {
+        return ranking->scores[a] > ranking->scores[b];
+    }
+    return strcmp(string_pool_get(ranking->tally->names, (StringId)a),
+                  string_pool_get(ranking->tally->names, (StringId)b)) < 0;
+}
+
+/**
+ * Build stats->activities: the top `ranked` authors in rank order, then
+ * the rest in discovery order
+ * @return 0 on success, -1 on allocation failure
+ */
+static int store_ranked_activities(GitStats *stats, const ActivityRanking *ranking, int ranked) {
+    const ActivityTally *tally = ranking->tally;
+
+    int *order = malloc(sizeof(int) * (size_t)(ranked > 0 ? ranked : 1));
+    unsigned char *placed = calloc((size_t)tally->count, 1);
+    if (order == NULL || placed == NULL ||
+        VECTOR_RESERVE(stats->activities, stats->activity_capacity, tally->count) != 0) {
+        free(order);
+        free(placed);
+        return -1;
+    }
+
+    ranked = top_k_select(tally->count, ranked, activity_ranks_before, (void *)ranking, order);
+    for (int i = 0; i < ranked; i++) {
+        placed[order[i]] = 1;
+    }
+
+    /* Ranked rows first, then every other row */
+    int count = 0;
+    for (int i = 0; i < tally->count + ranked; i++) {
+        int row = (i < ranked) ? order[i] : i - ranked;
+        if (i >= ranked && placed[row]) continue;
+
+        AuthorActivity *activity = &stats->activities[count++];
+        memset(activity, 0, sizeof(AuthorActivity));
+        activity->name = (StringId)row;
+        activity->commit_count = tally->commits[row];
+        activity->lines_added = tally->lines_added[row];
+        activity->lines_deleted = tally->lines_deleted[row];
+        safe_string_copy(activity->first_commit_date, tally->dates[row].first,
+                         sizeof(activity->first_commit_date));
+        safe_string_copy(activity->last_commit_date, tally->dates[row].last,
+                         sizeof(activity->last_commit_date));
+        activity->days_since_last_commit = ranking->days_since_last[row];
+        activity->is_active = (ranking->days_since_last[row] <= 90) ? 1 : 0;
+        activity->activity_score = ranking->scores[row];
+    }
+    stats->activity_count = count;
 
-    /* Sort in descending order by activity score */
-    if (activity_a->activity_score < activity_b->activity_score) return 1;
-    if (activity_a->activity_score > activity_b->activity_score) return -1;
+    free(order);
+    free(placed);
     return 0;
 }
@@ -3,6 +3,35 @@
 
 #include "../git_stats.h"
 
+/**
+ * First and last commit date of an author
+ */
+typedef struct {
+    char first[SHORT_DATE_SIZE];
+    char last[SHORT_DATE_SIZE];
+} ActivityDates;
+
+/**
+ * Per-author activity accumulated from history, one column per field,
+ * indexed by name id
+ * The counters sit in flat arrays; the dates, which are only compared per
+ * commit, are kept apart. A tally can be fed further commits and ranked
+ * again at any time.
+ */
+typedef struct {
+    StringPool *names;
+    int count;
+    int current;    /* Row of the author of the commit being fed, -1 if dropped */
+    int *commits;
+    int *lines_added;
+    int *lines_deleted;
+    ActivityDates *dates;
+    int commits_capacity;
+    int added_capacity;
+    int deleted_capacity;
+    int dates_capacity;
+} ActivityTally;
+
 /**
  * Get author activity statistics over time
  * @param stats GitStats structure to populate with activity data
@@ -10,6 +39,42 @@
  */
 int get_activity_stats(GitStats *stats);
 
+/**
+ * Start an empty tally
+ * @param tally Tally to initialize
+ * @param names Initialized pool the author names are interned in
+ */
+void activity_tally_init(ActivityTally *tally, StringPool *names);
 
+/**
+ * Attribute a commit to its author's row
+ * @param tally Tally to update
+ * @param author Author name
+ * @param date Commit date as YYYY-MM-DD
+ */
+void activity_tally_commit(ActivityTally *tally, const char *author, const char *date);
+
+/**
+ * Add a numstat line to the author of the last commit fed
+ * @param tally Tally to update
+ * @param lines_added Lines added by the change
+ * @param lines_deleted Lines deleted by the change
+ */
+void activity_tally_lines(ActivityTally *tally, int lines_added, int lines_deleted);
+
+/**
+ * Score the tally against today's date and store it in stats->activities
+ * @param tally Tally whose pool is stats->activity_names
+ * @param stats Receives the activities
+ * @param ranked Rows to put in rank order first; the rest follow unordered
+ * @return 0 on success, -1 on allocation failure
+ */
+int activity_tally_rank(const ActivityTally *tally, GitStats *stats, int ranked);
+
+/**
+ * Release a tally (not its pool)
+ * @param tally Tally to free
+ */
+void activity_tally_free(ActivityTally *tally);
 
-#endif /* ACTIVITY_H */
\ No newline at end of file
+#endif /* ACTIVITY_H */
@@ -0,0 +1,100 @@
+#include "fast_summary.h"
+#include "../utils/hyperloglog.h"
+#include "../utils/string_utils.h"
+#include "../utils/subprocess.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* Marks a commit record of the stream (%x1e) */
+#define FAST_SUMMARY_COMMIT_MARK '\x1e'
+
+/**
+ * Sketches fed by the history stream
+ */
+typedef struct {
+    HyperLogLog authors;
+    HyperLogLog files;
+    HyperLogLog extensions;
+    long commits;
+} FastSummaryPass;
+
+/* Forward declarations */
+static int add_summary_record(char *record, size_t length, void *ctx);
+
+/**
+ * Summarize history in one streaming pass with bounded memory
+ */
+int get_fast_summary(GitStats *stats) {
+    assert(stats != NULL);
+
+    get_repository_info(stats);
+    notify_stats_section(stats, STATS_SECTION_REPOSITORY);
+
+    const CollectOptions *options = &stats->options;
+    int precision = options->hll_precision;
+    FastSummaryPass pass = {0};
+    if (hyperloglog_init(&pass.authors, precision) != 0 ||
+        hyperloglog_init(&pass.files, precision) != 0 ||
+        hyperloglog_init(&pass.extensions, precision) != 0) {
+        hyperloglog_free(&pass.authors);
+        hyperloglog_free(&pass.files);
+        hyperloglog_free(&pass.extensions);
+        return -1;
+    }
+
+    /*
+     * -z leaves paths unquoted and ends each with a NUL, which also ends the
+     * commit line; the first path of a commit follows a newline.
+     */
+    HistoryWindowArgs window;
+    const char *argv[10] = {"git", "log", "--all", "-z", "--no-renames", "--name-only",
+                            "--format=%x1e%aN", NULL};
+    append_history_window(options, &window, argv, 7);
+    int result = subprocess_stream(argv, NULL, 0, '\0', add_summary_record, &pass);
+
+    if (result == 0) {
+        stats->total_commits = (pass.commits <= INT_MAX) ? (int)pass.commits : INT_MAX;
+
+        DistinctEstimates *estimates = &stats->estimates;
+        estimates->enabled = 1;
+        estimates->precision = precision;
+        estimates->standard_error = hyperloglog_standard_error(precision);
+        estimates->memory = 3 * hyperloglog_size(precision);
+        estimates->authors = hyperloglog_estimate(&pass.authors);
+        estimates->files = hyperloglog_estimate(&pass.files);
+        estimates->extensions = hyperloglog_estimate(&pass.extensions);
+        notify_stats_section(stats, STATS_SECTION_COMMITS);
+    }
+
+    hyperloglog_free(&pass.authors);
+    hyperloglog_free(&pass.files);
+    hyperloglog_free(&pass.extensions);
+    return (result == 0) ? 0 : -1;
+}
+
+/**
+ * Add one NUL-terminated record of the stream: a commit's author or a
+ * path it touched
+ */
+static int add_summary_record(char *record, size_t length, void *ctx) {
+    FastSummaryPass *pass = (FastSummaryPass *)ctx;
+
+    if (length > 0 && record[0] == FAST_SUMMARY_COMMIT_MARK) {
+        pass->commits++;
+        hyperloglog_add(&pass->authors, record + 1);
+        return 0;
+    }
+
+    if (length > 0 && record[0] == '\n') {
+        record++;
+    }
+    if (record[0] != '\0') {
+        char extension[MAX_EXTENSION_LENGTH];
+        get_file_extension(record, extension, sizeof(extension));
+        hyperloglog_add(&pass->files, record);
+        hyperloglog_add(&pass->extensions, extension);
+    }
+    return 0;
+}
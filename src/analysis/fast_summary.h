@@ -0,0 +1,18 @@
+#ifndef FAST_SUMMARY_H
+#define FAST_SUMMARY_H
+
+#include "../git_stats.h"
+
+/**
+ * Summarize history in one streaming pass with bounded memory (--fast)
+ * Counts commits exactly and estimates the distinct authors, paths ever
+ * touched and extensions of those paths with HyperLogLog sketches of
+ * stats->options.hll_precision, filling stats->total_commits and
+ * stats->estimates. Nothing grows with the size of history, so the
+ * history cache is not read.
+ * @param stats GitStats structure to populate
+ * @return 0 on success, -1 on error
+ */
+int get_fast_summary(GitStats *stats);
+
+#endif /* FAST_SUMMARY_H */
@@ -1,116 +1,641 @@
 #define _GNU_SOURCE
 #include "hotspots.h"
 #include "../utils/string_utils.h"
-#include "../utils/git_commands.h"
+#include "../utils/log_stream.h"
+#include "../utils/hash_map.h"
+#include "../utils/string_pool.h"
+#include "../utils/top_k.h"
+#include "../utils/vector.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <math.h>
 
+/**
+ * Tally and scores being ranked
+ */
+typedef struct {
+    const HotspotTally *tally;
+    const double *scores;
+} HotspotRanking;
+
+/* Path bytes budgeted per sketch counter; longer paths use less common room */
+#define HOTSPOT_SKETCH_PATH_BYTES 64
+
+/* Marks an empty slot of the sketch index */
+#define HOTSPOT_SKETCH_EMPTY -1
+
+/**
+ * A path monitored by the sketch
+ */
+typedef struct {
+    char *path;
+    uint64_t hash;
+    int commits;        /* Estimate: at least the true count, at most error more */
+    int error;          /* Commits inherited from the path it replaced */
+    int lines_added;    /* Since monitoring started */
+    int lines_deleted;
+    int heap_position;
+} HotspotCounter;
+
+/**
+ * Space-Saving summary of path churn (Metwally et al.) within a fixed
+ * memory budget
+ * Up to `capacity` paths are monitored. A path that is not monitored
+ * replaces the one with the fewest commits, and more while its copy does
+ * not fit in the path budget. A path's true count when it is evicted is at
+ * most its counter, so no unmonitored path has more commits than the most
+ * any evicted counter held; a newcomer inherits that running maximum, and
+ * every estimate is an upper bound. With one eviction per newcomer this is
+ * the classic rule of inheriting the minimum, and any path changed in more
+ * than changes / capacity commits is sure to be monitored. A min-heap on
+ * commits finds the path to replace, and an open-addressing index finds a
+ * path's counter; both are allocated once.
+ */
+typedef struct {
+    HotspotCounter *counters;   /* counters[0 .. count) */
+    int *heap;                  /* Counter ids, fewest commits first */
+    int *index;                 /* Counter id per slot, or HOTSPOT_SKETCH_EMPTY */
+    size_t index_mask;
+    int count;
+    int capacity;
+    size_t path_bytes;          /* Held by the paths of counters */
+    size_t path_budget;
+    long long changes;
+    long long evictions;
+    int max_evicted;            /* Most commits of any counter evicted so far */
+    long long oversized_changes;    /* Changes to paths longer than the whole path budget */
+} HotspotSketch;
+
+/**
+ * Sketch and scores being ranked
+ */
+typedef struct {
+    const HotspotSketch *sketch;
+    const double *scores;
+} SketchRanking;
+
 /* Forward declarations */
-static double calculate_hotspot_score(int commits, int lines_added, int lines_deleted);
-static int compare_hotspots_by_score(const void* a, const void* b);
+static int get_approximate_hotspot_stats(GitStats *stats);
+static int hotspot_sketch_init(HotspotSketch *sketch, size_t memory_budget);
+static void hotspot_sketch_file(HotspotSketch *sketch, const char *path, int lines_added, int lines_deleted);
+static int hotspot_sketch_rank(const HotspotSketch *sketch, GitStats *stats, int ranked);
+static void hotspot_sketch_free(HotspotSketch *sketch);
+static size_t sketch_find(const HotspotSketch *sketch, const char *path, uint64_t hash);
+static void sketch_remove(HotspotSketch *sketch, int id);
+static void sketch_index_delete(HotspotSketch *sketch, size_t slot);
+static void sketch_heap_swap(HotspotSketch *sketch, int a, int b);
+static void sketch_sift_up(HotspotSketch *sketch, int position);
+static void sketch_sift_down(HotspotSketch *sketch, int position);
+static int sketch_ranks_before(int a, int b, void *ctx);
+static void score_hotspots(const HotspotTally *tally, double *scores);
+static int hotspot_ranks_before(int a, int b, void *ctx);
+static int store_ranked_hotspots(GitStats *stats, const HotspotRanking *ranking, int ranked);
+
+/**
+ * Count a numstat line towards its file's churn
+ */
+static void on_hotspot_file(const LogFileChange *change, void *ctx) {
+    hotspot_tally_file((HotspotTally *)ctx, change->path, change->lines_added, change->lines_deleted);
+}
+
+/**
+ * Count a numstat line in the sketch
+ */
+static void on_sketch_file(const LogFileChange *change, void *ctx) {
+    hotspot_sketch_file((HotspotSketch *)ctx, change->path, change->lines_added, change->lines_deleted);
+}
 
 /**
  * Get file hotspot statistics
+ * Commit counts and line changes per path come from a single
+ * `git log HEAD --numstat` pass instead of one history walk per file.
+ * Only the history of HEAD counts: paths that exist only on other
+ * branches are not hotspots of the checked-out code.
+ * Only the rows that will be displayed are ranked: a bounded heap picks
+ * them, and the remaining entries follow unordered.
  */
 int get_hotspot_stats(GitStats *stats) {
     assert(stats != NULL);
 
-    FILE *fp = popen("git log --name-only --pretty=format: 2>/dev/null", "r");
-    if (fp == NULL) {
+    if (stats->options.approximate_hotspots) {
+        return get_approximate_hotspot_stats(stats);
+    }
+
+    stats->hotspot_count = 0;
+    string_pool_free(&stats->hotspot_paths);
+    if (string_pool_init(&stats->hotspot_paths, 0) != 0) {
         return -1;
     }
 
-    char filename[MAX_LINE_LENGTH];
+    HotspotTally tally;
+    hotspot_tally_init(&tally, &stats->hotspot_paths);
+
+    LogStreamHandler handler = { NULL, on_hotspot_file, &tally };
+    int result = stream_git_log(&handler, &stats->options, LOG_SCOPE_HEAD);
+
+    hash_map_debug_report(&stats->hotspot_paths.index, "hotspots");
+
+    if (result == 0) {
+        int ranked = display_row_count(&stats->options, tally.count, MAX_HOTSPOTS_DISPLAY);
+        result = hotspot_tally_rank(&tally, stats, ranked);
+    }
+
+    hotspot_tally_free(&tally);
+    return result;
+}
+
+/**
+ * Start an empty tally
+ */
+void hotspot_tally_init(HotspotTally *tally, StringPool *paths) {
+    assert(tally != NULL && paths != NULL);
+
+    memset(tally, 0, sizeof(HotspotTally));
+    tally->paths = paths;
+}
+
+/**
+ * Count one numstat line towards its path's churn
+ */
+void hotspot_tally_file(HotspotTally *tally, const char *path, int lines_added, int lines_deleted) {
+    assert(tally != NULL && path != NULL);
+
+    /* Path ids are dense, so a path's id is its row in the columns */
+    int needed = tally->count + 1;
+    if (VECTOR_RESERVE(tally->commits, tally->commits_capacity, needed) != 0 ||
+        VECTOR_RESERVE(tally->lines_added, tally->added_capacity, needed) != 0 ||
+        VECTOR_RESERVE(tally->lines_deleted, tally->deleted_capacity, needed) != 0) {
+        return;
+    }
+
+    StringId id;
+    int inserted = string_pool_intern(tally->paths, path, &id);
+    if (inserted < 0) {
+        return;
+    }
+    if (inserted) {
+        tally->commits[id] = 0;
+        tally->lines_added[id] = 0;
+        tally->lines_deleted[id] = 0;
+        tally->count++;
+    }
+
+    tally->commits[id]++;
+    tally->lines_added[id] += lines_added;
+    tally->lines_deleted[id] += lines_deleted;
+}
+
+/**
+ * Score the tally and store it in stats->hotspots
+ * Only the first `ranked` rows are ordered: a bounded heap picks them.
+ */
+int hotspot_tally_rank(const HotspotTally *tally, GitStats *stats, int ranked) {
+    assert(tally != NULL && stats != NULL);
+    assert(tally->paths == &stats->hotspot_paths);
+
     stats->hotspot_count = 0;
+    if (tally->count == 0) {
+        return 0;
+    }
+
+    double *scores = malloc(sizeof(double) * (size_t)tally->count);
+    if (scores == NULL) {
+        return -1;
+    }
+    score_hotspots(tally, scores);
 
-    /* Count commits per file */
-    while (fgets(filename, sizeof(filename), fp) != NULL) {
-        remove_trailing_newline(filename);
+    HotspotRanking ranking = { tally, scores };
+    int result = store_ranked_hotspots(stats, &ranking, ranked);
+    free(scores);
+    return result;
+}
 
-        /* Skip empty lines */
-        if (strlen(filename) == 0) continue;
+/**
+ * Release a tally (not its pool)
+ */
+void hotspot_tally_free(HotspotTally *tally) {
+    assert(tally != NULL);
 
-        /* Skip if filename is too long */
-        if (strlen(filename) >= MAX_PATH_LENGTH) continue;
+    free(tally->commits);
+    free(tally->lines_added);
+    free(tally->lines_deleted);
+    memset(tally, 0, sizeof(HotspotTally));
+}
 
-        /* Find or create hotspot entry */
-        int found = 0;
-        for (int i = 0; i < stats->hotspot_count; i++) {
-            if (strcmp(stats->hotspots[i].filename, filename) == 0) {
-                stats->hotspots[i].commit_count++;
-                found = 1;
-                break;
-            }
+/**
+ * Score every path: commits * sqrt(lines changed + 1)
+ * The +1 prevents sqrt(0) and gives small weight to files with commits
+ * but no line data (binary files). The loop is branch-free over the
+ * columns so the compiler can vectorize it.
+ */
+static void score_hotspots(const HotspotTally *tally, double *scores) {
+    const int *commits = tally->commits;
+    const int *lines_added = tally->lines_added;
+    const int *lines_deleted = tally->lines_deleted;
+
+    for (int i = 0; i < tally->count; i++) {
+        int total_lines = lines_added[i] + lines_deleted[i];
+        scores[i] = (double)commits[i] * sqrt((double)(total_lines + 1));
+    }
+}
+
+/**
+ * Ranking for top-K selection: higher score first, ties by path
+ */
+static int hotspot_ranks_before(int a, int b, void *ctx) {
+    const HotspotRanking *ranking = (const HotspotRanking *)ctx;
+
+    if (ranking->scores[a] != ranking->scores[b]) {
+        return ranking->scores[a] > ranking->scores[b];
+    }
+    return strcmp(string_pool_get(ranking->tally->paths, (StringId)a),
+                  string_pool_get(ranking->tally->paths, (StringId)b)) < 0;
+}
+
+/**
+ * Build stats->hotspots: the top `ranked` paths in rank order, then the
+ * rest in discovery order
+ * @return 0 on success, -1 on allocation failure
+ */
+static int store_ranked_hotspots(GitStats *stats, const HotspotRanking *ranking, int ranked) {
+    const HotspotTally *tally = ranking->tally;
+
+    int *order = malloc(sizeof(int) * (size_t)(ranked > 0 ? ranked : 1));
+    unsigned char *placed = calloc((size_t)tally->count, 1);
+    if (order == NULL || placed == NULL ||
+        VECTOR_RESERVE(stats->hotspots, stats->hotspot_capacity, tally->count) != 0) {
+        free(order);
+        free(placed);
+        return -1;
+    }
+
+    ranked = top_k_select(tally->count, ranked, hotspot_ranks_before, (void *)ranking, order);
+    for (int i = 0; i < ranked; i++) {
+        placed[order[i]] = 1;
+    }
+
+    /* Ranked rows first, then every other row */
+    int count = 0;
+    for (int i = 0; i < tally->count + ranked; i++) {
+        int row = (i < ranked) ? order[i] : i - ranked;
+        if (i >= ranked && placed[row]) continue;
+
+        FileHotspot *hotspot = &stats->hotspots[count++];
+        hotspot->filename = (StringId)row;
+        hotspot->commit_count = tally->commits[row];
+        hotspot->lines_added = tally->lines_added[row];
+        hotspot->lines_deleted = tally->lines_deleted[row];
+        hotspot->hotspot_score = ranking->scores[row];
+        hotspot->commit_error = 0;
+    }
+    stats->hotspot_count = count;
+
+    free(order);
+    free(placed);
+    return 0;
+}
+
+/**
+ * Rank hotspots from a Space-Saving sketch that never outgrows
+ * options.memory_budget (--hotspots=approx)
+ */
+static int get_approximate_hotspot_stats(GitStats *stats) {
+    stats->hotspot_count = 0;
+    string_pool_free(&stats->hotspot_paths);
+    if (string_pool_init(&stats->hotspot_paths, 0) != 0) {
+        return -1;
+    }
+
+    HotspotSketch sketch;
+    if (hotspot_sketch_init(&sketch, stats->options.memory_budget) != 0) {
+        return -1;
+    }
+
+    LogStreamHandler handler = { NULL, on_sketch_file, &sketch };
+    int result = stream_git_log(&handler, &stats->options, LOG_SCOPE_HEAD);
+
+    if (result == 0) {
+        /* Only ranked rows are kept, so the output stays within the budget too */
+        int ranked = display_row_count(&stats->options, sketch.count, MAX_HOTSPOTS_DISPLAY);
+        result = hotspot_sketch_rank(&sketch, stats, ranked);
+    }
+
+    HotspotAccuracy *accuracy = &stats->hotspot_accuracy;
+    accuracy->approximate = 1;
+    accuracy->counters = sketch.capacity;
+    accuracy->changes = sketch.changes;
+    accuracy->evictions = sketch.evictions;
+    /* Paths too long to monitor at all may have had every such change */
+    long long unmonitored = (sketch.oversized_changes > sketch.max_evicted) ?
+                            sketch.oversized_changes : sketch.max_evicted;
+    accuracy->max_unmonitored_commits = (unmonitored > INT_MAX) ? INT_MAX : (int)unmonitored;
+    accuracy->oversized_changes = sketch.oversized_changes;
+    accuracy->memory_budget = stats->options.memory_budget;
+
+    hotspot_sketch_free(&sketch);
+    return result;
+}
+
+/**
+ * Size a sketch to a memory budget
+ * The budget covers the counters, heap and index, which are allocated
+ * here, and the path copies made later.
+ * @return 0 on success, -1 on allocation failure
+ */
+static int hotspot_sketch_init(HotspotSketch *sketch, size_t memory_budget) {
+    memset(sketch, 0, sizeof(HotspotSketch));
+
+    /* The index has between two and four slots per counter */
+    size_t per_counter = sizeof(HotspotCounter) + sizeof(int) * 5 + HOTSPOT_SKETCH_PATH_BYTES;
+    size_t capacity = memory_budget / per_counter;
+    if (capacity > INT_MAX / 4) {
+        capacity = INT_MAX / 4;
+    }
+    if (capacity < 1) {
+        return -1;
+    }
+
+    size_t index_size = 1;
+    while (index_size < capacity * 2) {
+        index_size *= 2;
+    }
+
+    sketch->counters = malloc(sizeof(HotspotCounter) * capacity);
+    sketch->heap = malloc(sizeof(int) * capacity);
+    sketch->index = malloc(sizeof(int) * index_size);
+    if (sketch->counters == NULL || sketch->heap == NULL || sketch->index == NULL) {
+        hotspot_sketch_free(sketch);
+        return -1;
+    }
+    memset(sketch->index, 0xff, sizeof(int) * index_size); /* HOTSPOT_SKETCH_EMPTY */
+
+    size_t fixed = (sizeof(HotspotCounter) + sizeof(int)) * capacity + sizeof(int) * index_size;
+    sketch->capacity = (int)capacity;
+    sketch->index_mask = index_size - 1;
+    sketch->path_budget = memory_budget - fixed;
+    return 0;
+}
+
+/**
+ * Count one numstat line towards its path's churn
+ * An unmonitored path replaces the least changed monitored one, and
+ * further ones while its copy would not fit in the path budget.
+ */
+static void hotspot_sketch_file(HotspotSketch *sketch, const char *path, int lines_added, int lines_deleted) {
+    sketch->changes++;
+
+    uint64_t hash = hash_map_hash(path);
+    size_t slot = sketch_find(sketch, path, hash);
+    int id = sketch->index[slot];
+    if (id != HOTSPOT_SKETCH_EMPTY) {
+        HotspotCounter *counter = &sketch->counters[id];
+        counter->commits++;
+        counter->lines_added += lines_added;
+        counter->lines_deleted += lines_deleted;
+        sketch_sift_down(sketch, counter->heap_position);
+        return;
+    }
+
+    size_t length = strlen(path) + 1;
+    if (length > sketch->path_budget) {
+        sketch->oversized_changes++;
+        return;
+    }
+
+    while (sketch->count > 0 &&
+           (sketch->count == sketch->capacity || sketch->path_bytes + length > sketch->path_budget)) {
+        int least = sketch->heap[0];
+        if (sketch->counters[least].commits > sketch->max_evicted) {
+            sketch->max_evicted = sketch->counters[least].commits;
+        }
+        sketch_remove(sketch, least);
+        sketch->evictions++;
+    }
+
+    /* The newcomer may have been seen as often as any evicted path */
+    int inherited = sketch->max_evicted;
+
+    char *copy = malloc(length);
+    if (copy == NULL) {
+        return;
+    }
+    memcpy(copy, path, length); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+
+    /* Removals may have moved entries, so look for the free slot again */
+    slot = sketch_find(sketch, path, hash);
+    id = sketch->count++;
+    HotspotCounter *counter = &sketch->counters[id];
+    counter->path = copy;
+    counter->hash = hash;
+    counter->commits = inherited + 1;
+    counter->error = inherited;
+    counter->lines_added = lines_added;
+    counter->lines_deleted = lines_deleted;
+    counter->heap_position = id;
+    sketch->heap[id] = id;
+    sketch->index[slot] = id;
+    sketch->path_bytes += length;
+    sketch_sift_up(sketch, id);
+}
+
+/**
+ * Score the monitored paths and store the top `ranked` in stats->hotspots
+ * @return 0 on success, -1 on allocation failure
+ */
+static int hotspot_sketch_rank(const HotspotSketch *sketch, GitStats *stats, int ranked) {
+    if (sketch->count == 0) {
+        return 0;
+    }
+
+    double *scores = malloc(sizeof(double) * (size_t)sketch->count);
+    int *order = malloc(sizeof(int) * (size_t)(ranked > 0 ? ranked : 1));
+    if (scores == NULL || order == NULL ||
+        VECTOR_RESERVE(stats->hotspots, stats->hotspot_capacity, ranked > 0 ? ranked : 1) != 0) {
+        free(scores);
+        free(order);
+        return -1;
+    }
+
+    for (int i = 0; i < sketch->count; i++) {
+        const HotspotCounter *counter = &sketch->counters[i];
+        int total_lines = counter->lines_added + counter->lines_deleted;
+        scores[i] = (double)counter->commits * sqrt((double)(total_lines + 1));
+    }
+
+    SketchRanking ranking = { sketch, scores };
+    ranked = top_k_select(sketch->count, ranked, sketch_ranks_before, &ranking, order);
+
+    int result = 0;
+    for (int i = 0; i < ranked; i++) {
+        const HotspotCounter *counter = &sketch->counters[order[i]];
+        StringId path;
+        if (string_pool_intern(&stats->hotspot_paths, counter->path, &path) < 0) {
+            result = -1;
+            break;
         }
 
-        if (!found && stats->hotspot_count < MAX_FILES) {
-            safe_string_copy(stats->hotspots[stats->hotspot_count].filename,
-                           filename, sizeof(stats->hotspots[stats->hotspot_count].filename));
-            stats->hotspots[stats->hotspot_count].commit_count = 1;
-            stats->hotspots[stats->hotspot_count].lines_added = 0;
-            stats->hotspots[stats->hotspot_count].lines_deleted = 0;
-            stats->hotspot_count++;
+        FileHotspot *hotspot = &stats->hotspots[stats->hotspot_count++];
+        hotspot->filename = path;
+        hotspot->commit_count = counter->commits;
+        hotspot->lines_added = counter->lines_added;
+        hotspot->lines_deleted = counter->lines_deleted;
+        hotspot->hotspot_score = scores[order[i]];
+        hotspot->commit_error = counter->error;
+    }
+
+    free(scores);
+    free(order);
+    return result;
+}
+
+/**
+ * Release a sketch
+ */
+static void hotspot_sketch_free(HotspotSketch *sketch) {
+    if (sketch->counters != NULL) {
+        for (int i = 0; i < sketch->count; i++) {
+            free(sketch->counters[i].path);
         }
     }
-    pclose(fp);
-
-    /* Get line change statistics for each file */
-    for (int i = 0; i < stats->hotspot_count; i++) {
-        char command[MAX_COMMAND_LENGTH];
-        int ret = snprintf(command, sizeof(command),
-                "git log --numstat --pretty=format: -- \"%s\" 2>/dev/null | "
-                "awk '{add+=$1; del+=$2} END {print add\" \"del}'",
-                stats->hotspots[i].filename);
-
-        if (ret > 0 && ret < (int)sizeof(command)) {
-            char *result = execute_git_command(command);
-            if (result != NULL) {
-                sscanf(result, "%d %d", &stats->hotspots[i].lines_added,
-                       &stats->hotspots[i].lines_deleted);
-                free(result);
-            }
+    free(sketch->counters);
+    free(sketch->heap);
+    free(sketch->index);
+    memset(sketch, 0, sizeof(HotspotSketch));
+}
+
+/**
+ * Find the index slot holding a path, or the empty slot where it belongs
+ */
+static size_t sketch_find(const HotspotSketch *sketch, const char *path, uint64_t hash) {
+    size_t slot = (size_t)hash & sketch->index_mask;
+    while (sketch->index[slot] != HOTSPOT_SKETCH_EMPTY) {
+        const HotspotCounter *counter = &sketch->counters[sketch->index[slot]];
+        if (counter->hash == hash && strcmp(counter->path, path) == 0) {
+            break;
         }
+        slot = (slot + 1) & sketch->index_mask;
+    }
+    return slot;
+}
+
+/**
+ * Stop monitoring a path
+ * The last counter moves into the freed one, so counters stay dense.
+ */
+static void sketch_remove(HotspotSketch *sketch, int id) {
+    HotspotCounter *counter = &sketch->counters[id];
 
-        /* Calculate hotspot score */
-        stats->hotspots[i].hotspot_score = calculate_hotspot_score(
-            stats->hotspots[i].commit_count,
-            stats->hotspots[i].lines_added,
-            stats->hotspots[i].lines_deleted
-        );
+    sketch_index_delete(sketch, sketch_find(sketch, counter->path, counter->hash));
+    sketch->path_bytes -= strlen(counter->path) + 1;
+    free(counter->path);
+
+    /* Take it out of the heap: the last element fills its place */
+    int position = counter->heap_position;
+    int last = sketch->count - 1;
+    if (position != last) {
+        sketch_heap_swap(sketch, position, last);
+    }
+    sketch->count--;
+    if (position < sketch->count) {
+        sketch_sift_down(sketch, position);
+        sketch_sift_up(sketch, position);
     }
 
-    /* Sort hotspots by score */
-    qsort(stats->hotspots, stats->hotspot_count, sizeof(FileHotspot),
-          compare_hotspots_by_score);
+    /* Move the last counter into the freed id */
+    if (id != sketch->count) {
+        HotspotCounter *moved = &sketch->counters[sketch->count];
+        size_t slot = (size_t)moved->hash & sketch->index_mask;
+        while (sketch->index[slot] != sketch->count) {
+            slot = (slot + 1) & sketch->index_mask;
+        }
+        sketch->index[slot] = id;
+        sketch->heap[moved->heap_position] = id;
+        *counter = *moved;
+    }
+}
 
-    return 0;
+/**
+ * Empty an index slot, shifting later entries of its probe run back so
+ * that every entry stays reachable
+ */
+static void sketch_index_delete(HotspotSketch *sketch, size_t slot) {
+    size_t mask = sketch->index_mask;
+    size_t next = (slot + 1) & mask;
+
+    while (sketch->index[next] != HOTSPOT_SKETCH_EMPTY) {
+        size_t home = (size_t)sketch->counters[sketch->index[next]].hash & mask;
+
+        /* Move the entry back unless its home lies cyclically in (slot, next] */
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            sketch->index[slot] = sketch->index[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    sketch->index[slot] = HOTSPOT_SKETCH_EMPTY;
 }
 
 /**
- * Calculate hotspot score based on commits and line changes
+ * Exchange two heap elements and update their counters' positions
  */
-static double calculate_hotspot_score(int commits, int lines_added, int lines_deleted) {
-    if (commits <= 0) return 0.0;
+static void sketch_heap_swap(HotspotSketch *sketch, int a, int b) {
+    int id = sketch->heap[a];
+    sketch->heap[a] = sketch->heap[b];
+    sketch->heap[b] = id;
+    sketch->counters[sketch->heap[a]].heap_position = a;
+    sketch->counters[sketch->heap[b]].heap_position = b;
+}
 
-    int total_lines = lines_added + lines_deleted;
+/**
+ * Restore the heap order above a position
+ */
+static void sketch_sift_up(HotspotSketch *sketch, int position) {
+    while (position > 0) {
+        int parent = (position - 1) / 2;
+        if (sketch->counters[sketch->heap[parent]].commits <=
+            sketch->counters[sketch->heap[position]].commits) {
+            break;
+        }
+        sketch_heap_swap(sketch, parent, position);
+        position = parent;
+    }
+}
 
-    /* Score = commits * sqrt(total_lines + 1) */
-    /* The +1 prevents sqrt(0) and gives small weight to files with commits but no line data */
-    return (double)commits * sqrt((double)(total_lines + 1));
+/**
+ * Restore the heap order below a position
+ */
+static void sketch_sift_down(HotspotSketch *sketch, int position) {
+    for (;;) {
+        int least = position;
+        int left = position * 2 + 1;
+        int right = left + 1;
+        if (left < sketch->count &&
+            sketch->counters[sketch->heap[left]].commits < sketch->counters[sketch->heap[least]].commits) {
+            least = left;
+        }
+        if (right < sketch->count &&
+            sketch->counters[sketch->heap[right]].commits < sketch->counters[sketch->heap[least]].commits) {
+            least = right;
+        }
+        if (least == position) {
+            return;
+        }
+        sketch_heap_swap(sketch, position, least);
+        position = least;
+    }
 }
 
 /**
- * Comparison function for sorting hotspots by score
+ * Ranking for top-K selection of sketch counters: higher score first,
+ * ties by path
  */
-static int compare_hotspots_by_score(const void* a, const void* b) {
-    const FileHotspot* hotspot_a = (const FileHotspot*)a;
-    const FileHotspot* hotspot_b = (const FileHotspot*)b;
+static int sketch_ranks_before(int a, int b, void *ctx) {
+    const SketchRanking *ranking = (const SketchRanking *)ctx;
 
-    /* Sort in descending order by hotspot score */
-    if (hotspot_a->hotspot_score < hotspot_b->hotspot_score) return 1;
-    if (hotspot_a->hotspot_score > hotspot_b->hotspot_score) return -1;
-    return 0;
-}
\ No newline at end of file
+    if (ranking->scores[a] != ranking->scores[b]) {
+        return ranking->scores[a] > ranking->scores[b];
+    }
+    return strcmp(ranking->sketch->counters[a].path, ranking->sketch->counters[b].path) < 0;
+}
@@ -4,12 +4,59 @@
 #include "../git_stats.h"
 
 /**
- * Get file hotspot statistics
+ * Per-path churn accumulated from history, one column per field, indexed
+ * by path id
+ * Each numstat line touches only these counters. A tally can be fed
+ * further commits and ranked again at any time, so history that has
+ * already been counted never needs another walk.
+ */
+typedef struct {
+    StringPool *paths;
+    int count;
+    int *commits;
+    int *lines_added;
+    int *lines_deleted;
+    int commits_capacity;
+    int added_capacity;
+    int deleted_capacity;
+} HotspotTally;
+
+/**
+ * Get file hotspot statistics over the history of HEAD
  * @param stats GitStats structure to populate with hotspot data
  * @return 0 on success, -1 on error
  */
 int get_hotspot_stats(GitStats *stats);
 
+/**
+ * Start an empty tally
+ * @param tally Tally to initialize
+ * @param paths Initialized pool the paths are interned in
+ */
+void hotspot_tally_init(HotspotTally *tally, StringPool *paths);
 
+/**
+ * Count one numstat line towards its path's churn
+ * @param tally Tally to update
+ * @param path Changed path
+ * @param lines_added Lines added to the path
+ * @param lines_deleted Lines deleted from the path
+ */
+void hotspot_tally_file(HotspotTally *tally, const char *path, int lines_added, int lines_deleted);
+
+/**
+ * Score the tally and store it in stats->hotspots
+ * @param tally Tally whose pool is stats->hotspot_paths
+ * @param stats Receives the hotspots
+ * @param ranked Rows to put in rank order first; the rest follow unordered
+ * @return 0 on success, -1 on allocation failure
+ */
+int hotspot_tally_rank(const HotspotTally *tally, GitStats *stats, int ranked);
+
+/**
+ * Release a tally (not its pool)
+ * @param tally Tally to free
+ */
+void hotspot_tally_free(HotspotTally *tally);
 
-#endif /* HOTSPOTS_H */
\ No newline at end of file
+#endif /* HOTSPOTS_H */
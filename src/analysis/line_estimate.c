@@ -0,0 +1,470 @@
+#define _GNU_SOURCE
+#include "line_estimate.h"
+#include "../utils/blob_stream.h"
+#include "../utils/git_commands.h"
+#include "../utils/git_index.h"
+#include "../utils/git_repo.h"
+#include "../utils/hash_map.h"
+#include "../utils/parallel.h"
+#include "../utils/string_utils.h"
+#include "../utils/subprocess.h"
+#include "../utils/vector.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* Two-sided 95% quantile of the normal distribution */
+#define LINE_ESTIMATE_Z 1.96
+
+/* Sampled files handed to a counting worker per claim; also the number of
+ * requests pipelined to cat-file at once */
+#define SAMPLE_COUNT_BATCH BLOB_STREAM_MAX_PENDING
+
+/**
+ * Tracked files with their sizes
+ */
+typedef struct {
+    TreeBlob *files;
+    int count;
+    int capacity;
+} SizedFileList;
+
+/**
+ * Files of one extension and the part of the sample drawn from them
+ */
+typedef struct {
+    char extension[MAX_EXTENSION_LENGTH];
+    int count;
+    long long bytes;
+    int sample_start;   /* Into the sample array */
+    int sampled;
+} Stratum;
+
+/**
+ * Place of a file in the draw: each stratum samples its lowest keys
+ */
+typedef struct {
+    uint64_t key;
+    int stratum;
+    int file;
+} SampleCandidate;
+
+/**
+ * Work shared by the workers counting the sample
+ * With a revision, blobs are read through one cat-file process per worker;
+ * otherwise the working tree copies are read.
+ */
+typedef struct {
+    const TreeBlob *files;
+    const int *sample;  /* Indexes into files */
+    long *lines;        /* Lines of each sampled file, -1 if unreadable */
+    int sample_count;
+    const char *rev;    /* NULL to count the working tree */
+    atomic_int next;    /* Next unclaimed index into sample */
+    atomic_int failed;
+} SampleCountJob;
+
+/* Forward declarations */
+static int list_sized_files(const char *git_dir, SizedFileList *list);
+static int add_index_entry(const char *path, uint32_t mode, uint32_t size, void *ctx);
+static int add_listed_file(char *path, size_t length, void *ctx);
+static int append_file(SizedFileList *list, const char *path, size_t length);
+static int draw_sample(const TreeBlob *files, int file_count, int sample_size,
+                       Stratum **strata, int *stratum_count, int **sample, int *sample_count);
+static void count_sample_worker(int worker_index, void *ctx);
+static int count_sample_batch(BlobStream *stream, SampleCountJob *job, int start, int end);
+static double estimate_stratum(const Stratum *stratum, const TreeBlob *files,
+                               const int *sample, const long *lines, double *variance);
+static int compare_candidates(const void *a, const void *b);
+
+/**
+ * Estimate lines per file type from a stratified sample
+ * Files are drawn by the hash of their path, so the same tree always
+ * yields the same sample and estimate.
+ */
+int get_estimated_file_stats(GitStats *stats) {
+    assert(stats != NULL);
+
+    /* Bare repositories have no working tree: sample what HEAD points to */
+    const char *rev = stats->options.rev;
+    char git_dir[MAX_PATH_LENGTH];
+    int discovered = git_repository_discover(git_dir, sizeof(git_dir)) == 0;
+    if (rev == NULL && discovered && strcmp(git_dir, ".") == 0) {
+        rev = "HEAD";
+    }
+
+    SizedFileList list = {NULL, 0, 0};
+    if (rev != NULL) {
+        if (list_tree_blobs(rev, 1, &list.files, &list.count) != 0) {
+            fprintf(stderr, "Warning: Cannot read the tree of revision '%s'\n", rev);
+            return -1;
+        }
+    } else if (!discovered || list_sized_files(git_dir, &list) != 0) {
+        tree_blobs_free(list.files, list.count);
+        return -1;
+    }
+
+    Stratum *strata = NULL;
+    int stratum_count = 0;
+    int *sample = NULL;
+    int sample_count = 0;
+    long *lines = NULL;
+    int result = draw_sample(list.files, list.count, stats->options.sample_size,
+                             &strata, &stratum_count, &sample, &sample_count);
+    if (result == 0 && sample_count > 0) {
+        lines = malloc((size_t)sample_count * sizeof(long));
+        result = (lines != NULL) ? 0 : -1;
+    }
+
+    if (result == 0 && sample_count > 0) {
+        /* No more workers than there are batches to hand out */
+        int workers = (stats->options.jobs > 0) ? stats->options.jobs : parallel_default_jobs();
+        int batches = (sample_count + SAMPLE_COUNT_BATCH - 1) / SAMPLE_COUNT_BATCH;
+        if (workers > batches) workers = batches;
+
+        SampleCountJob job;
+        job.files = list.files;
+        job.sample = sample;
+        job.lines = lines;
+        job.sample_count = sample_count;
+        job.rev = rev;
+        atomic_init(&job.next, 0);
+        atomic_init(&job.failed, 0);
+        parallel_run(workers, count_sample_worker, &job);
+        result = atomic_load(&job.failed) ? -1 : 0;
+    }
+
+    stats->file_type_count = 0;
+    stats->total_lines = 0;
+    if (result == 0 && stratum_count > 0 &&
+        VECTOR_RESERVE(stats->file_types, stats->file_type_capacity, stratum_count) != 0) {
+        result = -1;
+    }
+
+    if (result == 0) {
+        LineEstimate *estimate = &stats->line_estimate;
+        memset(estimate, 0, sizeof(LineEstimate));
+        estimate->enabled = 1;
+        estimate->sample_size = stats->options.sample_size;
+        estimate->sampled_files = sample_count;
+
+        double total_variance = 0.0;
+        for (int i = 0; i < stratum_count; i++) {
+            const Stratum *stratum = &strata[i];
+            double variance;
+            double lines_estimate = estimate_stratum(stratum, list.files, sample, lines, &variance);
+
+            FileType *type = &stats->file_types[stats->file_type_count++];
+            safe_string_copy(type->extension, stratum->extension, sizeof(type->extension));
+            type->count = stratum->count;
+            type->total_lines = lround(lines_estimate);
+            type->sampled = stratum->sampled;
+            type->lines_margin = lround(LINE_ESTIMATE_Z * sqrt(variance));
+
+            stats->total_lines += type->total_lines;
+            estimate->total_bytes += stratum->bytes;
+            total_variance += variance;
+        }
+        estimate->lines_margin = lround(LINE_ESTIMATE_Z * sqrt(total_variance));
+        stats->total_files = list.count;
+
+        /* Keep file types ranked by count for the formatters */
+        if (stats->file_type_count > 0) {
+            qsort(stats->file_types, stats->file_type_count, sizeof(FileType),
+                  compare_file_types_by_count);
+        }
+    }
+
+    free(lines);
+    free(sample);
+    free(strata);
+    tree_blobs_free(list.files, list.count);
+    return result;
+}
+
+/**
+ * List the tracked files of the working tree with their sizes
+ * Paths come from the index, or from `git ls-files` when it cannot be
+ * read. Every file is stat()ed: the index keeps sizes modulo 2^32, so a
+ * recorded size cannot tell a small file from one of 4 GiB or more.
+ */
+static int list_sized_files(const char *git_dir, SizedFileList *list) {
+    int read = git_index_read(git_dir, add_index_entry, list);
+    if (read == 1) {
+        return -1;
+    }
+    if (read != 0) {
+        tree_blobs_free(list->files, list->count);
+        list->files = NULL;
+        list->count = 0;
+        list->capacity = 0;
+
+        const char *const argv[] = {"git", "ls-files", "-z", NULL};
+        if (subprocess_stream(argv, NULL, 0, '\0', add_listed_file, list) != 0) {
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < list->count; i++) {
+        TreeBlob *file = &list->files[i];
+        struct stat st;
+        file->size = (stat(file->path, &st) == 0) ? (long)st.st_size : 0;
+    }
+    return 0;
+}
+
+/**
+ * Append one index entry; submodules have no lines to count
+ */
+static int add_index_entry(const char *path, uint32_t mode, uint32_t size, void *ctx) {
+    (void)size;
+    if (mode == GIT_INDEX_MODE_GITLINK) {
+        return 0;
+    }
+    return append_file(ctx, path, strlen(path));
+}
+
+/**
+ * Append one path of `git ls-files -z`
+ */
+static int add_listed_file(char *path, size_t length, void *ctx) {
+    /* Skip empty filenames */
+    if (length == 0) return 0;
+
+    return append_file(ctx, path, length);
+}
+
+/**
+ * Append a file with an empty object id, to be stat()ed
+ */
+static int append_file(SizedFileList *list, const char *path, size_t length) {
+    if (VECTOR_RESERVE(list->files, list->capacity, list->count + 1) != 0) {
+        return 1;
+    }
+    TreeBlob *file = &list->files[list->count];
+    file->path = strndup(path, length);
+    if (file->path == NULL) {
+        return 1;
+    }
+    file->oid[0] = '\0';
+    file->size = 0;
+    list->count++;
+    return 0;
+}
+
+/**
+ * Group the files by extension and draw up to sample_size from each
+ * Every file gets a key from the mixed hash of its path; the lowest keys
+ * of a stratum are a uniform random sample of it. The sample lists each
+ * stratum's files together, in stratum order.
+ */
+static int draw_sample(const TreeBlob *files, int file_count, int sample_size,
+                       Stratum **strata, int *stratum_count, int **sample, int *sample_count) {
+    *strata = NULL;
+    *stratum_count = 0;
+    *sample = NULL;
+    *sample_count = 0;
+    if (file_count == 0) {
+        return 0;
+    }
+
+    HashMap index;
+    if (hash_map_init(&index, 0) != 0) {
+        return -1;
+    }
+
+    int capacity = 0;
+    SampleCandidate *candidates = malloc((size_t)file_count * sizeof(SampleCandidate));
+    int result = (candidates != NULL) ? 0 : -1;
+
+    for (int i = 0; result == 0 && i < file_count; i++) {
+        char extension[MAX_EXTENSION_LENGTH];
+        get_file_extension(files[i].path, extension, sizeof(extension));
+
+        int inserted;
+        int *position = hash_map_upsert(&index, extension, *stratum_count, &inserted);
+        if (position == NULL) {
+            result = -1;
+            break;
+        }
+        if (inserted) {
+            if (VECTOR_RESERVE(*strata, capacity, *stratum_count + 1) != 0) {
+                result = -1;
+                break;
+            }
+            Stratum *stratum = &(*strata)[(*stratum_count)++];
+            memset(stratum, 0, sizeof(Stratum));
+            safe_string_copy(stratum->extension, extension, sizeof(stratum->extension));
+        }
+
+        Stratum *stratum = &(*strata)[*position];
+        stratum->count++;
+        stratum->bytes += (files[i].size > 0) ? files[i].size : 0;
+
+        candidates[i].key = hash_map_mix(hash_map_hash(files[i].path));
+        candidates[i].stratum = *position;
+        candidates[i].file = i;
+    }
+
+    hash_map_free(&index);
+
+    if (result == 0) {
+        qsort(candidates, (size_t)file_count, sizeof(SampleCandidate), compare_candidates);
+
+        int total = 0;
+        for (int i = 0; i < *stratum_count; i++) {
+            Stratum *stratum = &(*strata)[i];
+            stratum->sampled = (stratum->count < sample_size) ? stratum->count : sample_size;
+            stratum->sample_start = total;
+            total += stratum->sampled;
+        }
+
+        *sample = malloc((size_t)total * sizeof(int));
+        if (*sample == NULL) {
+            result = -1;
+        }
+
+        /* Candidates are grouped by stratum, lowest key first: take each group's head */
+        int taken = 0;
+        for (int i = 0; result == 0 && i < file_count; i++) {
+            if (i > 0 && candidates[i].stratum != candidates[i - 1].stratum) {
+                taken = 0;
+            }
+            const Stratum *stratum = &(*strata)[candidates[i].stratum];
+            if (taken < stratum->sampled) {
+                (*sample)[stratum->sample_start + taken++] = candidates[i].file;
+            }
+        }
+        *sample_count = (result == 0) ? total : 0;
+    }
+
+    free(candidates);
+    return result;
+}
+
+/**
+ * Sample-counting worker: claims batches of sampled files until none are left
+ * Each worker writes only the line counts of the batches it claimed.
+ */
+static void count_sample_worker(int worker_index, void *ctx) {
+    (void)worker_index;
+    SampleCountJob *job = (SampleCountJob *)ctx;
+
+    BlobStream stream;
+    int stream_open = 0;
+
+    for (;;) {
+        int start = atomic_fetch_add(&job->next, SAMPLE_COUNT_BATCH);
+        if (start >= job->sample_count) break;
+
+        int end = (start + SAMPLE_COUNT_BATCH < job->sample_count) ? start + SAMPLE_COUNT_BATCH
+                                                                   : job->sample_count;
+
+        if (job->rev == NULL) {
+            for (int i = start; i < end; i++) {
+                job->lines[i] = count_lines_in_file(job->files[job->sample[i]].path);
+            }
+            continue;
+        }
+
+        if (!stream_open) {
+            if (blob_stream_open(&stream) != 0) {
+                atomic_store(&job->failed, 1);
+                break;
+            }
+            stream_open = 1;
+        }
+        if (count_sample_batch(&stream, job, start, end) != 0) {
+            atomic_store(&job->failed, 1);
+            break;
+        }
+    }
+
+    if (stream_open) {
+        blob_stream_close(&stream);
+    }
+}
+
+/**
+ * Count a batch of sampled blobs through the worker's cat-file process
+ * All requests of the batch are written before the first response is read.
+ */
+static int count_sample_batch(BlobStream *stream, SampleCountJob *job, int start, int end) {
+    for (int i = start; i < end; i++) {
+        if (blob_stream_request(stream, job->files[job->sample[i]].oid) != 0) {
+            return -1;
+        }
+    }
+    if (blob_stream_flush(stream) != 0) {
+        return -1;
+    }
+
+    for (int i = start; i < end; i++) {
+        long lines = blob_stream_count_lines(stream);
+        if (lines == -1) {
+            return -1;
+        }
+        job->lines[i] = (lines < 0) ? -1 : lines;
+    }
+
+    return 0;
+}
+
+/**
+ * Estimate the lines of one stratum and the variance of the estimate
+ * The sample's lines per byte scale up to the stratum's bytes, with the
+ * usual approximate variance of a ratio estimator, corrected for sampling
+ * without replacement. A sample of empty files from a stratum that has
+ * bytes falls back to scaling the mean by the file count. Unreadable files
+ * count as no lines, as they do when every file is counted.
+ */
+static double estimate_stratum(const Stratum *stratum, const TreeBlob *files,
+                               const int *sample, const long *lines, double *variance) {
+    const int *files_of = sample + stratum->sample_start;
+    const long *lines_of = lines + stratum->sample_start;
+    int n = stratum->sampled;
+
+    double sum_lines = 0.0;
+    double sum_bytes = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum_lines += (lines_of[i] > 0) ? (double)lines_of[i] : 0.0;
+        sum_bytes += (files[files_of[i]].size > 0) ? (double)files[files_of[i]].size : 0.0;
+    }
+
+    *variance = 0.0;
+    if (n >= stratum->count) {
+        return sum_lines; /* Counted in full */
+    }
+
+    double ratio = (sum_bytes > 0.0) ? sum_lines / sum_bytes : 0.0;
+    double mean = sum_lines / n;
+    double residuals = 0.0;
+    for (int i = 0; i < n; i++) {
+        double y = (lines_of[i] > 0) ? (double)lines_of[i] : 0.0;
+        double x = (files[files_of[i]].size > 0) ? (double)files[files_of[i]].size : 0.0;
+        double residual = (sum_bytes > 0.0) ? y - ratio * x : y - mean;
+        residuals += residual * residual;
+    }
+
+    double count = stratum->count;
+    *variance = count * count * (1.0 - n / count) * (residuals / (n - 1)) / n;
+    return (sum_bytes > 0.0) ? ratio * (double)stratum->bytes : mean * count;
+}
+
+/**
+ * Order candidates by stratum, then key (listing order breaks hash ties)
+ */
+static int compare_candidates(const void *a, const void *b) {
+    const SampleCandidate *candidate_a = (const SampleCandidate *)a;
+    const SampleCandidate *candidate_b = (const SampleCandidate *)b;
+
+    if (candidate_a->stratum != candidate_b->stratum) {
+        return (candidate_a->stratum < candidate_b->stratum) ? -1 : 1;
+    }
+    if (candidate_a->key != candidate_b->key) {
+        return (candidate_a->key < candidate_b->key) ? -1 : 1;
+    }
+    return (candidate_a->file < candidate_b->file) ? -1 : (candidate_a->file > candidate_b->file);
+}
@@ -0,0 +1,20 @@
+#ifndef LINE_ESTIMATE_H
+#define LINE_ESTIMATE_H
+
+#include "../git_stats.h"
+
+/**
+ * Estimate lines per file type from a sample of the tracked files
+ * (--estimate-lines)
+ * Every extension is sampled separately: up to options.sample_size of
+ * its files are counted and the others are extrapolated from their sizes,
+ * stat()ed from the files the index lists (working tree) or read from
+ * `git ls-tree --long` (--rev), so only the sampled files are opened. Fills the same fields as
+ * get_file_stats() plus each type's sampled and lines_margin and
+ * stats->line_estimate.
+ * @param stats GitStats structure to populate
+ * @return 0 on success, -1 on error
+ */
+int get_estimated_file_stats(GitStats *stats);
+
+#endif /* LINE_ESTIMATE_H */
@@ -0,0 +1,1053 @@
+#define _GNU_SOURCE
+#include "batch.h"
+#include "analysis/hotspots.h"
+#include "analysis/activity.h"
+#include "output/formatters.h"
+#include "output/json_writer.h"
+#include "utils/parallel.h"
+#include "utils/profile.h"
+#include "utils/string_pool.h"
+#include "utils/top_k.h"
+#include "utils/vector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/* Directory levels searched below --repos DIR */
+#define BATCH_MAX_DEPTH 4
+
+/* Bytes read from a worker pipe at a time */
+#define BATCH_READ_SIZE (64 * 1024)
+
+/* Diagnostics kept per repository; anything beyond is read and dropped */
+#define BATCH_MESSAGES_MAX (16 * 1024)
+
+/* Worker output line that ends the rollup facts; the JSON document follows */
+#define BATCH_DOCUMENT_MARKER "document\n"
+
+/**
+ * Growable byte buffer for what a worker writes
+ */
+typedef struct {
+    char *data;
+    size_t used;
+    size_t capacity;
+} BatchBuffer;
+
+/**
+ * Progress of one repository
+ */
+typedef enum {
+    REPOSITORY_PENDING,
+    REPOSITORY_RUNNING,
+    REPOSITORY_DONE
+} RepositoryState;
+
+/**
+ * One repository of the run and the worker analyzing it
+ * A worker writes rollup facts, one per line, then BATCH_DOCUMENT_MARKER
+ * and the compact JSON document of the repository:
+ *   summary <commits> <authors> <branches> <files> <lines>
+ *   author <commits> <added> <deleted> <name>
+ *   type <files> <lines> <extension>
+ */
+typedef struct {
+    char *path;
+    RepositoryState state;
+    pid_t pid;
+    int output_fd;          /* Facts and document, -1 once closed */
+    int messages_fd;        /* Worker stderr, -1 once closed */
+    int timed_out;
+    long long started_ms;
+    long long elapsed_ms;
+    const char *status;     /* "ok", "error", "timeout" or "not_a_repository" */
+    BatchBuffer output;
+    BatchBuffer messages;
+    const char *document;   /* Compact JSON inside output once parsed, or NULL */
+    size_t document_length;
+} BatchRepository;
+
+/**
+ * Fleet-wide totals of one author name
+ */
+typedef struct {
+    long long commits;
+    long long lines_added;
+    long long lines_deleted;
+    int repositories;
+} FleetAuthor;
+
+/**
+ * Fleet-wide totals of one file extension
+ */
+typedef struct {
+    long long files;
+    long long lines;
+    int repositories;
+} FleetFileType;
+
+/**
+ * Totals over every analyzed repository; rows are indexed by the id of
+ * their interned name
+ */
+typedef struct {
+    int succeeded;
+    int failed;
+    int timed_out;
+    int not_repositories;
+    long long total_commits;
+    long long total_branches;
+    long long total_files;
+    long long total_lines;
+    StringPool author_names;
+    FleetAuthor *authors;
+    int author_count;
+    int author_capacity;
+    StringPool extensions;
+    FleetFileType *file_types;
+    int file_type_count;
+    int file_type_capacity;
+} FleetRollup;
+
+/**
+ * State of a --repos run
+ */
+typedef struct {
+    AnalysisMode mode;
+    CollectOptions options;     /* As handed to every worker */
+    int workers;
+    long long timeout_ms;       /* 0 = no limit */
+    BatchRepository *repositories;
+    int count;
+    int capacity;
+    int next_start;             /* First repository not started yet */
+    int next_write;             /* First repository not written yet */
+    int running;
+    JsonWriter json;
+    int records;                /* NDJSON: one record per repository */
+    FleetRollup rollup;
+} BatchRun;
+
+/* Set by SIGINT and SIGTERM */
+static volatile sig_atomic_t stop_requested;
+
+/* Forward declarations */
+static int discover_repositories(BatchRun *run, const char *source);
+static int read_repository_list(BatchRun *run, const char *source);
+static int scan_directory(BatchRun *run, const char *dir, int depth);
+static int add_repository(BatchRun *run, const char *path);
+static int is_repository_root(const char *path);
+static void start_worker(BatchRun *run, BatchRepository *repo);
+static void run_worker(const BatchRun *run, const BatchRepository *repo, int output_fd);
+static void write_worker_facts(FILE *out, const GitStats *stats);
+static void wait_for_workers(BatchRun *run);
+static void read_worker_pipe(int *fd, BatchBuffer *buffer, size_t limit);
+static void finish_worker(BatchRun *run, BatchRepository *repo);
+static void stop_workers(BatchRun *run);
+static int add_worker_facts(FleetRollup *rollup, BatchRepository *repo);
+static void write_finished_repositories(BatchRun *run);
+static void write_repository_json(BatchRun *run, BatchRepository *repo);
+static void write_rollup_json(BatchRun *run, long long elapsed_ms);
+static int compare_names(const void *a, const void *b);
+static int fleet_author_ranks_before(int a, int b, void *ctx);
+static int fleet_file_type_ranks_before(int a, int b, void *ctx);
+static int buffer_reserve(BatchBuffer *buffer, size_t needed);
+static void free_batch_run(BatchRun *run);
+static long long monotonic_ms(void);
+
+/**
+ * Ask the run to stop
+ */
+static void request_stop(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+/**
+ * Analyze many repositories and print one combined document
+ */
+int analyze_repositories(const BatchOptions *batch, OutputFormat format, AnalysisMode mode,
+                         const CollectOptions *options) {
+    assert(batch != NULL && batch->source != NULL);
+    assert(format == OUTPUT_JSON || format == OUTPUT_NDJSON);
+    assert(options != NULL);
+
+    BatchRun run;
+    memset(&run, 0, sizeof(run));
+    run.mode = mode;
+    run.options = *options;
+    run.timeout_ms = (long long)batch->timeout * 1000;
+    run.records = (format == OUTPUT_NDJSON);
+
+    /* Repositories already run side by side, so each counts lines on one thread unless told otherwise */
+    if (run.options.jobs == 0) {
+        run.options.jobs = 1;
+    }
+
+    if (string_pool_init(&run.rollup.author_names, 0) != 0 ||
+        string_pool_init(&run.rollup.extensions, 0) != 0) {
+        fprintf(stderr, "Error: Failed to allocate the rollup\n");
+        free_batch_run(&run);
+        return EXIT_ERROR_CODE;
+    }
+    if (discover_repositories(&run, batch->source) != 0) {
+        free_batch_run(&run);
+        return EXIT_ERROR_CODE;
+    }
+
+    run.workers = (batch->workers > 0) ? batch->workers : parallel_default_jobs();
+    if (run.workers > run.count) {
+        run.workers = (run.count > 0) ? run.count : 1;
+    }
+
+    if (json_writer_init(&run.json, stdout, run.records) != 0) {
+        fprintf(stderr, "Error: Failed to allocate the output buffer\n");
+        free_batch_run(&run);
+        return EXIT_ERROR_CODE;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    if (!run.records) {
+        json_writer_begin_object(&run.json);
+        json_writer_key(&run.json, "repositories");
+        json_writer_begin_array(&run.json);
+    }
+
+    long long started_ms = monotonic_ms();
+    while (run.next_write < run.count && !stop_requested) {
+        while (run.running < run.workers && run.next_start < run.count) {
+            start_worker(&run, &run.repositories[run.next_start++]);
+        }
+        wait_for_workers(&run);
+        write_finished_repositories(&run);
+    }
+
+    int exit_code = EXIT_SUCCESS_CODE;
+    if (stop_requested) {
+        stop_workers(&run);
+        fprintf(stderr, "Error: Interrupted after %d of %d repositories\n", run.next_write, run.count);
+        exit_code = EXIT_ERROR_CODE;
+    } else {
+        if (!run.records) {
+            json_writer_end_array(&run.json);
+            json_writer_key(&run.json, "rollup");
+        }
+        write_rollup_json(&run, monotonic_ms() - started_ms);
+        if (!run.records) {
+            json_writer_end_object(&run.json);
+        }
+    }
+
+    if (json_writer_finish(&run.json) != 0 && exit_code == EXIT_SUCCESS_CODE) {
+        fprintf(stderr, "Error: Failed to write %s output\n", run.records ? "NDJSON" : "JSON");
+        exit_code = EXIT_ERROR_CODE;
+    }
+
+    free_batch_run(&run);
+    return exit_code;
+}
+
+/**
+ * Fill run->repositories from a directory to search or a list file
+ * @return 0 on success, -1 after printing an error
+ */
+static int discover_repositories(BatchRun *run, const char *source) {
+    struct stat info;
+    if (strcmp(source, "-") != 0 && stat(source, &info) != 0) {
+        fprintf(stderr, "Error: Cannot access '%s': %s\n", source, strerror(errno));
+        return -1;
+    }
+
+    int result;
+    if (strcmp(source, "-") == 0 || !S_ISDIR(info.st_mode)) {
+        result = read_repository_list(run, source);
+    } else if (is_repository_root(source)) {
+        result = add_repository(run, source);
+    } else {
+        result = scan_directory(run, source, 1);
+    }
+
+    if (result != 0) {
+        fprintf(stderr, "Error: Failed to read the repositories in '%s'\n", source);
+    }
+    return result;
+}
+
+/**
+ * Read one repository path per line; blank lines and lines starting
+ * with '#' are skipped, relative paths are taken from the current
+ * directory
+ */
+static int read_repository_list(BatchRun *run, const char *source) {
+    FILE *list = (strcmp(source, "-") == 0) ? stdin : fopen(source, "r");
+    if (list == NULL) {
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    int result = 0;
+    while (result == 0 && getline(&line, &line_size, list) != -1) {
+        char *path = line;
+        while (*path == ' ' || *path == '\t') path++;
+
+        size_t length = strlen(path);
+        while (length > 0 && strchr(" \t\r\n", path[length - 1]) != NULL) {
+            path[--length] = '\0';
+        }
+        if (length == 0 || path[0] == '#') continue;
+
+        result = add_repository(run, path);
+    }
+    if (ferror(list)) {
+        result = -1;
+    }
+
+    free(line);
+    if (list != stdin) {
+        fclose(list);
+    }
+    return result;
+}
+
+/**
+ * Add the repositories below a directory, in name order
+ * Hidden directories and symbolic links are not followed, and the search
+ * does not descend into a repository once found.
+ */
+static int scan_directory(BatchRun *run, const char *dir, int depth) {
+    DIR *handle = opendir(dir);
+    if (handle == NULL) {
+        fprintf(stderr, "Warning: Cannot read directory '%s': %s\n", dir, strerror(errno));
+        return 0;
+    }
+
+    char **names = NULL;
+    int name_count = 0;
+    int name_capacity = 0;
+    int result = 0;
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char *name = strdup(entry->d_name);
+        if (name == NULL || VECTOR_RESERVE(names, name_capacity, name_count + 1) != 0) {
+            free(name);
+            result = -1;
+            break;
+        }
+        names[name_count++] = name;
+    }
+    closedir(handle);
+
+    if (name_count > 1) {
+        qsort(names, (size_t)name_count, sizeof(char *), compare_names);
+    }
+
+    size_t dir_length = strlen(dir);
+    const char *separator = (dir_length > 0 && dir[dir_length - 1] == '/') ? "" : "/";
+    for (int i = 0; i < name_count && result == 0; i++) {
+        char path[MAX_PATH_LENGTH];
+        int ret = snprintf(path, sizeof(path), "%s%s%s", dir, separator, names[i]);
+        struct stat info;
+        if (ret < 0 || ret >= (int)sizeof(path) || lstat(path, &info) != 0 || !S_ISDIR(info.st_mode)) {
+            continue;
+        }
+
+        if (is_repository_root(path)) {
+            result = add_repository(run, path);
+        } else if (depth < BATCH_MAX_DEPTH) {
+            result = scan_directory(run, path, depth + 1);
+        }
+    }
+
+    for (int i = 0; i < name_count; i++) {
+        free(names[i]);
+    }
+    free(names);
+    return result;
+}
+
+/**
+ * Queue a repository for analysis
+ */
+static int add_repository(BatchRun *run, const char *path) {
+    if (VECTOR_RESERVE(run->repositories, run->capacity, run->count + 1) != 0) {
+        return -1;
+    }
+
+    BatchRepository *repo = &run->repositories[run->count];
+    memset(repo, 0, sizeof(BatchRepository));
+    repo->path = strdup(path);
+    if (repo->path == NULL) {
+        return -1;
+    }
+    repo->state = REPOSITORY_PENDING;
+    repo->output_fd = -1;
+    repo->messages_fd = -1;
+    run->count++;
+    return 0;
+}
+
+/**
+ * Whether a directory is a work tree (with a .git directory or file) or
+ * a bare repository
+ */
+static int is_repository_root(const char *path) {
+    char probe[MAX_PATH_LENGTH];
+    struct stat info;
+
+    int ret = snprintf(probe, sizeof(probe), "%s/.git", path);
+    if (ret > 0 && ret < (int)sizeof(probe) && stat(probe, &info) == 0) {
+        return 1;
+    }
+
+    static const char *const bare_entries[] = { "HEAD", "objects", "refs" };
+    for (size_t i = 0; i < sizeof(bare_entries) / sizeof(bare_entries[0]); i++) {
+        ret = snprintf(probe, sizeof(probe), "%s/%s", path, bare_entries[i]);
+        if (ret < 0 || ret >= (int)sizeof(probe) || stat(probe, &info) != 0 ||
+            S_ISDIR(info.st_mode) != (i > 0)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Fork the worker of a repository
+ * A repository whose worker cannot be started is finished as an error.
+ */
+static void start_worker(BatchRun *run, BatchRepository *repo) {
+    int output_pipe[2];
+    int messages_pipe[2];
+
+    repo->started_ms = monotonic_ms();
+    repo->state = REPOSITORY_RUNNING;
+    run->running++;
+
+    if (pipe2(output_pipe, O_CLOEXEC) != 0) {
+        finish_worker(run, repo);
+        return;
+    }
+    if (pipe2(messages_pipe, O_CLOEXEC) != 0) {
+        close(output_pipe[0]);
+        close(output_pipe[1]);
+        finish_worker(run, repo);
+        return;
+    }
+
+    /* Nothing buffered may be written twice */
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(output_pipe[0]);
+        close(messages_pipe[0]);
+        /* Anything printed besides the facts and document is a message */
+        if (dup2(messages_pipe[1], STDERR_FILENO) < 0 || dup2(messages_pipe[1], STDOUT_FILENO) < 0) {
+            _exit(EXIT_ERROR_CODE);
+        }
+        close(messages_pipe[1]);
+        run_worker(run, repo, output_pipe[1]);
+    }
+
+    close(output_pipe[1]);
+    close(messages_pipe[1]);
+    if (pid < 0) {
+        close(output_pipe[0]);
+        close(messages_pipe[0]);
+        finish_worker(run, repo);
+        return;
+    }
+
+    /* Set on both sides, so a timeout can kill the group before the child runs */
+    setpgid(pid, pid);
+    repo->pid = pid;
+    repo->output_fd = output_pipe[0];
+    repo->messages_fd = messages_pipe[0];
+}
+
+/**
+ * Analyze one repository in a forked worker and exit
+ * The exit status tells the parent how it went: EXIT_NOT_GIT_REPO if the
+ * path is not a repository.
+ */
+static void run_worker(const BatchRun *run, const BatchRepository *repo, int output_fd) {
+    setpgid(0, 0);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    if (chdir(repo->path) != 0) {
+        fprintf(stderr, "Error: Cannot enter '%s': %s\n", repo->path, strerror(errno));
+        _exit(EXIT_ERROR_CODE);
+    }
+    if (!is_git_repository()) {
+        fprintf(stderr, "Error: Not a git repository\n");
+        _exit(EXIT_NOT_GIT_REPO);
+    }
+
+    FILE *out = fdopen(output_fd, "w");
+    if (out == NULL) {
+        _exit(EXIT_ERROR_CODE);
+    }
+
+    /* The run and CPU clocks start over in the child */
+    if (run->options.profile) {
+        profile_enable();
+    }
+
+    GitStats stats;
+    init_git_stats(&stats);
+    stats.options = run->options;
+
+    if (get_basic_git_stats(&stats) != 0) {
+        fprintf(stderr, "Error: Failed to gather basic git statistics\n");
+        _exit(EXIT_ERROR_CODE);
+    }
+
+    if (run->mode == ANALYSIS_HOTSPOTS && get_hotspot_stats(&stats) != 0) {
+        fprintf(stderr, "Warning: Failed to get hotspot statistics\n");
+    } else if (run->mode == ANALYSIS_ACTIVITY && get_activity_stats(&stats) != 0) {
+        fprintf(stderr, "Warning: Failed to get activity statistics\n");
+    }
+
+    write_worker_facts(out, &stats);
+
+    JsonWriter json;
+    int result = json_writer_init(&json, out, 1);
+    if (result == 0) {
+        write_stats_json(&json, &stats, run->mode);
+        json_writer_end_record(&json);
+        result = json_writer_finish(&json);
+    }
+    if (fclose(out) != 0) {
+        result = -1;
+    }
+
+    free_git_stats(&stats);
+    _exit(result == 0 ? EXIT_SUCCESS_CODE : EXIT_ERROR_CODE);
+}
+
+/**
+ * Write the facts the rollup needs: totals, every author and every file
+ * type, not only the rows the document lists
+ */
+static void write_worker_facts(FILE *out, const GitStats *stats) {
+    fprintf(out, "summary %d %d %d %d %ld\n", stats->total_commits, stats->total_authors,
+            stats->total_branches, stats->total_files, stats->total_lines);
+
+    GIT_STATS_FOR_EACH(const Author, author, stats->authors, stats->total_authors) {
+        fprintf(out, "author %d %d %d ", author->commit_count, author->lines_added, author->lines_deleted);
+
+        /* A name runs to the end of its line */
+        for (const char *c = git_stats_author_name(stats, author); *c != '\0'; c++) {
+            fputc((*c == '\n' || *c == '\r') ? ' ' : *c, out);
+        }
+        fputc('\n', out);
+    }
+
+    GIT_STATS_FOR_EACH(const FileType, type, stats->file_types, stats->file_type_count) {
+        fprintf(out, "type %d %ld %s\n", type->count, type->total_lines, type->extension);
+    }
+
+    fputs(BATCH_DOCUMENT_MARKER, out);
+}
+
+/**
+ * Wait until a worker writes, exits or runs out of time, and finish the
+ * workers that are done
+ */
+static void wait_for_workers(BatchRun *run) {
+    struct pollfd *fds = calloc((size_t)run->running * 2 + 1, sizeof(struct pollfd));
+    int *owners = calloc((size_t)run->running * 2 + 1, sizeof(int));
+    if (fds == NULL || owners == NULL) {
+        free(fds);
+        free(owners);
+        stop_requested = 1;
+        return;
+    }
+
+    /* Sleep until the earliest deadline at most */
+    long long now = monotonic_ms();
+    long long wait_ms = -1;
+    int nfds = 0;
+    for (int i = run->next_write; i < run->next_start; i++) {
+        BatchRepository *repo = &run->repositories[i];
+        if (repo->state != REPOSITORY_RUNNING) continue;
+
+        int pipes[2] = { repo->output_fd, repo->messages_fd };
+        for (int p = 0; p < 2; p++) {
+            if (pipes[p] < 0) continue;
+            fds[nfds].fd = pipes[p];
+            fds[nfds].events = POLLIN;
+            owners[nfds++] = i;
+        }
+        if (run->timeout_ms > 0) {
+            long long remaining = repo->started_ms + run->timeout_ms - now;
+            if (remaining < 0) remaining = 0;
+            if (remaining > INT_MAX) remaining = INT_MAX;
+            if (wait_ms < 0 || remaining < wait_ms) wait_ms = remaining;
+        }
+    }
+
+    if (nfds > 0 && poll(fds, (nfds_t)nfds, (int)wait_ms) > 0) {
+        for (int f = 0; f < nfds; f++) {
+            if (fds[f].revents == 0) continue;
+
+            BatchRepository *repo = &run->repositories[owners[f]];
+            if (fds[f].fd == repo->output_fd) {
+                read_worker_pipe(&repo->output_fd, &repo->output, SIZE_MAX);
+            } else {
+                read_worker_pipe(&repo->messages_fd, &repo->messages, BATCH_MESSAGES_MAX);
+            }
+        }
+    }
+
+    now = monotonic_ms();
+    for (int i = run->next_write; i < run->next_start; i++) {
+        BatchRepository *repo = &run->repositories[i];
+        if (repo->state != REPOSITORY_RUNNING) continue;
+
+        if (repo->output_fd < 0 && repo->messages_fd < 0) {
+            finish_worker(run, repo);
+        } else if (run->timeout_ms > 0 && now - repo->started_ms >= run->timeout_ms) {
+            /* The group includes the git processes the worker started */
+            kill(-repo->pid, SIGKILL);
+            kill(repo->pid, SIGKILL);
+            repo->timed_out = 1;
+            finish_worker(run, repo);
+        }
+    }
+
+    free(fds);
+    free(owners);
+}
+
+/**
+ * Read what is available from a worker pipe, closing it at end of file
+ * Bytes beyond limit are read and dropped.
+ */
+static void read_worker_pipe(int *fd, BatchBuffer *buffer, size_t limit) {
+    char scratch[BATCH_READ_SIZE];
+    int keep = (buffer->used < limit && buffer_reserve(buffer, buffer->used + BATCH_READ_SIZE + 1) == 0);
+    char *target = keep ? buffer->data + buffer->used : scratch;
+
+    ssize_t length = read(*fd, target, BATCH_READ_SIZE);
+    if (length < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return;
+    }
+    if (length <= 0) {
+        close(*fd);
+        *fd = -1;
+        return;
+    }
+
+    if (keep) {
+        buffer->used += (size_t)length;
+        buffer->data[buffer->used] = '\0';
+    }
+}
+
+/**
+ * Reap a worker that is done, timed out or could not start, and settle
+ * its status
+ */
+static void finish_worker(BatchRun *run, BatchRepository *repo) {
+    if (repo->output_fd >= 0) {
+        close(repo->output_fd);
+        repo->output_fd = -1;
+    }
+    if (repo->messages_fd >= 0) {
+        close(repo->messages_fd);
+        repo->messages_fd = -1;
+    }
+
+    int exit_status = -1;
+    if (repo->pid > 0) {
+        int wait_status = 0;
+        pid_t reaped;
+        do {
+            reaped = waitpid(repo->pid, &wait_status, 0);
+        } while (reaped < 0 && errno == EINTR);
+        if (reaped == repo->pid && WIFEXITED(wait_status)) {
+            exit_status = WEXITSTATUS(wait_status);
+        }
+    }
+
+    repo->elapsed_ms = monotonic_ms() - repo->started_ms;
+    repo->state = REPOSITORY_DONE;
+    run->running--;
+
+    if (repo->timed_out) {
+        repo->status = "timeout";
+        run->rollup.timed_out++;
+    } else if (exit_status == EXIT_NOT_GIT_REPO) {
+        repo->status = "not_a_repository";
+        run->rollup.not_repositories++;
+    } else if (exit_status == EXIT_SUCCESS_CODE && add_worker_facts(&run->rollup, repo) == 0) {
+        repo->status = "ok";
+        run->rollup.succeeded++;
+    } else {
+        repo->status = "error";
+        run->rollup.failed++;
+    }
+}
+
+/**
+ * Kill and reap every running worker
+ */
+static void stop_workers(BatchRun *run) {
+    for (int i = run->next_write; i < run->next_start; i++) {
+        BatchRepository *repo = &run->repositories[i];
+        if (repo->state != REPOSITORY_RUNNING) continue;
+
+        kill(-repo->pid, SIGKILL);
+        kill(repo->pid, SIGKILL);
+        finish_worker(run, repo);
+    }
+}
+
+/**
+ * Parse the facts a worker wrote, add them to the rollup and locate its
+ * document
+ * Everything is validated before anything is added.
+ * @return 0 on success, -1 if the output is incomplete or malformed
+ */
+static int add_worker_facts(FleetRollup *rollup, BatchRepository *repo) {
+    if (repo->output.data == NULL) {
+        return -1;
+    }
+
+    char *marker = strstr(repo->output.data, "\n" BATCH_DOCUMENT_MARKER);
+    if (marker == NULL) {
+        return -1;
+    }
+    char *document = marker + 1 + strlen(BATCH_DOCUMENT_MARKER);
+    size_t document_length = repo->output.used - (size_t)(document - repo->output.data);
+    while (document_length > 0 && document[document_length - 1] == '\n') {
+        document_length--;
+    }
+    if (document_length == 0 || document[0] != '{') {
+        return -1;
+    }
+    marker[1] = '\0'; /* Facts end with the newline before the marker */
+
+    int commits, authors, branches, files;
+    long lines;
+    int consumed = 0;
+    if (sscanf(repo->output.data, "summary %d %d %d %d %ld\n%n", // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+               &commits, &authors, &branches, &files, &lines, &consumed) != 5 || consumed == 0) {
+        return -1;
+    }
+    rollup->total_commits += commits;
+    rollup->total_branches += branches;
+    rollup->total_files += files;
+    rollup->total_lines += lines;
+
+    char *line = repo->output.data + consumed;
+    while (*line != '\0') {
+        char *end = strchr(line, '\n');
+        if (end == NULL) break;
+        *end = '\0';
+
+        int count, added, deleted, offset = 0;
+        long type_lines;
+        StringId id;
+        if (sscanf(line, "author %d %d %d %n", &count, &added, &deleted, &offset) == 3 && offset > 0) { // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+            int inserted = string_pool_intern(&rollup->author_names, line + offset, &id);
+            if (inserted >= 0 &&
+                VECTOR_RESERVE(rollup->authors, rollup->author_capacity, (int)id + 1) == 0) {
+                if (inserted) {
+                    memset(&rollup->authors[id], 0, sizeof(FleetAuthor));
+                    rollup->author_count++;
+                }
+                rollup->authors[id].commits += count;
+                rollup->authors[id].lines_added += added;
+                rollup->authors[id].lines_deleted += deleted;
+                rollup->authors[id].repositories++;
+            }
+        } else if (sscanf(line, "type %d %ld %n", &count, &type_lines, &offset) == 2 && offset > 0) { // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+            int inserted = string_pool_intern(&rollup->extensions, line + offset, &id);
+            if (inserted >= 0 &&
+                VECTOR_RESERVE(rollup->file_types, rollup->file_type_capacity, (int)id + 1) == 0) {
+                if (inserted) {
+                    memset(&rollup->file_types[id], 0, sizeof(FleetFileType));
+                    rollup->file_type_count++;
+                }
+                rollup->file_types[id].files += count;
+                rollup->file_types[id].lines += type_lines;
+                rollup->file_types[id].repositories++;
+            }
+        }
+        line = end + 1;
+    }
+
+    repo->document = document;
+    repo->document_length = document_length;
+    return 0;
+}
+
+/**
+ * Write every finished repository that no unfinished one precedes, so
+ * sections come out in discovery order, and release their buffers
+ */
+static void write_finished_repositories(BatchRun *run) {
+    int wrote = 0;
+    while (run->next_write < run->next_start &&
+           run->repositories[run->next_write].state == REPOSITORY_DONE) {
+        BatchRepository *repo = &run->repositories[run->next_write++];
+        write_repository_json(run, repo);
+
+        free(repo->output.data);
+        free(repo->messages.data);
+        memset(&repo->output, 0, sizeof(BatchBuffer));
+        memset(&repo->messages, 0, sizeof(BatchBuffer));
+        repo->document = NULL;
+        wrote = 1;
+    }
+
+    if (wrote) {
+        json_writer_flush(&run->json);
+    }
+}
+
+/**
+ * Write the section of one repository: an element of "repositories", or
+ * a "repository" record
+ */
+static void write_repository_json(BatchRun *run, BatchRepository *repo) {
+    JsonWriter *json = &run->json;
+
+    json_writer_begin_object(json);
+    if (run->records) {
+        json_writer_key(json, "type");
+        json_writer_string(json, "repository");
+    }
+    json_writer_key(json, "path");
+    json_writer_string(json, repo->path);
+    json_writer_key(json, "status");
+    json_writer_string(json, repo->status);
+    json_writer_key(json, "elapsed_ms");
+    json_writer_int(json, repo->elapsed_ms);
+
+    /* What the worker printed on stderr, one line per entry */
+    if (repo->messages.used > 0) {
+        json_writer_key(json, "messages");
+        json_writer_begin_array(json);
+        char *line = repo->messages.data;
+        while (*line != '\0') {
+            char *end = strchr(line, '\n');
+            if (end != NULL) *end = '\0';
+            if (*line != '\0') {
+                json_writer_string(json, line);
+            }
+            if (end == NULL) break;
+            line = end + 1;
+        }
+        json_writer_end_array(json);
+    }
+
+    if (repo->document != NULL) {
+        json_writer_key(json, "stats");
+        json_writer_embed(json, repo->document, repo->document_length);
+    }
+
+    json_writer_end_object(json);
+    if (run->records) {
+        json_writer_end_record(json);
+    }
+}
+
+/**
+ * Write the fleet-wide rollup: the value of "rollup", or a "rollup" record
+ * Authors are matched across repositories by name.
+ */
+static void write_rollup_json(BatchRun *run, long long elapsed_ms) {
+    JsonWriter *json = &run->json;
+    FleetRollup *rollup = &run->rollup;
+
+    json_writer_begin_object(json);
+    if (run->records) {
+        json_writer_key(json, "type");
+        json_writer_string(json, "rollup");
+    }
+    json_writer_key(json, "repositories");
+    json_writer_int(json, run->count);
+    json_writer_key(json, "succeeded");
+    json_writer_int(json, rollup->succeeded);
+    json_writer_key(json, "failed");
+    json_writer_int(json, rollup->failed);
+    json_writer_key(json, "timed_out");
+    json_writer_int(json, rollup->timed_out);
+    json_writer_key(json, "not_repositories");
+    json_writer_int(json, rollup->not_repositories);
+    json_writer_key(json, "elapsed_ms");
+    json_writer_int(json, elapsed_ms);
+    json_writer_key(json, "total_commits");
+    json_writer_int(json, rollup->total_commits);
+    json_writer_key(json, "total_authors");
+    json_writer_int(json, rollup->author_count);
+    json_writer_key(json, "total_branches");
+    json_writer_int(json, rollup->total_branches);
+    json_writer_key(json, "total_files");
+    json_writer_int(json, rollup->total_files);
+    json_writer_key(json, "total_lines");
+    json_writer_int(json, rollup->total_lines);
+    write_history_window_json(json, &run->options);
+
+    int rows = rollup->author_count > rollup->file_type_count ? rollup->author_count
+                                                              : rollup->file_type_count;
+    int *order = malloc(sizeof(int) * (size_t)(rows > 0 ? rows : 1));
+
+    json_writer_key(json, "authors");
+    json_writer_begin_array(json);
+    int ranked = (order == NULL) ? 0 :
+        top_k_select(rollup->author_count,
+                     display_row_count(&run->options, rollup->author_count, MAX_AUTHORS_DISPLAY),
+                     fleet_author_ranks_before, rollup, order);
+    for (int i = 0; i < ranked; i++) {
+        const FleetAuthor *author = &rollup->authors[order[i]];
+        json_writer_begin_object(json);
+        json_writer_key(json, "name");
+        json_writer_string(json, string_pool_get(&rollup->author_names, (StringId)order[i]));
+        json_writer_key(json, "repositories");
+        json_writer_int(json, author->repositories);
+        json_writer_key(json, "commits");
+        json_writer_int(json, author->commits);
+        json_writer_key(json, "lines_added");
+        json_writer_int(json, author->lines_added);
+        json_writer_key(json, "lines_deleted");
+        json_writer_int(json, author->lines_deleted);
+        json_writer_end_object(json);
+    }
+    json_writer_end_array(json);
+
+    json_writer_key(json, "file_types");
+    json_writer_begin_array(json);
+    ranked = (order == NULL) ? 0 :
+        top_k_select(rollup->file_type_count,
+                     display_row_count(&run->options, rollup->file_type_count, MAX_FILE_TYPES_DISPLAY),
+                     fleet_file_type_ranks_before, rollup, order);
+    for (int i = 0; i < ranked; i++) {
+        const FleetFileType *type = &rollup->file_types[order[i]];
+        double percentage = (rollup->total_lines > 0) ?
+                           (double)type->lines * 100.0 / (double)rollup->total_lines : 0.0;
+        json_writer_begin_object(json);
+        json_writer_key(json, "extension");
+        json_writer_string(json, string_pool_get(&rollup->extensions, (StringId)order[i]));
+        json_writer_key(json, "repositories");
+        json_writer_int(json, type->repositories);
+        json_writer_key(json, "files");
+        json_writer_int(json, type->files);
+        json_writer_key(json, "lines");
+        json_writer_int(json, type->lines);
+        json_writer_key(json, "percentage");
+        json_writer_fixed(json, percentage, 1);
+        json_writer_end_object(json);
+    }
+    json_writer_end_array(json);
+
+    free(order);
+    json_writer_end_object(json);
+    if (run->records) {
+        json_writer_end_record(json);
+    }
+}
+
+/**
+ * qsort comparator for directory entry names
+ */
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/**
+ * Ranking of fleet authors: more commits first, ties by name
+ */
+static int fleet_author_ranks_before(int a, int b, void *ctx) {
+    const FleetRollup *rollup = (const FleetRollup *)ctx;
+
+    if (rollup->authors[a].commits != rollup->authors[b].commits) {
+        return rollup->authors[a].commits > rollup->authors[b].commits;
+    }
+    return strcmp(string_pool_get(&rollup->author_names, (StringId)a),
+                  string_pool_get(&rollup->author_names, (StringId)b)) < 0;
+}
+
+/**
+ * Ranking of fleet file types: more files first, ties by extension
+ */
+static int fleet_file_type_ranks_before(int a, int b, void *ctx) {
+    const FleetRollup *rollup = (const FleetRollup *)ctx;
+
+    if (rollup->file_types[a].files != rollup->file_types[b].files) {
+        return rollup->file_types[a].files > rollup->file_types[b].files;
+    }
+    return strcmp(string_pool_get(&rollup->extensions, (StringId)a),
+                  string_pool_get(&rollup->extensions, (StringId)b)) < 0;
+}
+
+/**
+ * Grow a buffer to hold at least `needed` bytes
+ * @return 0 on success, -1 on allocation failure
+ */
+static int buffer_reserve(BatchBuffer *buffer, size_t needed) {
+    if (needed <= buffer->capacity) {
+        return 0;
+    }
+
+    size_t capacity = (buffer->capacity > 0) ? buffer->capacity : BATCH_READ_SIZE;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    char *data = realloc(buffer->data, capacity);
+    if (data == NULL) {
+        return -1;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Release everything a run holds
+ */
+static void free_batch_run(BatchRun *run) {
+    for (int i = 0; i < run->count; i++) {
+        free(run->repositories[i].path);
+        free(run->repositories[i].output.data);
+        free(run->repositories[i].messages.data);
+    }
+    free(run->repositories);
+    string_pool_free(&run->rollup.author_names);
+    string_pool_free(&run->rollup.extensions);
+    free(run->rollup.authors);
+    free(run->rollup.file_types);
+}
+
+/**
+ * Milliseconds on a clock that never jumps
+ */
+static long long monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
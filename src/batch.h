@@ -0,0 +1,37 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "git_stats.h"
+
+/* Seconds a repository may take before it is abandoned, unless --timeout says otherwise */
+#define BATCH_DEFAULT_TIMEOUT 600
+
+/* Upper bound accepted for --timeout (one day) */
+#define BATCH_MAX_TIMEOUT 86400
+
+/**
+ * Settings of a --repos run
+ */
+typedef struct {
+    const char *source;     /* Directory to search, or file listing one repository per line ("-" = stdin) */
+    int workers;            /* Repositories analyzed at once, 0 = one per processor */
+    int timeout;            /* Seconds per repository, 0 = no limit */
+} BatchOptions;
+
+/**
+ * Analyze many repositories and print one combined document (--repos)
+ * Each repository is analyzed in its own child process, at most
+ * batch->workers at a time; a child that exceeds the timeout is killed
+ * together with the git processes it started. The document has one
+ * section per repository, written in the order the repositories were
+ * found, and a fleet-wide rollup.
+ * @param batch Repository source, worker count and timeout
+ * @param format OUTPUT_JSON or OUTPUT_NDJSON
+ * @param mode Analysis mode applied to every repository
+ * @param options Collection options applied to every repository
+ * @return Exit code
+ */
+int analyze_repositories(const BatchOptions *batch, OutputFormat format, AnalysisMode mode,
+                         const CollectOptions *options);
+
+#endif /* BATCH_H */
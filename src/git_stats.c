@@ -1,25 +1,41 @@
 #define _GNU_SOURCE
 #include "git_stats.h"
+#include "analysis/line_estimate.h"
 #include "utils/string_utils.h"
 #include "utils/git_commands.h"
+#include "utils/log_stream.h"
+#include "utils/hash_map.h"
+#include "utils/vector.h"
+#include "utils/git_repo.h"
+#include "utils/revwalk.h"
+#include "utils/parallel.h"
+#include "utils/blob_stream.h"
+#include "utils/subprocess.h"
+#include "utils/profile.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
 /* Forward declarations */
-static int get_repository_info(GitStats *stats);
-static int get_commit_stats(GitStats *stats);
-static int get_author_stats(GitStats *stats);
-static int get_branch_stats(GitStats *stats);
-static int get_file_stats(GitStats *stats);
+static void notify_commit(const GitStats *stats, const CommitRecord *commit);
+static int compare_authors_by_commits(const void* a, const void* b);
+
+/* Serializes listener calls from concurrently running collectors */
+static pthread_mutex_t listener_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Names of the authors being sorted, for breaking ties in qsort */
+static _Thread_local const StringPool *sorting_author_names;
 
 /**
  * Check if current directory is a git repository
+ * Accepts work trees (a .git directory or file) and bare repositories.
  */
 int is_git_repository(void) {
-    struct stat st;
-    return (stat(".git", &st) == 0 && S_ISDIR(st.st_mode));
+    char git_dir[MAX_PATH_LENGTH];
+    return git_repository_discover(git_dir, sizeof(git_dir)) == 0;
 }
 
 /**
@@ -34,27 +50,90 @@ void init_git_stats(GitStats *stats) {
 }
 
 /**
- * Gather basic git statistics
+ * Release all heap storage held by a GitStats structure
  */
-int get_basic_git_stats(GitStats *stats) {
+void free_git_stats(GitStats *stats) {
     assert(stats != NULL);
 
-    get_repository_info(stats);
+    free(stats->authors);
+    free(stats->branches);
+    free(stats->file_types);
+    free(stats->hotspots);
+    free(stats->activities);
+    string_pool_free(&stats->author_names);
+    string_pool_free(&stats->hotspot_paths);
+    string_pool_free(&stats->activity_names);
 
-    if (get_commit_stats(stats) != 0) {
-        fprintf(stderr, "Warning: Failed to get commit statistics\n");
-    }
+    init_git_stats(stats);
+}
 
-    if (get_author_stats(stats) != 0) {
-        fprintf(stderr, "Warning: Failed to get author statistics\n");
-    }
+/**
+ * Basic collectors; each writes only its own GitStats fields
+ */
+static const struct {
+    const char *name;       /* --profile phase */
+    int (*collect)(GitStats *stats);
+    StatsSection section;   /* Reported to the listener on success */
+    const char *warning;
+} BASIC_COLLECTORS[] = {
+    { "commits", get_commit_stats, STATS_SECTION_COMMITS, "Warning: Failed to get commit statistics\n" },
+    { "authors", get_author_stats, STATS_SECTION_AUTHORS, "Warning: Failed to get author statistics\n" },
+    { "branches", get_branch_stats, STATS_SECTION_BRANCHES, "Warning: Failed to get branch statistics\n" },
+    { "files", get_file_stats, STATS_SECTION_FILE_TYPES, "Warning: Failed to get file statistics\n" },
+};
+
+#define BASIC_COLLECTOR_COUNT ((int)(sizeof(BASIC_COLLECTORS) / sizeof(BASIC_COLLECTORS[0])))
+
+/**
+ * Shared state for running the basic collectors on a thread pool
+ */
+typedef struct {
+    GitStats *stats;
+    int workers;
+    int results[BASIC_COLLECTOR_COUNT];
+} BasicStatsJob;
 
-    if (get_branch_stats(stats) != 0) {
-        fprintf(stderr, "Warning: Failed to get branch statistics\n");
+/**
+ * Worker: run every collector assigned to this worker index
+ */
+static void run_basic_collectors(int worker_index, void *ctx) {
+    BasicStatsJob *job = (BasicStatsJob *)ctx;
+
+    for (int i = worker_index; i < BASIC_COLLECTOR_COUNT; i += job->workers) {
+        ProfilePhase *phase = profile_begin(BASIC_COLLECTORS[i].name);
+        job->results[i] = BASIC_COLLECTORS[i].collect(job->stats);
+        profile_end(phase);
+        if (job->results[i] == 0) {
+            notify_stats_section(job->stats, BASIC_COLLECTORS[i].section);
+        }
     }
+}
 
-    if (get_file_stats(stats) != 0) {
-        fprintf(stderr, "Warning: Failed to get file statistics\n");
+/**
+ * Gather basic git statistics
+ * The collectors mostly wait on git or the disk and touch disjoint
+ * fields, so they run concurrently (--jobs 1 runs them in sequence).
+ * Warnings are reported afterwards in collector order.
+ */
+int get_basic_git_stats(GitStats *stats) {
+    assert(stats != NULL);
+
+    ProfilePhase *phase = profile_begin("repository");
+    get_repository_info(stats);
+    profile_end(phase);
+    notify_stats_section(stats, STATS_SECTION_REPOSITORY);
+
+    BasicStatsJob job;
+    job.stats = stats;
+    job.workers = (stats->options.jobs > 0 && stats->options.jobs < BASIC_COLLECTOR_COUNT)
+                      ? stats->options.jobs
+                      : BASIC_COLLECTOR_COUNT;
+    parallel_run(job.workers, run_basic_collectors, &job);
+
+    for (int i = 0; i < BASIC_COLLECTOR_COUNT; i++) {
+        if (job.results[i] != 0) {
+            fputs(BASIC_COLLECTORS[i].warning, stderr);
+        }
     }
 
     return 0;
@@ -63,17 +142,22 @@ int get_basic_git_stats(GitStats *stats) {
 /**
  * Get basic repository information
  */
-static int get_repository_info(GitStats *stats) {
+int get_repository_info(GitStats *stats) {
     assert(stats != NULL);
 
-    char *result;
-
-    /* Get current branch */
-    result = execute_git_command("git branch --show-current 2>/dev/null");
-    if (result != NULL) {
-        remove_trailing_newline(result);
-        safe_string_copy(stats->current_branch, result, sizeof(stats->current_branch));
-        free(result);
+    /* Get current branch, reading HEAD directly when possible */
+    char git_dir[MAX_PATH_LENGTH];
+    GitRepository repo;
+    if (git_repository_discover(git_dir, sizeof(git_dir)) == 0 && git_repository_open(&repo) == 0) {
+        git_repository_current_branch(&repo, stats->current_branch, sizeof(stats->current_branch));
+        git_repository_close(&repo);
+    } else {
+        const char *const argv[] = {"git", "branch", "--show-current", NULL};
+        char *result = execute_git_command(argv);
+        if (result != NULL) {
+            safe_string_copy(stats->current_branch, result, sizeof(stats->current_branch));
+            free(result);
+        }
     }
 
     /* Get repository name from current directory */
@@ -91,10 +175,22 @@ static int get_repository_info(GitStats *stats) {
 /**
  * Get commit statistics
  */
-static int get_commit_stats(GitStats *stats) {
+int get_commit_stats(GitStats *stats) {
     assert(stats != NULL);
 
-    char *result = execute_git_command("git rev-list --all --count 2>/dev/null");
+    /* Walk the object database in-process; fall back to rev-list */
+    const CollectOptions *options = &stats->options;
+    long native_count;
+    if (revwalk_count_all(options->since, options->until, &native_count) == 0 &&
+        native_count <= INT_MAX) {
+        stats->total_commits = (int)native_count;
+        return 0;
+    }
+
+    HistoryWindowArgs window;
+    const char *argv[7] = {"git", "rev-list", "--all", "--count", NULL};
+    append_history_window(options, &window, argv, 4);
+    char *result = execute_git_command(argv);
     if (result != NULL) {
         long commit_count = strtol(result, NULL, 10);
         if (commit_count >= 0 && commit_count <= INT_MAX) {
@@ -107,191 +203,697 @@ static int get_commit_stats(GitStats *stats) {
     return -1;
 }
 
+/**
+ * Streaming state for the single-pass author aggregation
+ */
+typedef struct {
+    GitStats *stats;
+    AuthorTally tally;
+    int streaming;  /* Commit records go to the listener */
+    CommitRecord record;    /* Commit being streamed; id is NULL before the first */
+    char record_id[OID_HEX_SIZE + 1];
+    char record_author[MAX_NAME_LENGTH];
+    char record_date[32];
+} AuthorContext;
+
+/**
+ * Report the commit record accumulated so far, if any
+ */
+static void flush_commit_record(AuthorContext *context) {
+    if (context->streaming && context->record.id != NULL) {
+        notify_commit(context->stats, &context->record);
+    }
+}
+
+/**
+ * Attribute a commit to its author, creating the entry on first sight
+ */
+static void on_author_commit(const LogCommit *commit, void *ctx) {
+    AuthorContext *context = (AuthorContext *)ctx;
+
+    if (context->streaming) {
+        flush_commit_record(context);
+        safe_string_copy(context->record_id, commit->id, sizeof(context->record_id));
+        safe_string_copy(context->record_author, commit->author, sizeof(context->record_author));
+        safe_string_copy(context->record_date, commit->date, sizeof(context->record_date));
+        CommitRecord record = { context->record_id, context->record_author, context->record_date, 0, 0, 0 };
+        context->record = record;
+    }
+
+    author_tally_commit(&context->tally, commit->author);
+}
+
+/**
+ * Add a numstat line to the author of the current commit
+ */
+static void on_author_file(const LogFileChange *change, void *ctx) {
+    AuthorContext *context = (AuthorContext *)ctx;
+    if (context->streaming) {
+        context->record.files_changed++;
+        context->record.lines_added += change->lines_added;
+        context->record.lines_deleted += change->lines_deleted;
+    }
+    author_tally_lines(&context->tally, change->lines_added, change->lines_deleted);
+}
+
 /**
  * Get author statistics
+ * Commit counts and line changes for every author come from a single
+ * `git log --all --numstat` pass instead of one history walk per author.
  */
-static int get_author_stats(GitStats *stats) {
+int get_author_stats(GitStats *stats) {
     assert(stats != NULL);
 
-    FILE *fp;
-    char line[MAX_LINE_LENGTH];
+    stats->total_authors = 0;
+    string_pool_free(&stats->author_names);
+    if (string_pool_init(&stats->author_names, 0) != 0) {
+        return -1;
+    }
+
+    AuthorContext context;
+    memset(&context, 0, sizeof(context));
+    context.stats = stats;
+    author_tally_init(&context.tally, &stats->author_names);
+    context.streaming = (stats->options.commit_records && stats->listener != NULL &&
+                         stats->listener->on_commit != NULL);
+
+    /* The author walk also feeds the per-commit record stream */
+    LogStreamHandler handler = { on_author_commit, on_author_file, &context };
+    int result = stream_git_log(&handler, &stats->options, LOG_SCOPE_ALL);
+    flush_commit_record(&context);
 
-    /* Get author commit counts */
-    fp = popen("git shortlog -sn --all 2>/dev/null", "r");
-    if (fp == NULL) {
+    hash_map_debug_report(&stats->author_names.index, "authors");
+
+    if (result == 0) {
+        result = author_tally_rank(&context.tally, stats);
+    }
+    author_tally_free(&context.tally);
+    return result;
+}
+
+/**
+ * Start an empty author tally
+ */
+void author_tally_init(AuthorTally *tally, StringPool *names) {
+    assert(tally != NULL && names != NULL);
+
+    memset(tally, 0, sizeof(AuthorTally));
+    tally->names = names;
+    tally->current = -1;
+}
+
+/**
+ * Attribute a commit to its author, creating the row on first sight
+ */
+void author_tally_commit(AuthorTally *tally, const char *author) {
+    assert(tally != NULL && author != NULL);
+
+    /* Name ids are dense, so a name's id is its row */
+    StringId name;
+    tally->current = -1;
+    if (VECTOR_RESERVE(tally->rows, tally->capacity, tally->count + 1) != 0) {
+        return;
+    }
+    int inserted = string_pool_intern(tally->names, author, &name);
+    if (inserted < 0) {
+        return;
+    }
+
+    if (inserted) {
+        Author *row = &tally->rows[tally->count++];
+        memset(row, 0, sizeof(Author));
+        row->name = name;
+    }
+    tally->rows[name].commit_count++;
+    tally->current = (int)name;
+}
+
+/**
+ * Add a numstat line to the author of the last commit fed
+ */
+void author_tally_lines(AuthorTally *tally, int lines_added, int lines_deleted) {
+    assert(tally != NULL);
+    if (tally->current < 0) return;
+
+    tally->rows[tally->current].lines_added += lines_added;
+    tally->rows[tally->current].lines_deleted += lines_deleted;
+}
+
+/**
+ * Store the tally in stats->authors, ranked by commit count as
+ * shortlog -sn did
+ * The tally's pool must be stats->author_names.
+ * @return 0 on success, -1 on allocation failure
+ */
+int author_tally_rank(const AuthorTally *tally, GitStats *stats) {
+    assert(tally != NULL && stats != NULL);
+    assert(tally->names == &stats->author_names);
+
+    stats->total_authors = 0;
+    if (tally->count == 0) {
+        return 0;
+    }
+    if (VECTOR_RESERVE(stats->authors, stats->author_capacity, tally->count) != 0) {
         return -1;
     }
 
-    int author_count = 0;
-    while (fgets(line, sizeof(line), fp) != NULL && author_count < MAX_AUTHORS) {
-        char *tab = strchr(line, '\t');
-        if (tab != NULL) {
-            *tab = '\0';
+    memcpy(stats->authors, tally->rows, sizeof(Author) * (size_t)tally->count); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    stats->total_authors = tally->count;
 
-            /* Parse commit count */
-            long commits = strtol(line, NULL, 10);
-            if (commits >= 0 && commits <= INT_MAX) {
-                stats->authors[author_count].commit_count = (int)commits;
-            }
+    sorting_author_names = &stats->author_names;
+    qsort(stats->authors, stats->total_authors, sizeof(Author), compare_authors_by_commits);
+    sorting_author_names = NULL;
+    return 0;
+}
+
+/**
+ * Release an author tally (not its pool)
+ */
+void author_tally_free(AuthorTally *tally) {
+    assert(tally != NULL);
 
-            /* Copy author name */
-            char *author_name = tab + 1;
-            remove_trailing_newline(author_name);
-            safe_string_copy(stats->authors[author_count].name, author_name,
-                           sizeof(stats->authors[author_count].name));
+    free(tally->rows);
+    memset(tally, 0, sizeof(AuthorTally));
+    tally->current = -1;
+}
 
-            author_count++;
-        }
+/**
+ * Count commits on every local branch using the in-process reader
+ * @return 0 on success, -1 if the repository cannot be read in-process
+ */
+static int get_branch_stats_native(GitStats *stats) {
+    GitRepository repo;
+    if (git_repository_open(&repo) != 0) {
+        return -1;
+    }
+
+    GitRef *refs;
+    int ref_count;
+    if (git_repository_list_refs(&repo, "refs/heads/", 0, &refs, &ref_count) != 0) {
+        git_repository_close(&repo);
+        return -1;
     }
-    pclose(fp);
-    stats->total_authors = author_count;
 
-    /* Get line statistics for top authors */
-    for (int i = 0; i < author_count && i < MAX_AUTHORS_DISPLAY; i++) {
-        char command[MAX_COMMAND_LENGTH];
-        int ret = snprintf(command, sizeof(command),
-                "git log --author=\"%s\" --pretty=tformat: --numstat 2>/dev/null | "
-                "awk '{add+=$1; del+=$2} END {print add\" \"del}'",
-                stats->authors[i].name);
+    /* One graph walk yields the counts for every branch */
+    ObjectId *tips = malloc(sizeof(ObjectId) * (size_t)(ref_count > 0 ? ref_count : 1));
+    long *counts = malloc(sizeof(long) * (size_t)(ref_count > 0 ? ref_count : 1));
+    int result = (tips != NULL && counts != NULL) ? 0 : -1;
+    for (int i = 0; result == 0 && i < ref_count; i++) {
+        tips[i] = refs[i].oid;
+    }
+    if (result == 0) {
+        result = revwalk_count_reachable(&repo, tips, ref_count, stats->options.since,
+                                         stats->options.until, counts);
+    }
+    if (result == 0 && VECTOR_RESERVE(stats->branches, stats->branch_capacity, ref_count) != 0) {
+        result = -1;
+    }
 
-        if (ret < 0 || ret >= (int)sizeof(command)) {
-            continue; /* Command too long, skip this author */
-        }
+    for (int i = 0; result == 0 && i < ref_count; i++) {
+        Branch *branch = &stats->branches[i];
+        memset(branch, 0, sizeof(Branch));
+        safe_string_copy(branch->name, refs[i].name + strlen("refs/heads/"), sizeof(branch->name));
+        branch->commit_count = (counts[i] <= INT_MAX) ? (int)counts[i] : INT_MAX;
+    }
 
-        char *result = execute_git_command(command);
-        if (result != NULL) {
-            sscanf(result, "%d %d", &stats->authors[i].lines_added,
-                   &stats->authors[i].lines_deleted);
-            free(result);
+    free(tips);
+    free(counts);
+
+    if (result == 0) {
+        stats->total_branches = ref_count;
+    }
+
+    git_refs_free(refs, ref_count);
+    git_repository_close(&repo);
+    return result;
+}
+
+/**
+ * Record one branch listed by for-each-ref and count its commits
+ */
+static int add_listed_branch(char *refname, size_t length, void *ctx) {
+    GitStats *stats = ctx;
+    const char *prefix = "refs/heads/";
+    size_t prefix_length = strlen(prefix);
+    if (length <= prefix_length || strncmp(refname, prefix, prefix_length) != 0) {
+        return 0;
+    }
+
+    if (VECTOR_RESERVE(stats->branches, stats->branch_capacity, stats->total_branches + 1) != 0) {
+        return 1;
+    }
+    Branch *branch = &stats->branches[stats->total_branches];
+    memset(branch, 0, sizeof(Branch));
+    safe_string_copy(branch->name, refname + prefix_length, sizeof(branch->name));
+
+    /* The full ref name cannot be mistaken for a tag or an option */
+    HistoryWindowArgs window;
+    const char *argv[7] = {"git", "rev-list", "--count", NULL};
+    int argc = append_history_window(&stats->options, &window, argv, 3);
+    argv[argc] = refname;
+    argv[argc + 1] = NULL;
+    char *result = execute_git_command(argv);
+    if (result != NULL) {
+        long commits = strtol(result, NULL, 10);
+        if (commits >= 0 && commits <= INT_MAX) {
+            branch->commit_count = (int)commits;
         }
+        free(result);
     }
 
+    stats->total_branches++;
     return 0;
 }
 
 /**
  * Get branch statistics
  */
-static int get_branch_stats(GitStats *stats) {
+int get_branch_stats(GitStats *stats) {
     assert(stats != NULL);
 
-    FILE *fp = popen("git branch 2>/dev/null", "r");
-    if (fp == NULL) {
-        return -1;
+    if (get_branch_stats_native(stats) == 0) {
+        return 0;
     }
 
-    char line[MAX_LINE_LENGTH];
-    int branch_count = 0;
+    stats->total_branches = 0;
+    const char *const argv[] = {"git", "for-each-ref", "--format=%(refname)", "refs/heads/", NULL};
+    return (subprocess_stream(argv, NULL, 0, '\n', add_listed_branch, stats) == 0) ? 0 : -1;
+}
+
+/* Files handed to a line-counting worker per claim; also the number of
+ * requests pipelined to cat-file at once, so it must fit in a pipe buffer */
+#define LINE_COUNT_BATCH BLOB_STREAM_MAX_PENDING
+
+/**
+ * Per-worker file type totals, merged once all workers finish
+ */
+typedef struct {
+    HashMap index;      /* Extension -> position in types */
+    FileType *types;
+    int type_count;
+    int type_capacity;
+    long total_lines;
+    int failed;
+} LineCountShard;
 
-    while (fgets(line, sizeof(line), fp) != NULL && branch_count < MAX_BRANCHES) {
-        /* Skip if line is too short */
-        if (strlen(line) < 3) continue;
+/**
+ * Work shared by the line-counting workers
+ * With a revision, blobs are read through one cat-file process per worker;
+ * otherwise the working tree copies are read.
+ */
+typedef struct {
+    TreeBlob *files;
+    int file_count;
+    const char *rev;    /* NULL to count the working tree */
+    atomic_int next;    /* Next unclaimed index into files */
+    LineCountShard *shards;
+} LineCountJob;
 
-        char *branch_name = line;
-        /* Skip current branch marker and whitespace */
-        if (line[0] == '*' || line[0] == ' ') {
-            branch_name += 2;
+/**
+ * Files collected from `git ls-files -z`
+ */
+typedef struct {
+    TreeBlob *files;
+    int count;
+    int capacity;
+} TrackedFileList;
+
+/**
+ * Append one tracked file; object ids are left empty
+ */
+static int add_tracked_file(char *path, size_t length, void *ctx) {
+    TrackedFileList *list = ctx;
+
+    /* Skip empty filenames */
+    if (length == 0) return 0;
+
+    if (VECTOR_RESERVE(list->files, list->capacity, list->count + 1) != 0) {
+        return 1;
+    }
+    list->files[list->count].path = strndup(path, length);
+    if (list->files[list->count].path == NULL) {
+        return 1;
+    }
+    list->files[list->count].oid[0] = '\0';
+    list->files[list->count].size = -1;
+    list->count++;
+    return 0;
+}
+
+/**
+ * Read the NUL-separated output of `git ls-files -z`
+ * Object ids are left empty; the files are read from the working tree.
+ * @return 0 on success, -1 on error
+ */
+static int list_tracked_files(TreeBlob **files, int *count) {
+    *files = NULL;
+    *count = 0;
+
+    TrackedFileList list = {NULL, 0, 0};
+    const char *const argv[] = {"git", "ls-files", "-z", NULL};
+    int result = subprocess_stream(argv, NULL, 0, '\0', add_tracked_file, &list);
+
+    *files = list.files;
+    *count = list.count;
+    return (result == 0) ? 0 : -1;
+}
+
+/**
+ * Add one file to a worker's extension totals
+ */
+static void shard_add_file(LineCountShard *shard, const char *extension, int lines) {
+    int inserted;
+    int *position = hash_map_upsert(&shard->index, extension, shard->type_count, &inserted);
+    if (position == NULL) {
+        shard->failed = 1;
+        return;
+    }
+
+    if (inserted) {
+        if (VECTOR_RESERVE(shard->types, shard->type_capacity, shard->type_count + 1) != 0) {
+            *position = -1;
+            shard->failed = 1;
+            return;
+        }
+        FileType *type = &shard->types[shard->type_count++];
+        safe_string_copy(type->extension, extension, sizeof(type->extension));
+        type->count = 0;
+        type->total_lines = 0;
+        type->sampled = 0;
+        type->lines_margin = 0;
+    }
+
+    if (*position >= 0) {
+        shard->types[*position].count++;
+        if (lines >= 0) {
+            shard->types[*position].total_lines += lines;
+        }
+    }
+}
+
+/**
+ * Record the line count of one file in a worker's shard
+ */
+static void shard_count_file(LineCountShard *shard, const char *path, int lines) {
+    if (lines >= 0) {
+        shard->total_lines += lines;
+    }
+
+    /* Get file extension and update statistics */
+    char extension[MAX_EXTENSION_LENGTH];
+    get_file_extension(path, extension, sizeof(extension));
+    shard_add_file(shard, extension, lines);
+}
+
+/**
+ * Count a batch of committed blobs through the worker's cat-file process
+ * All requests of the batch are written before the first response is read.
+ */
+static int count_blob_batch(BlobStream *stream, LineCountShard *shard,
+                            const TreeBlob *files, int start, int end) {
+    for (int i = start; i < end; i++) {
+        if (blob_stream_request(stream, files[i].oid) != 0) {
+            return -1;
+        }
+    }
+    if (blob_stream_flush(stream) != 0) {
+        return -1;
+    }
+
+    for (int i = start; i < end; i++) {
+        long lines = blob_stream_count_lines(stream);
+        if (lines == -1) {
+            return -1;
         }
+        shard_count_file(shard, files[i].path, (lines < 0) ? -1 : (lines > INT_MAX) ? INT_MAX : (int)lines);
+    }
+
+    return 0;
+}
+
+/**
+ * Line-counting worker: claims batches of files until none are left
+ * Each worker writes only to its own shard, so no locking is needed.
+ */
+static void count_lines_worker(int worker_index, void *ctx) {
+    LineCountJob *job = (LineCountJob *)ctx;
+    LineCountShard *shard = &job->shards[worker_index];
 
-        /* Remove trailing newline */
-        remove_trailing_newline(branch_name);
+    BlobStream stream;
+    int stream_open = 0;
 
-        /* Skip empty branch names */
-        if (strlen(branch_name) == 0) continue;
+    for (;;) {
+        int start = atomic_fetch_add(&job->next, LINE_COUNT_BATCH);
+        if (start >= job->file_count) break;
 
-        safe_string_copy(stats->branches[branch_count].name, branch_name,
-                        sizeof(stats->branches[branch_count].name));
+        int end = (start + LINE_COUNT_BATCH < job->file_count) ? start + LINE_COUNT_BATCH : job->file_count;
 
-        /* Get commit count for this branch */
-        char command[MAX_COMMAND_LENGTH];
-        int ret = snprintf(command, sizeof(command),
-                "git rev-list --count \"%s\" 2>/dev/null", branch_name);
+        if (job->rev == NULL) {
+            for (int i = start; i < end; i++) {
+                shard_count_file(shard, job->files[i].path, count_lines_in_file(job->files[i].path));
+            }
+            continue;
+        }
 
-        if (ret > 0 && ret < (int)sizeof(command)) {
-            char *result = execute_git_command(command);
-            if (result != NULL) {
-                long commits = strtol(result, NULL, 10);
-                if (commits >= 0 && commits <= INT_MAX) {
-                    stats->branches[branch_count].commit_count = (int)commits;
-                }
-                free(result);
+        if (!stream_open) {
+            if (blob_stream_open(&stream) != 0) {
+                shard->failed = 1;
+                break;
             }
+            stream_open = 1;
+        }
+        if (count_blob_batch(&stream, shard, job->files, start, end) != 0) {
+            shard->failed = 1;
+            break;
+        }
+    }
+
+    if (stream_open) {
+        blob_stream_close(&stream);
+    }
+}
+
+/**
+ * Fold a worker's totals into the shared file type table
+ */
+static int merge_line_count_shard(GitStats *stats, HashMap *type_index, const LineCountShard *shard) {
+    if (shard->failed) {
+        return -1;
+    }
+
+    stats->total_lines += shard->total_lines;
+
+    for (int i = 0; i < shard->type_count; i++) {
+        const FileType *source = &shard->types[i];
+
+        int inserted;
+        int *position = hash_map_upsert(type_index, source->extension, stats->file_type_count, &inserted);
+        if (position == NULL) {
+            return -1;
         }
 
-        branch_count++;
+        if (inserted) {
+            if (VECTOR_RESERVE(stats->file_types, stats->file_type_capacity,
+                               stats->file_type_count + 1) != 0) {
+                return -1;
+            }
+            stats->file_types[stats->file_type_count++] = *source;
+        } else {
+            stats->file_types[*position].count += source->count;
+            stats->file_types[*position].total_lines += source->total_lines;
+        }
     }
-    pclose(fp);
-    stats->total_branches = branch_count;
 
     return 0;
 }
 
 /**
  * Get file statistics
+ * Tracked files are sharded across a worker pool (--jobs); every worker
+ * keeps private per-extension totals that are merged at the end. With
+ * --rev the files of that commit are counted from their blobs instead of
+ * the working tree, which also works in bare repositories.
+ * --estimate-lines counts only a sample (see get_estimated_file_stats()).
  */
-static int get_file_stats(GitStats *stats) {
+int get_file_stats(GitStats *stats) {
     assert(stats != NULL);
 
-    FILE *fp = popen("git ls-files 2>/dev/null", "r");
-    if (fp == NULL) {
+    if (stats->options.estimate_lines) {
+        return get_estimated_file_stats(stats);
+    }
+
+    /* Bare repositories have no working tree: count what HEAD points to */
+    const char *rev = stats->options.rev;
+    char git_dir[MAX_PATH_LENGTH];
+    if (rev == NULL && git_repository_discover(git_dir, sizeof(git_dir)) == 0 &&
+        strcmp(git_dir, ".") == 0) {
+        rev = "HEAD";
+    }
+
+    TreeBlob *files;
+    int file_count;
+    if (rev != NULL) {
+        if (list_tree_blobs(rev, 0, &files, &file_count) != 0) {
+            fprintf(stderr, "Warning: Cannot read the tree of revision '%s'\n", rev);
+            return -1;
+        }
+    } else if (list_tracked_files(&files, &file_count) != 0) {
+        tree_blobs_free(files, file_count);
         return -1;
     }
 
-    char filename[MAX_LINE_LENGTH];
-    int file_count = 0;
-    long total_lines = 0;
+    /* No more workers than there are batches to hand out */
+    int workers = (stats->options.jobs > 0) ? stats->options.jobs : parallel_default_jobs();
+    int batches = (file_count + LINE_COUNT_BATCH - 1) / LINE_COUNT_BATCH;
+    if (workers > batches) workers = batches;
+    if (workers < 1) workers = 1;
+
+    LineCountJob job;
+    job.files = files;
+    job.file_count = file_count;
+    job.rev = rev;
+    atomic_init(&job.next, 0);
+    job.shards = calloc((size_t)workers, sizeof(LineCountShard));
+
+    HashMap type_index;
+    int result = (job.shards != NULL && hash_map_init(&type_index, 0) == 0) ? 0 : -1;
+
+    for (int i = 0; result == 0 && i < workers; i++) {
+        if (hash_map_init(&job.shards[i].index, 0) != 0) {
+            job.shards[i].failed = 1;
+        }
+    }
 
     /* Initialize file type counters */
     stats->file_type_count = 0;
+    stats->total_lines = 0;
 
-    while (fgets(filename, sizeof(filename), fp) != NULL) {
-        /* Remove trailing newline */
-        remove_trailing_newline(filename);
+    if (result == 0) {
+        parallel_run(workers, count_lines_worker, &job);
 
-        /* Skip empty filenames */
-        if (strlen(filename) == 0) continue;
+        /* Merge in worker order so results do not depend on scheduling */
+        for (int i = 0; result == 0 && i < workers; i++) {
+            result = merge_line_count_shard(stats, &type_index, &job.shards[i]);
+        }
 
-        file_count++;
+        hash_map_debug_report(&type_index, "file types");
+        hash_map_free(&type_index);
+    }
 
-        /* Count lines in file */
-        int lines = count_lines_in_file(filename);
-        if (lines >= 0) {
-            total_lines += lines;
+    for (int i = 0; job.shards != NULL && i < workers; i++) {
+        if (job.shards[i].index.slots != NULL) {
+            hash_map_free(&job.shards[i].index);
         }
+        free(job.shards[i].types);
+    }
+    free(job.shards);
 
-        /* Get file extension and update statistics */
-        char extension[MAX_EXTENSION_LENGTH];
-        get_file_extension(filename, extension, sizeof(extension));
-
-        /* Find or create file type entry */
-        int found = 0;
-        for (int i = 0; i < stats->file_type_count; i++) {
-            if (strcmp(stats->file_types[i].extension, extension) == 0) {
-                stats->file_types[i].count++;
-                if (lines >= 0) {
-                    stats->file_types[i].total_lines += lines;
-                }
-                found = 1;
-                break;
-            }
-        }
+    tree_blobs_free(files, file_count);
 
-        if (!found && stats->file_type_count < MAX_FILE_TYPES) {
-            safe_string_copy(stats->file_types[stats->file_type_count].extension,
-                           extension, sizeof(stats->file_types[stats->file_type_count].extension));
-            stats->file_types[stats->file_type_count].count = 1;
-            stats->file_types[stats->file_type_count].total_lines = (lines >= 0) ? lines : 0;
-            stats->file_type_count++;
-        }
+    if (result != 0) {
+        return -1;
     }
-    pclose(fp);
 
     stats->total_files = file_count;
-    stats->total_lines = total_lines;
+
+    /* Keep file types ranked by count for the formatters */
+    if (stats->file_type_count > 0) {
+        qsort(stats->file_types, stats->file_type_count, sizeof(FileType),
+              compare_file_types_by_count);
+    }
 
     return 0;
 }
 
+/**
+ * Report a section that has become final to the listener, if any
+ */
+void notify_stats_section(const GitStats *stats, StatsSection section) {
+    assert(stats != NULL);
+
+    if (stats->listener == NULL || stats->listener->on_section == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&listener_lock);
+    stats->listener->on_section(stats, section, stats->listener->ctx);
+    pthread_mutex_unlock(&listener_lock);
+}
+
+/**
+ * Hand one finished commit record to the listener
+ */
+static void notify_commit(const GitStats *stats, const CommitRecord *commit) {
+    pthread_mutex_lock(&listener_lock);
+    stats->listener->on_commit(commit, stats->listener->ctx);
+    pthread_mutex_unlock(&listener_lock);
+}
+
+/**
+ * Number of rows of a section to output under the --limit option
+ */
+int display_row_count(const CollectOptions *options, int count, int default_limit) {
+    assert(options != NULL);
+
+    int limit = default_limit;
+    if (options->limit == LIMIT_ALL) {
+        return count;
+    }
+    if (options->limit > 0) {
+        limit = options->limit;
+    }
+    return (count < limit) ? count : limit;
+}
+
+/**
+ * Append --since/--until for the options' date window to a git command
+ * The window is passed as @<epoch> so git applies exactly the bounds
+ * parsed here. argv must have room for two more entries and the NULL.
+ */
+int append_history_window(const CollectOptions *options, HistoryWindowArgs *storage,
+                          const char **argv, int argc) {
+    assert(options != NULL && storage != NULL);
+    assert(argv != NULL && argc >= 0);
+
+    if (options->since > 0) {
+        int ret = snprintf(storage->since, sizeof(storage->since), "--since=@%lld", options->since);
+        if (ret > 0 && ret < (int)sizeof(storage->since)) {
+            argv[argc++] = storage->since;
+        }
+    }
+    if (options->until > 0) {
+        int ret = snprintf(storage->until, sizeof(storage->until), "--until=@%lld", options->until);
+        if (ret > 0 && ret < (int)sizeof(storage->until)) {
+            argv[argc++] = storage->until;
+        }
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+/**
+ * Name of an author entry
+ */
+const char* git_stats_author_name(const GitStats *stats, const Author *author) {
+    assert(stats != NULL && author != NULL);
+    return string_pool_get(&stats->author_names, author->name);
+}
+
+/**
+ * Path of a hotspot entry
+ */
+const char* git_stats_hotspot_path(const GitStats *stats, const FileHotspot *hotspot) {
+    assert(stats != NULL && hotspot != NULL);
+    return string_pool_get(&stats->hotspot_paths, hotspot->filename);
+}
+
+/**
+ * Name of an activity entry
+ */
+const char* git_stats_activity_name(const GitStats *stats, const AuthorActivity *activity) {
+    assert(stats != NULL && activity != NULL);
+    return string_pool_get(&stats->activity_names, activity->name);
+}
+
 /**
  * Comparison function for sorting file types by count
  */
@@ -299,8 +901,22 @@ int compare_file_types_by_count(const void* a, const void* b) {
     const FileType* type_a = (const FileType*)a;
     const FileType* type_b = (const FileType*)b;
 
-    /* Sort in descending order */
+    /* Sort in descending order, ties broken by extension for stable output */
     if (type_a->count < type_b->count) return 1;
     if (type_a->count > type_b->count) return -1;
-    return 0;
+    return strcmp(type_a->extension, type_b->extension);
+}
+
+/**
+ * Comparison function for sorting authors by commit count
+ */
+static int compare_authors_by_commits(const void* a, const void* b) {
+    const Author* author_a = (const Author*)a;
+    const Author* author_b = (const Author*)b;
+
+    /* Sort in descending order, ties broken by name for stable output */
+    if (author_a->commit_count < author_b->commit_count) return 1;
+    if (author_a->commit_count > author_b->commit_count) return -1;
+    return strcmp(string_pool_get(sorting_author_names, author_a->name),
+                  string_pool_get(sorting_author_names, author_b->name));
 }
\ No newline at end of file
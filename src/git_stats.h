@@ -12,6 +12,7 @@
 #include <limits.h>
 #include <assert.h>
 #include <math.h>
+#include "utils/string_pool.h"
 
 /* Buffer size constants */
 #define MAX_LINE_LENGTH 1024
@@ -19,17 +20,18 @@
 #define MAX_PATH_LENGTH 1024
 #define MAX_NAME_LENGTH 256
 #define MAX_EXTENSION_LENGTH 16
-
-/* Collection size limits */
-#define MAX_AUTHORS 100
-#define MAX_BRANCHES 50
-#define MAX_FILE_TYPES 50
-#define MAX_FILES 1000
+#define SHORT_DATE_SIZE 11 /* YYYY-MM-DD and the terminator */
 
 /* Display limits */
 #define MAX_AUTHORS_DISPLAY 10
 #define MAX_BRANCHES_DISPLAY 10
 #define MAX_FILE_TYPES_DISPLAY 10
+#define MAX_HOTSPOTS_DISPLAY 15
+#define MAX_ACTIVITY_DISPLAY 15
+
+/* CollectOptions.limit values besides a positive row count */
+#define LIMIT_DEFAULT 0     /* Each section's own display limit */
+#define LIMIT_ALL -1        /* Every row */
 
 /* Return codes */
 #define EXIT_SUCCESS_CODE 0
@@ -41,7 +43,8 @@
 /* Output formats */
 typedef enum {
     OUTPUT_DEFAULT,
-    OUTPUT_JSON
+    OUTPUT_JSON,
+    OUTPUT_NDJSON
 } OutputFormat;
 
 /* Analysis modes */
@@ -51,11 +54,51 @@ typedef enum {
     ANALYSIS_ACTIVITY
 } AnalysisMode;
 
+/* Upper bound accepted for --jobs */
+#define MAX_JOBS 256
+
+/* Hotspot sketch memory: default, and least accepted for --memory-budget */
+#define DEFAULT_MEMORY_BUDGET ((size_t)64 * 1024 * 1024)
+#define MIN_MEMORY_BUDGET ((size_t)64 * 1024)
+
+/* Files counted per extension by --estimate-lines: default and bounds of --sample-size */
+#define DEFAULT_LINE_SAMPLE_SIZE 100
+#define MIN_LINE_SAMPLE_SIZE 2
+#define MAX_LINE_SAMPLE_SIZE 1000000
+
+/**
+ * Collection options taken from the command line
+ */
+typedef struct {
+    int jobs;           /* Worker threads for line counting, 0 = one per processor */
+    const char *rev;    /* Count lines in this commit's blobs, NULL = working tree */
+    int use_cache;      /* Reuse per-commit history facts from .git/git-stat/cache */
+    int limit;          /* Rows per listed section: LIMIT_DEFAULT, LIMIT_ALL or a count */
+    int commit_records; /* Stream one record per commit to the listener (--commits) */
+    int profile;        /* Record per-phase costs and report them (--profile) */
+    long long since;    /* Only commits dated at or after this (epoch seconds), 0 = no bound */
+    long long until;    /* Only commits dated at or before this, 0 = no bound */
+    int approximate_hotspots;   /* Rank hotspots from a bounded sketch (--hotspots=approx) */
+    size_t memory_budget;       /* Bytes the hotspot sketch may use (--memory-budget) */
+    int fast_summary;           /* Estimate distinct counts in one history pass (--fast) */
+    int hll_precision;          /* Register index bits of the --fast sketches */
+    int estimate_lines;         /* Extrapolate line counts from a sample (--estimate-lines) */
+    int sample_size;            /* Files counted per extension with --estimate-lines */
+} CollectOptions;
+
+/**
+ * Storage for the --since/--until arguments handed to git
+ */
+typedef struct {
+    char since[32];
+    char until[32];
+} HistoryWindowArgs;
+
 /**
  * Author statistics structure
  */
 typedef struct {
-    char name[MAX_NAME_LENGTH];
+    StringId name;      /* In GitStats.author_names */
     int commit_count;
     int lines_added;
     int lines_deleted;
@@ -65,12 +108,12 @@ typedef struct {
  * Author activity structure for temporal analysis
  */
 typedef struct {
-    char name[MAX_NAME_LENGTH];
+    StringId name;      /* In GitStats.activity_names */
     int commit_count;
     int lines_added;
     int lines_deleted;
-    char first_commit_date[32];
-    char last_commit_date[32];
+    char first_commit_date[SHORT_DATE_SIZE];
+    char last_commit_date[SHORT_DATE_SIZE];
     int days_since_last_commit;
     int is_active;  /* 1 if active (committed within last 90 days), 0 otherwise */
     double activity_score;
@@ -92,23 +135,150 @@ typedef struct {
     char extension[MAX_EXTENSION_LENGTH];
     int count;
     long total_lines;
+    int sampled;        /* --estimate-lines: files whose lines were counted */
+    long lines_margin;  /* --estimate-lines: half-width of the 95% interval of total_lines */
 } FileType;
 
 /**
  * File hotspot structure for churn analysis
  */
 typedef struct {
-    char filename[MAX_PATH_LENGTH];
+    StringId filename;  /* In GitStats.hotspot_paths */
     int commit_count;
     int lines_added;
     int lines_deleted;
     double hotspot_score;
+    int commit_error;   /* Approximate mode: commit_count may exceed the true count by this */
 } FileHotspot;
 
 /**
- * Main statistics container
+ * How far approximate hotspots can be from the exact ones
+ * A path ranked from the sketch has between commit_count - commit_error
+ * and commit_count commits. Its line counts cover only the changes made
+ * since the sketch last started monitoring it: they are lower bounds, exact
+ * when commit_error is 0, and the score mixes them with the overestimated
+ * commits, so it is neither bound. A path the sketch does not monitor at
+ * the end, including one too long to monitor at all, has at most
+ * max_unmonitored_commits commits.
  */
 typedef struct {
+    int approximate;            /* hotspots come from the sketch */
+    int counters;               /* Paths the memory budget lets the sketch monitor */
+    long long changes;          /* Numstat lines counted */
+    long long evictions;        /* Paths dropped to make room */
+    long long oversized_changes;    /* Changes to paths longer than the path budget, not counted */
+    int max_unmonitored_commits;
+    size_t memory_budget;
+} HotspotAccuracy;
+
+/**
+ * Distinct counts estimated by the --fast summary
+ * Each count comes from a HyperLogLog sketch of 2^precision bytes, so the
+ * pass runs in the same memory however large history is. An estimate is
+ * within standard_error of the true count (as a fraction of it) about two
+ * times in three, and within three times that almost always.
+ */
+typedef struct {
+    int enabled;            /* The summary came from the --fast pass */
+    int precision;
+    double standard_error;
+    size_t memory;          /* Bytes of all sketches */
+    double authors;
+    double files;           /* Distinct paths ever touched */
+    double extensions;      /* Distinct extensions of those paths */
+} DistinctEstimates;
+
+/**
+ * How the --estimate-lines file table was extrapolated
+ * Each extension is sampled on its own. Its line count is the sample's
+ * lines per byte times the size of all its files (a ratio estimator), and
+ * its margin is the half-width of a 95% confidence interval: types counted
+ * in full have none. The margin of total_lines combines the types'
+ * variances, so it is narrower than their sum.
+ */
+typedef struct {
+    int enabled;            /* file_types come from a sample */
+    int sample_size;        /* Most files counted per extension */
+    int sampled_files;      /* Files counted across all extensions */
+    long long total_bytes;  /* Size of every file */
+    long lines_margin;      /* Of total_lines */
+} LineEstimate;
+
+/**
+ * Per-author commit and line totals accumulated from history, indexed by
+ * name id
+ * A tally can be fed further commits and ranked again at any time, so
+ * history that has already been counted never needs another walk.
+ */
+typedef struct {
+    StringPool *names;
+    Author *rows;       /* rows[id] is the author whose name has that id */
+    int count;
+    int capacity;
+    int current;        /* Row of the author of the commit being fed, -1 if dropped */
+} AuthorTally;
+
+/**
+ * Results that become final while statistics are gathered
+ */
+typedef enum {
+    STATS_SECTION_REPOSITORY,   /* repo_name, current_branch */
+    STATS_SECTION_COMMITS,      /* total_commits */
+    STATS_SECTION_AUTHORS,
+    STATS_SECTION_BRANCHES,
+    STATS_SECTION_FILE_TYPES,   /* file_types, total_files, total_lines */
+    STATS_SECTION_HOTSPOTS,
+    STATS_SECTION_ACTIVITY
+} StatsSection;
+
+/**
+ * One commit of the history walk with its numstat totals
+ */
+typedef struct {
+    const char *id;         /* Hex commit id */
+    const char *author;
+    const char *date;       /* YYYY-MM-DD */
+    int files_changed;
+    long lines_added;
+    long lines_deleted;
+} CommitRecord;
+
+struct GitStats;
+
+/**
+ * Receives results as soon as they are final, for streaming output
+ * Collectors run concurrently, but calls are serialized. A section's
+ * fields must not be modified after it has been reported.
+ */
+typedef struct {
+    void (*on_section)(const struct GitStats *stats, StatsSection section, void *ctx);
+    void (*on_commit)(const CommitRecord *commit, void *ctx);  /* With options.commit_records */
+    void *ctx;
+} StatsListener;
+
+/**
+ * Main statistics container
+ *
+ * Collections are heap-backed vectors sized to the repository; there are
+ * no fixed caps. Each array holds exactly its count of valid entries:
+ *   authors[0 .. total_authors)
+ *   branches[0 .. total_branches)
+ *   file_types[0 .. file_type_count)
+ *   hotspots[0 .. hotspot_count)
+ *   activities[0 .. activity_count)
+ * Use GIT_STATS_FOR_EACH to visit every entry. The *_capacity fields are
+ * bookkeeping for vector_reserve() and must not be used for iteration.
+ * hotspots and activities are ranked only as far as options.limit will
+ * display (all of them with LIMIT_ALL); entries past those rows are
+ * unordered.
+ * Author names and hotspot paths are stored once in a StringPool per
+ * collection; records carry their StringId (see git_stats_author_name()
+ * and friends).
+ * Release the storage with free_git_stats().
+ */
+typedef struct GitStats {
+    CollectOptions options;
+    const StatsListener *listener;  /* Notified as sections become final, or NULL */
     int total_commits;
     int total_authors;
     int total_branches;
@@ -116,21 +286,64 @@ typedef struct {
     long total_lines;
     char current_branch[MAX_NAME_LENGTH];
     char repo_name[MAX_NAME_LENGTH];
-    Author authors[MAX_AUTHORS];
-    Branch branches[MAX_BRANCHES];
-    FileType file_types[MAX_FILE_TYPES];
+    Author *authors;
+    int author_capacity;
+    StringPool author_names;
+    Branch *branches;
+    int branch_capacity;
+    FileType *file_types;
     int file_type_count;
-    FileHotspot hotspots[MAX_FILES];
+    int file_type_capacity;
+    LineEstimate line_estimate;
+    FileHotspot *hotspots;
     int hotspot_count;
-    AuthorActivity activities[MAX_AUTHORS];
+    int hotspot_capacity;
+    StringPool hotspot_paths;
+    HotspotAccuracy hotspot_accuracy;
+    DistinctEstimates estimates;
+    AuthorActivity *activities;
     int activity_count;
+    int activity_capacity;
+    StringPool activity_names;
 } GitStats;
 
+/**
+ * Iterate every entry of a GitStats collection
+ * Example: GIT_STATS_FOR_EACH(const Author, author, stats->authors, stats->total_authors) { ... }
+ */
+#define GIT_STATS_FOR_EACH(type, item, array, count) \
+    for (type *item = (array); item != NULL && item < (array) + (count); item++)
+
 /* Core API functions */
 int is_git_repository(void);
 void init_git_stats(GitStats *stats);
+void free_git_stats(GitStats *stats);
 int get_basic_git_stats(GitStats *stats);
 
+/* Individual basic collectors, run together by get_basic_git_stats() */
+int get_repository_info(GitStats *stats);
+int get_commit_stats(GitStats *stats);
+int get_author_stats(GitStats *stats);
+int get_branch_stats(GitStats *stats);
+int get_file_stats(GitStats *stats);
+
+/* Author tallies, which get_author_stats() feeds from one history walk */
+void author_tally_init(AuthorTally *tally, StringPool *names);
+void author_tally_commit(AuthorTally *tally, const char *author);
+void author_tally_lines(AuthorTally *tally, int lines_added, int lines_deleted);
+int author_tally_rank(const AuthorTally *tally, GitStats *stats);
+void author_tally_free(AuthorTally *tally);
+
+int display_row_count(const CollectOptions *options, int count, int default_limit);
+int append_history_window(const CollectOptions *options, HistoryWindowArgs *storage,
+                          const char **argv, int argc);
+void notify_stats_section(const GitStats *stats, StatsSection section);
+
+/* Interned strings of collection entries */
+const char* git_stats_author_name(const GitStats *stats, const Author *author);
+const char* git_stats_hotspot_path(const GitStats *stats, const FileHotspot *hotspot);
+const char* git_stats_activity_name(const GitStats *stats, const AuthorActivity *activity);
+
 /* Comparison functions for sorting */
 int compare_file_types_by_count(const void* a, const void* b);
 
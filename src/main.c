@@ -1,22 +1,58 @@
 #define _GNU_SOURCE
 #include "git_stats.h"
+#include "server.h"
+#include "batch.h"
 #include "analysis/hotspots.h"
 #include "analysis/activity.h"
+#include "analysis/fast_summary.h"
 #include "output/formatters.h"
+#include "utils/hyperloglog.h"
+#include "utils/profile.h"
+#include "utils/string_utils.h"
 #include "version.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <time.h>
 
 /**
  * Parse command line arguments
  */
-static int parse_arguments(int argc, const char *const argv[], OutputFormat *format, AnalysisMode *mode) {
+static int parse_arguments(int argc, const char *const argv[], OutputFormat *format, AnalysisMode *mode,
+                           CollectOptions *options, const char **socket_path, BatchOptions *batch) {
     assert(format != NULL);
     assert(mode != NULL);
+    assert(options != NULL);
+    assert(socket_path != NULL);
+    assert(batch != NULL);
 
     *format = OUTPUT_DEFAULT;
     *mode = ANALYSIS_BASIC;
+    *socket_path = NULL;
+    batch->source = NULL;
+    batch->workers = 0;
+    batch->timeout = BATCH_DEFAULT_TIMEOUT;
+    int batch_option_given = 0;
+    int output_given = 0;
+    options->jobs = 0;
+    options->rev = NULL;
+    options->use_cache = 1;
+    options->limit = LIMIT_DEFAULT;
+    options->commit_records = 0;
+    options->profile = 0;
+    options->since = 0;
+    options->until = 0;
+    options->approximate_hotspots = 0;
+    options->memory_budget = DEFAULT_MEMORY_BUDGET;
+    int budget_given = 0;
+    options->fast_summary = 0;
+    options->hll_precision = HYPERLOGLOG_DEFAULT_PRECISION;
+    int precision_given = 0;
+    options->estimate_lines = 0;
+    options->sample_size = DEFAULT_LINE_SAMPLE_SIZE;
+    int sample_size_given = 0;
+    time_t now = time(NULL);
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
@@ -32,22 +68,180 @@ static int parse_arguments(int argc, const char *const argv[], OutputFormat *for
         if (strcmp(argv[i], "--output") == 0) {
             if (i + 1 >= argc) {
                 fprintf(stderr, "Error: --output requires a format argument\n");
-                fprintf(stderr, "Supported formats: json\n");
+                fprintf(stderr, "Supported formats: json, ndjson\n");
                 return EXIT_ERROR_CODE;
             }
 
             i++; /* Move to format argument */
+            output_given = 1;
             if (strcmp(argv[i], "json") == 0) {
                 *format = OUTPUT_JSON;
+            } else if (strcmp(argv[i], "ndjson") == 0) {
+                *format = OUTPUT_NDJSON;
             } else {
                 fprintf(stderr, "Error: Unknown output format '%s'\n", argv[i]);
-                fprintf(stderr, "Supported formats: json\n");
+                fprintf(stderr, "Supported formats: json, ndjson\n");
                 return EXIT_ERROR_CODE;
             }
-        } else if (strcmp(argv[i], "--hotspots") == 0) {
+        } else if (strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires a thread count\n", argv[i]);
+                return EXIT_ERROR_CODE;
+            }
+
+            i++; /* Move to count argument */
+            char *end;
+            long jobs = strtol(argv[i], &end, 10);
+            if (end == argv[i] || *end != '\0' || jobs < 1 || jobs > MAX_JOBS) {
+                fprintf(stderr, "Error: Invalid thread count '%s' (expected 1-%d)\n", argv[i], MAX_JOBS);
+                return EXIT_ERROR_CODE;
+            }
+            options->jobs = (int)jobs;
+        } else if (strcmp(argv[i], "--rev") == 0) {
+            /* Refuse option-like values: the revision is passed to git as an argument */
+            if (i + 1 >= argc || argv[i + 1][0] == '-' || argv[i + 1][0] == '\0') {
+                fprintf(stderr, "Error: --rev requires a commit argument\n");
+                return EXIT_ERROR_CODE;
+            }
+            options->rev = argv[++i];
+        } else if (strcmp(argv[i], "--limit") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --limit requires a row count or 'all'\n");
+                return EXIT_ERROR_CODE;
+            }
+
+            i++; /* Move to limit argument */
+            if (strcmp(argv[i], "all") == 0) {
+                options->limit = LIMIT_ALL;
+            } else {
+                char *end;
+                long limit = strtol(argv[i], &end, 10);
+                if (end == argv[i] || *end != '\0' || limit < 1 || limit > INT_MAX) {
+                    fprintf(stderr, "Error: Invalid limit '%s' (expected a positive count or 'all')\n",
+                            argv[i]);
+                    return EXIT_ERROR_CODE;
+                }
+                options->limit = (int)limit;
+            }
+        } else if (strcmp(argv[i], "--since") == 0 || strcmp(argv[i], "--until") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires a date\n", argv[i]);
+                return EXIT_ERROR_CODE;
+            }
+
+            long long *bound = (argv[i][2] == 's') ? &options->since : &options->until;
+            if (parse_date_expression(argv[i + 1], now, bound) != 0 || *bound <= 0) {
+                fprintf(stderr, "Error: Invalid date '%s' (expected YYYY-MM-DD[ HH:MM[:SS]], "
+                                "'N days ago' or @SECONDS)\n", argv[i + 1]);
+                return EXIT_ERROR_CODE;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                fprintf(stderr, "Error: --serve requires a socket path\n");
+                return EXIT_ERROR_CODE;
+            }
+            *socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--repos") == 0) {
+            if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                fprintf(stderr, "Error: --repos requires a directory or list file\n");
+                return EXIT_ERROR_CODE;
+            }
+            batch->source = argv[++i];
+        } else if (strcmp(argv[i], "--repo-jobs") == 0 || strcmp(argv[i], "--timeout") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires a count\n", argv[i]);
+                return EXIT_ERROR_CODE;
+            }
+
+            int is_timeout = (argv[i][2] == 't');
+            long minimum = is_timeout ? 0 : 1;
+            long maximum = is_timeout ? BATCH_MAX_TIMEOUT : MAX_JOBS;
+            char *end;
+            long value = strtol(argv[i + 1], &end, 10);
+            if (end == argv[i + 1] || *end != '\0' || value < minimum || value > maximum) {
+                fprintf(stderr, "Error: Invalid %s '%s' (expected %ld-%ld)\n",
+                        is_timeout ? "timeout" : "repository job count", argv[i + 1], minimum, maximum);
+                return EXIT_ERROR_CODE;
+            }
+            if (is_timeout) {
+                batch->timeout = (int)value;
+            } else {
+                batch->workers = (int)value;
+            }
+            batch_option_given = 1;
+            i++;
+        } else if (strcmp(argv[i], "--commits") == 0) {
+            options->commit_records = 1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            options->profile = 1;
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            options->use_cache = 0;
+        } else if (strcmp(argv[i], "--hotspots") == 0 || strncmp(argv[i], "--hotspots=", 11) == 0) {
             *mode = ANALYSIS_HOTSPOTS;
+            const char *method = (argv[i][10] == '=') ? argv[i] + 11 : "exact";
+            if (strcmp(method, "exact") == 0) {
+                options->approximate_hotspots = 0;
+            } else if (strcmp(method, "approx") == 0) {
+                options->approximate_hotspots = 1;
+            } else {
+                fprintf(stderr, "Error: Unknown hotspot method '%s' (expected exact or approx)\n", method);
+                return EXIT_ERROR_CODE;
+            }
+        } else if (strcmp(argv[i], "--memory-budget") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --memory-budget requires a size\n");
+                return EXIT_ERROR_CODE;
+            }
+
+            i++; /* Move to size argument */
+            if (parse_byte_size(argv[i], &options->memory_budget) != 0 ||
+                options->memory_budget < MIN_MEMORY_BUDGET) {
+                fprintf(stderr, "Error: Invalid memory budget '%s' (expected a size such as 64M, "
+                                "at least %zuK)\n", argv[i], MIN_MEMORY_BUDGET / 1024);
+                return EXIT_ERROR_CODE;
+            }
+            budget_given = 1;
         } else if (strcmp(argv[i], "--activity") == 0) {
             *mode = ANALYSIS_ACTIVITY;
+        } else if (strcmp(argv[i], "--fast") == 0) {
+            options->fast_summary = 1;
+        } else if (strcmp(argv[i], "--hll-precision") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --hll-precision requires a bit count\n");
+                return EXIT_ERROR_CODE;
+            }
+
+            i++; /* Move to precision argument */
+            char *end;
+            long precision = strtol(argv[i], &end, 10);
+            if (end == argv[i] || *end != '\0' ||
+                precision < HYPERLOGLOG_MIN_PRECISION || precision > HYPERLOGLOG_MAX_PRECISION) {
+                fprintf(stderr, "Error: Invalid precision '%s' (expected %d-%d)\n", argv[i],
+                        HYPERLOGLOG_MIN_PRECISION, HYPERLOGLOG_MAX_PRECISION);
+                return EXIT_ERROR_CODE;
+            }
+            options->hll_precision = (int)precision;
+            precision_given = 1;
+        } else if (strcmp(argv[i], "--estimate-lines") == 0) {
+            options->estimate_lines = 1;
+        } else if (strcmp(argv[i], "--sample-size") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --sample-size requires a file count\n");
+                return EXIT_ERROR_CODE;
+            }
+
+            i++; /* Move to sample size argument */
+            char *end;
+            long sample_size = strtol(argv[i], &end, 10);
+            if (end == argv[i] || *end != '\0' ||
+                sample_size < MIN_LINE_SAMPLE_SIZE || sample_size > MAX_LINE_SAMPLE_SIZE) {
+                fprintf(stderr, "Error: Invalid sample size '%s' (expected %d-%d)\n", argv[i],
+                        MIN_LINE_SAMPLE_SIZE, MAX_LINE_SAMPLE_SIZE);
+                return EXIT_ERROR_CODE;
+            }
+            options->sample_size = (int)sample_size;
+            sample_size_given = 1;
         } else {
             /* Unknown argument */
             fprintf(stderr, "Error: Unknown argument '%s'\n", argv[i]);
@@ -56,6 +250,80 @@ static int parse_arguments(int argc, const char *const argv[], OutputFormat *for
         }
     }
 
+    if (options->since > 0 && options->until > 0 && options->since > options->until) {
+        fprintf(stderr, "Error: --since is later than --until\n");
+        return EXIT_ERROR_CODE;
+    }
+
+    if (budget_given && !(options->approximate_hotspots && *mode == ANALYSIS_HOTSPOTS)) {
+        fprintf(stderr, "Error: --memory-budget requires --hotspots=approx\n");
+        return EXIT_ERROR_CODE;
+    }
+    if (options->approximate_hotspots && *mode != ANALYSIS_HOTSPOTS) {
+        options->approximate_hotspots = 0; /* A later --activity replaced the hotspot analysis */
+    }
+
+    if (precision_given && !options->fast_summary) {
+        fprintf(stderr, "Error: --hll-precision requires --fast\n");
+        return EXIT_ERROR_CODE;
+    }
+
+    /* The fast summary is its own report: exact sections would need the walks it avoids */
+    if (options->fast_summary &&
+        (*mode != ANALYSIS_BASIC || options->rev != NULL || options->commit_records ||
+         *socket_path != NULL || batch->source != NULL)) {
+        fprintf(stderr, "Error: --fast cannot be combined with --hotspots, --activity, --rev, "
+                        "--commits, --serve or --repos\n");
+        return EXIT_ERROR_CODE;
+    }
+
+    if (sample_size_given && !options->estimate_lines) {
+        fprintf(stderr, "Error: --sample-size requires --estimate-lines\n");
+        return EXIT_ERROR_CODE;
+    }
+
+    /* The fast summary counts no lines, and the server keeps its file table exact */
+    if (options->estimate_lines && (options->fast_summary || *socket_path != NULL)) {
+        fprintf(stderr, "Error: --estimate-lines cannot be combined with --fast or --serve\n");
+        return EXIT_ERROR_CODE;
+    }
+
+    /* The server keeps all of history, exactly, and answers in JSON */
+    if (*socket_path != NULL &&
+        (output_given || options->since > 0 || options->until > 0 || options->commit_records ||
+         options->profile || options->approximate_hotspots)) {
+        fprintf(stderr, "Error: --serve cannot be combined with --output, --since, --until, "
+                        "--commits, --profile or --hotspots=approx\n");
+        return EXIT_ERROR_CODE;
+    }
+
+    if (batch_option_given && batch->source == NULL) {
+        fprintf(stderr, "Error: --repo-jobs and --timeout require --repos\n");
+        return EXIT_ERROR_CODE;
+    }
+
+    /* A fleet run writes one combined document */
+    if (batch->source != NULL) {
+        if (*socket_path != NULL || options->commit_records) {
+            fprintf(stderr, "Error: --repos cannot be combined with --serve or --commits\n");
+            return EXIT_ERROR_CODE;
+        }
+        if (*format == OUTPUT_DEFAULT) {
+            fprintf(stderr, "Error: --repos requires --output json or --output ndjson\n");
+            return EXIT_ERROR_CODE;
+        }
+    }
+
+    /* NDJSON streams every row unless --limit says otherwise */
+    if (*format == OUTPUT_NDJSON && options->limit == LIMIT_DEFAULT) {
+        options->limit = LIMIT_ALL;
+    }
+
+    if (options->commit_records && *format != OUTPUT_NDJSON) {
+        fprintf(stderr, "Error: --commits requires --output ndjson\n");
+        return EXIT_ERROR_CODE;
+    }
+
     return 0;
 }
 
@@ -65,9 +333,18 @@ static int parse_arguments(int argc, const char *const argv[], OutputFormat *for
 int main(int argc, char *argv[]) {
     OutputFormat output_format = OUTPUT_DEFAULT;
     AnalysisMode analysis_mode = ANALYSIS_BASIC;
+    CollectOptions options;
+    const char *socket_path;
+    BatchOptions batch;
+
+#ifndef _WIN32
+    /* A git child exiting early must surface as EPIPE, not kill us */
+    signal(SIGPIPE, SIG_IGN);
+#endif
 
     /* Parse command line arguments */
-    int parse_result = parse_arguments(argc, (const char *const *)argv, &output_format, &analysis_mode);
+    int parse_result = parse_arguments(argc, (const char *const *)argv, &output_format, &analysis_mode,
+                                       &options, &socket_path, &batch);
     if (parse_result == EXIT_HELP_SHOWN || parse_result == EXIT_VERSION_SHOWN) {
         return EXIT_SUCCESS_CODE;
     }
@@ -75,6 +352,23 @@ int main(int argc, char *argv[]) {
         return parse_result;
     }
 
+    if (options.profile) {
+        profile_enable();
+    }
+
+    if (batch.source != NULL) {
+        return analyze_repositories(&batch, output_format, analysis_mode, &options);
+    }
+
+    if (socket_path != NULL) {
+        if (!is_git_repository()) {
+            fprintf(stderr, "Error: Not a git repository (or any of the parent directories)\n");
+            fprintf(stderr, "Run this command from within a git repository.\n");
+            return EXIT_NOT_GIT_REPO;
+        }
+        return serve_stats(socket_path, &options);
+    }
+
     /* Print header for default output only */
     if (output_format == OUTPUT_DEFAULT) {
         printf("%s v%s\n", PROGRAM_NAME, VERSION_STRING);
@@ -91,24 +385,46 @@ int main(int argc, char *argv[]) {
     /* Initialize and gather basic statistics */
     GitStats stats;
     init_git_stats(&stats);
+    stats.options = options;
 
-    if (get_basic_git_stats(&stats) != 0) {
-        fprintf(stderr, "Error: Failed to gather basic git statistics\n");
+    /* NDJSON records are written while the collectors run */
+    NdjsonOutput ndjson;
+    if (output_format == OUTPUT_NDJSON && ndjson_output_begin(&ndjson, &stats) != 0) {
+        fprintf(stderr, "Error: Failed to allocate the output buffer\n");
         return EXIT_ERROR_CODE;
     }
 
+    /* --fast replaces the basic collectors with its single bounded pass */
+    ProfilePhase *phase = profile_begin(options.fast_summary ? "fast" : "basic");
+    int collected = options.fast_summary ? get_fast_summary(&stats) : get_basic_git_stats(&stats);
+    if (collected != 0) {
+        fprintf(stderr, "Error: Failed to gather %s git statistics\n",
+                options.fast_summary ? "fast summary" : "basic");
+        free_git_stats(&stats);
+        return EXIT_ERROR_CODE;
+    }
+    profile_end(phase);
+
     /* Gather additional analysis data based on mode */
     switch (analysis_mode) {
         case ANALYSIS_HOTSPOTS:
+            phase = profile_begin("hotspots");
             if (get_hotspot_stats(&stats) != 0) {
                 fprintf(stderr, "Warning: Failed to get hotspot statistics\n");
+            } else {
+                notify_stats_section(&stats, STATS_SECTION_HOTSPOTS);
             }
+            profile_end(phase);
             break;
 
         case ANALYSIS_ACTIVITY:
+            phase = profile_begin("activity");
             if (get_activity_stats(&stats) != 0) {
                 fprintf(stderr, "Warning: Failed to get activity statistics\n");
+            } else {
+                notify_stats_section(&stats, STATS_SECTION_ACTIVITY);
             }
+            profile_end(phase);
             break;
 
         case ANALYSIS_BASIC:
@@ -119,10 +435,27 @@ int main(int argc, char *argv[]) {
 
     /* Output results in requested format */
     if (output_format == OUTPUT_JSON) {
-        print_stats_json(&stats, analysis_mode);
+        if (print_stats_json(&stats, analysis_mode) != 0) {
+            fprintf(stderr, "Error: Failed to write JSON output\n");
+            free_git_stats(&stats);
+            return EXIT_ERROR_CODE;
+        }
+    } else if (output_format == OUTPUT_NDJSON) {
+        if (ndjson_output_end(&ndjson, &stats) != 0) {
+            fprintf(stderr, "Error: Failed to write NDJSON output\n");
+            free_git_stats(&stats);
+            return EXIT_ERROR_CODE;
+        }
     } else {
+        /* Only the human report can include its own output phase */
+        phase = profile_begin("output");
         print_stats_human(&stats, analysis_mode);
+        profile_end(phase);
+        if (options.profile) {
+            print_profile_human();
+        }
     }
 
+    free_git_stats(&stats);
     return EXIT_SUCCESS_CODE;
 }
\ No newline at end of file
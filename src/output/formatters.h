@@ -2,6 +2,8 @@
 #define FORMATTERS_H
 
 #include "../git_stats.h"
+#include "json_writer.h"
+#include "../utils/profile.h"
 
 /**
  * Print comprehensive statistics in human-readable format
@@ -14,9 +16,85 @@ void print_stats_human(const GitStats *stats, AnalysisMode mode);
  * Print statistics in JSON format
  * @param stats GitStats structure containing all statistics
  * @param mode Analysis mode to determine what sections to include
+ * @return 0 on success, -1 if the output could not be written
  */
-void print_stats_json(const GitStats *stats, AnalysisMode mode);
+int print_stats_json(const GitStats *stats, AnalysisMode mode);
 
+/**
+ * Write the document print_stats_json() prints as the next value
+ * @param json Active writer
+ * @param stats GitStats structure containing all statistics
+ * @param mode Analysis mode to determine what sections to include
+ */
+void write_stats_json(JsonWriter *json, const GitStats *stats, AnalysisMode mode);
+
+/**
+ * Write the --since/--until bounds that are set into an open JSON object,
+ * as epoch seconds
+ * @param json Writer inside an object
+ * @param options Options holding the date window
+ */
+void write_history_window_json(JsonWriter *json, const CollectOptions *options);
+
+/**
+ * Write how approximate hotspots may differ from exact ones into an open
+ * JSON object (--hotspots=approx)
+ * @param json Writer inside an object
+ * @param accuracy Sketch bounds of the collection
+ */
+void write_hotspot_accuracy_json(JsonWriter *json, const HotspotAccuracy *accuracy);
+
+/**
+ * Write how an --estimate-lines file table was extrapolated into an open
+ * JSON object
+ * @param json Writer inside an object
+ * @param estimate Sampling summary of the collection
+ */
+void write_line_estimate_json(JsonWriter *json, const LineEstimate *estimate);
+
+/**
+ * Write the distinct counts of the --fast summary into an open JSON object
+ * @param json Writer inside an object
+ * @param estimates Sketch estimates of the collection
+ */
+void write_distinct_estimates_json(JsonWriter *json, const DistinctEstimates *estimates);
+
+/**
+ * Write the members of one --profile sample into an open JSON object
+ * @param json Writer inside an object
+ * @param sample Phase or run costs
+ */
+void write_profile_sample_json(JsonWriter *json, const ProfileSample *sample);
+
+/**
+ * Print the --profile phase table to stderr
+ */
+void print_profile_human(void);
+
+/**
+ * Streaming NDJSON output: one JSON record per line, written as soon as
+ * each section of the statistics is final
+ */
+typedef struct {
+    JsonWriter json;
+    StatsListener listener;
+} NdjsonOutput;
+
+/**
+ * Start NDJSON output and attach it to the statistics as their listener
+ * @param output Output state; must outlive the collection
+ * @param stats Statistics to stream
+ * @return 0 on success, -1 on allocation failure
+ */
+int ndjson_output_begin(NdjsonOutput *output, GitStats *stats);
+
+/**
+ * Write the closing summary record and flush the stream
+ * @param output Started output
+ * @param stats Collected statistics
+ * @return 0 on success, -1 if the output could not be written
+ */
+int ndjson_output_end(NdjsonOutput *output, const GitStats *stats);
 
 
 /**
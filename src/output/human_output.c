@@ -1,14 +1,22 @@
+#define _GNU_SOURCE
 #include "formatters.h"
 #include "../git_stats.h"
+#include "../batch.h"
+#include "../utils/hyperloglog.h"
 #include "../version.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 /* Forward declarations */
 static void print_hotspots_human(const GitStats *stats);
 static void print_activity_human(const GitStats *stats);
+static void print_profile_row(const ProfileSample *sample, int depth);
+static int profile_depth(const ProfileSample *samples, int count, int index);
+static void print_window_bound(const char *label, long long bound);
+static void print_fast_summary_human(const GitStats *stats);
 
 /**
  * Print comprehensive statistics in human-readable format
@@ -21,20 +29,36 @@ void print_stats_human(const GitStats *stats, AnalysisMode mode) {
 
     printf("General Information:\n");
     printf("  Current Branch: %s\n", stats->current_branch);
+    if (stats->options.since > 0 || stats->options.until > 0) {
+        printf("  History Window:");
+        print_window_bound("since", stats->options.since);
+        print_window_bound("until", stats->options.until);
+        printf("\n");
+    }
+    if (stats->estimates.enabled) {
+        printf("  Total Commits: %d\n\n", stats->total_commits);
+        print_fast_summary_human(stats);
+        return;
+    }
     printf("  Total Commits: %d\n", stats->total_commits);
     printf("  Total Authors: %d\n", stats->total_authors);
     printf("  Total Branches: %d\n", stats->total_branches);
     printf("  Total Files: %d\n", stats->total_files);
-    printf("  Total Lines of Code: %ld\n\n", stats->total_lines);
+    if (stats->line_estimate.enabled) {
+        printf("  Total Lines of Code: ~%ld (+/- %ld, estimated)\n\n", stats->total_lines,
+               stats->line_estimate.lines_margin);
+    } else {
+        printf("  Total Lines of Code: %ld\n\n", stats->total_lines);
+    }
 
     /* Print top contributors */
     printf("Top Contributors:\n");
-    int authors_to_show = (stats->total_authors < MAX_AUTHORS_DISPLAY) ?
-                         stats->total_authors : MAX_AUTHORS_DISPLAY;
+    int authors_to_show = display_row_count(&stats->options, stats->total_authors,
+                                            MAX_AUTHORS_DISPLAY);
 
     for (int i = 0; i < authors_to_show; i++) {
         printf("  %2d. %-30s %4d commits", i + 1,
-               stats->authors[i].name, stats->authors[i].commit_count);
+               git_stats_author_name(stats, &stats->authors[i]), stats->authors[i].commit_count);
         if (stats->authors[i].lines_added > 0 || stats->authors[i].lines_deleted > 0) {
             printf(" (+%d/-%d lines)", stats->authors[i].lines_added,
                    stats->authors[i].lines_deleted);
@@ -45,45 +69,52 @@ void print_stats_human(const GitStats *stats, AnalysisMode mode) {
 
     /* Print branches */
     printf("Branches:\n");
-    int branches_to_show = (stats->total_branches < MAX_BRANCHES_DISPLAY) ?
-                          stats->total_branches : MAX_BRANCHES_DISPLAY;
+    int branches_to_show = display_row_count(&stats->options, stats->total_branches,
+                                             MAX_BRANCHES_DISPLAY);
 
     for (int i = 0; i < branches_to_show; i++) {
         printf("  %-20s %4d commits\n", stats->branches[i].name,
                stats->branches[i].commit_count);
     }
-    if (stats->total_branches > MAX_BRANCHES_DISPLAY) {
+    if (stats->total_branches > branches_to_show) {
         printf("  ... and %d more branches\n",
-               stats->total_branches - MAX_BRANCHES_DISPLAY);
+               stats->total_branches - branches_to_show);
     }
     printf("\n");
 
     /* Print file types */
     printf("File Types:\n");
     if (stats->file_type_count > 0) {
-        /* Create a copy for sorting */
-        FileType temp_types[MAX_FILE_TYPES];
-        memcpy(temp_types, stats->file_types,
-               sizeof(FileType) * stats->file_type_count); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-
-        /* Sort by count */
-        qsort(temp_types, stats->file_type_count, sizeof(FileType),
-              compare_file_types_by_count);
+        /* File types are already sorted by count */
+        const FileType *types = stats->file_types;
 
-        int types_to_show = (stats->file_type_count < MAX_FILE_TYPES_DISPLAY) ?
-                           stats->file_type_count : MAX_FILE_TYPES_DISPLAY;
+        int types_to_show = display_row_count(&stats->options, stats->file_type_count,
+                                              MAX_FILE_TYPES_DISPLAY);
 
         for (int i = 0; i < types_to_show; i++) {
             double percentage = (stats->total_lines > 0) ?
-                               (double)temp_types[i].total_lines * 100.0 / stats->total_lines : 0.0;
-            printf("  %-10s %4d files, %8ld lines (%5.1f%%)\n",
-                   temp_types[i].extension, temp_types[i].count,
-                   temp_types[i].total_lines, percentage);
+                               (double)types[i].total_lines * 100.0 / stats->total_lines : 0.0;
+            printf("  %-10s %4d files, %8ld lines (%5.1f%%)",
+                   types[i].extension, types[i].count,
+                   types[i].total_lines, percentage);
+            if (stats->line_estimate.enabled && types[i].sampled < types[i].count) {
+                printf(" +/- %ld from %d sampled", types[i].lines_margin, types[i].sampled);
+            }
+            printf("\n");
         }
 
-        if (stats->file_type_count > MAX_FILE_TYPES_DISPLAY) {
+        if (stats->file_type_count > types_to_show) {
             printf("  ... and %d more file types\n",
-                   stats->file_type_count - MAX_FILE_TYPES_DISPLAY);
+                   stats->file_type_count - types_to_show);
+        }
+
+        const LineEstimate *estimate = &stats->line_estimate;
+        if (estimate->enabled) {
+            printf("\n");
+            printf("  Estimated: %d of %d files counted (at most %d per type), the rest\n",
+                   estimate->sampled_files, stats->total_files, estimate->sample_size);
+            printf("  extrapolated from %.1f MiB by lines per byte; +/- is a 95%% interval\n",
+                   (double)estimate->total_bytes / (1024.0 * 1024.0));
         }
     }
     printf("\n");
@@ -96,6 +127,37 @@ void print_stats_human(const GitStats *stats, AnalysisMode mode) {
     }
 }
 
+/**
+ * Print the distinct counts estimated by --fast
+ * The range shown is two standard errors either side: about 95% of
+ * estimates fall within it.
+ */
+static void print_fast_summary_human(const GitStats *stats) {
+    assert(stats != NULL);
+
+    const DistinctEstimates *estimates = &stats->estimates;
+    const struct {
+        const char *label;
+        double value;
+    } rows[] = {
+        {"Authors", estimates->authors},
+        {"Files Touched", estimates->files},
+        {"Extensions", estimates->extensions},
+    };
+
+    printf("Fast Summary (estimated):\n");
+    for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+        printf("  %-14s ~%-10.0f (%.0f - %.0f)\n", rows[i].label, rows[i].value,
+               rows[i].value * (1.0 - 2.0 * estimates->standard_error),
+               rows[i].value * (1.0 + 2.0 * estimates->standard_error));
+    }
+    printf("\n");
+    printf("  HyperLogLog, precision %d: %zu bytes, standard error %.2f%%\n",
+           estimates->precision, estimates->memory, estimates->standard_error * 100.0);
+    printf("  Ranges cover two standard errors; commits are counted exactly\n");
+    printf("\n");
+}
+
 /**
  * Print hotspot analysis in human-readable format
  */
@@ -109,25 +171,48 @@ static void print_hotspots_human(const GitStats *stats) {
         return;
     }
 
-    int hotspots_to_show = (stats->hotspot_count < 15) ? stats->hotspot_count : 15;
+    int hotspots_to_show = display_row_count(&stats->options, stats->hotspot_count,
+                                             MAX_HOTSPOTS_DISPLAY);
 
+    const HotspotAccuracy *accuracy = &stats->hotspot_accuracy;
     for (int i = 0; i < hotspots_to_show; i++) {
-        printf("  %2d. %-40s %3d commits, +%d/-%d lines (score: %.1f)\n",
+        printf("  %2d. %-40s %3d commits, +%d/-%d lines (score: %.1f)",
                i + 1,
-               stats->hotspots[i].filename,
+               git_stats_hotspot_path(stats, &stats->hotspots[i]),
                stats->hotspots[i].commit_count,
                stats->hotspots[i].lines_added,
                stats->hotspots[i].lines_deleted,
                stats->hotspots[i].hotspot_score);
+        if (accuracy->approximate && stats->hotspots[i].commit_error > 0) {
+            printf(" [commits -%d at most]", stats->hotspots[i].commit_error);
+        }
+        printf("\n");
     }
 
-    if (stats->hotspot_count > 15) {
-        printf("  ... and %d more files\n", stats->hotspot_count - 15);
+    if (stats->hotspot_count > hotspots_to_show) {
+        printf("  ... and %d more files\n", stats->hotspot_count - hotspots_to_show);
     }
 
     printf("\n");
     printf("  Hotspot Score = commits * sqrt(lines_added + lines_deleted + 1)\n");
     printf("  High scores indicate files that change frequently with significant modifications\n");
+    if (accuracy->approximate) {
+        printf("  Approximate: %d paths monitored in %.1f MiB, %lld changes counted, %lld paths evicted\n",
+               accuracy->counters, (double)accuracy->memory_budget / (1024.0 * 1024.0),
+               accuracy->changes, accuracy->evictions);
+        if (accuracy->evictions > 0 || accuracy->oversized_changes > 0) {
+            printf("  Commits may be high by the amount shown. Lines only count from when a path was\n");
+            printf("  last admitted, so rows with a commit error have too few lines and an inexact\n");
+            printf("  score. Paths not monitored changed in at most %d commits\n",
+                   accuracy->max_unmonitored_commits);
+            if (accuracy->oversized_changes > 0) {
+                printf("  %lld changes to paths too long for the budget were not counted\n",
+                       accuracy->oversized_changes);
+            }
+        } else {
+            printf("  Every path fit in the budget, so the counts are exact\n");
+        }
+    }
     printf("\n");
 }
 
@@ -148,9 +233,9 @@ static void print_activity_human(const GitStats *stats) {
     int active_count = 0;
     int single_commit_count = 0;
 
-    for (int i = 0; i < stats->activity_count; i++) {
-        if (stats->activities[i].is_active) active_count++;
-        if (stats->activities[i].commit_count == 1) single_commit_count++;
+    GIT_STATS_FOR_EACH(const AuthorActivity, activity, stats->activities, stats->activity_count) {
+        if (activity->is_active) active_count++;
+        if (activity->commit_count == 1) single_commit_count++;
     }
 
     printf("  Summary: %d total contributors, %d active (< 90 days), %d single-commit\n\n",
@@ -158,13 +243,14 @@ static void print_activity_human(const GitStats *stats) {
 
     /* Show top contributors by activity score */
     printf("  Top Contributors by Activity:\n");
-    int contributors_to_show = (stats->activity_count < 10) ? stats->activity_count : 10;
+    int contributors_to_show = display_row_count(&stats->options, stats->activity_count,
+                                                 MAX_AUTHORS_DISPLAY);
 
     for (int i = 0; i < contributors_to_show; i++) {
         const char* status = stats->activities[i].is_active ? "ACTIVE" : "INACTIVE";
         printf("  %2d. %-25s %3d commits, last: %s (%d days ago) [%s]\n",
                i + 1,
-               stats->activities[i].name,
+               git_stats_activity_name(stats, &stats->activities[i]),
                stats->activities[i].commit_count,
                stats->activities[i].last_commit_date,
                stats->activities[i].days_since_last_commit,
@@ -174,7 +260,7 @@ static void print_activity_human(const GitStats *stats) {
     printf("\n  Activity Details:\n");
     for (int i = 0; i < contributors_to_show; i++) {
         printf("      %s: %s -> %s (%d commits, +%d/-%d lines, score: %.1f)\n",
-               stats->activities[i].name,
+               git_stats_activity_name(stats, &stats->activities[i]),
                stats->activities[i].first_commit_date,
                stats->activities[i].last_commit_date,
                stats->activities[i].commit_count,
@@ -188,6 +274,76 @@ static void print_activity_human(const GitStats *stats) {
     printf("\n");
 }
 
+/**
+ * Print the --profile phase table to stderr
+ * Nested phases are indented under the phase that encloses them; their
+ * costs are already included in it.
+ */
+void print_profile_human(void) {
+    ProfileSample samples[PROFILE_MAX_PHASES];
+    int count = profile_snapshot(samples, PROFILE_MAX_PHASES);
+
+    fprintf(stderr, "\nProfile:\n");
+    fprintf(stderr, "  %-16s %10s %10s %10s %6s %10s %10s %10s %10s\n", "Phase", "Wall ms", "CPU ms",
+            "Git CPU ms", "Procs", "Pipe KiB", "File KiB", "RSS KiB", "Git RSS");
+    for (int i = 0; i < count; i++) {
+        print_profile_row(&samples[i], profile_depth(samples, count, i));
+    }
+
+    ProfileSample total;
+    profile_total(&total);
+    print_profile_row(&total, 0);
+}
+
+/**
+ * Print one row of the profile table
+ */
+static void print_profile_row(const ProfileSample *sample, int depth) {
+    fprintf(stderr, "  %*s%-*s %10.1f %10.1f %10.1f %6lld %10lld %10lld %10ld %10ld\n",
+            depth * 2, "", 16 - depth * 2, sample->name, sample->wall_ms, sample->cpu_ms,
+            sample->child_cpu_ms, sample->subprocesses, sample->pipe_bytes / 1024,
+            sample->file_bytes / 1024, sample->peak_rss_kb, sample->child_peak_rss_kb);
+}
+
+/**
+ * Nesting depth of a phase, found through its parents' names
+ */
+static int profile_depth(const ProfileSample *samples, int count, int index) {
+    int depth = 0;
+    const char *parent = samples[index].parent;
+    while (parent != NULL && depth < count) {
+        const char *next = NULL;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(samples[i].name, parent) == 0) {
+                next = samples[i].parent;
+                break;
+            }
+        }
+        depth++;
+        parent = next;
+    }
+    return depth;
+}
+
+/**
+ * Print one --since/--until bound as a local date and time, if set
+ */
+static void print_window_bound(const char *label, long long bound) {
+    if (bound <= 0) {
+        return;
+    }
+
+    time_t seconds = (time_t)bound;
+    struct tm local;
+    char text[32];
+    if (localtime_r(&seconds, &local) == NULL ||
+        strftime(text, sizeof(text), "%Y-%m-%d %H:%M", &local) == 0) {
+        printf(" %s @%lld", label, bound);
+        return;
+    }
+    printf(" %s %s", label, text);
+}
+
 /**
  * Print help information
  */
@@ -200,9 +356,46 @@ void print_help(void) {
     printf("  -h, --help          Show this help message\n");
     printf("  -v, --version       Show version information\n");
     printf("  --output FORMAT     Output format (default: human-readable)\n");
-    printf("                      Supported formats: json\n");
-    printf("  --hotspots          Analyze and display file hotspots (high churn)\n");
-    printf("  --activity          Analyze author activity over time\n\n");
+    printf("                      Supported formats: json, ndjson (one record per line,\n");
+    printf("                      written as each section completes)\n");
+    printf("  --hotspots          Analyze and display file hotspots (high churn) in the\n");
+    printf("                      history of HEAD\n");
+    printf("  --hotspots=approx   Rank hotspots from a sketch of bounded size, with error\n");
+    printf("                      bounds (--hotspots is --hotspots=exact)\n");
+    printf("  --memory-budget SIZE  Memory for --hotspots=approx (default: 64M; K, M, G)\n");
+    printf("  --activity          Analyze author activity over time\n");
+    printf("  --fast              Count commits and estimate distinct authors, files touched\n");
+    printf("                      and extensions in one pass of constant memory\n");
+    printf("  --hll-precision P   Sketch precision for --fast, %d-%d (default: %d; each step\n",
+           HYPERLOGLOG_MIN_PRECISION, HYPERLOGLOG_MAX_PRECISION, HYPERLOGLOG_DEFAULT_PRECISION);
+    printf("                      doubles memory and cuts the error by a factor of 1.4)\n");
+    printf("  --estimate-lines    Count lines in a random sample of each file type and\n");
+    printf("                      extrapolate by file size, with 95%% intervals\n");
+    printf("  --sample-size N     Files counted per type by --estimate-lines (default: %d)\n",
+           DEFAULT_LINE_SAMPLE_SIZE);
+    printf("  -j, --jobs N        Threads for collectors and line counting\n");
+    printf("                      (default: one per CPU, 1 runs everything in sequence)\n");
+    printf("  --rev COMMIT        Count lines in COMMIT instead of the working tree\n");
+    printf("                      (bare repositories default to HEAD)\n");
+    printf("  --no-cache          Walk the full history instead of using .git/git-stat/cache\n");
+    printf("  --limit N|all       Rows to show per list, or all of them (default: 10-15;\n");
+    printf("                      ndjson: all)\n");
+    printf("  --since DATE        Only count history committed at or after DATE\n");
+    printf("  --until DATE        Only count history committed at or before DATE\n");
+    printf("                      (YYYY-MM-DD[ HH:MM[:SS]], 'N days ago' or @SECONDS;\n");
+    printf("                      units: seconds to years)\n");
+    printf("  --commits           With ndjson, also stream one record per commit\n");
+    printf("  --profile           Report time, CPU, subprocesses, bytes read and peak memory\n");
+    printf("                      per phase (stderr, or a \"profile\" object/record in JSON)\n");
+    printf("  --serve SOCKET      Keep statistics in memory, follow ref changes and answer\n");
+    printf("                      JSON queries on a Unix socket, one per line, e.g.\n");
+    printf("                      {\"query\":\"hotspots\",\"limit\":20} (also stats, activity, status)\n");
+    printf("  --repos DIR|FILE    Analyze every repository found under DIR (or listed in\n");
+    printf("                      FILE, one path per line, - for stdin) into one json or\n");
+    printf("                      ndjson document with a fleet rollup\n");
+    printf("  --repo-jobs N       Repositories analyzed at once (default: one per CPU)\n");
+    printf("  --timeout SECONDS   Abandon a repository after SECONDS (default: %d, 0: never)\n\n",
+           BATCH_DEFAULT_TIMEOUT);
     printf("Features:\n");
     printf("  - Repository overview (commits, authors, branches, files)\n");
     printf("  - Top contributors with commit counts and line changes\n");
@@ -218,6 +411,17 @@ void print_help(void) {
     printf("  git-stat --output json      # Output in JSON format\n");
     printf("  git-stat --hotspots --output json  # Hotspots in JSON format\n");
     printf("  git-stat --activity --output json  # Activity analysis in JSON format\n");
+    printf("  git-stat --jobs 4           # Count lines with 4 threads\n");
+    printf("  git-stat --rev v1.0         # Count lines as of tag v1.0\n");
+    printf("  git-stat --hotspots --output json --limit all  # Export every hotspot\n");
+    printf("  git-stat --hotspots=approx --memory-budget 16M  # Hotspots of a huge history\n");
+    printf("  git-stat --fast             # Quick summary of a very large history\n");
+    printf("  git-stat --estimate-lines   # File types of a huge checkout in seconds\n");
+    printf("  git-stat --output ndjson --commits  # Stream records for a pipeline\n");
+    printf("  git-stat --activity --since \"90 days ago\"  # Activity in the last quarter\n");
+    printf("  git-stat --profile          # Show which phase a slow run spends its time in\n");
+    printf("  git-stat --serve /tmp/stats.sock  # Answer repeated queries from memory\n");
+    printf("  git-stat --repos ~/src --output ndjson  # Every repository under ~/src\n");
     printf("  git-stat --help             # Show this help\n");
     printf("  git-stat --version          # Show version info\n\n");
     printf("Exit Codes:\n");
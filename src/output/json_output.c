@@ -1,144 +1,396 @@
 #include "formatters.h"
+#include "json_writer.h"
 #include "../git_stats.h"
 #include <string.h>
 #include <assert.h>
 
 /* Forward declarations */
-static void print_hotspots_json(const GitStats *stats);
-static void print_activity_json(const GitStats *stats);
+static void write_hotspots_json(JsonWriter *json, const GitStats *stats);
+static void write_activity_json(JsonWriter *json, const GitStats *stats);
+static void write_profile_json(JsonWriter *json);
+static void write_fast_summary_json(JsonWriter *json, const GitStats *stats);
 
 /**
  * Print statistics in JSON format
  */
-void print_stats_json(const GitStats *stats, AnalysisMode mode) {
+int print_stats_json(const GitStats *stats, AnalysisMode mode) {
     assert(stats != NULL);
 
-    printf("{\n");
-    printf("  \"repository\": {\n");
-    printf("    \"name\": \"%s\",\n", stats->repo_name);
-    printf("    \"current_branch\": \"%s\"\n", stats->current_branch);
-    printf("  },\n");
+    JsonWriter json;
+    if (json_writer_init(&json, stdout, 0) != 0) {
+        return -1;
+    }
+
+    write_stats_json(&json, stats, mode);
+    return json_writer_finish(&json);
+}
+
+/**
+ * Write the statistics document as the next JSON value
+ */
+void write_stats_json(JsonWriter *json, const GitStats *stats, AnalysisMode mode) {
+    assert(json != NULL && stats != NULL);
+
+    json_writer_begin_object(json);
+
+    json_writer_key(json, "repository");
+    json_writer_begin_object(json);
+    json_writer_key(json, "name");
+    json_writer_string(json, stats->repo_name);
+    json_writer_key(json, "current_branch");
+    json_writer_string(json, stats->current_branch);
+    json_writer_end_object(json);
 
-    printf("  \"summary\": {\n");
-    printf("    \"total_commits\": %d,\n", stats->total_commits);
-    printf("    \"total_authors\": %d,\n", stats->total_authors);
-    printf("    \"total_branches\": %d,\n", stats->total_branches);
-    printf("    \"total_files\": %d,\n", stats->total_files);
-    printf("    \"total_lines\": %ld\n", stats->total_lines);
-    printf("  },\n");
+    /* A --fast document has only the exact commit count and the estimates */
+    if (stats->estimates.enabled) {
+        write_fast_summary_json(json, stats);
+        if (profile_enabled()) {
+            write_profile_json(json);
+        }
+        json_writer_end_object(json);
+        return;
+    }
+
+    json_writer_key(json, "summary");
+    json_writer_begin_object(json);
+    json_writer_key(json, "total_commits");
+    json_writer_int(json, stats->total_commits);
+    json_writer_key(json, "total_authors");
+    json_writer_int(json, stats->total_authors);
+    json_writer_key(json, "total_branches");
+    json_writer_int(json, stats->total_branches);
+    json_writer_key(json, "total_files");
+    json_writer_int(json, stats->total_files);
+    json_writer_key(json, "total_lines");
+    json_writer_int(json, stats->total_lines);
+    write_history_window_json(json, &stats->options);
+    json_writer_end_object(json);
 
     /* Authors array */
-    printf("  \"authors\": [\n");
-    int authors_to_show = (stats->total_authors < MAX_AUTHORS_DISPLAY) ?
-                         stats->total_authors : MAX_AUTHORS_DISPLAY;
+    json_writer_key(json, "authors");
+    json_writer_begin_array(json);
+    int authors_to_show = display_row_count(&stats->options, stats->total_authors,
+                                            MAX_AUTHORS_DISPLAY);
     for (int i = 0; i < authors_to_show; i++) {
-        printf("    {\n");
-        printf("      \"name\": \"%s\",\n", stats->authors[i].name);
-        printf("      \"commits\": %d,\n", stats->authors[i].commit_count);
-        printf("      \"lines_added\": %d,\n", stats->authors[i].lines_added);
-        printf("      \"lines_deleted\": %d\n", stats->authors[i].lines_deleted);
-        printf("    }%s\n", (i < authors_to_show - 1) ? "," : "");
+        json_writer_begin_object(json);
+        json_writer_key(json, "name");
+        json_writer_string(json, git_stats_author_name(stats, &stats->authors[i]));
+        json_writer_key(json, "commits");
+        json_writer_int(json, stats->authors[i].commit_count);
+        json_writer_key(json, "lines_added");
+        json_writer_int(json, stats->authors[i].lines_added);
+        json_writer_key(json, "lines_deleted");
+        json_writer_int(json, stats->authors[i].lines_deleted);
+        json_writer_end_object(json);
     }
-    printf("  ],\n");
+    json_writer_end_array(json);
 
     /* File types array */
-    printf("  \"file_types\": [\n");
-    if (stats->file_type_count > 0) {
-        FileType temp_types[MAX_FILE_TYPES];
-        memcpy(temp_types, stats->file_types, sizeof(FileType) * stats->file_type_count); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-        qsort(temp_types, stats->file_type_count, sizeof(FileType), compare_file_types_by_count);
-
-        int types_to_show = (stats->file_type_count < MAX_FILE_TYPES_DISPLAY) ?
-                           stats->file_type_count : MAX_FILE_TYPES_DISPLAY;
-
-        for (int i = 0; i < types_to_show; i++) {
-            double percentage = (stats->total_lines > 0) ?
-                               (double)temp_types[i].total_lines * 100.0 / stats->total_lines : 0.0;
-            printf("    {\n");
-            printf("      \"extension\": \"%s\",\n", temp_types[i].extension);
-            printf("      \"files\": %d,\n", temp_types[i].count);
-            printf("      \"lines\": %ld,\n", temp_types[i].total_lines);
-            printf("      \"percentage\": %.1f\n", percentage);
-            printf("    }%s\n", (i < types_to_show - 1) ? "," : "");
+    json_writer_key(json, "file_types");
+    json_writer_begin_array(json);
+    int types_to_show = display_row_count(&stats->options, stats->file_type_count,
+                                          MAX_FILE_TYPES_DISPLAY);
+    for (int i = 0; i < types_to_show; i++) {
+        const FileType *type = &stats->file_types[i];
+        double percentage = (stats->total_lines > 0) ?
+                           (double)type->total_lines * 100.0 / stats->total_lines : 0.0;
+        json_writer_begin_object(json);
+        json_writer_key(json, "extension");
+        json_writer_string(json, type->extension);
+        json_writer_key(json, "files");
+        json_writer_int(json, type->count);
+        json_writer_key(json, "lines");
+        json_writer_int(json, type->total_lines);
+        json_writer_key(json, "percentage");
+        json_writer_fixed(json, percentage, 1);
+        if (stats->line_estimate.enabled) {
+            json_writer_key(json, "lines_margin");
+            json_writer_int(json, type->lines_margin);
+            json_writer_key(json, "sampled_files");
+            json_writer_int(json, type->sampled);
         }
+        json_writer_end_object(json);
+    }
+    json_writer_end_array(json);
+
+    if (stats->line_estimate.enabled) {
+        json_writer_key(json, "line_estimate");
+        json_writer_begin_object(json);
+        write_line_estimate_json(json, &stats->line_estimate);
+        json_writer_end_object(json);
     }
-    printf("  ]");
 
     /* Add analysis-specific sections */
     if (mode == ANALYSIS_HOTSPOTS) {
-        printf(",\n");
-        print_hotspots_json(stats);
+        write_hotspots_json(json, stats);
     } else if (mode == ANALYSIS_ACTIVITY) {
-        printf(",\n");
-        print_activity_json(stats);
-    } else {
-        printf("\n");
+        write_activity_json(json, stats);
+    }
+
+    if (profile_enabled()) {
+        write_profile_json(json);
     }
 
-    printf("}\n");
+    json_writer_end_object(json);
 }
 
 /**
- * Print hotspots in JSON format
+ * Write hotspots in JSON format
  */
-static void print_hotspots_json(const GitStats *stats) {
+static void write_hotspots_json(JsonWriter *json, const GitStats *stats) {
     assert(stats != NULL);
 
-    printf("  \"hotspots\": [\n");
-    if (stats->hotspot_count > 0) {
-        int hotspots_to_show = (stats->hotspot_count < 15) ? stats->hotspot_count : 15;
-
-        for (int i = 0; i < hotspots_to_show; i++) {
-            printf("    {\n");
-            printf("      \"filename\": \"%s\",\n", stats->hotspots[i].filename);
-            printf("      \"commits\": %d,\n", stats->hotspots[i].commit_count);
-            printf("      \"lines_added\": %d,\n", stats->hotspots[i].lines_added);
-            printf("      \"lines_deleted\": %d,\n", stats->hotspots[i].lines_deleted);
-            printf("      \"hotspot_score\": %.1f\n", stats->hotspots[i].hotspot_score);
-            printf("    }%s\n", (i < hotspots_to_show - 1) ? "," : "");
+    json_writer_key(json, "hotspots");
+    json_writer_begin_array(json);
+    int hotspots_to_show = display_row_count(&stats->options, stats->hotspot_count,
+                                             MAX_HOTSPOTS_DISPLAY);
+    for (int i = 0; i < hotspots_to_show; i++) {
+        const FileHotspot *hotspot = &stats->hotspots[i];
+        json_writer_begin_object(json);
+        json_writer_key(json, "filename");
+        json_writer_string(json, git_stats_hotspot_path(stats, hotspot));
+        json_writer_key(json, "commits");
+        json_writer_int(json, hotspot->commit_count);
+        json_writer_key(json, "lines_added");
+        json_writer_int(json, hotspot->lines_added);
+        json_writer_key(json, "lines_deleted");
+        json_writer_int(json, hotspot->lines_deleted);
+        json_writer_key(json, "hotspot_score");
+        json_writer_fixed(json, hotspot->hotspot_score, 1);
+        if (stats->hotspot_accuracy.approximate) {
+            json_writer_key(json, "commits_error");
+            json_writer_int(json, hotspot->commit_error);
+            json_writer_key(json, "lines_exact");
+            json_writer_bool(json, hotspot->commit_error == 0);
         }
+        json_writer_end_object(json);
+    }
+    json_writer_end_array(json);
+
+    if (stats->hotspot_accuracy.approximate) {
+        json_writer_key(json, "hotspot_accuracy");
+        json_writer_begin_object(json);
+        write_hotspot_accuracy_json(json, &stats->hotspot_accuracy);
+        json_writer_end_object(json);
     }
-    printf("  ]");
 }
 
 /**
- * Print activity analysis in JSON format
+ * Write activity analysis in JSON format
  */
-static void print_activity_json(const GitStats *stats) {
+static void write_activity_json(JsonWriter *json, const GitStats *stats) {
     assert(stats != NULL);
 
     /* Calculate summary statistics */
     int active_count = 0;
     int single_commit_count = 0;
 
-    for (int i = 0; i < stats->activity_count; i++) {
-        if (stats->activities[i].is_active) active_count++;
-        if (stats->activities[i].commit_count == 1) single_commit_count++;
+    GIT_STATS_FOR_EACH(const AuthorActivity, activity, stats->activities, stats->activity_count) {
+        if (activity->is_active) active_count++;
+        if (activity->commit_count == 1) single_commit_count++;
     }
 
-    printf("  \"activity_summary\": {\n");
-    printf("    \"total_contributors\": %d,\n", stats->activity_count);
-    printf("    \"active_contributors\": %d,\n", active_count);
-    printf("    \"single_commit_contributors\": %d\n", single_commit_count);
-    printf("  },\n");
-
-    printf("  \"author_activity\": [\n");
-    if (stats->activity_count > 0) {
-        int contributors_to_show = (stats->activity_count < 15) ? stats->activity_count : 15;
-
-        for (int i = 0; i < contributors_to_show; i++) {
-            printf("    {\n");
-            printf("      \"name\": \"%s\",\n", stats->activities[i].name);
-            printf("      \"commits\": %d,\n", stats->activities[i].commit_count);
-            printf("      \"lines_added\": %d,\n", stats->activities[i].lines_added);
-            printf("      \"lines_deleted\": %d,\n", stats->activities[i].lines_deleted);
-            printf("      \"first_commit_date\": \"%s\",\n", stats->activities[i].first_commit_date);
-            printf("      \"last_commit_date\": \"%s\",\n", stats->activities[i].last_commit_date);
-            printf("      \"days_since_last_commit\": %d,\n", stats->activities[i].days_since_last_commit);
-            printf("      \"is_active\": %s,\n", stats->activities[i].is_active ? "true" : "false");
-            printf("      \"activity_score\": %.1f\n", stats->activities[i].activity_score);
-            printf("    }%s\n", (i < contributors_to_show - 1) ? "," : "");
-        }
+    json_writer_key(json, "activity_summary");
+    json_writer_begin_object(json);
+    json_writer_key(json, "total_contributors");
+    json_writer_int(json, stats->activity_count);
+    json_writer_key(json, "active_contributors");
+    json_writer_int(json, active_count);
+    json_writer_key(json, "single_commit_contributors");
+    json_writer_int(json, single_commit_count);
+    json_writer_end_object(json);
+
+    json_writer_key(json, "author_activity");
+    json_writer_begin_array(json);
+    int contributors_to_show = display_row_count(&stats->options, stats->activity_count,
+                                                 MAX_ACTIVITY_DISPLAY);
+    for (int i = 0; i < contributors_to_show; i++) {
+        const AuthorActivity *activity = &stats->activities[i];
+        json_writer_begin_object(json);
+        json_writer_key(json, "name");
+        json_writer_string(json, git_stats_activity_name(stats, activity));
+        json_writer_key(json, "commits");
+        json_writer_int(json, activity->commit_count);
+        json_writer_key(json, "lines_added");
+        json_writer_int(json, activity->lines_added);
+        json_writer_key(json, "lines_deleted");
+        json_writer_int(json, activity->lines_deleted);
+        json_writer_key(json, "first_commit_date");
+        json_writer_string(json, activity->first_commit_date);
+        json_writer_key(json, "last_commit_date");
+        json_writer_string(json, activity->last_commit_date);
+        json_writer_key(json, "days_since_last_commit");
+        json_writer_int(json, activity->days_since_last_commit);
+        json_writer_key(json, "is_active");
+        json_writer_bool(json, activity->is_active);
+        json_writer_key(json, "activity_score");
+        json_writer_fixed(json, activity->activity_score, 1);
+        json_writer_end_object(json);
+    }
+    json_writer_end_array(json);
+}
+
+/**
+ * Write the summary and estimates of the --fast pass
+ */
+static void write_fast_summary_json(JsonWriter *json, const GitStats *stats) {
+    assert(stats != NULL);
+
+    json_writer_key(json, "summary");
+    json_writer_begin_object(json);
+    json_writer_key(json, "total_commits");
+    json_writer_int(json, stats->total_commits);
+    write_history_window_json(json, &stats->options);
+    json_writer_end_object(json);
+
+    json_writer_key(json, "estimates");
+    json_writer_begin_object(json);
+    write_distinct_estimates_json(json, &stats->estimates);
+    json_writer_end_object(json);
+}
+
+/**
+ * Write the phases finished so far and the run totals
+ */
+static void write_profile_json(JsonWriter *json) {
+    ProfileSample samples[PROFILE_MAX_PHASES];
+    int count = profile_snapshot(samples, PROFILE_MAX_PHASES);
+
+    json_writer_key(json, "profile");
+    json_writer_begin_object(json);
+    json_writer_key(json, "phases");
+    json_writer_begin_array(json);
+    for (int i = 0; i < count; i++) {
+        json_writer_begin_object(json);
+        write_profile_sample_json(json, &samples[i]);
+        json_writer_end_object(json);
+    }
+    json_writer_end_array(json);
+
+    ProfileSample total;
+    profile_total(&total);
+    json_writer_key(json, "total");
+    json_writer_begin_object(json);
+    write_profile_sample_json(json, &total);
+    json_writer_end_object(json);
+    json_writer_end_object(json);
+}
+
+/**
+ * Write the --since/--until bounds that are set
+ */
+void write_history_window_json(JsonWriter *json, const CollectOptions *options) {
+    assert(json != NULL);
+    assert(options != NULL);
+
+    if (options->since > 0) {
+        json_writer_key(json, "since");
+        json_writer_int(json, options->since);
+    }
+    if (options->until > 0) {
+        json_writer_key(json, "until");
+        json_writer_int(json, options->until);
+    }
+}
+
+/**
+ * Write how approximate hotspots may differ from exact ones
+ */
+void write_hotspot_accuracy_json(JsonWriter *json, const HotspotAccuracy *accuracy) {
+    assert(json != NULL);
+    assert(accuracy != NULL);
+
+    json_writer_key(json, "method");
+    json_writer_string(json, "space-saving");
+    json_writer_key(json, "memory_budget");
+    json_writer_int(json, (long long)accuracy->memory_budget);
+    json_writer_key(json, "counters");
+    json_writer_int(json, accuracy->counters);
+    json_writer_key(json, "changes");
+    json_writer_int(json, accuracy->changes);
+    json_writer_key(json, "evictions");
+    json_writer_int(json, accuracy->evictions);
+    json_writer_key(json, "oversized_changes");
+    json_writer_int(json, accuracy->oversized_changes);
+    json_writer_key(json, "max_unmonitored_commits");
+    json_writer_int(json, accuracy->max_unmonitored_commits);
+    json_writer_key(json, "lines");
+    json_writer_string(json, "lower_bound");
+}
+
+/**
+ * Write how the --estimate-lines file table was extrapolated
+ * Margins are half-widths of 95% confidence intervals, in lines.
+ */
+void write_line_estimate_json(JsonWriter *json, const LineEstimate *estimate) {
+    assert(json != NULL);
+    assert(estimate != NULL);
+
+    json_writer_key(json, "method");
+    json_writer_string(json, "stratified_ratio");
+    json_writer_key(json, "confidence");
+    json_writer_fixed(json, 0.95, 2);
+    json_writer_key(json, "sample_size");
+    json_writer_int(json, estimate->sample_size);
+    json_writer_key(json, "sampled_files");
+    json_writer_int(json, estimate->sampled_files);
+    json_writer_key(json, "total_bytes");
+    json_writer_int(json, estimate->total_bytes);
+    json_writer_key(json, "total_lines_margin");
+    json_writer_int(json, estimate->lines_margin);
+}
+
+/**
+ * Write the distinct counts of the --fast summary
+ * Counts are rounded to whole numbers; standard_error is relative.
+ */
+void write_distinct_estimates_json(JsonWriter *json, const DistinctEstimates *estimates) {
+    assert(json != NULL);
+    assert(estimates != NULL);
+
+    json_writer_key(json, "method");
+    json_writer_string(json, "hyperloglog");
+    json_writer_key(json, "precision");
+    json_writer_int(json, estimates->precision);
+    json_writer_key(json, "standard_error");
+    json_writer_fixed(json, estimates->standard_error, 4);
+    json_writer_key(json, "memory_bytes");
+    json_writer_int(json, (long long)estimates->memory);
+    json_writer_key(json, "authors");
+    json_writer_int(json, llround(estimates->authors));
+    json_writer_key(json, "files_touched");
+    json_writer_int(json, llround(estimates->files));
+    json_writer_key(json, "extensions");
+    json_writer_int(json, llround(estimates->extensions));
+}
+
+/**
+ * Write the members of one --profile sample
+ */
+void write_profile_sample_json(JsonWriter *json, const ProfileSample *sample) {
+    assert(json != NULL);
+    assert(sample != NULL);
+
+    json_writer_key(json, "name");
+    json_writer_string(json, sample->name);
+    if (sample->parent != NULL) {
+        json_writer_key(json, "parent");
+        json_writer_string(json, sample->parent);
     }
-    printf("  ]");
+    json_writer_key(json, "wall_ms");
+    json_writer_fixed(json, sample->wall_ms, 3);
+    json_writer_key(json, "cpu_ms");
+    json_writer_fixed(json, sample->cpu_ms, 3);
+    json_writer_key(json, "child_cpu_ms");
+    json_writer_fixed(json, sample->child_cpu_ms, 3);
+    json_writer_key(json, "subprocesses");
+    json_writer_int(json, sample->subprocesses);
+    json_writer_key(json, "pipe_bytes");
+    json_writer_int(json, sample->pipe_bytes);
+    json_writer_key(json, "file_bytes");
+    json_writer_int(json, sample->file_bytes);
+    json_writer_key(json, "peak_rss_kb");
+    json_writer_int(json, sample->peak_rss_kb);
+    json_writer_key(json, "child_peak_rss_kb");
+    json_writer_int(json, sample->child_peak_rss_kb);
 }
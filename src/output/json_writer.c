@@ -0,0 +1,414 @@
+#include "json_writer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+/* Longest fixed-point number written (sign, digits, point, decimals) */
+#define JSON_NUMBER_MAX 64
+
+/* Spaces per nesting level */
+#define JSON_INDENT 2
+
+/* Forward declarations */
+static void flush_buffer(JsonWriter *writer);
+static void append(JsonWriter *writer, const char *data, size_t length);
+static void begin_value(JsonWriter *writer);
+static void close_container(JsonWriter *writer, char bracket);
+static void write_line_break(JsonWriter *writer);
+static size_t utf8_sequence_length(const unsigned char *text, size_t remaining);
+static size_t scalar_length(const char *json, size_t remaining);
+
+/**
+ * Start writing a document
+ */
+int json_writer_init(JsonWriter *writer, FILE *out, int compact) {
+    assert(writer != NULL);
+    assert(out != NULL);
+
+    writer->out = out;
+    writer->used = 0;
+    writer->compact = compact;
+    writer->depth = 0;
+    writer->first = 1;
+    writer->after_key = 0;
+    writer->failed = 0;
+    writer->buffer = malloc(JSON_WRITER_BUFFER_SIZE);
+    return (writer->buffer != NULL) ? 0 : -1;
+}
+
+/**
+ * End the document, flush it and release the buffer
+ */
+int json_writer_finish(JsonWriter *writer) {
+    assert(writer != NULL);
+
+    if (!writer->compact) {
+        append(writer, "\n", 1);
+    }
+    json_writer_flush(writer);
+
+    free(writer->buffer);
+    writer->buffer = NULL;
+    return writer->failed ? -1 : 0;
+}
+
+/**
+ * Terminate a complete top-level value with a newline
+ */
+void json_writer_end_record(JsonWriter *writer) {
+    assert(writer != NULL);
+    assert(writer->depth == 0);
+
+    append(writer, "\n", 1);
+}
+
+/**
+ * Hand everything written so far to the output stream
+ */
+int json_writer_flush(JsonWriter *writer) {
+    assert(writer != NULL);
+
+    flush_buffer(writer);
+    if (!writer->failed && fflush(writer->out) != 0) {
+        writer->failed = 1;
+    }
+    return writer->failed ? -1 : 0;
+}
+
+/**
+ * Open an object as the next value
+ */
+void json_writer_begin_object(JsonWriter *writer) {
+    begin_value(writer);
+    append(writer, "{", 1);
+    writer->depth++;
+    writer->first = 1;
+}
+
+/**
+ * Close the innermost object
+ */
+void json_writer_end_object(JsonWriter *writer) {
+    close_container(writer, '}');
+}
+
+/**
+ * Open an array as the next value
+ */
+void json_writer_begin_array(JsonWriter *writer) {
+    begin_value(writer);
+    append(writer, "[", 1);
+    writer->depth++;
+    writer->first = 1;
+}
+
+/**
+ * Close the innermost array
+ */
+void json_writer_end_array(JsonWriter *writer) {
+    close_container(writer, ']');
+}
+
+/**
+ * Write an object member name; the next call writes its value
+ */
+void json_writer_key(JsonWriter *writer, const char *name) {
+    json_writer_string(writer, name);
+    append(writer, ": ", writer->compact ? 1 : 2);
+    writer->after_key = 1;
+}
+
+/**
+ * Write an escaped string value
+ * Runs of bytes that need no escaping are copied in one piece.
+ */
+void json_writer_string(JsonWriter *writer, const char *value) {
+    assert(value != NULL);
+
+    begin_value(writer);
+    append(writer, "\"", 1);
+
+    const unsigned char *text = (const unsigned char *)value;
+    size_t remaining = strlen(value);
+    size_t run = 0;
+
+    while (run < remaining) {
+        unsigned char c = text[run];
+        if (c >= 0x20 && c != '"' && c != '\\' && c < 0x80) {
+            run++;
+            continue;
+        }
+
+        size_t sequence = (c >= 0x80) ? utf8_sequence_length(text + run, remaining - run) : 0;
+        if (sequence > 0) {
+            run += sequence;
+            continue;
+        }
+
+        append(writer, (const char *)text, run);
+        switch (c) {
+            case '"': append(writer, "\\\"", 2); break;
+            case '\\': append(writer, "\\\\", 2); break;
+            case '\b': append(writer, "\\b", 2); break;
+            case '\f': append(writer, "\\f", 2); break;
+            case '\n': append(writer, "\\n", 2); break;
+            case '\r': append(writer, "\\r", 2); break;
+            case '\t': append(writer, "\\t", 2); break;
+            default:
+                if (c < 0x20) {
+                    static const char digits[] = "0123456789abcdef";
+                    char escape[6] = {'\\', 'u', '0', '0', digits[c >> 4], digits[c & 0x0f]};
+                    append(writer, escape, sizeof(escape));
+                } else {
+                    append(writer, "\\ufffd", 6); /* Not valid UTF-8 */
+                }
+                break;
+        }
+        text += run + 1;
+        remaining -= run + 1;
+        run = 0;
+    }
+
+    append(writer, (const char *)text, run);
+    append(writer, "\"", 1);
+}
+
+/**
+ * Write an integer value
+ */
+void json_writer_int(JsonWriter *writer, long long value) {
+    begin_value(writer);
+
+    /* Digits are produced backwards from the end of the scratch buffer */
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *start = end;
+    unsigned long long magnitude = (value < 0) ? 0ULL - (unsigned long long)value
+                                               : (unsigned long long)value;
+    do {
+        *--start = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        *--start = '-';
+    }
+
+    append(writer, start, (size_t)(end - start));
+}
+
+/**
+ * Write a number with a fixed count of decimals (null if not finite)
+ */
+void json_writer_fixed(JsonWriter *writer, double value, int decimals) {
+    begin_value(writer);
+
+    if (!isfinite(value)) {
+        append(writer, "null", 4);
+        return;
+    }
+
+    char number[JSON_NUMBER_MAX];
+    int length = snprintf(number, sizeof(number), "%.*f", decimals, value);
+    if (length < 0 || length >= (int)sizeof(number)) {
+        append(writer, "null", 4);
+        return;
+    }
+    append(writer, number, (size_t)length);
+}
+
+/**
+ * Write true or false
+ */
+void json_writer_bool(JsonWriter *writer, int value) {
+    begin_value(writer);
+    if (value) {
+        append(writer, "true", 4);
+    } else {
+        append(writer, "false", 5);
+    }
+}
+
+/**
+ * Write a value rendered elsewhere, laid out as if this writer had
+ * produced it
+ * The compact text is replayed token by token through the container and
+ * separator logic, so embedded output matches directly written output
+ * byte for byte. Strings and numbers are copied as they are.
+ */
+void json_writer_embed(JsonWriter *writer, const char *json, size_t length) {
+    assert(writer != NULL && json != NULL);
+
+    size_t i = 0;
+    while (i < length) {
+        switch (json[i]) {
+            case '{': json_writer_begin_object(writer); i++; continue;
+            case '[': json_writer_begin_array(writer); i++; continue;
+            case '}': json_writer_end_object(writer); i++; continue;
+            case ']': json_writer_end_array(writer); i++; continue;
+            case ',': i++; continue; /* Separators come from begin_value() */
+            default: break;
+        }
+
+        size_t token = scalar_length(json + i, length - i);
+        if (token == 0) {
+            writer->failed = 1; /* Not the compact JSON promised */
+            return;
+        }
+        begin_value(writer);
+        append(writer, json + i, token);
+        i += token;
+
+        /* A string followed by a colon was a member name */
+        if (i < length && json[i] == ':') {
+            append(writer, ": ", writer->compact ? 1 : 2);
+            writer->after_key = 1;
+            i++;
+        }
+    }
+}
+
+/**
+ * Measure the string, number or literal at the start of compact JSON
+ * @return Length in bytes, or 0 if none starts there
+ */
+static size_t scalar_length(const char *json, size_t remaining) {
+    size_t length = 0;
+
+    if (json[0] == '"') {
+        for (length = 1; length < remaining; length++) {
+            if (json[length] == '\\') {
+                length++;
+            } else if (json[length] == '"') {
+                return length + 1;
+            }
+        }
+        return 0; /* Unterminated */
+    }
+
+    while (length < remaining && strchr("{}[],:\"", json[length]) == NULL &&
+           json[length] != ' ' && json[length] != '\n') {
+        length++;
+    }
+    return length;
+}
+
+/**
+ * Hand the buffered bytes to the output stream
+ */
+static void flush_buffer(JsonWriter *writer) {
+    if (writer->used > 0 && !writer->failed &&
+        fwrite(writer->buffer, 1, writer->used, writer->out) != writer->used) {
+        writer->failed = 1;
+    }
+    writer->used = 0;
+}
+
+/**
+ * Copy bytes into the buffer, flushing whenever it fills
+ */
+static void append(JsonWriter *writer, const char *data, size_t length) {
+    if (writer->buffer == NULL) {
+        writer->failed = 1;
+        return;
+    }
+
+    while (length > 0) {
+        if (writer->used == JSON_WRITER_BUFFER_SIZE) {
+            flush_buffer(writer);
+        }
+        size_t space = JSON_WRITER_BUFFER_SIZE - writer->used;
+        size_t chunk = (length < space) ? length : space;
+        memcpy(writer->buffer + writer->used, data, chunk); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+        writer->used += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+/**
+ * Write the separator and indentation that precede a value or key
+ */
+static void begin_value(JsonWriter *writer) {
+    assert(writer != NULL);
+
+    if (writer->after_key) {
+        writer->after_key = 0;
+        return;
+    }
+    if (writer->depth == 0) {
+        return;
+    }
+
+    if (!writer->first) {
+        append(writer, ",", 1);
+    }
+    if (!writer->compact) {
+        write_line_break(writer);
+    }
+    writer->first = 0;
+}
+
+/**
+ * Close the innermost container on its own line
+ */
+static void close_container(JsonWriter *writer, char bracket) {
+    assert(writer != NULL);
+    assert(writer->depth > 0);
+
+    writer->depth--;
+    if (!writer->compact) {
+        write_line_break(writer);
+    }
+    append(writer, &bracket, 1);
+    writer->first = 0;
+}
+
+/**
+ * Start a new line indented to the current depth
+ */
+static void write_line_break(JsonWriter *writer) {
+    static const char spaces[] = "\n                                ";
+    size_t indent = (size_t)writer->depth * JSON_INDENT;
+
+    size_t chunk = (indent < sizeof(spaces) - 2) ? indent : sizeof(spaces) - 2;
+    append(writer, spaces, chunk + 1);
+    for (indent -= chunk; indent > 0; indent -= chunk) {
+        chunk = (indent < sizeof(spaces) - 2) ? indent : sizeof(spaces) - 2;
+        append(writer, spaces + 1, chunk);
+    }
+}
+
+/**
+ * Measure a well-formed multi-byte UTF-8 sequence
+ * Overlong forms, surrogates and code points above U+10FFFF are rejected.
+ * @return Sequence length, or 0 if the bytes are not valid UTF-8
+ */
+static size_t utf8_sequence_length(const unsigned char *text, size_t remaining) {
+    unsigned char lead = text[0];
+    size_t length;
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        if (lead == 0xe0) low = 0xa0;
+        if (lead == 0xed) high = 0x9f;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        if (lead == 0xf0) low = 0x90;
+        if (lead == 0xf4) high = 0x8f;
+    } else {
+        return 0;
+    }
+
+    if (remaining < length || text[1] < low || text[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if (text[i] < 0x80 || text[i] > 0xbf) return 0;
+    }
+    return length;
+}
@@ -0,0 +1,129 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Bytes collected before each write to the output stream */
+#define JSON_WRITER_BUFFER_SIZE (256 * 1024)
+
+/**
+ * Buffered JSON emitter
+ * Values are written as they are produced, so arrays of any length stream
+ * through a fixed buffer. Strings are escaped, and bytes that are not
+ * valid UTF-8 are replaced with U+FFFD. Pretty output is indented by two
+ * spaces per level with one member or element per line; compact output
+ * has no whitespace and suits one-record-per-line (NDJSON) streams.
+ */
+typedef struct {
+    FILE *out;
+    char *buffer;
+    size_t used;
+    int compact;        /* No line breaks or indentation */
+    int depth;          /* Open objects and arrays */
+    int first;          /* Nothing written yet in the innermost container */
+    int after_key;      /* A key was written; its value goes on the same line */
+    int failed;         /* Allocation or write error; later output is dropped */
+} JsonWriter;
+
+/**
+ * Start writing a document
+ * @param writer Writer to initialize
+ * @param out Destination stream
+ * @param compact Non-zero for compact output
+ * @return 0 on success, -1 on allocation failure
+ */
+int json_writer_init(JsonWriter *writer, FILE *out, int compact);
+
+/**
+ * End the document, flush it and release the buffer
+ * Pretty output gets a final newline; compact records end with
+ * json_writer_end_record() instead.
+ * @param writer Writer to finish
+ * @return 0 if everything was written, -1 otherwise
+ */
+int json_writer_finish(JsonWriter *writer);
+
+/**
+ * Terminate a complete top-level value with a newline
+ * @param writer Active writer
+ */
+void json_writer_end_record(JsonWriter *writer);
+
+/**
+ * Hand everything written so far to the output stream
+ * @param writer Active writer
+ * @return 0 on success, -1 if the output could not be written
+ */
+int json_writer_flush(JsonWriter *writer);
+
+/**
+ * Open an object as the next value
+ * @param writer Active writer
+ */
+void json_writer_begin_object(JsonWriter *writer);
+
+/**
+ * Close the innermost object
+ * @param writer Active writer
+ */
+void json_writer_end_object(JsonWriter *writer);
+
+/**
+ * Open an array as the next value
+ * @param writer Active writer
+ */
+void json_writer_begin_array(JsonWriter *writer);
+
+/**
+ * Close the innermost array
+ * @param writer Active writer
+ */
+void json_writer_end_array(JsonWriter *writer);
+
+/**
+ * Write an object member name; the next call writes its value
+ * @param writer Active writer
+ * @param name Member name
+ */
+void json_writer_key(JsonWriter *writer, const char *name);
+
+/**
+ * Write an escaped string value
+ * @param writer Active writer
+ * @param value NUL-terminated string
+ */
+void json_writer_string(JsonWriter *writer, const char *value);
+
+/**
+ * Write an integer value
+ * @param writer Active writer
+ * @param value Integer to write
+ */
+void json_writer_int(JsonWriter *writer, long long value);
+
+/**
+ * Write a number with a fixed count of decimals (null if not finite)
+ * @param writer Active writer
+ * @param value Number to write
+ * @param decimals Digits after the decimal point
+ */
+void json_writer_fixed(JsonWriter *writer, double value, int decimals);
+
+/**
+ * Write true or false
+ * @param writer Active writer
+ * @param value Non-zero for true
+ */
+void json_writer_bool(JsonWriter *writer, int value);
+
+/**
+ * Write a value rendered elsewhere, for example by a compact writer in
+ * another process, laid out as if this writer had produced it
+ * @param writer Active writer
+ * @param json Well-formed compact JSON value
+ * @param length Length of json in bytes
+ */
+void json_writer_embed(JsonWriter *writer, const char *json, size_t length);
+
+#endif /* JSON_WRITER_H */
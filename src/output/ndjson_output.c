@@ -0,0 +1,332 @@
+#include "formatters.h"
+#include "json_writer.h"
+#include "../git_stats.h"
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+
+/* Forward declarations */
+static void on_ndjson_section(const GitStats *stats, StatsSection section, void *ctx);
+static void on_ndjson_commit(const CommitRecord *commit, void *ctx);
+static void begin_record(JsonWriter *json, const char *type);
+static void end_record(JsonWriter *json);
+static void write_author_records(JsonWriter *json, const GitStats *stats);
+static void write_branch_records(JsonWriter *json, const GitStats *stats);
+static void write_file_type_records(JsonWriter *json, const GitStats *stats);
+static void write_hotspot_records(JsonWriter *json, const GitStats *stats);
+static void write_activity_records(JsonWriter *json, const GitStats *stats);
+static void write_profile_records(JsonWriter *json);
+
+/**
+ * Start NDJSON output and attach it to the statistics as their listener
+ */
+int ndjson_output_begin(NdjsonOutput *output, GitStats *stats) {
+    assert(output != NULL);
+    assert(stats != NULL);
+
+    if (json_writer_init(&output->json, stdout, 1) != 0) {
+        return -1;
+    }
+
+    output->listener.on_section = on_ndjson_section;
+    output->listener.on_commit = on_ndjson_commit;
+    output->listener.ctx = output;
+    stats->listener = &output->listener;
+    return 0;
+}
+
+/**
+ * Write the closing summary record and flush the stream
+ * With --profile, one profile record per finished phase and one for the
+ * whole run come first.
+ */
+int ndjson_output_end(NdjsonOutput *output, const GitStats *stats) {
+    assert(output != NULL);
+    assert(stats != NULL);
+
+    JsonWriter *json = &output->json;
+    if (profile_enabled()) {
+        write_profile_records(json);
+    }
+
+    /* A --fast run has only the exact commit count and the estimates */
+    if (stats->estimates.enabled) {
+        begin_record(json, "estimates");
+        write_distinct_estimates_json(json, &stats->estimates);
+        end_record(json);
+
+        begin_record(json, "summary");
+        json_writer_key(json, "total_commits");
+        json_writer_int(json, stats->total_commits);
+        write_history_window_json(json, &stats->options);
+        end_record(json);
+        return json_writer_finish(json);
+    }
+
+    begin_record(json, "summary");
+    json_writer_key(json, "total_commits");
+    json_writer_int(json, stats->total_commits);
+    json_writer_key(json, "total_authors");
+    json_writer_int(json, stats->total_authors);
+    json_writer_key(json, "total_branches");
+    json_writer_int(json, stats->total_branches);
+    json_writer_key(json, "total_files");
+    json_writer_int(json, stats->total_files);
+    json_writer_key(json, "total_lines");
+    json_writer_int(json, stats->total_lines);
+    write_history_window_json(json, &stats->options);
+    end_record(json);
+
+    return json_writer_finish(json);
+}
+
+/**
+ * Write the records of a finished section and flush them to the reader
+ */
+static void on_ndjson_section(const GitStats *stats, StatsSection section, void *ctx) {
+    NdjsonOutput *output = (NdjsonOutput *)ctx;
+    JsonWriter *json = &output->json;
+
+    switch (section) {
+        case STATS_SECTION_REPOSITORY:
+            begin_record(json, "repository");
+            json_writer_key(json, "name");
+            json_writer_string(json, stats->repo_name);
+            json_writer_key(json, "current_branch");
+            json_writer_string(json, stats->current_branch);
+            end_record(json);
+            break;
+        case STATS_SECTION_AUTHORS:
+            write_author_records(json, stats);
+            break;
+        case STATS_SECTION_BRANCHES:
+            write_branch_records(json, stats);
+            break;
+        case STATS_SECTION_FILE_TYPES:
+            write_file_type_records(json, stats);
+            break;
+        case STATS_SECTION_HOTSPOTS:
+            write_hotspot_records(json, stats);
+            break;
+        case STATS_SECTION_ACTIVITY:
+            write_activity_records(json, stats);
+            break;
+        case STATS_SECTION_COMMITS:
+        default:
+            return; /* Totals go into the summary record */
+    }
+
+    json_writer_flush(json);
+}
+
+/**
+ * Write one record of the per-commit stream
+ * Left in the buffer; it is flushed when full or with the next section.
+ */
+static void on_ndjson_commit(const CommitRecord *commit, void *ctx) {
+    NdjsonOutput *output = (NdjsonOutput *)ctx;
+    JsonWriter *json = &output->json;
+
+    begin_record(json, "commit");
+    json_writer_key(json, "id");
+    json_writer_string(json, commit->id);
+    json_writer_key(json, "author");
+    json_writer_string(json, commit->author);
+    json_writer_key(json, "date");
+    json_writer_string(json, commit->date);
+    json_writer_key(json, "files");
+    json_writer_int(json, commit->files_changed);
+    json_writer_key(json, "lines_added");
+    json_writer_int(json, commit->lines_added);
+    json_writer_key(json, "lines_deleted");
+    json_writer_int(json, commit->lines_deleted);
+    end_record(json);
+}
+
+/**
+ * Open a record object tagged with its type
+ */
+static void begin_record(JsonWriter *json, const char *type) {
+    json_writer_begin_object(json);
+    json_writer_key(json, "type");
+    json_writer_string(json, type);
+}
+
+/**
+ * Close a record and end its line
+ */
+static void end_record(JsonWriter *json) {
+    json_writer_end_object(json);
+    json_writer_end_record(json);
+}
+
+/**
+ * Write one record per author (every author unless --limit is given)
+ */
+static void write_author_records(JsonWriter *json, const GitStats *stats) {
+    int count = display_row_count(&stats->options, stats->total_authors, INT_MAX);
+    for (int i = 0; i < count; i++) {
+        const Author *author = &stats->authors[i];
+        begin_record(json, "author");
+        json_writer_key(json, "name");
+        json_writer_string(json, git_stats_author_name(stats, author));
+        json_writer_key(json, "commits");
+        json_writer_int(json, author->commit_count);
+        json_writer_key(json, "lines_added");
+        json_writer_int(json, author->lines_added);
+        json_writer_key(json, "lines_deleted");
+        json_writer_int(json, author->lines_deleted);
+        end_record(json);
+    }
+}
+
+/**
+ * Write one record per local branch
+ */
+static void write_branch_records(JsonWriter *json, const GitStats *stats) {
+    int count = display_row_count(&stats->options, stats->total_branches, INT_MAX);
+    for (int i = 0; i < count; i++) {
+        begin_record(json, "branch");
+        json_writer_key(json, "name");
+        json_writer_string(json, stats->branches[i].name);
+        json_writer_key(json, "commits");
+        json_writer_int(json, stats->branches[i].commit_count);
+        end_record(json);
+    }
+}
+
+/**
+ * Write one record per file extension
+ * Estimated line counts are preceded by a record of how they were drawn.
+ */
+static void write_file_type_records(JsonWriter *json, const GitStats *stats) {
+    if (stats->line_estimate.enabled) {
+        begin_record(json, "line_estimate");
+        write_line_estimate_json(json, &stats->line_estimate);
+        end_record(json);
+    }
+
+    int count = display_row_count(&stats->options, stats->file_type_count, INT_MAX);
+    for (int i = 0; i < count; i++) {
+        const FileType *type = &stats->file_types[i];
+        double percentage = (stats->total_lines > 0) ?
+                           (double)type->total_lines * 100.0 / stats->total_lines : 0.0;
+        begin_record(json, "file_type");
+        json_writer_key(json, "extension");
+        json_writer_string(json, type->extension);
+        json_writer_key(json, "files");
+        json_writer_int(json, type->count);
+        json_writer_key(json, "lines");
+        json_writer_int(json, type->total_lines);
+        json_writer_key(json, "percentage");
+        json_writer_fixed(json, percentage, 1);
+        if (stats->line_estimate.enabled) {
+            json_writer_key(json, "lines_margin");
+            json_writer_int(json, type->lines_margin);
+            json_writer_key(json, "sampled_files");
+            json_writer_int(json, type->sampled);
+        }
+        end_record(json);
+    }
+}
+
+/**
+ * Write one record per file, highest hotspot score first
+ * Approximate hotspots are preceded by a record of their error bounds.
+ */
+static void write_hotspot_records(JsonWriter *json, const GitStats *stats) {
+    if (stats->hotspot_accuracy.approximate) {
+        begin_record(json, "hotspot_accuracy");
+        write_hotspot_accuracy_json(json, &stats->hotspot_accuracy);
+        end_record(json);
+    }
+
+    int count = display_row_count(&stats->options, stats->hotspot_count, INT_MAX);
+    for (int i = 0; i < count; i++) {
+        const FileHotspot *hotspot = &stats->hotspots[i];
+        begin_record(json, "hotspot");
+        json_writer_key(json, "filename");
+        json_writer_string(json, git_stats_hotspot_path(stats, hotspot));
+        json_writer_key(json, "commits");
+        json_writer_int(json, hotspot->commit_count);
+        json_writer_key(json, "lines_added");
+        json_writer_int(json, hotspot->lines_added);
+        json_writer_key(json, "lines_deleted");
+        json_writer_int(json, hotspot->lines_deleted);
+        json_writer_key(json, "hotspot_score");
+        json_writer_fixed(json, hotspot->hotspot_score, 1);
+        if (stats->hotspot_accuracy.approximate) {
+            json_writer_key(json, "commits_error");
+            json_writer_int(json, hotspot->commit_error);
+            json_writer_key(json, "lines_exact");
+            json_writer_bool(json, hotspot->commit_error == 0);
+        }
+        end_record(json);
+    }
+}
+
+/**
+ * Write the activity summary followed by one record per contributor
+ */
+static void write_activity_records(JsonWriter *json, const GitStats *stats) {
+    int active_count = 0;
+    int single_commit_count = 0;
+
+    GIT_STATS_FOR_EACH(const AuthorActivity, activity, stats->activities, stats->activity_count) {
+        if (activity->is_active) active_count++;
+        if (activity->commit_count == 1) single_commit_count++;
+    }
+
+    begin_record(json, "activity_summary");
+    json_writer_key(json, "total_contributors");
+    json_writer_int(json, stats->activity_count);
+    json_writer_key(json, "active_contributors");
+    json_writer_int(json, active_count);
+    json_writer_key(json, "single_commit_contributors");
+    json_writer_int(json, single_commit_count);
+    end_record(json);
+
+    int count = display_row_count(&stats->options, stats->activity_count, INT_MAX);
+    for (int i = 0; i < count; i++) {
+        const AuthorActivity *activity = &stats->activities[i];
+        begin_record(json, "activity");
+        json_writer_key(json, "name");
+        json_writer_string(json, git_stats_activity_name(stats, activity));
+        json_writer_key(json, "commits");
+        json_writer_int(json, activity->commit_count);
+        json_writer_key(json, "lines_added");
+        json_writer_int(json, activity->lines_added);
+        json_writer_key(json, "lines_deleted");
+        json_writer_int(json, activity->lines_deleted);
+        json_writer_key(json, "first_commit_date");
+        json_writer_string(json, activity->first_commit_date);
+        json_writer_key(json, "last_commit_date");
+        json_writer_string(json, activity->last_commit_date);
+        json_writer_key(json, "days_since_last_commit");
+        json_writer_int(json, activity->days_since_last_commit);
+        json_writer_key(json, "is_active");
+        json_writer_bool(json, activity->is_active);
+        json_writer_key(json, "activity_score");
+        json_writer_fixed(json, activity->activity_score, 1);
+        end_record(json);
+    }
+}
+
+/**
+ * Write one record per finished --profile phase, then the run totals
+ */
+static void write_profile_records(JsonWriter *json) {
+    ProfileSample samples[PROFILE_MAX_PHASES];
+    int count = profile_snapshot(samples, PROFILE_MAX_PHASES);
+    for (int i = 0; i < count; i++) {
+        begin_record(json, "profile");
+        write_profile_sample_json(json, &samples[i]);
+        end_record(json);
+    }
+
+    ProfileSample total;
+    profile_total(&total);
+    begin_record(json, "profile");
+    write_profile_sample_json(json, &total);
+    end_record(json);
+}
@@ -0,0 +1,943 @@
+#define _GNU_SOURCE
+#include "server.h"
+#include "analysis/hotspots.h"
+#include "analysis/activity.h"
+#include "output/formatters.h"
+#include "output/json_writer.h"
+#include "utils/log_stream.h"
+#include "utils/git_repo.h"
+#include "utils/git_commands.h"
+#include "utils/string_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+/* Connections served at once; further ones wait in the listen backlog */
+#define SERVER_MAX_CLIENTS 32
+
+/* Longest request line, including the newline */
+#define SERVER_REQUEST_SIZE 4096
+
+/* Quiet time after a ref change before updating, so that a fetch or push
+   touching many refs is applied once */
+#define SERVER_SETTLE_MS 50
+
+/* Ref check interval when inotify is unavailable */
+#define SERVER_POLL_MS 2000
+
+/* A client that stops reading its answer is dropped after this long */
+#define SERVER_SEND_TIMEOUT_S 5
+
+/* Deepest ref directory nesting that is watched */
+#define SERVER_MAX_WATCH_DEPTH 16
+
+#ifdef __linux__
+/* Git replaces ref files by renaming a lock file over them */
+#define REF_WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR)
+#endif
+
+/**
+ * Queries a client can send
+ */
+typedef enum {
+    QUERY_STATS,        /* The document of --output json */
+    QUERY_HOTSPOTS,     /* ... of --output json --hotspots */
+    QUERY_ACTIVITY,     /* ... of --output json --activity */
+    QUERY_STATUS        /* Server state */
+} ServerQueryKind;
+
+/**
+ * Parsed request line
+ */
+typedef struct {
+    ServerQueryKind kind;
+    int limit;          /* Rows per listed section, as for --limit */
+} ServerQuery;
+
+/**
+ * Connection and its partly received request
+ */
+typedef struct {
+    int fd;
+    size_t used;
+    char buffer[SERVER_REQUEST_SIZE];
+} ServerClient;
+
+/**
+ * Server state
+ * The tallies hold the history reachable from tips. After every update
+ * each section of stats is ranked in full, so a query for any number of
+ * rows only reads a prefix.
+ */
+typedef struct {
+    GitStats stats;
+    AuthorTally authors;
+    HotspotTally hotspots;
+    ActivityTally activity;
+    int loaded;                 /* The tallies match tips */
+    GitRef *tips;
+    int tip_count;
+    char file_tree[OID_HEX_SIZE + 1];   /* Tree the file statistics were counted for */
+    char ranked_day[SHORT_DATE_SIZE];   /* Local date activity recency was computed on */
+    long generation;            /* Updates applied */
+    long long updated_at;       /* Time of the last update (epoch seconds) */
+    long commits_applied;       /* Commits logged by the last history update */
+    int listen_fd;
+    int watch_fd;               /* inotify descriptor, -1 when polling */
+    int git_dir_watch;
+    int common_dir_watch;
+    char refs_dir[MAX_PATH_LENGTH];
+    ServerClient *clients[SERVER_MAX_CLIENTS];
+    int client_count;
+} StatsServer;
+
+/* Set by SIGINT and SIGTERM */
+static volatile sig_atomic_t stop_requested;
+
+/* Forward declarations */
+static int open_server_socket(const char *socket_path);
+static void watch_refs(StatsServer *server);
+static void watch_ref_tree(StatsServer *server, const char *path, int depth);
+static int drain_watch_events(StatsServer *server);
+static void run_server(StatsServer *server);
+static int refresh_server(StatsServer *server);
+static int apply_new_history(StatsServer *server, GitRef **tips, int *tip_count);
+static int reset_history(StatsServer *server);
+static int rank_activity(StatsServer *server);
+static int resolve_file_tree(const CollectOptions *options, char *tree, size_t tree_size);
+static void accept_client(StatsServer *server);
+static int serve_client(StatsServer *server, ServerClient *client);
+static int answer_request(StatsServer *server, int fd, const char *line);
+static void write_status_json(JsonWriter *json, const StatsServer *server);
+static const char* parse_query(const char *line, int default_limit, ServerQuery *query);
+static int parse_json_string(const char **cursor, char *value, size_t value_size);
+static const char* skip_space(const char *text);
+static long long monotonic_ms(void);
+static void local_date(char *date, size_t date_size);
+
+/**
+ * Ask the event loop to stop
+ */
+static void request_stop(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+/**
+ * Serve statistics over a Unix socket until SIGINT or SIGTERM
+ */
+int serve_stats(const char *socket_path, const CollectOptions *options) {
+    assert(socket_path != NULL && options != NULL);
+
+    StatsServer server;
+    memset(&server, 0, sizeof(server));
+    init_git_stats(&server.stats);
+    server.stats.options = *options;
+    server.watch_fd = -1;
+
+    /* Listen first so that clients queue up while history loads */
+    server.listen_fd = open_server_socket(socket_path);
+    if (server.listen_fd < 0) {
+        return EXIT_ERROR_CODE;
+    }
+
+    /* Watch before loading, so no change made meanwhile is missed */
+    watch_refs(&server);
+
+    int exit_code = EXIT_SUCCESS_CODE;
+    if (refresh_server(&server) != 0) {
+        fprintf(stderr, "Error: Failed to read the repository history\n");
+        exit_code = EXIT_ERROR_CODE;
+    }
+
+    if (exit_code == EXIT_SUCCESS_CODE) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = request_stop;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+
+        printf("Serving %s on %s\n", server.stats.repo_name, socket_path);
+        fflush(stdout);
+        run_server(&server);
+    }
+
+    for (int i = 0; i < server.client_count; i++) {
+        close(server.clients[i]->fd);
+        free(server.clients[i]);
+    }
+    close(server.listen_fd);
+    unlink(socket_path);
+    if (server.watch_fd >= 0) {
+        close(server.watch_fd);
+    }
+
+    author_tally_free(&server.authors);
+    hotspot_tally_free(&server.hotspots);
+    activity_tally_free(&server.activity);
+    git_refs_free(server.tips, server.tip_count);
+    free_git_stats(&server.stats);
+    return exit_code;
+}
+
+/**
+ * Create, bind and listen on the server socket
+ * A socket left behind by a server that did not exit cleanly is replaced;
+ * any other file at the path is left alone.
+ * @return Listening descriptor, or -1 after printing an error
+ */
+static int open_server_socket(const char *socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path is too long: %s\n", socket_path);
+        return -1;
+    }
+    safe_string_copy(address.sun_path, socket_path, sizeof(address.sun_path));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot create a socket: %s\n", strerror(errno));
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    struct stat info;
+    if (lstat(socket_path, &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            fprintf(stderr, "Error: %s exists and is not a socket\n", socket_path);
+            close(fd);
+            return -1;
+        }
+        if (connect(fd, (const struct sockaddr *)&address, sizeof(address)) == 0) {
+            fprintf(stderr, "Error: A server is already listening on %s\n", socket_path);
+            close(fd);
+            return -1;
+        }
+        unlink(socket_path);
+    }
+
+    if (bind(fd, (const struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(fd, SERVER_MAX_CLIENTS) != 0) {
+        fprintf(stderr, "Error: Cannot listen on %s: %s\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Watch HEAD, packed-refs and the refs directory tree for changes
+ * Without inotify the server falls back to checking the refs periodically.
+ */
+static void watch_refs(StatsServer *server) {
+    server->watch_fd = -1;
+
+#ifdef __linux__
+    GitRepository repo;
+    if (git_repository_open(&repo) != 0) {
+        return;
+    }
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    int ret = snprintf(server->refs_dir, sizeof(server->refs_dir), "%s/refs", repo.common_dir);
+    if (fd >= 0 && ret > 0 && ret < (int)sizeof(server->refs_dir)) {
+        server->watch_fd = fd;
+        server->git_dir_watch = inotify_add_watch(fd, repo.git_dir, REF_WATCH_EVENTS);
+        server->common_dir_watch = inotify_add_watch(fd, repo.common_dir, REF_WATCH_EVENTS);
+        watch_ref_tree(server, server->refs_dir, 0);
+        if (server->git_dir_watch < 0 || server->common_dir_watch < 0) {
+            close(fd);
+            server->watch_fd = -1;
+        }
+    } else if (fd >= 0) {
+        close(fd);
+    }
+    git_repository_close(&repo);
+
+    if (server->watch_fd < 0) {
+        fprintf(stderr, "Warning: Cannot watch the refs; checking them every %d ms\n", SERVER_POLL_MS);
+    }
+#endif
+}
+
+/**
+ * Watch a directory and every directory below it
+ * Watching an already watched directory is harmless, so this also picks
+ * up directories created since the last call.
+ */
+static void watch_ref_tree(StatsServer *server, const char *path, int depth) {
+#ifdef __linux__
+    if (inotify_add_watch(server->watch_fd, path, REF_WATCH_EVENTS) < 0 ||
+        depth >= SERVER_MAX_WATCH_DEPTH) {
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char child[MAX_PATH_LENGTH];
+        int ret = snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (ret < 0 || ret >= (int)sizeof(child)) continue;
+
+        struct stat info;
+        if (entry->d_type == DT_DIR ||
+            (entry->d_type == DT_UNKNOWN && stat(child, &info) == 0 && S_ISDIR(info.st_mode))) {
+            watch_ref_tree(server, child, depth + 1);
+        }
+    }
+    closedir(dir);
+#else
+    (void)server;
+    (void)path;
+    (void)depth;
+#endif
+}
+
+/**
+ * Read every pending inotify event
+ * @return 1 if a ref, HEAD or packed-refs changed, 0 otherwise
+ */
+static int drain_watch_events(StatsServer *server) {
+#ifdef __linux__
+    _Alignas(struct inotify_event) char buffer[4096];
+    int changed = 0;
+    int new_directory = 0;
+
+    for (;;) {
+        ssize_t length = read(server->watch_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break; /* EAGAIN once drained */
+        }
+
+        for (char *next = buffer; next < buffer + length;) {
+            const struct inotify_event *event = (const struct inotify_event *)next;
+            next += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                changed = new_directory = 1;
+                continue;
+            }
+            if (event->mask & IN_ISDIR) {
+                new_directory = 1;
+            }
+
+            /* A lock file is renamed over its ref, which reports the ref itself */
+            size_t name_length = (event->len > 0) ? strlen(event->name) : 0;
+            if (name_length >= 5 && strcmp(event->name + name_length - 5, ".lock") == 0) {
+                continue;
+            }
+
+            /* Of the git directory's own files only HEAD and packed-refs matter */
+            if ((event->wd == server->git_dir_watch || event->wd == server->common_dir_watch) &&
+                (name_length == 0 ||
+                 (strcmp(event->name, "HEAD") != 0 && strcmp(event->name, "packed-refs") != 0))) {
+                continue;
+            }
+            changed = 1;
+        }
+    }
+
+    if (new_directory) {
+        watch_ref_tree(server, server->refs_dir, 0);
+    }
+    return changed;
+#else
+    (void)server;
+    return 0;
+#endif
+}
+
+/**
+ * Answer clients and apply ref changes until asked to stop
+ */
+static void run_server(StatsServer *server) {
+    /* Monotonic time of the next update, -1 while none is due */
+    long long refresh_due = (server->watch_fd < 0) ? monotonic_ms() + SERVER_POLL_MS : -1;
+
+    while (!stop_requested) {
+        struct pollfd fds[SERVER_MAX_CLIENTS + 2];
+        int client_count = server->client_count;
+
+        /* Leave new connections in the backlog while every slot is taken */
+        fds[0].fd = (client_count < SERVER_MAX_CLIENTS) ? server->listen_fd : -1;
+        fds[0].events = POLLIN;
+        fds[1].fd = server->watch_fd;
+        fds[1].events = POLLIN;
+        for (int i = 0; i < client_count; i++) {
+            fds[i + 2].fd = server->clients[i]->fd;
+            fds[i + 2].events = POLLIN;
+        }
+
+        int timeout = -1;
+        if (refresh_due >= 0) {
+            long long remaining = refresh_due - monotonic_ms();
+            timeout = (remaining > 0) ? (int)remaining : 0;
+        }
+
+        int ready = poll(fds, (nfds_t)(client_count + 2), timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Warning: poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if (fds[1].fd >= 0 && (fds[1].revents & POLLIN) && drain_watch_events(server) &&
+            refresh_due < 0) {
+            refresh_due = monotonic_ms() + SERVER_SETTLE_MS;
+        }
+
+        /* Backwards, so that dropping a client (moving the last one into
+           its slot) leaves the slots still to visit in place */
+        for (int i = client_count - 1; i >= 0; i--) {
+            if (fds[i + 2].revents == 0) continue;
+
+            ServerClient *client = server->clients[i];
+            if (serve_client(server, client) != 0) {
+                close(client->fd);
+                free(client);
+                server->clients[i] = server->clients[--server->client_count];
+            }
+        }
+
+        if (fds[0].fd >= 0 && (fds[0].revents & POLLIN)) {
+            accept_client(server);
+        }
+
+        if (refresh_due >= 0 && monotonic_ms() >= refresh_due) {
+            refresh_server(server);
+            refresh_due = (server->watch_fd < 0) ? monotonic_ms() + SERVER_POLL_MS : -1;
+        }
+    }
+}
+
+/**
+ * Bring the statistics up to date with the repository
+ * History is only logged when the tips moved, and files are only
+ * recounted when the tree they are counted from changed.
+ * @return 0 if the statistics are current, -1 if the update failed
+ */
+static int refresh_server(StatsServer *server) {
+    GitStats *stats = &server->stats;
+
+    GitRef *tips;
+    int tip_count;
+    if (log_stream_tips(&tips, &tip_count) != 0) {
+        fprintf(stderr, "Warning: Failed to read the repository refs\n");
+        return -1;
+    }
+
+    int changed = 0;
+    if (!server->loaded || !git_refs_equal(server->tips, server->tip_count, tips, tip_count)) {
+        if (apply_new_history(server, &tips, &tip_count) != 0) {
+            git_refs_free(tips, tip_count);
+            return -1;
+        }
+        git_refs_free(server->tips, server->tip_count);
+        server->tips = tips;
+        server->tip_count = tip_count;
+        changed = 1;
+    } else {
+        git_refs_free(tips, tip_count);
+    }
+
+    /* A checkout moves HEAD without moving any tip */
+    char branch[MAX_NAME_LENGTH];
+    safe_string_copy(branch, stats->current_branch, sizeof(branch));
+    safe_string_copy(stats->current_branch, "unknown", sizeof(stats->current_branch));
+    get_repository_info(stats);
+    if (strcmp(branch, stats->current_branch) != 0) {
+        changed = 1;
+    }
+
+    /* The work tree is recounted when a new tree is checked out */
+    char tree[OID_HEX_SIZE + 1];
+    if (resolve_file_tree(&stats->options, tree, sizeof(tree)) == 0 &&
+        strcmp(tree, server->file_tree) != 0) {
+        if (get_file_stats(stats) == 0) {
+            safe_string_copy(server->file_tree, tree, sizeof(server->file_tree));
+            changed = 1;
+        } else {
+            fprintf(stderr, "Warning: Failed to get file statistics\n");
+        }
+    }
+
+    if (changed) {
+        server->generation++;
+        server->updated_at = (long long)time(NULL);
+    }
+    return 0;
+}
+
+/**
+ * Attribute a logged commit to the author and activity tallies
+ */
+static void on_server_commit(const LogCommit *commit, void *ctx) {
+    StatsServer *server = (StatsServer *)ctx;
+
+    author_tally_commit(&server->authors, commit->author);
+    activity_tally_commit(&server->activity, commit->author, commit->date);
+    server->commits_applied++;
+}
+
+/**
+ * Add a numstat line to every tally
+ */
+static void on_server_file(const LogFileChange *change, void *ctx) {
+    StatsServer *server = (StatsServer *)ctx;
+
+    author_tally_lines(&server->authors, change->lines_added, change->lines_deleted);
+    hotspot_tally_file(&server->hotspots, change->path, change->lines_added, change->lines_deleted);
+    activity_tally_lines(&server->activity, change->lines_added, change->lines_deleted);
+}
+
+/**
+ * Tally the commits new since the last update, then recount and rank
+ * If some of the tallied history is no longer reachable (a force push or
+ * a deleted branch), the tallies are rebuilt from a full walk, which goes
+ * through the history cache unless --no-cache was given. That walk may
+ * see newer tips than the ones passed in; they are replaced with the tips
+ * it covered.
+ * @return 0 on success, -1 if the history could not be read
+ */
+static int apply_new_history(StatsServer *server, GitRef **tips, int *tip_count) {
+    GitStats *stats = &server->stats;
+    LogStreamHandler handler = { on_server_commit, on_server_file, server };
+
+    server->commits_applied = 0;
+    int result = 1;
+    if (server->loaded) {
+        result = stream_git_log_between(&handler, server->tips, server->tip_count, *tips, *tip_count);
+    }
+    if (result == 1) {
+        result = reset_history(server);
+
+        GitRef *covered;
+        int covered_count;
+        if (result == 0 && stats->options.use_cache &&
+            stream_cached_history(&handler, &covered, &covered_count) == 0) {
+            git_refs_free(*tips, *tip_count);
+            *tips = covered;
+            *tip_count = covered_count;
+        } else if (result == 0) {
+            result = stream_git_log_between(&handler, NULL, 0, *tips, *tip_count);
+        }
+    }
+
+    /* Rank every row once, so that queries only read prefixes */
+    if (result == 0 &&
+        (author_tally_rank(&server->authors, stats) != 0 ||
+         hotspot_tally_rank(&server->hotspots, stats, server->hotspots.count) != 0 ||
+         rank_activity(server) != 0)) {
+        result = -1;
+    }
+
+    if (result != 0) {
+        /* Part of the new history may have been tallied: rebuild next time */
+        server->loaded = 0;
+        fprintf(stderr, "Warning: Failed to apply the new history\n");
+        return -1;
+    }
+    server->loaded = 1;
+
+    if (get_commit_stats(stats) != 0) {
+        fprintf(stderr, "Warning: Failed to get commit statistics\n");
+    }
+    if (get_branch_stats(stats) != 0) {
+        fprintf(stderr, "Warning: Failed to get branch statistics\n");
+    }
+    return 0;
+}
+
+/**
+ * Empty the tallies and their string pools
+ * @return 0 on success, -1 on allocation failure
+ */
+static int reset_history(StatsServer *server) {
+    GitStats *stats = &server->stats;
+
+    author_tally_free(&server->authors);
+    hotspot_tally_free(&server->hotspots);
+    activity_tally_free(&server->activity);
+    string_pool_free(&stats->author_names);
+    string_pool_free(&stats->hotspot_paths);
+    string_pool_free(&stats->activity_names);
+    stats->total_authors = 0;
+    stats->hotspot_count = 0;
+    stats->activity_count = 0;
+
+    if (string_pool_init(&stats->author_names, 0) != 0 ||
+        string_pool_init(&stats->hotspot_paths, 0) != 0 ||
+        string_pool_init(&stats->activity_names, 0) != 0) {
+        return -1;
+    }
+
+    author_tally_init(&server->authors, &stats->author_names);
+    hotspot_tally_init(&server->hotspots, &stats->hotspot_paths);
+    activity_tally_init(&server->activity, &stats->activity_names);
+    return 0;
+}
+
+/**
+ * Rank every activity row against today's date
+ * @return 0 on success, -1 on allocation failure
+ */
+static int rank_activity(StatsServer *server) {
+    if (activity_tally_rank(&server->activity, &server->stats, server->activity.count) != 0) {
+        return -1;
+    }
+    local_date(server->ranked_day, sizeof(server->ranked_day));
+    return 0;
+}
+
+/**
+ * Id of the tree file statistics are counted for: that of --rev, else HEAD's
+ * A work tree is counted as it is, but a new HEAD tree is the cue to
+ * count it again.
+ * @return 0 on success, -1 if there is no such tree (for example no commits yet)
+ */
+static int resolve_file_tree(const CollectOptions *options, char *tree, size_t tree_size) {
+    char revision[MAX_NAME_LENGTH];
+    int ret = snprintf(revision, sizeof(revision), "%s^{tree}",
+                       (options->rev != NULL) ? options->rev : "HEAD");
+    if (ret < 0 || ret >= (int)sizeof(revision)) {
+        return -1;
+    }
+
+    const char *const argv[] = {"git", "rev-parse", "-q", "--verify", revision, NULL};
+    char *result = execute_git_command(argv);
+    if (result == NULL) {
+        return -1;
+    }
+    safe_string_copy(tree, result, tree_size);
+    free(result);
+    return 0;
+}
+
+/**
+ * Take a pending connection
+ */
+static void accept_client(StatsServer *server) {
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    ServerClient *client = malloc(sizeof(ServerClient));
+    if (client == NULL) {
+        close(fd);
+        return;
+    }
+
+    /* Answers are written blocking; this bounds how long a client can stall them */
+    struct timeval timeout = { SERVER_SEND_TIMEOUT_S, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    client->fd = fd;
+    client->used = 0;
+    server->clients[server->client_count++] = client;
+}
+
+/**
+ * Read from a readable client and answer each complete request line
+ * @return 0 to keep the connection, -1 to close it
+ */
+static int serve_client(StatsServer *server, ServerClient *client) {
+    size_t room = sizeof(client->buffer) - 1 - client->used;
+    ssize_t received = recv(client->fd, client->buffer + client->used, room, 0);
+    if (received < 0 && errno == EINTR) {
+        return 0;
+    }
+    if (received <= 0) {
+        return -1;
+    }
+    client->used += (size_t)received;
+
+    char *start = client->buffer;
+    char *end = client->buffer + client->used;
+    char *newline;
+    while ((newline = memchr(start, '\n', (size_t)(end - start))) != NULL) {
+        *newline = '\0';
+        if (answer_request(server, client->fd, start) != 0) {
+            return -1;
+        }
+        start = newline + 1;
+    }
+
+    client->used = (size_t)(end - start);
+    memmove(client->buffer, start, client->used);
+    if (client->used == sizeof(client->buffer) - 1) {
+        answer_request(server, client->fd, NULL);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write the answer to one request line as a line of JSON
+ * @param line Request, or NULL for one that was too long
+ * @return 0 on success, -1 if the answer could not be written
+ */
+static int answer_request(StatsServer *server, int fd, const char *line) {
+    if (line != NULL && *skip_space(line) == '\0') {
+        return 0; /* Blank lines keep a connection alive */
+    }
+
+    int out_fd = dup(fd);
+    FILE *out = (out_fd >= 0) ? fdopen(out_fd, "w") : NULL;
+    if (out == NULL) {
+        if (out_fd >= 0) close(out_fd);
+        return -1;
+    }
+
+    JsonWriter json;
+    if (json_writer_init(&json, out, 1) != 0) {
+        fclose(out);
+        return -1;
+    }
+
+    ServerQuery query;
+    const char *error = (line != NULL) ? parse_query(line, server->stats.options.limit, &query)
+                                       : "request is too long";
+    if (error != NULL) {
+        json_writer_begin_object(&json);
+        json_writer_key(&json, "error");
+        json_writer_string(&json, error);
+        json_writer_end_object(&json);
+    } else if (query.kind == QUERY_STATUS) {
+        write_status_json(&json, server);
+    } else {
+        /* Recency counts whole days, so it only changes with the date */
+        char today[SHORT_DATE_SIZE];
+        local_date(today, sizeof(today));
+        if (query.kind == QUERY_ACTIVITY && strcmp(today, server->ranked_day) != 0) {
+            rank_activity(server);
+        }
+
+        GitStats view = server->stats;
+        view.listener = NULL;
+        view.options.limit = query.limit;
+        AnalysisMode mode = (query.kind == QUERY_HOTSPOTS) ? ANALYSIS_HOTSPOTS :
+                            (query.kind == QUERY_ACTIVITY) ? ANALYSIS_ACTIVITY : ANALYSIS_BASIC;
+        write_stats_json(&json, &view, mode);
+    }
+    json_writer_end_record(&json);
+
+    int result = json_writer_finish(&json);
+    if (fclose(out) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+/**
+ * Write the answer to a status query
+ */
+static void write_status_json(JsonWriter *json, const StatsServer *server) {
+    json_writer_begin_object(json);
+    json_writer_key(json, "repository");
+    json_writer_string(json, server->stats.repo_name);
+    json_writer_key(json, "generation");
+    json_writer_int(json, server->generation);
+    json_writer_key(json, "updated_at");
+    json_writer_int(json, server->updated_at);
+    json_writer_key(json, "commits_applied");
+    json_writer_int(json, server->commits_applied);
+    json_writer_key(json, "refs");
+    json_writer_int(json, server->tip_count);
+    json_writer_key(json, "watch");
+    json_writer_string(json, (server->watch_fd >= 0) ? "inotify" : "poll");
+    json_writer_key(json, "clients");
+    json_writer_int(json, server->client_count);
+    json_writer_end_object(json);
+}
+
+/**
+ * Parse a request line: a JSON object with an optional "query" (stats,
+ * hotspots, activity or status) and "limit" (a positive count or "all")
+ * Other members are ignored.
+ * @return NULL on success, or a description of the problem
+ */
+static const char* parse_query(const char *line, int default_limit, ServerQuery *query) {
+    static const struct {
+        const char *name;
+        ServerQueryKind kind;
+    } QUERIES[] = {
+        { "stats", QUERY_STATS },
+        { "hotspots", QUERY_HOTSPOTS },
+        { "activity", QUERY_ACTIVITY },
+        { "status", QUERY_STATUS },
+    };
+
+    query->kind = QUERY_STATS;
+    query->limit = default_limit;
+
+    const char *cursor = skip_space(line);
+    if (*cursor != '{') {
+        return "request must be a JSON object";
+    }
+    cursor = skip_space(cursor + 1);
+
+    while (*cursor != '}') {
+        char key[32];
+        if (parse_json_string(&cursor, key, sizeof(key)) != 0) {
+            return "expected a member name";
+        }
+        cursor = skip_space(cursor);
+        if (*cursor != ':') {
+            return "expected ':' after a member name";
+        }
+        cursor = skip_space(cursor + 1);
+
+        char value[32];
+        if (strcmp(key, "query") == 0) {
+            if (parse_json_string(&cursor, value, sizeof(value)) != 0) {
+                return "query must be a string";
+            }
+            size_t i = 0;
+            while (i < sizeof(QUERIES) / sizeof(QUERIES[0]) && strcmp(value, QUERIES[i].name) != 0) {
+                i++;
+            }
+            if (i == sizeof(QUERIES) / sizeof(QUERIES[0])) {
+                return "unknown query (expected stats, hotspots, activity or status)";
+            }
+            query->kind = QUERIES[i].kind;
+        } else if (strcmp(key, "limit") == 0) {
+            if (*cursor == '"') {
+                if (parse_json_string(&cursor, value, sizeof(value)) != 0 || strcmp(value, "all") != 0) {
+                    return "limit must be a positive count or \"all\"";
+                }
+                query->limit = LIMIT_ALL;
+            } else {
+                char *end;
+                errno = 0;
+                long limit = strtol(cursor, &end, 10);
+                if (end == cursor || errno != 0 || limit < 1 || limit > INT_MAX) {
+                    return "limit must be a positive count or \"all\"";
+                }
+                query->limit = (int)limit;
+                cursor = end;
+            }
+        } else if (*cursor == '"') {
+            if (parse_json_string(&cursor, NULL, 0) != 0) {
+                return "malformed string";
+            }
+        } else {
+            /* Numbers, true, false and null */
+            size_t length = strspn(cursor, "+-.0123456789eEaflnrstu");
+            if (length == 0) {
+                return "unsupported member value";
+            }
+            cursor += length;
+        }
+
+        cursor = skip_space(cursor);
+        if (*cursor == ',') {
+            cursor = skip_space(cursor + 1);
+        } else if (*cursor != '}') {
+            return "expected ',' or '}'";
+        }
+    }
+
+    if (*skip_space(cursor + 1) != '\0') {
+        return "unexpected text after the request object";
+    }
+    return NULL;
+}
+
+/**
+ * Read a JSON string at the cursor and move past it
+ * \u escapes are not needed for the members understood here and are
+ * refused.
+ * @param value Receives the string, or NULL to skip it
+ * @return 0 on success, -1 if it is malformed or does not fit
+ */
+static int parse_json_string(const char **cursor, char *value, size_t value_size) {
+    const char *in = *cursor;
+    if (*in++ != '"') {
+        return -1;
+    }
+
+    size_t length = 0;
+    for (; *in != '"'; in++) {
+        char c = *in;
+        if (c == '\0') {
+            return -1;
+        }
+        if (c == '\\') {
+            static const char ESCAPED[] = "\"\\/bfnrt";
+            static const char DECODED[] = "\"\\/\b\f\n\r\t";
+            const char *escape = (*++in != '\0') ? strchr(ESCAPED, *in) : NULL;
+            if (escape == NULL) {
+                return -1;
+            }
+            c = DECODED[escape - ESCAPED];
+        }
+        if (value != NULL) {
+            if (length + 1 >= value_size) {
+                return -1;
+            }
+            value[length++] = c;
+        }
+    }
+
+    if (value != NULL) {
+        value[length] = '\0';
+    }
+    *cursor = in + 1;
+    return 0;
+}
+
+/**
+ * First character that is not JSON whitespace
+ */
+static const char* skip_space(const char *text) {
+    while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') {
+        text++;
+    }
+    return text;
+}
+
+/**
+ * Milliseconds on a clock that never jumps
+ */
+static long long monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Today's local date as YYYY-MM-DD, or "" if it cannot be determined
+ */
+static void local_date(char *date, size_t date_size) {
+    time_t now = time(NULL);
+    struct tm local;
+    if (localtime_r(&now, &local) == NULL || strftime(date, date_size, "%Y-%m-%d", &local) == 0) {
+        date[0] = '\0';
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "git_stats.h"
+
+/**
+ * Serve statistics for the repository in the current directory over a
+ * Unix socket until SIGINT or SIGTERM (--serve)
+ * History is walked once and kept as tallies in memory. When refs change,
+ * only the commits added since are logged and applied; rewritten history
+ * is walked again from scratch. Each request line is a JSON object such
+ * as {"query":"hotspots","limit":20}, and each answer is one line of
+ * JSON.
+ * @param socket_path Path of the socket to create
+ * @param options Collection options; options->limit is the default row
+ *                count for queries
+ * @return Exit code
+ */
+int serve_stats(const char *socket_path, const CollectOptions *options);
+
+#endif /* SERVER_H */
@@ -0,0 +1,203 @@
+#define _GNU_SOURCE
+#include "blob_stream.h"
+#include "line_count.h"
+#include "profile.h"
+#include "subprocess.h"
+#include "vector.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+/* Block size used when streaming blob contents */
+#define BLOB_STREAM_BLOCK_SIZE (64 * 1024)
+
+/**
+ * Blobs collected from `git ls-tree`
+ */
+typedef struct {
+    TreeBlob *blobs;
+    int count;
+    int capacity;
+} TreeBlobList;
+
+/* Forward declarations */
+static int add_tree_entry(char *entry, size_t length, void *ctx);
+
+/**
+ * List every blob in the tree of a revision
+ */
+int list_tree_blobs(const char *rev, int with_sizes, TreeBlob **blobs, int *count) {
+    assert(rev != NULL);
+    assert(blobs != NULL && count != NULL);
+
+    *blobs = NULL;
+    *count = 0;
+
+    const char *argv[8] = {"git", "ls-tree", "-r", "-z", "--full-tree", NULL};
+    int argc = 5;
+    if (with_sizes) {
+        argv[argc++] = "--long";
+    }
+    argv[argc++] = rev;
+    argv[argc] = NULL;
+    TreeBlobList list = {NULL, 0, 0};
+    if (subprocess_stream(argv, NULL, 0, '\0', add_tree_entry, &list) != 0) {
+        tree_blobs_free(list.blobs, list.count);
+        return -1;
+    }
+
+    *blobs = list.blobs;
+    *count = list.count;
+    return 0;
+}
+
+/**
+ * Append the blob of one ls-tree entry
+ * Entries are "<mode> SP <type> SP <oid> TAB <path>"; with --long the
+ * oid is followed by spaces and the size.
+ */
+static int add_tree_entry(char *entry, size_t length, void *ctx) {
+    TreeBlobList *list = ctx;
+    (void)length;
+
+    char *type = strchr(entry, ' ');
+    char *tab = strchr(entry, '\t');
+    if (type == NULL || tab == NULL || tab - type < 5 + 1 + 40 ||
+        strncmp(type + 1, "blob ", 5) != 0) {
+        return 0; /* Submodules (commit entries) have no blob to count */
+    }
+
+    long size = -1;
+    if (tab - type > 5 + 1 + 40) {
+        char *end;
+        size = strtol(type + 5 + 1 + 40, &end, 10);
+        if (end != tab || size < 0) {
+            return 0;
+        }
+    }
+
+    if (VECTOR_RESERVE(list->blobs, list->capacity, list->count + 1) != 0) {
+        return 1;
+    }
+
+    TreeBlob *blob = &list->blobs[list->count];
+    blob->path = strdup(tab + 1);
+    if (blob->path == NULL) {
+        return 1;
+    }
+    memcpy(blob->oid, type + 6, 40); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    blob->oid[40] = '\0';
+    blob->size = size;
+    list->count++;
+    return 0;
+}
+
+/**
+ * Release a list returned by list_tree_blobs()
+ */
+void tree_blobs_free(TreeBlob *blobs, int count) {
+    for (int i = 0; i < count; i++) {
+        free(blobs[i].path);
+    }
+    free(blobs);
+}
+
+/**
+ * Start a `git cat-file --batch` process
+ */
+int blob_stream_open(BlobStream *stream) {
+    assert(stream != NULL);
+
+    const char *const argv[] = {"git", "cat-file", "--batch", NULL};
+    if (subprocess_start(&stream->proc, argv, SUBPROCESS_STDIN) != 0) {
+        return -1;
+    }
+
+    stream->request = fdopen(stream->proc.input_fd, "w");
+    stream->response = fdopen(stream->proc.output_fd, "r");
+    if (stream->request == NULL || stream->response == NULL) {
+        if (stream->request != NULL) fclose(stream->request); else close(stream->proc.input_fd);
+        if (stream->response != NULL) fclose(stream->response); else close(stream->proc.output_fd);
+        subprocess_wait(&stream->proc);
+        return -1;
+    }
+
+    /* Small blobs then cost one read() per batch rather than several each */
+    setvbuf(stream->response, NULL, _IOFBF, SUBPROCESS_READ_BLOCK);
+
+    return 0;
+}
+
+/**
+ * Queue a request for an object
+ */
+int blob_stream_request(BlobStream *stream, const char *oid) {
+    assert(stream != NULL && oid != NULL);
+    return (fprintf(stream->request, "%s\n", oid) < 0) ? -1 : 0;
+}
+
+/**
+ * Send all queued requests to cat-file
+ */
+int blob_stream_flush(BlobStream *stream) {
+    assert(stream != NULL);
+    return (fflush(stream->request) == 0) ? 0 : -1;
+}
+
+/**
+ * Read the next response and count the newlines in its contents
+ */
+long blob_stream_count_lines(BlobStream *stream) {
+    assert(stream != NULL);
+
+    /* Header is "<oid> <type> <size>" or "<oid> missing" */
+    char header[128];
+    if (fgets(header, sizeof(header), stream->response) == NULL) {
+        return -1;
+    }
+
+    char *size_field = strrchr(header, ' ');
+    if (size_field == NULL || strstr(header, " missing") != NULL) {
+        return -2;
+    }
+
+    char *end;
+    long long remaining = strtoll(size_field + 1, &end, 10);
+    if (end == size_field + 1 || remaining < 0) {
+        return -1;
+    }
+    /* Header, contents and the separator */
+    profile_count_pipe_bytes(strlen(header) + (size_t)remaining + 1);
+
+    unsigned char buffer[BLOB_STREAM_BLOCK_SIZE];
+    size_t lines = 0;
+    while (remaining > 0) {
+        size_t want = (remaining < (long long)sizeof(buffer)) ? (size_t)remaining : sizeof(buffer);
+        size_t got = fread(buffer, 1, want, stream->response);
+        if (got == 0) {
+            return -1;
+        }
+        lines += count_newlines(buffer, got);
+        remaining -= (long long)got;
+    }
+
+    /* Contents are followed by a newline separator */
+    if (fgetc(stream->response) != '\n') {
+        return -1;
+    }
+
+    return (long)lines;
+}
+
+/**
+ * Close the pipes and wait for cat-file to exit
+ */
+void blob_stream_close(BlobStream *stream) {
+    assert(stream != NULL);
+
+    /* EOF on stdin makes cat-file exit */
+    fclose(stream->request);
+    fclose(stream->response);
+    subprocess_wait(&stream->proc);
+}
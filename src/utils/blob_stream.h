@@ -0,0 +1,87 @@
+#ifndef BLOB_STREAM_H
+#define BLOB_STREAM_H
+
+#include "subprocess.h"
+#include <stdio.h>
+
+/**
+ * Blob and path of a file in a committed tree
+ */
+typedef struct {
+    char *path;
+    char oid[41];   /* Hex object id */
+    long size;      /* Blob size in bytes, or -1 if not listed */
+} TreeBlob;
+
+/**
+ * Long-lived `git cat-file --batch` process
+ * Requests are answered in order, so several can be written before the
+ * responses are read. Keep the number of unanswered requests small enough
+ * to fit in a pipe buffer (see BLOB_STREAM_MAX_PENDING).
+ */
+typedef struct {
+    Subprocess proc;
+    FILE *request;      /* cat-file stdin */
+    FILE *response;     /* cat-file stdout */
+} BlobStream;
+
+/* Unanswered requests that always fit in a pipe buffer (41 bytes each) */
+#define BLOB_STREAM_MAX_PENDING 64
+
+/**
+ * List every blob in the tree of a revision with `git ls-tree -r -z`
+ * Submodule entries are skipped. Caller releases the list with
+ * tree_blobs_free().
+ * @param rev Revision to read (commit, tag or tree)
+ * @param with_sizes Also list blob sizes (--long), which makes git look
+ *                   up every blob
+ * @param blobs Receives the allocated blob array
+ * @param count Receives the number of blobs
+ * @return 0 on success, -1 if the revision cannot be read
+ */
+int list_tree_blobs(const char *rev, int with_sizes, TreeBlob **blobs, int *count);
+
+/**
+ * Release a list returned by list_tree_blobs()
+ * @param blobs Blob array
+ * @param count Number of blobs
+ */
+void tree_blobs_free(TreeBlob *blobs, int count);
+
+/**
+ * Start a `git cat-file --batch` process
+ * @param stream Stream to initialize
+ * @return 0 on success, -1 on error
+ */
+int blob_stream_open(BlobStream *stream);
+
+/**
+ * Queue a request for an object
+ * Requests are buffered; call blob_stream_flush() before reading.
+ * @param stream Open stream
+ * @param oid Hex object id
+ * @return 0 on success, -1 on error
+ */
+int blob_stream_request(BlobStream *stream, const char *oid);
+
+/**
+ * Send all queued requests to cat-file
+ * @param stream Open stream
+ * @return 0 on success, -1 on error
+ */
+int blob_stream_flush(BlobStream *stream);
+
+/**
+ * Read the next response and count the newlines in its contents
+ * @param stream Open stream
+ * @return Number of lines, -2 if the object is missing, -1 on stream error
+ */
+long blob_stream_count_lines(BlobStream *stream);
+
+/**
+ * Close the pipes and wait for cat-file to exit
+ * @param stream Stream to close
+ */
+void blob_stream_close(BlobStream *stream);
+
+#endif /* BLOB_STREAM_H */
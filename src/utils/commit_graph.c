@@ -0,0 +1,339 @@
+#define _GNU_SOURCE
+#include "commit_graph.h"
+#include "vector.h"
+#include "../git_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* File header: "CGPH", version, hash version, chunk count, base layer count */
+#define GRAPH_HEADER_SIZE 8
+#define GRAPH_SIGNATURE "CGPH"
+#define GRAPH_VERSION 1
+#define GRAPH_HASH_SHA1 1
+
+/* Chunk table entries: 4-byte id and 8-byte offset, plus a terminator */
+#define GRAPH_CHUNK_ENTRY_SIZE 12
+#define GRAPH_FANOUT_SIZE (256 * 4)
+
+/* CDAT entry: tree id, two parent words, generation and commit date */
+#define GRAPH_DATA_SIZE (OID_RAW_SIZE + 16)
+
+/* Parent word values */
+#define GRAPH_PARENT_NONE 0x70000000u
+#define GRAPH_EXTRA_EDGES 0x80000000u
+#define GRAPH_LAST_EDGE 0x80000000u
+
+/* Generation values that carry no ordering */
+#define GRAPH_GENERATION_ZERO 0u
+#define GRAPH_GENERATION_MAX 0x3FFFFFFFu
+
+/* Forward declarations */
+static int load_layer(CommitGraphFile *graph, const char *path);
+static int load_chain(CommitGraphFile *graph, const char *objects_dir);
+static const CommitGraphLayer* layer_of(const CommitGraphFile *graph, uint32_t position);
+static const unsigned char* commit_entry(const CommitGraphFile *graph, uint32_t position);
+static uint32_t generation_of(const CommitGraphFile *graph, uint32_t position);
+static uint32_t read_be32(const unsigned char *p);
+static uint64_t read_be64(const unsigned char *p);
+
+/**
+ * Open a repository's commit-graph
+ */
+int commit_graph_open(CommitGraphFile *graph, const char *objects_dir) {
+    assert(graph != NULL);
+    assert(objects_dir != NULL);
+
+    memset(graph, 0, sizeof(CommitGraphFile));
+
+    /* A single file takes precedence over a chain, as in git */
+    char path[MAX_PATH_LENGTH];
+    int ret = snprintf(path, sizeof(path), "%s/info/commit-graph", objects_dir);
+    if (ret < 0 || ret >= (int)sizeof(path)) {
+        return -1;
+    }
+    if (load_layer(graph, path) == 0) {
+        return 0;
+    }
+
+    load_chain(graph, objects_dir);
+    return (graph->layer_count > 0) ? 0 : -1;
+}
+
+/**
+ * Unmap the graph's files
+ */
+void commit_graph_close(CommitGraphFile *graph) {
+    assert(graph != NULL);
+
+    for (int i = 0; i < graph->layer_count; i++) {
+        object_file_unmap(graph->layers[i].data, graph->layers[i].size);
+    }
+    free(graph->layers);
+    memset(graph, 0, sizeof(CommitGraphFile));
+}
+
+/**
+ * Find a commit's position
+ */
+uint32_t commit_graph_find(const CommitGraphFile *graph, const ObjectId *oid) {
+    assert(graph != NULL);
+    assert(oid != NULL);
+
+    for (int i = graph->layer_count - 1; i >= 0; i--) {
+        const CommitGraphLayer *layer = &graph->layers[i];
+        unsigned first = oid->hash[0];
+        uint32_t low = (first == 0) ? 0 : read_be32(layer->fanout + (first - 1) * 4);
+        uint32_t high = read_be32(layer->fanout + first * 4);
+
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            int cmp = memcmp(layer->oids + (size_t)mid * OID_RAW_SIZE, oid->hash, OID_RAW_SIZE);
+            if (cmp == 0) return layer->base_count + mid;
+            if (cmp < 0) low = mid + 1;
+            else high = mid;
+        }
+    }
+    return COMMIT_GRAPH_NONE;
+}
+
+/**
+ * Object id of the commit at a position
+ */
+void commit_graph_oid(const CommitGraphFile *graph, uint32_t position, ObjectId *oid) {
+    assert(graph != NULL && oid != NULL);
+    assert(position < graph->commit_count);
+
+    const CommitGraphLayer *layer = layer_of(graph, position);
+    memcpy(oid->hash, layer->oids + (size_t)(position - layer->base_count) * OID_RAW_SIZE, OID_RAW_SIZE); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+}
+
+/**
+ * Parent positions of a commit
+ */
+int commit_graph_parents(const CommitGraphFile *graph, uint32_t position,
+                         uint32_t *parents, int max_parents) {
+    assert(graph != NULL && parents != NULL);
+    assert(position < graph->commit_count);
+
+    const CommitGraphLayer *layer = layer_of(graph, position);
+    const unsigned char *entry = commit_entry(graph, position);
+    uint32_t first = read_be32(entry + OID_RAW_SIZE);
+    uint32_t second = read_be32(entry + OID_RAW_SIZE + 4);
+
+    /* Parents live in the commit's own layer or below it */
+    uint32_t limit = layer->base_count + layer->commit_count;
+    int count = 0;
+
+    if (first != GRAPH_PARENT_NONE) {
+        if (first >= limit) return -1;
+        if (count < max_parents) parents[count++] = first;
+    }
+
+    if (second != GRAPH_PARENT_NONE && (second & GRAPH_EXTRA_EDGES)) {
+        /* Octopus merge: the rest are listed in EDGE up to a marked last entry */
+        uint32_t edge = second & ~GRAPH_EXTRA_EDGES;
+        for (;;) {
+            if (edge >= layer->edge_count) return -1;
+            uint32_t value = read_be32(layer->edges + (size_t)edge * 4);
+            uint32_t parent = value & ~GRAPH_LAST_EDGE;
+            if (parent >= limit) return -1;
+            if (count < max_parents) parents[count++] = parent;
+            if (value & GRAPH_LAST_EDGE) break;
+            edge++;
+        }
+    } else if (second != GRAPH_PARENT_NONE) {
+        if (second >= limit) return -1;
+        if (count < max_parents) parents[count++] = second;
+    }
+
+    /* Every parent must be strictly older in topological level */
+    uint32_t generation = generation_of(graph, position);
+    if (generation != GRAPH_GENERATION_ZERO && generation != GRAPH_GENERATION_MAX) {
+        for (int i = 0; i < count; i++) {
+            uint32_t parent_generation = generation_of(graph, parents[i]);
+            if (parent_generation != GRAPH_GENERATION_ZERO && parent_generation >= generation) {
+                return -1;
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Committer date of a commit
+ */
+long long commit_graph_commit_time(const CommitGraphFile *graph, uint32_t position) {
+    assert(graph != NULL);
+    assert(position < graph->commit_count);
+
+    /* Low 34 bits of the final 8 bytes */
+    uint64_t word = read_be64(commit_entry(graph, position) + OID_RAW_SIZE + 8);
+    return (long long)(word & 0x3FFFFFFFFULL);
+}
+
+/**
+ * Map and validate one commit-graph file, appending it as the next layer
+ * @return 0 on success, -1 if the file is missing or unusable
+ */
+static int load_layer(CommitGraphFile *graph, const char *path) {
+    if (graph->layer_count >= COMMIT_GRAPH_MAX_LAYERS) {
+        return -1;
+    }
+
+    size_t size;
+    const unsigned char *data = object_file_map(path, &size);
+    if (data == NULL) {
+        return -1;
+    }
+
+    CommitGraphLayer layer;
+    memset(&layer, 0, sizeof(layer));
+    layer.data = data;
+    layer.size = size;
+
+    /* Header, and a base count matching this layer's place in the chain */
+    int valid = (size >= GRAPH_HEADER_SIZE + GRAPH_CHUNK_ENTRY_SIZE + OID_RAW_SIZE &&
+                 memcmp(data, GRAPH_SIGNATURE, 4) == 0 && data[4] == GRAPH_VERSION &&
+                 data[5] == GRAPH_HASH_SHA1 && data[7] == graph->layer_count);
+    int chunk_count = valid ? data[6] : 0;
+    size_t table_end = GRAPH_HEADER_SIZE + (size_t)(chunk_count + 1) * GRAPH_CHUNK_ENTRY_SIZE;
+    size_t data_end = size - OID_RAW_SIZE; /* Trailing checksum */
+    if (table_end > data_end) {
+        valid = 0;
+    }
+
+    size_t oids_size = 0;
+    size_t commits_size = 0;
+    for (int i = 0; valid && i < chunk_count; i++) {
+        const unsigned char *entry = data + GRAPH_HEADER_SIZE + (size_t)i * GRAPH_CHUNK_ENTRY_SIZE;
+        uint64_t start = read_be64(entry + 4);
+        uint64_t end = read_be64(entry + GRAPH_CHUNK_ENTRY_SIZE + 4);
+        if (start < table_end || start > end || end > data_end) {
+            valid = 0;
+            break;
+        }
+
+        size_t chunk_size = (size_t)(end - start);
+        if (memcmp(entry, "OIDF", 4) == 0) {
+            if (chunk_size != GRAPH_FANOUT_SIZE) valid = 0;
+            layer.fanout = data + start;
+        } else if (memcmp(entry, "OIDL", 4) == 0) {
+            layer.oids = data + start;
+            oids_size = chunk_size;
+        } else if (memcmp(entry, "CDAT", 4) == 0) {
+            layer.commits = data + start;
+            commits_size = chunk_size;
+        } else if (memcmp(entry, "EDGE", 4) == 0) {
+            if (chunk_size % 4 != 0 || chunk_size / 4 > UINT32_MAX) valid = 0;
+            layer.edges = data + start;
+            layer.edge_count = (uint32_t)(chunk_size / 4);
+        }
+    }
+
+    if (valid && (layer.fanout == NULL || layer.oids == NULL || layer.commits == NULL)) {
+        valid = 0;
+    }
+
+    /* Fanout must be cumulative and agree with the table sizes */
+    for (int i = 1; valid && i < 256; i++) {
+        if (read_be32(layer.fanout + i * 4) < read_be32(layer.fanout + (i - 1) * 4)) {
+            valid = 0;
+        }
+    }
+    if (valid) {
+        layer.commit_count = read_be32(layer.fanout + 255 * 4);
+        if (oids_size != (size_t)layer.commit_count * OID_RAW_SIZE ||
+            commits_size != (size_t)layer.commit_count * GRAPH_DATA_SIZE ||
+            layer.commit_count > COMMIT_GRAPH_NONE - 1 - graph->commit_count) {
+            valid = 0;
+        }
+    }
+
+    if (!valid || VECTOR_RESERVE(graph->layers, graph->layer_capacity, graph->layer_count + 1) != 0) {
+        object_file_unmap(data, size);
+        return -1;
+    }
+
+    layer.base_count = graph->commit_count;
+    graph->layers[graph->layer_count++] = layer;
+    graph->commit_count += layer.commit_count;
+    return 0;
+}
+
+/**
+ * Load the layers listed in commit-graphs/commit-graph-chain, base first
+ * A layer that cannot be loaded ends the chain; the layers below it are
+ * complete on their own and stay usable.
+ */
+static int load_chain(CommitGraphFile *graph, const char *objects_dir) {
+    char path[MAX_PATH_LENGTH];
+    int ret = snprintf(path, sizeof(path), "%s/info/commit-graphs/commit-graph-chain", objects_dir);
+    if (ret < 0 || ret >= (int)sizeof(path)) {
+        return -1;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[MAX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        ObjectId oid;
+        if (oid_from_hex(line, &oid) != 0) {
+            break;
+        }
+
+        line[OID_HEX_SIZE] = '\0';
+        ret = snprintf(path, sizeof(path), "%s/info/commit-graphs/graph-%s.graph", objects_dir, line);
+        if (ret < 0 || ret >= (int)sizeof(path) || load_layer(graph, path) != 0) {
+            break;
+        }
+    }
+
+    fclose(file);
+    return (graph->layer_count > 0) ? 0 : -1;
+}
+
+/**
+ * Layer holding a position
+ */
+static const CommitGraphLayer* layer_of(const CommitGraphFile *graph, uint32_t position) {
+    int i = graph->layer_count - 1;
+    while (i > 0 && position < graph->layers[i].base_count) {
+        i--;
+    }
+    return &graph->layers[i];
+}
+
+/**
+ * CDAT entry of a position
+ */
+static const unsigned char* commit_entry(const CommitGraphFile *graph, uint32_t position) {
+    const CommitGraphLayer *layer = layer_of(graph, position);
+    return layer->commits + (size_t)(position - layer->base_count) * GRAPH_DATA_SIZE;
+}
+
+/**
+ * Topological level stored in the top 30 bits of the date word
+ */
+static uint32_t generation_of(const CommitGraphFile *graph, uint32_t position) {
+    return read_be32(commit_entry(graph, position) + OID_RAW_SIZE + 8) >> 2;
+}
+
+/**
+ * Read a big-endian 32-bit value
+ */
+static uint32_t read_be32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/**
+ * Read a big-endian 64-bit value
+ */
+static uint64_t read_be64(const unsigned char *p) {
+    return ((uint64_t)read_be32(p) << 32) | read_be32(p + 4);
+}
@@ -0,0 +1,97 @@
+#ifndef COMMIT_GRAPH_H
+#define COMMIT_GRAPH_H
+
+#include "object_store.h"
+#include <stdint.h>
+
+/* Position returned for commits the graph does not contain */
+#define COMMIT_GRAPH_NONE UINT32_MAX
+
+/* Most layers followed in a commit-graph chain */
+#define COMMIT_GRAPH_MAX_LAYERS 64
+
+/**
+ * One mapped commit-graph file
+ * Positions in a chain are global: a layer's commits follow the commits
+ * of all the layers below it.
+ */
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    uint32_t commit_count;
+    uint32_t base_count;            /* Commits in the layers below */
+    const unsigned char *fanout;    /* OIDF: 256 cumulative counts */
+    const unsigned char *oids;      /* OIDL: sorted object ids */
+    const unsigned char *commits;   /* CDAT: tree, parents, generation and date */
+    const unsigned char *edges;     /* EDGE: parents beyond the second, may be NULL */
+    uint32_t edge_count;
+} CommitGraphLayer;
+
+/**
+ * Commit-graph of a repository: objects/info/commit-graph, or the layers
+ * listed in objects/info/commit-graphs/commit-graph-chain
+ * The graph answers parent and date lookups without reading commit
+ * objects. It need not cover every commit: commits made since it was
+ * written are not in it, but every commit in it has its parents in it.
+ */
+typedef struct {
+    CommitGraphLayer *layers;       /* Base layer first */
+    int layer_count;
+    int layer_capacity;
+    uint32_t commit_count;
+} CommitGraphFile;
+
+/**
+ * Open a repository's commit-graph
+ * Files that are missing, use another hash or fail validation leave the
+ * graph empty, so lookups simply miss.
+ * @param graph Graph to initialize
+ * @param objects_dir Path to the objects directory
+ * @return 0 if a graph was loaded, -1 otherwise
+ */
+int commit_graph_open(CommitGraphFile *graph, const char *objects_dir);
+
+/**
+ * Unmap the graph's files
+ * @param graph Graph to close
+ */
+void commit_graph_close(CommitGraphFile *graph);
+
+/**
+ * Find a commit's position
+ * @param graph Open graph (may be empty)
+ * @param oid Commit to look up
+ * @return Position, or COMMIT_GRAPH_NONE if the commit is not in the graph
+ */
+uint32_t commit_graph_find(const CommitGraphFile *graph, const ObjectId *oid);
+
+/**
+ * Object id of the commit at a position
+ * @param graph Open graph
+ * @param position Position below graph->commit_count
+ * @param oid Receives the id
+ */
+void commit_graph_oid(const CommitGraphFile *graph, uint32_t position, ObjectId *oid);
+
+/**
+ * Parent positions of a commit
+ * Parents must sit at a lower generation (topological level) than the
+ * commit, so a damaged file cannot send a walk round a cycle.
+ * @param graph Open graph
+ * @param position Position below graph->commit_count
+ * @param parents Receives up to max_parents positions
+ * @param max_parents Capacity of parents
+ * @return Number of parents stored, or -1 if the entry is corrupt
+ */
+int commit_graph_parents(const CommitGraphFile *graph, uint32_t position,
+                         uint32_t *parents, int max_parents);
+
+/**
+ * Committer date of a commit
+ * @param graph Open graph
+ * @param position Position below graph->commit_count
+ * @return Seconds since the epoch
+ */
+long long commit_graph_commit_time(const CommitGraphFile *graph, uint32_t position);
+
+#endif /* COMMIT_GRAPH_H */
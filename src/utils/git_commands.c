@@ -1,36 +1,42 @@
 #define _GNU_SOURCE
 #include "git_commands.h"
+#include "line_count.h"
+#include "subprocess.h"
 #include "../git_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <limits.h>
+
+/* Forward declarations */
+static int keep_first_line(char *line, size_t length, void *ctx);
 
 /**
- * Execute a git command and return its output
- * Caller is responsible for freeing the returned string
+ * Keep the first record of a command's output
  */
-char* execute_git_command(const char* command) {
-    assert(command != NULL);
-
-    FILE *fp = popen(command, "r");
-    if (fp == NULL) {
-        return NULL;
+static int keep_first_line(char *line, size_t length, void *ctx) {
+    char **first = ctx;
+    if (*first == NULL) {
+        *first = strndup(line, length);
     }
+    return 0;
+}
 
-    char *result = malloc(MAX_LINE_LENGTH);
-    if (result == NULL) {
-        pclose(fp);
-        return NULL;
-    }
+/**
+ * Execute a git command and return the first line of its output
+ * Caller is responsible for freeing the returned string
+ */
+char* execute_git_command(const char *const argv[]) {
+    assert(argv != NULL && argv[0] != NULL);
 
-    if (fgets(result, MAX_LINE_LENGTH, fp) != NULL) {
-        pclose(fp);
-        return result;
+    /* Read to the end so the exit status reflects the whole command */
+    char *first = NULL;
+    if (subprocess_stream(argv, NULL, 0, '\n', keep_first_line, &first) != 0 || first == NULL) {
+        free(first);
+        return NULL;
     }
-
-    pclose(fp);
-    free(result);
-    return NULL;
+    return first;
 }
 
 /**
@@ -40,25 +46,9 @@ char* execute_git_command(const char* command) {
 int count_lines_in_file(const char* filename) {
     assert(filename != NULL);
 
-    FILE *file = fopen(filename, "r");
-    if (file == NULL) {
+    long lines = count_file_lines(filename);
+    if (lines < 0) {
         return -1;
     }
-
-    int lines = 0;
-    int ch;
-
-    while ((ch = fgetc(file)) != EOF) {
-        if (ch == '\n') {
-            lines++;
-        }
-    }
-
-    if (ferror(file)) {
-        fclose(file);
-        return -1;
-    }
-
-    fclose(file);
-    return lines;
+    return (lines > INT_MAX) ? INT_MAX : (int)lines;
 }
\ No newline at end of file
@@ -2,12 +2,14 @@
 #define GIT_COMMANDS_H
 
 /**
- * Execute a git command and return its output
+ * Execute a git command and return the first line of its output
+ * The command runs without a shell, so arguments need no quoting.
  * Caller is responsible for freeing the returned string
- * @param command Git command to execute
- * @return Allocated string with command output, or NULL on error
+ * @param argv NULL-terminated argument vector, starting with "git"
+ * @return Allocated first line without its newline, or NULL if the
+ *         command failed
  */
-char* execute_git_command(const char* command);
+char* execute_git_command(const char *const argv[]);
 
 /**
  * Count lines in a file
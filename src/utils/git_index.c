@@ -0,0 +1,263 @@
+#define _GNU_SOURCE
+#include "git_index.h"
+#include "object_store.h"
+#include "../git_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* File header: "DIRC", version, entry count */
+#define INDEX_HEADER_SIZE 12
+#define INDEX_SIGNATURE "DIRC"
+#define INDEX_MIN_VERSION 2
+#define INDEX_MAX_VERSION 4
+
+/* Entry: ten 32-bit stat words, object id and 16-bit flags */
+#define INDEX_STAT_SIZE 40
+#define INDEX_MODE_OFFSET 24
+#define INDEX_SIZE_OFFSET 36
+#define INDEX_ENTRY_FIXED_SIZE (INDEX_STAT_SIZE + OID_RAW_SIZE + 2)
+
+/* Flag bits */
+#define INDEX_FLAG_EXTENDED 0x4000
+#define INDEX_FLAG_STAGE_SHIFT 12
+#define INDEX_FLAG_NAME_MASK 0x0FFF
+
+/* Extension header: 4-byte signature and 32-bit size */
+#define INDEX_EXTENSION_HEADER_SIZE 8
+
+/* Directory entries of a sparse index */
+#define INDEX_MODE_TYPE_MASK 0170000
+#define INDEX_MODE_DIRECTORY 0040000
+
+/**
+ * Position of a walk through the mapped index
+ */
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;   /* Start of the trailing checksum */
+    uint32_t version;
+    char *path;                 /* Path of the current entry */
+    size_t path_length;
+    size_t path_capacity;
+    char *conflict;             /* Last path seen with a merge stage, or NULL */
+} IndexCursor;
+
+/* Forward declarations */
+static int walk_entries(IndexCursor *cursor, uint32_t count, GitIndexCallback callback, void *ctx);
+static int read_entry_path(IndexCursor *cursor, uint16_t flags);
+static int skip_extensions(IndexCursor *cursor);
+static int read_varint(IndexCursor *cursor, size_t *value);
+static uint32_t read_be32(const unsigned char *p);
+
+/**
+ * Read the entries of a repository's index without running git
+ * The first walk validates every entry and the extensions that follow,
+ * the second reports the entries.
+ */
+int git_index_read(const char *git_dir, GitIndexCallback callback, void *ctx) {
+    assert(git_dir != NULL);
+    assert(callback != NULL);
+
+    char path[MAX_PATH_LENGTH];
+    const char *index_file = getenv("GIT_INDEX_FILE");
+    if (index_file == NULL || index_file[0] == '\0') {
+        int ret = snprintf(path, sizeof(path), "%s/index", git_dir);
+        if (ret < 0 || ret >= (int)sizeof(path)) {
+            return -1;
+        }
+        index_file = path;
+    }
+
+    size_t size;
+    const unsigned char *data = object_file_map(index_file, &size);
+    if (data == NULL) {
+        return -1;
+    }
+
+    /* The header and trailing checksum must fit before anything is read */
+    int result = -1;
+    uint32_t version = 0;
+    if (size >= INDEX_HEADER_SIZE + OID_RAW_SIZE && memcmp(data, INDEX_SIGNATURE, 4) == 0) {
+        version = read_be32(data + 4);
+    }
+    if (version >= INDEX_MIN_VERSION && version <= INDEX_MAX_VERSION) {
+        uint32_t count = read_be32(data + 8);
+        IndexCursor cursor = {data + INDEX_HEADER_SIZE, data + size - OID_RAW_SIZE, version, NULL, 0, 0, NULL};
+
+        if (walk_entries(&cursor, count, NULL, NULL) == 0 && skip_extensions(&cursor) == 0) {
+            cursor.p = data + INDEX_HEADER_SIZE;
+            cursor.path_length = 0;
+            free(cursor.conflict);
+            cursor.conflict = NULL;
+            result = walk_entries(&cursor, count, callback, ctx);
+        }
+        free(cursor.path);
+        free(cursor.conflict);
+    }
+
+    object_file_unmap(data, size);
+    return result;
+}
+
+/**
+ * Walk the entries, reporting them when a callback is given
+ * @return 0 when all were read, 1 if the callback stopped, -1 if damaged
+ */
+static int walk_entries(IndexCursor *cursor, uint32_t count, GitIndexCallback callback, void *ctx) {
+    for (uint32_t i = 0; i < count; i++) {
+        const unsigned char *entry = cursor->p;
+        if ((size_t)(cursor->end - entry) < INDEX_ENTRY_FIXED_SIZE) {
+            return -1;
+        }
+
+        uint32_t mode = read_be32(entry + INDEX_MODE_OFFSET);
+        uint32_t size = read_be32(entry + INDEX_SIZE_OFFSET);
+        uint16_t flags = (uint16_t)((entry[INDEX_STAT_SIZE + OID_RAW_SIZE] << 8) |
+                                    entry[INDEX_STAT_SIZE + OID_RAW_SIZE + 1]);
+        cursor->p += INDEX_ENTRY_FIXED_SIZE;
+        if (flags & INDEX_FLAG_EXTENDED) {
+            if (cursor->version < 3 || cursor->end - cursor->p < 2) {
+                return -1;
+            }
+            cursor->p += 2;
+        }
+
+        /* Only an index that lists every file can stand in for ls-files */
+        if ((mode & INDEX_MODE_TYPE_MASK) == INDEX_MODE_DIRECTORY) {
+            return -1;
+        }
+
+        if (read_entry_path(cursor, flags) != 0) {
+            return -1;
+        }
+
+        /* Versions 2 and 3 end the path with 1 to 8 NULs, to a multiple of 8 bytes */
+        if (cursor->version < 4) {
+            size_t length = (size_t)(cursor->p - entry) - 1;
+            size_t padded = (length + 8) & ~(size_t)7;
+            if ((size_t)(cursor->end - entry) < padded) {
+                return -1;
+            }
+            cursor->p = entry + padded;
+        }
+
+        /* The merge stages of a conflicted path follow each other: report the first */
+        int stage = (flags >> INDEX_FLAG_STAGE_SHIFT) & 3;
+        if (stage > 0) {
+            if (cursor->conflict != NULL && strcmp(cursor->conflict, cursor->path) == 0) {
+                continue;
+            }
+            free(cursor->conflict);
+            cursor->conflict = strdup(cursor->path);
+            if (cursor->conflict == NULL) {
+                return -1;
+            }
+        }
+        if (callback != NULL && callback(cursor->path, mode, size, ctx) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Read the path of an entry into the cursor's path buffer
+ * Version 4 paths drop a number of bytes from the end of the previous
+ * path and append the rest; earlier versions store the path whole.
+ */
+static int read_entry_path(IndexCursor *cursor, uint16_t flags) {
+    size_t keep = 0;
+    if (cursor->version >= 4) {
+        size_t strip;
+        if (read_varint(cursor, &strip) != 0 || strip > cursor->path_length) {
+            return -1;
+        }
+        keep = cursor->path_length - strip;
+    }
+
+    const unsigned char *name = cursor->p;
+    const unsigned char *nul = memchr(name, '\0', (size_t)(cursor->end - name));
+    if (nul == NULL) {
+        return -1;
+    }
+    size_t suffix = (size_t)(nul - name);
+    size_t length = keep + suffix;
+
+    /* Names shorter than the mask must match the recorded length */
+    size_t recorded = flags & INDEX_FLAG_NAME_MASK;
+    if (length == 0 || (recorded < INDEX_FLAG_NAME_MASK && recorded != length) ||
+        (recorded == INDEX_FLAG_NAME_MASK && length < INDEX_FLAG_NAME_MASK)) {
+        return -1;
+    }
+
+    if (length + 1 > cursor->path_capacity) {
+        size_t capacity = (cursor->path_capacity > 0) ? cursor->path_capacity : 256;
+        while (capacity < length + 1) capacity *= 2;
+        char *grown = realloc(cursor->path, capacity);
+        if (grown == NULL) {
+            return -1;
+        }
+        cursor->path = grown;
+        cursor->path_capacity = capacity;
+    }
+
+    memcpy(cursor->path + keep, name, suffix + 1); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    cursor->path_length = length;
+    cursor->p = nul + 1;
+    return 0;
+}
+
+/**
+ * Check that the extensions end exactly at the trailing checksum
+ * A split index ("link") keeps its entries in a shared file and is
+ * refused.
+ */
+static int skip_extensions(IndexCursor *cursor) {
+    while (cursor->p < cursor->end) {
+        if ((size_t)(cursor->end - cursor->p) < INDEX_EXTENSION_HEADER_SIZE) {
+            return -1;
+        }
+        if (memcmp(cursor->p, "link", 4) == 0) {
+            return -1;
+        }
+        uint32_t size = read_be32(cursor->p + 4);
+        cursor->p += INDEX_EXTENSION_HEADER_SIZE;
+        if ((size_t)(cursor->end - cursor->p) < size) {
+            return -1;
+        }
+        cursor->p += size;
+    }
+    return 0;
+}
+
+/**
+ * Read git's variable-length integer (7 bits per byte, most significant
+ * first, each continuation adding one)
+ */
+static int read_varint(IndexCursor *cursor, size_t *value) {
+    if (cursor->p >= cursor->end) {
+        return -1;
+    }
+
+    unsigned char c = *cursor->p++;
+    size_t result = c & 0x7F;
+    while (c & 0x80) {
+        if (cursor->p >= cursor->end || result > (SIZE_MAX >> 7) - 1) {
+            return -1;
+        }
+        c = *cursor->p++;
+        result = ((result + 1) << 7) | (c & 0x7F);
+    }
+
+    *value = result;
+    return 0;
+}
+
+/**
+ * Read a big-endian 32-bit value
+ */
+static uint32_t read_be32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
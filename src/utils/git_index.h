@@ -0,0 +1,36 @@
+#ifndef GIT_INDEX_H
+#define GIT_INDEX_H
+
+#include <stdint.h>
+
+/* Mode of a submodule entry (gitlink) */
+#define GIT_INDEX_MODE_GITLINK 0160000
+
+/**
+ * Receives one entry of the index
+ * @param path Path relative to the top of the work tree
+ * @param mode File mode recorded for the entry
+ * @param size Size of the work tree file when git last checked it
+ *             (modulo 2^32); 0 when git has not recorded it
+ * @param ctx Caller context
+ * @return 0 to continue, non-zero to stop reading
+ */
+typedef int (*GitIndexCallback)(const char *path, uint32_t mode, uint32_t size, void *ctx);
+
+/**
+ * Read the entries of a repository's index (.git/index, or the file
+ * named by GIT_INDEX_FILE) without running git
+ * Versions 2 to 4 with SHA-1 object names are understood. The whole file
+ * is validated before the first entry is reported, and indexes whose
+ * entries live elsewhere (split or sparse indexes) are refused, so a
+ * failure leaves the caller free to fall back to `git ls-files`. Each
+ * path is reported once, even when it has several merge stages.
+ * @param git_dir Path to the git directory
+ * @param callback Entry callback
+ * @param ctx Context passed to the callback
+ * @return 0 on success, 1 if the callback stopped the walk, -1 if the
+ *         index is missing, unsupported or damaged
+ */
+int git_index_read(const char *git_dir, GitIndexCallback callback, void *ctx);
+
+#endif /* GIT_INDEX_H */
@@ -0,0 +1,476 @@
+#define _GNU_SOURCE
+#include "git_repo.h"
+#include "string_utils.h"
+#include "vector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/**
+ * Reference list under construction
+ */
+typedef struct {
+    GitRef *refs;
+    int count;
+    int capacity;
+} RefList;
+
+/* Forward declarations */
+static int read_first_line(const char *path, char *line, size_t line_size);
+static int is_directory(const char *path);
+static int is_regular_file(const char *path);
+static int config_is_supported(const char *common_dir);
+static void load_shallow(GitRepository *repo);
+static int add_ref(RefList *list, const char *name, const ObjectId *oid);
+static int load_packed_refs(const GitRepository *repo, RefList *list);
+static int load_loose_refs(const char *dir_path, const char *name_prefix, RefList *list);
+static int compare_refs_by_name(const void *a, const void *b);
+static int merge_ref_runs(RefList *list, int packed_count);
+
+/**
+ * Locate the git directory for the current working directory
+ */
+int git_repository_discover(char *git_dir, size_t git_dir_size) {
+    assert(git_dir != NULL);
+    assert(git_dir_size > 0);
+
+    if (is_directory(".git")) {
+        safe_string_copy(git_dir, ".git", git_dir_size);
+        return 0;
+    }
+
+    /* Worktrees and submodules use a "gitdir: <path>" file */
+    if (is_regular_file(".git")) {
+        char line[MAX_PATH_LENGTH];
+        if (read_first_line(".git", line, sizeof(line)) == 0 &&
+            strncmp(line, "gitdir: ", 8) == 0 && is_directory(line + 8)) {
+            safe_string_copy(git_dir, line + 8, git_dir_size);
+            return 0;
+        }
+        return -1;
+    }
+
+    /* Bare repository */
+    if (is_regular_file("HEAD") && is_directory("objects") && is_directory("refs")) {
+        safe_string_copy(git_dir, ".", git_dir_size);
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Open the repository in the current working directory
+ */
+int git_repository_open(GitRepository *repo) {
+    assert(repo != NULL);
+
+    memset(repo, 0, sizeof(GitRepository));
+
+    if (git_repository_discover(repo->git_dir, sizeof(repo->git_dir)) != 0) {
+        return -1;
+    }
+
+    /* Linked worktrees keep objects and refs in the common directory */
+    char path[MAX_PATH_LENGTH];
+    char line[MAX_PATH_LENGTH];
+    int ret = snprintf(path, sizeof(path), "%s/commondir", repo->git_dir);
+    if (ret > 0 && ret < (int)sizeof(path) && read_first_line(path, line, sizeof(line)) == 0) {
+        if (line[0] == '/') {
+            ret = snprintf(repo->common_dir, sizeof(repo->common_dir), "%s", line);
+        } else {
+            ret = snprintf(repo->common_dir, sizeof(repo->common_dir), "%s/%s", repo->git_dir, line);
+        }
+        if (ret < 0 || ret >= (int)sizeof(repo->common_dir)) return -1;
+    } else {
+        safe_string_copy(repo->common_dir, repo->git_dir, sizeof(repo->common_dir));
+    }
+
+    if (!config_is_supported(repo->common_dir)) {
+        return -1;
+    }
+
+    ret = snprintf(path, sizeof(path), "%s/objects", repo->common_dir);
+    if (ret < 0 || ret >= (int)sizeof(path) || object_store_open(&repo->objects, path) != 0) {
+        return -1;
+    }
+
+    if (oid_set_init(&repo->shallow) != 0) {
+        object_store_close(&repo->objects);
+        return -1;
+    }
+    load_shallow(repo);
+
+    /* git writes no commit-graph for shallow clones and ignores one there */
+    if (repo->shallow.count == 0) {
+        commit_graph_open(&repo->graph, path);
+    }
+
+    return 0;
+}
+
+/**
+ * Release a repository opened with git_repository_open()
+ */
+void git_repository_close(GitRepository *repo) {
+    assert(repo != NULL);
+
+    object_store_close(&repo->objects);
+    oid_set_free(&repo->shallow);
+    commit_graph_close(&repo->graph);
+}
+
+/**
+ * Read the branch HEAD points to
+ */
+int git_repository_current_branch(const GitRepository *repo, char *branch, size_t branch_size) {
+    assert(repo != NULL);
+    assert(branch != NULL);
+
+    char path[MAX_PATH_LENGTH];
+    char line[MAX_PATH_LENGTH];
+    int ret = snprintf(path, sizeof(path), "%s/HEAD", repo->git_dir);
+    if (ret < 0 || ret >= (int)sizeof(path) || read_first_line(path, line, sizeof(line)) != 0) {
+        return -1;
+    }
+
+    const char *prefix = "ref: refs/heads/";
+    if (strncmp(line, prefix, strlen(prefix)) != 0) {
+        return -1; /* Detached HEAD */
+    }
+
+    safe_string_copy(branch, line + strlen(prefix), branch_size);
+    return 0;
+}
+
+/**
+ * List loose and packed references below a prefix, sorted by name
+ */
+int git_repository_list_refs(const GitRepository *repo, const char *prefix, int include_head,
+                             GitRef **refs, int *count) {
+    assert(repo != NULL);
+    assert(prefix != NULL);
+    assert(refs != NULL && count != NULL);
+
+    RefList list = { NULL, 0, 0 };
+
+    /* Packed refs first; loose refs added later take precedence */
+    if (load_packed_refs(repo, &list) != 0) {
+        git_refs_free(list.refs, list.count);
+        return -1;
+    }
+    int packed_count = list.count;
+
+    char refs_dir[MAX_PATH_LENGTH];
+    int ret = snprintf(refs_dir, sizeof(refs_dir), "%s/refs", repo->common_dir);
+    if (ret < 0 || ret >= (int)sizeof(refs_dir) || load_loose_refs(refs_dir, "refs/", &list) != 0) {
+        git_refs_free(list.refs, list.count);
+        return -1;
+    }
+
+    /* Merge the two sorted runs; a loose ref shadows a packed one of the same name */
+    if (merge_ref_runs(&list, packed_count) != 0) {
+        git_refs_free(list.refs, list.count);
+        return -1;
+    }
+
+    /* Keep only references below the prefix */
+    size_t prefix_length = strlen(prefix);
+    int kept = 0;
+    for (int i = 0; i < list.count; i++) {
+        if (strncmp(list.refs[i].name, prefix, prefix_length) == 0) {
+            list.refs[kept++] = list.refs[i];
+        } else {
+            free(list.refs[i].name);
+        }
+    }
+    list.count = kept;
+
+    /* A detached HEAD is not reachable from any ref, so list it explicitly */
+    if (include_head) {
+        char path[MAX_PATH_LENGTH];
+        char line[MAX_PATH_LENGTH];
+        ObjectId head;
+        ret = snprintf(path, sizeof(path), "%s/HEAD", repo->git_dir);
+        if (ret > 0 && ret < (int)sizeof(path) &&
+            read_first_line(path, line, sizeof(line)) == 0 &&
+            oid_from_hex(line, &head) == 0) {
+            add_ref(&list, "HEAD", &head);
+        }
+    }
+
+    *refs = list.refs;
+    *count = list.count;
+    return 0;
+}
+
+/**
+ * Release a reference list
+ */
+void git_refs_free(GitRef *refs, int count) {
+    for (int i = 0; i < count; i++) {
+        free(refs[i].name);
+    }
+    free(refs);
+}
+
+/**
+ * Compare two sorted reference lists by name and target
+ */
+int git_refs_equal(const GitRef *a, int a_count, const GitRef *b, int b_count) {
+    if (a_count != b_count) return 0;
+
+    for (int i = 0; i < a_count; i++) {
+        if (strcmp(a[i].name, b[i].name) != 0 ||
+            memcmp(a[i].oid.hash, b[i].oid.hash, OID_RAW_SIZE) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Read the first line of a small text file without its newline
+ */
+static int read_first_line(const char *path, char *line, size_t line_size) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    int result = (fgets(line, (int)line_size, file) != NULL) ? 0 : -1;
+    fclose(file);
+
+    if (result == 0) {
+        line[strcspn(line, "\r\n")] = '\0';
+    }
+    return result;
+}
+
+/**
+ * Check whether a path is a directory
+ */
+static int is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/**
+ * Check whether a path is a regular file
+ */
+static int is_regular_file(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/**
+ * Reject repository extensions the in-process reader cannot handle
+ */
+static int config_is_supported(const char *common_dir) {
+    char path[MAX_PATH_LENGTH];
+    int ret = snprintf(path, sizeof(path), "%s/config", common_dir);
+    if (ret < 0 || ret >= (int)sizeof(path)) return 0;
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return 1; /* No config means default format */
+    }
+
+    char line[MAX_LINE_LENGTH];
+    int supported = 1;
+    while (supported && fgets(line, sizeof(line), file) != NULL) {
+        for (char *p = line; *p != '\0'; p++) {
+            *p = (char)tolower((unsigned char)*p);
+        }
+        /* SHA-256 object names and reftable ref storage */
+        if ((strstr(line, "objectformat") != NULL && strstr(line, "sha256") != NULL) ||
+            (strstr(line, "refstorage") != NULL && strstr(line, "reftable") != NULL)) {
+            supported = 0;
+        }
+    }
+
+    fclose(file);
+    return supported;
+}
+
+/**
+ * Load the list of shallow commits, if any
+ */
+static void load_shallow(GitRepository *repo) {
+    char path[MAX_PATH_LENGTH];
+    int ret = snprintf(path, sizeof(path), "%s/shallow", repo->common_dir);
+    if (ret < 0 || ret >= (int)sizeof(path)) return;
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return;
+
+    char line[MAX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        ObjectId oid;
+        if (oid_from_hex(line, &oid) == 0) {
+            oid_set_insert(&repo->shallow, &oid);
+        }
+    }
+
+    fclose(file);
+}
+
+/**
+ * Append a reference to the list
+ */
+static int add_ref(RefList *list, const char *name, const ObjectId *oid) {
+    if (VECTOR_RESERVE(list->refs, list->capacity, list->count + 1) != 0) {
+        return -1;
+    }
+
+    char *copy = strdup(name);
+    if (copy == NULL) {
+        return -1;
+    }
+
+    list->refs[list->count].name = copy;
+    list->refs[list->count].oid = *oid;
+    list->count++;
+    return 0;
+}
+
+/**
+ * Parse packed-refs ("<hex> <name>" lines; "^<hex>" peel lines are skipped)
+ */
+static int load_packed_refs(const GitRepository *repo, RefList *list) {
+    char path[MAX_PATH_LENGTH];
+    int ret = snprintf(path, sizeof(path), "%s/packed-refs", repo->common_dir);
+    if (ret < 0 || ret >= (int)sizeof(path)) return -1;
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return 0; /* Nothing packed */
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    int result = 0;
+
+    while (getline(&line, &line_size, file) != -1) {
+        remove_trailing_newline(line);
+        if (line[0] == '#' || line[0] == '^') continue;
+
+        ObjectId oid;
+        if (strlen(line) < OID_HEX_SIZE + 2 || line[OID_HEX_SIZE] != ' ' ||
+            oid_from_hex(line, &oid) != 0) {
+            continue;
+        }
+
+        if (add_ref(list, line + OID_HEX_SIZE + 1, &oid) != 0) {
+            result = -1;
+            break;
+        }
+    }
+
+    free(line);
+    fclose(file);
+    return result;
+}
+
+/**
+ * Recursively collect loose refs; symbolic refs are skipped because
+ * their targets are listed in their own right
+ */
+static int load_loose_refs(const char *dir_path, const char *name_prefix, RefList *list) {
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    const struct dirent *entry;
+    int result = 0;
+
+    while (result == 0 && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char path[MAX_PATH_LENGTH];
+        char name[MAX_PATH_LENGTH];
+        int path_ret = snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        int name_ret = snprintf(name, sizeof(name), "%s%s", name_prefix, entry->d_name);
+        if (path_ret < 0 || path_ret >= (int)sizeof(path) ||
+            name_ret < 0 || name_ret >= (int)sizeof(name) - 1) {
+            continue;
+        }
+
+        if (is_directory(path)) {
+            strcat(name, "/"); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+            result = load_loose_refs(path, name, list);
+            continue;
+        }
+
+        char line[MAX_LINE_LENGTH];
+        ObjectId oid;
+        if (read_first_line(path, line, sizeof(line)) == 0 && oid_from_hex(line, &oid) == 0) {
+            result = add_ref(list, name, &oid);
+        }
+    }
+
+    closedir(dir);
+    return result;
+}
+
+/**
+ * Comparison function for sorting references by name
+ */
+static int compare_refs_by_name(const void *a, const void *b) {
+    const GitRef *ref_a = (const GitRef *)a;
+    const GitRef *ref_b = (const GitRef *)b;
+    return strcmp(ref_a->name, ref_b->name);
+}
+
+/**
+ * Merge refs[0..packed_count) and refs[packed_count..count) by name,
+ * letting loose refs replace packed refs with the same name
+ */
+static int merge_ref_runs(RefList *list, int packed_count) {
+    int loose_count = list->count - packed_count;
+    if (list->count == 0) {
+        return 0;
+    }
+
+    if (packed_count > 0) {
+        qsort(list->refs, packed_count, sizeof(GitRef), compare_refs_by_name);
+    }
+    if (loose_count > 0) {
+        qsort(list->refs + packed_count, loose_count, sizeof(GitRef), compare_refs_by_name);
+    }
+
+    GitRef *merged = malloc(sizeof(GitRef) * (size_t)list->count);
+    if (merged == NULL) {
+        return -1;
+    }
+
+    int i = 0, j = packed_count, count = 0;
+    while (i < packed_count || j < list->count) {
+        if (j >= list->count) {
+            merged[count++] = list->refs[i++];
+        } else if (i >= packed_count) {
+            merged[count++] = list->refs[j++];
+        } else {
+            int cmp = strcmp(list->refs[i].name, list->refs[j].name);
+            if (cmp < 0) {
+                merged[count++] = list->refs[i++];
+            } else {
+                if (cmp == 0) {
+                    free(list->refs[i++].name);
+                }
+                merged[count++] = list->refs[j++];
+            }
+        }
+    }
+
+    free(list->refs);
+    list->refs = merged;
+    list->count = count;
+    list->capacity = list->count;
+    return 0;
+}
\ No newline at end of file
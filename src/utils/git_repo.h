@@ -0,0 +1,94 @@
+#ifndef GIT_REPO_H
+#define GIT_REPO_H
+
+#include "object_store.h"
+#include "commit_graph.h"
+#include "../git_stats.h"
+
+/**
+ * Reference name and the object it points to
+ */
+typedef struct {
+    char *name;         /* Full name, e.g. "refs/heads/main" */
+    ObjectId oid;
+} GitRef;
+
+/**
+ * Repository opened for in-process reading
+ * git_dir holds HEAD; common_dir holds objects and refs (they differ for
+ * linked worktrees).
+ */
+typedef struct {
+    char git_dir[MAX_PATH_LENGTH];
+    char common_dir[MAX_PATH_LENGTH];
+    ObjectStore objects;
+    ObjectIdSet shallow;    /* Commits whose parents are absent (shallow clones) */
+    CommitGraphFile graph;  /* Empty when there is none or the clone is shallow */
+} GitRepository;
+
+/**
+ * Locate the git directory for the current working directory
+ * Accepts a .git directory, a .git file (worktrees, submodules) or a bare
+ * repository in the current directory.
+ * @param git_dir Output buffer for the git directory path
+ * @param git_dir_size Size of the output buffer
+ * @return 0 on success, -1 if no repository was found
+ */
+int git_repository_discover(char *git_dir, size_t git_dir_size);
+
+/**
+ * Open the repository in the current working directory
+ * Fails for repository formats the reader does not understand (for
+ * example SHA-256 object names), so callers can fall back to the git CLI.
+ * @param repo Repository to initialize
+ * @return 0 on success, -1 on error
+ */
+int git_repository_open(GitRepository *repo);
+
+/**
+ * Release a repository opened with git_repository_open()
+ * @param repo Repository to close
+ */
+void git_repository_close(GitRepository *repo);
+
+/**
+ * Read the branch HEAD points to
+ * @param repo Repository to inspect
+ * @param branch Output buffer for the short branch name
+ * @param branch_size Size of the output buffer
+ * @return 0 on success, -1 if HEAD is detached or unreadable
+ */
+int git_repository_current_branch(const GitRepository *repo, char *branch, size_t branch_size);
+
+/**
+ * List loose and packed references below a prefix, sorted by name
+ * Pass "refs/" together with include_head for the equivalent of --all.
+ * Caller is responsible for releasing the list with git_refs_free().
+ * @param repo Repository to inspect
+ * @param prefix Reference name prefix, e.g. "refs/heads/"
+ * @param include_head Non-zero to append HEAD when it is detached
+ * @param refs Receives the allocated reference array
+ * @param count Receives the number of references
+ * @return 0 on success, -1 on error
+ */
+int git_repository_list_refs(const GitRepository *repo, const char *prefix, int include_head,
+                             GitRef **refs, int *count);
+
+/**
+ * Release a reference list
+ * @param refs Reference array
+ * @param count Number of references
+ */
+void git_refs_free(GitRef *refs, int count);
+
+/**
+ * Compare two reference lists sorted by name
+ * @param a First list
+ * @param a_count Entries in a
+ * @param b Second list
+ * @param b_count Entries in b
+ * @return 1 if both name the same references with the same targets, 0 otherwise
+ */
+int git_refs_equal(const GitRef *a, int a_count, const GitRef *b, int b_count);
+
+#endif /* GIT_REPO_H */
@@ -0,0 +1,240 @@
+#include "hash_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define HASH_MAP_DEFAULT_CAPACITY 64
+#define HASH_MAP_KEY_BLOCK_SIZE 16384
+
+/* Grow when count / capacity would exceed 7/10 */
+#define HASH_MAP_LOAD_NUMERATOR 7
+#define HASH_MAP_LOAD_DENOMINATOR 10
+
+/* Forward declarations */
+static HashMapSlot* find_slot(HashMap *map, const char *key, uint64_t hash);
+static int grow_slots(HashMap *map);
+static const char* intern_key(HashMap *map, const char *key);
+
+/**
+ * Initialize an empty map
+ */
+int hash_map_init(HashMap *map, size_t initial_capacity) {
+    assert(map != NULL);
+
+    memset(map, 0, sizeof(HashMap));
+
+    /* Size the table so the expected keys fit under the load limit */
+    size_t wanted = initial_capacity * HASH_MAP_LOAD_DENOMINATOR / HASH_MAP_LOAD_NUMERATOR + 1;
+    size_t capacity = HASH_MAP_DEFAULT_CAPACITY;
+    while (capacity < wanted) {
+        capacity *= 2;
+    }
+
+    map->slots = calloc(capacity, sizeof(HashMapSlot));
+    if (map->slots == NULL) {
+        return -1;
+    }
+    map->capacity = capacity;
+
+    return 0;
+}
+
+/**
+ * Release all slots and interned keys
+ */
+void hash_map_free(HashMap *map) {
+    assert(map != NULL);
+
+    HashMapKeyBlock *block = map->key_blocks;
+    while (block != NULL) {
+        HashMapKeyBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(map->slots);
+    memset(map, 0, sizeof(HashMap));
+}
+
+/**
+ * Look up a key, inserting it with the given value when absent
+ */
+int* hash_map_upsert(HashMap *map, const char *key, int value, int *inserted) {
+    assert(map != NULL);
+    assert(key != NULL);
+
+    uint64_t hash = hash_map_hash(key);
+    HashMapSlot *slot = find_slot(map, key, hash);
+
+    if (slot->key != NULL) {
+        if (inserted != NULL) *inserted = 0;
+        return &slot->value;
+    }
+
+    /* Grow before inserting and re-probe in the new table */
+    if ((map->count + 1) * HASH_MAP_LOAD_DENOMINATOR > map->capacity * HASH_MAP_LOAD_NUMERATOR) {
+        if (grow_slots(map) != 0) {
+            return NULL;
+        }
+        slot = find_slot(map, key, hash);
+    }
+
+    const char *interned = intern_key(map, key);
+    if (interned == NULL) {
+        return NULL;
+    }
+
+    slot->key = interned;
+    slot->hash = hash;
+    slot->value = value;
+    map->count++;
+
+    if (inserted != NULL) *inserted = 1;
+    return &slot->value;
+}
+
+/**
+ * Look up a key without inserting
+ */
+int* hash_map_find(HashMap *map, const char *key) {
+    assert(map != NULL);
+    assert(key != NULL);
+
+    HashMapSlot *slot = find_slot(map, key, hash_map_hash(key));
+    return (slot->key != NULL) ? &slot->value : NULL;
+}
+
+/**
+ * Interned copy of the key stored with a value
+ */
+const char* hash_map_key_of(const int *value) {
+    assert(value != NULL);
+
+    const HashMapSlot *slot = (const HashMapSlot *)(const void *)
+                                  ((const char *)value - offsetof(HashMapSlot, value));
+    return slot->key;
+}
+
+/**
+ * Print load factor and probe statistics to stderr
+ */
+void hash_map_debug_report(const HashMap *map, const char *label) {
+    assert(map != NULL);
+    assert(label != NULL);
+
+#ifdef DEBUG
+    double load = (map->capacity > 0) ? (double)map->count / (double)map->capacity : 0.0;
+    double average_probe = (map->lookups > 0) ? (double)map->probes / (double)map->lookups : 0.0;
+
+    fprintf(stderr, "[hash_map] %s: %zu keys, %zu slots, load %.2f, "
+            "%zu lookups, avg probe %.2f, max probe %zu\n",
+            label, map->count, map->capacity, load,
+            map->lookups, average_probe, map->max_probe);
+#endif
+}
+
+/**
+ * FNV-1a 64-bit string hash
+ */
+uint64_t hash_map_hash(const char *key) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (const unsigned char *p = (const unsigned char *)key; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * Spread a hash over all 64 bits
+ */
+uint64_t hash_map_mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * Find the slot holding key, or the empty slot where it belongs
+ */
+static HashMapSlot* find_slot(HashMap *map, const char *key, uint64_t hash) {
+    size_t mask = map->capacity - 1;
+    size_t index = (size_t)hash & mask;
+    size_t probe = 1;
+
+    while (map->slots[index].key != NULL) {
+        if (map->slots[index].hash == hash && strcmp(map->slots[index].key, key) == 0) {
+            break;
+        }
+        index = (index + 1) & mask;
+        probe++;
+    }
+
+    map->lookups++;
+    map->probes += probe;
+    if (probe > map->max_probe) {
+        map->max_probe = probe;
+    }
+
+    return &map->slots[index];
+}
+
+/**
+ * Double the slot table and rehash every key
+ */
+static int grow_slots(HashMap *map) {
+    size_t new_capacity = map->capacity * 2;
+    HashMapSlot *new_slots = calloc(new_capacity, sizeof(HashMapSlot));
+    if (new_slots == NULL) {
+        return -1;
+    }
+
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->slots[i].key == NULL) continue;
+
+        size_t index = (size_t)map->slots[i].hash & mask;
+        while (new_slots[index].key != NULL) {
+            index = (index + 1) & mask;
+        }
+        new_slots[index] = map->slots[i];
+    }
+
+    free(map->slots);
+    map->slots = new_slots;
+    map->capacity = new_capacity;
+
+    return 0;
+}
+
+/**
+ * Copy a key into block storage owned by the map
+ */
+static const char* intern_key(HashMap *map, const char *key) {
+    size_t length = strlen(key) + 1;
+    HashMapKeyBlock *block = map->key_blocks;
+
+    if (block == NULL || block->size - block->used < length) {
+        size_t size = (length > HASH_MAP_KEY_BLOCK_SIZE) ? length : HASH_MAP_KEY_BLOCK_SIZE;
+        block = malloc(sizeof(HashMapKeyBlock) + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = map->key_blocks;
+        block->used = 0;
+        block->size = size;
+        map->key_blocks = block;
+    }
+
+    char *interned = block->data + block->used;
+    memcpy(interned, key, length); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    block->used += length;
+
+    return interned;
+}
@@ -0,0 +1,107 @@
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Hash map slot: interned key, cached hash and caller-defined value
+ */
+typedef struct {
+    const char *key;    /* NULL when the slot is empty */
+    uint64_t hash;
+    int value;
+} HashMapSlot;
+
+/**
+ * Block of interned key storage
+ */
+typedef struct HashMapKeyBlock {
+    struct HashMapKeyBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+} HashMapKeyBlock;
+
+/**
+ * Open-addressing (linear probing) map from strings to int values
+ * Keys are copied into block storage owned by the map, so callers may
+ * pass transient buffers. Aggregators store an index into their own
+ * record array as the value.
+ */
+typedef struct {
+    HashMapSlot *slots;
+    size_t capacity;    /* Always a power of two */
+    size_t count;
+    HashMapKeyBlock *key_blocks;
+    /* Probe statistics, reported by hash_map_debug_report() */
+    size_t lookups;
+    size_t probes;
+    size_t max_probe;
+} HashMap;
+
+/**
+ * Initialize an empty map
+ * @param map Map to initialize
+ * @param initial_capacity Expected number of keys (0 for default)
+ * @return 0 on success, -1 on allocation failure
+ */
+int hash_map_init(HashMap *map, size_t initial_capacity);
+
+/**
+ * Release all slots and interned keys
+ * @param map Map to free
+ */
+void hash_map_free(HashMap *map);
+
+/**
+ * Look up a key, inserting it with the given value when absent
+ * @param map Map to update
+ * @param key Key to look up (copied on insertion)
+ * @param value Value to store if the key is new
+ * @param inserted Set to 1 if the key was inserted, 0 if it existed (may be NULL)
+ * @return Pointer to the stored value, or NULL on allocation failure
+ */
+int* hash_map_upsert(HashMap *map, const char *key, int value, int *inserted);
+
+/**
+ * Look up a key without inserting
+ * @param map Map to search
+ * @param key Key to look up
+ * @return Pointer to the stored value, or NULL if absent
+ */
+int* hash_map_find(HashMap *map, const char *key);
+
+/**
+ * Interned copy of the key stored with a value
+ * The copy stays at the same address until the map is freed.
+ * @param value Pointer returned by hash_map_upsert() or hash_map_find()
+ * @return Key of the slot holding value
+ */
+const char* hash_map_key_of(const int *value);
+
+/**
+ * Hash of a key as the map computes it (FNV-1a, 64 bits)
+ * @param key NUL-terminated key
+ * @return Hash value
+ */
+uint64_t hash_map_hash(const char *key);
+
+/**
+ * Spread a hash over all 64 bits (the MurmurHash3 finalizer)
+ * For callers that read the high bits or compare whole hashes, which
+ * FNV-1a alone mixes poorly for short, similar keys such as paths.
+ * @param hash Hash to mix
+ * @return Mixed hash
+ */
+uint64_t hash_map_mix(uint64_t hash);
+
+/**
+ * Print load factor and probe statistics to stderr
+ * Only produces output in DEBUG builds (make debug).
+ * @param map Map to report on
+ * @param label Name of the aggregation the map belongs to
+ */
+void hash_map_debug_report(const HashMap *map, const char *label);
+
+#endif /* HASH_MAP_H */
@@ -0,0 +1,606 @@
+#define _GNU_SOURCE
+#include "history_cache.h"
+#include "vector.h"
+#include "profile.h"
+#include "string_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/file.h>
+#endif
+
+/* File header: magic, format version, context string */
+#define CACHE_FILE_MAGIC "GSTCACHE"
+#define CACHE_FILE_MAGIC_SIZE 8
+#define CACHE_FORMAT_VERSION 1
+
+/* Segment header: magic and little-endian 64-bit body size */
+#define CACHE_SEGMENT_MAGIC "GSTS"
+#define CACHE_SEGMENT_MAGIC_SIZE 4
+#define CACHE_SEGMENT_HEADER_SIZE (CACHE_SEGMENT_MAGIC_SIZE + 8)
+
+/* Longest encoded varint (64-bit value) */
+#define VARINT_MAX_SIZE 10
+
+/**
+ * Bounds-checked reader over a loaded segment
+ */
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    int failed;
+} CacheCursor;
+
+/* Forward declarations */
+static int parse_segment(const unsigned char *body, size_t size, const LogStreamHandler *handler,
+                         GitRef **tips, int *tip_count, long *commit_count);
+static uint64_t read_varint(CacheCursor *cursor);
+static const char* read_string(CacheCursor *cursor);
+static size_t encode_varint(unsigned char *encoded, uint64_t value);
+static int append_bytes(unsigned char **data, int *size, int *capacity, const void *bytes, size_t length);
+static int append_varint(unsigned char **data, int *size, int *capacity, uint64_t value);
+static int writer_intern(HistoryCacheWriter *writer, const char *string);
+static void writer_close_commit(HistoryCacheWriter *writer);
+static int write_all(int fd, const void *data, size_t size);
+
+/**
+ * Build the path of the cache file for a repository
+ */
+int history_cache_path(const GitRepository *repo, char *path, size_t path_size) {
+    assert(repo != NULL && path != NULL);
+
+    int ret = snprintf(path, path_size, "%s/git-stat/cache", repo->common_dir);
+    return (ret < 0 || (size_t)ret >= path_size) ? -1 : 0;
+}
+
+/**
+ * Describe inputs that change author names
+ */
+void history_cache_context(char *context, size_t context_size) {
+    assert(context != NULL && context_size > 0);
+
+    /* %aN applies the .mailmap; editing it changes every author name */
+    struct stat st;
+    int ret;
+    if (stat(".mailmap", &st) == 0) {
+        ret = snprintf(context, context_size, "mailmap=%lld:%lld",
+                       (long long)st.st_size, (long long)st.st_mtime);
+    } else {
+        ret = snprintf(context, context_size, "mailmap=none");
+    }
+    if (ret < 0 || (size_t)ret >= context_size) {
+        context[0] = '\0';
+    }
+}
+
+/**
+ * Load and validate a cache file
+ */
+int history_cache_load(HistoryCache *cache, const char *path, const char *context) {
+    assert(cache != NULL && path != NULL && context != NULL);
+
+    memset(cache, 0, sizeof(HistoryCache));
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX) {
+        fclose(file);
+        return 0;
+    }
+
+    cache->data = malloc((size_t)st.st_size);
+    if (cache->data == NULL) {
+        fclose(file);
+        return -1;
+    }
+    cache->size = fread(cache->data, 1, (size_t)st.st_size, file);
+    fclose(file);
+    profile_count_file_bytes(cache->size);
+
+    /* Header must match this format and context, else start over */
+    CacheCursor cursor = { cache->data, cache->data + cache->size, 0 };
+    if (cache->size < CACHE_FILE_MAGIC_SIZE ||
+        memcmp(cache->data, CACHE_FILE_MAGIC, CACHE_FILE_MAGIC_SIZE) != 0) {
+        return 0;
+    }
+    cursor.p += CACHE_FILE_MAGIC_SIZE;
+    uint64_t version = read_varint(&cursor);
+    const char *stored_context = read_string(&cursor);
+    if (cursor.failed || version != CACHE_FORMAT_VERSION || strcmp(stored_context, context) != 0) {
+        return 0;
+    }
+    cache->valid_size = (size_t)(cursor.p - cache->data);
+
+    /* Accept segments until the first incomplete or malformed one */
+    while (cache->size - cache->valid_size >= CACHE_SEGMENT_HEADER_SIZE) {
+        const unsigned char *header = cache->data + cache->valid_size;
+        if (memcmp(header, CACHE_SEGMENT_MAGIC, CACHE_SEGMENT_MAGIC_SIZE) != 0) break;
+
+        uint64_t body_size = 0;
+        for (int i = 7; i >= 0; i--) {
+            body_size = (body_size << 8) | header[CACHE_SEGMENT_MAGIC_SIZE + i];
+        }
+        if (body_size > cache->size - cache->valid_size - CACHE_SEGMENT_HEADER_SIZE) break;
+
+        GitRef *tips = NULL;
+        int tip_count = 0;
+        long commits = 0;
+        if (parse_segment(header + CACHE_SEGMENT_HEADER_SIZE, (size_t)body_size, NULL,
+                          &tips, &tip_count, &commits) != 0) {
+            git_refs_free(tips, tip_count);
+            break;
+        }
+
+        git_refs_free(cache->tips, cache->tip_count);
+        cache->tips = tips;
+        cache->tip_count = tip_count;
+        cache->commit_count += commits;
+        cache->valid_size += CACHE_SEGMENT_HEADER_SIZE + (size_t)body_size;
+    }
+
+    return 0;
+}
+
+/**
+ * Feed every cached commit and file change to a log stream handler
+ */
+void history_cache_replay(const HistoryCache *cache, const LogStreamHandler *handler) {
+    assert(cache != NULL && handler != NULL);
+
+    if (cache->valid_size == 0) {
+        return;
+    }
+
+    /* Skip the file header; load() already validated it */
+    CacheCursor cursor = { cache->data + CACHE_FILE_MAGIC_SIZE, cache->data + cache->valid_size, 0 };
+    read_varint(&cursor);
+    read_string(&cursor);
+
+    size_t offset = (size_t)(cursor.p - cache->data);
+    while (offset < cache->valid_size) {
+        const unsigned char *header = cache->data + offset;
+        uint64_t body_size = 0;
+        for (int i = 7; i >= 0; i--) {
+            body_size = (body_size << 8) | header[CACHE_SEGMENT_MAGIC_SIZE + i];
+        }
+        parse_segment(header + CACHE_SEGMENT_HEADER_SIZE, (size_t)body_size, handler, NULL, NULL, NULL);
+        offset += CACHE_SEGMENT_HEADER_SIZE + (size_t)body_size;
+    }
+}
+
+/**
+ * Release a loaded cache
+ */
+void history_cache_free(HistoryCache *cache) {
+    assert(cache != NULL);
+
+    git_refs_free(cache->tips, cache->tip_count);
+    free(cache->data);
+    memset(cache, 0, sizeof(HistoryCache));
+}
+
+/**
+ * Start encoding a segment
+ */
+int history_cache_writer_init(HistoryCacheWriter *writer) {
+    assert(writer != NULL);
+
+    memset(writer, 0, sizeof(HistoryCacheWriter));
+    return hash_map_init(&writer->string_index, 0);
+}
+
+/**
+ * Begin a commit record
+ */
+void history_cache_writer_add_commit(HistoryCacheWriter *writer, const ObjectId *oid,
+                                     const char *author, const char *date) {
+    assert(writer != NULL && oid != NULL);
+    assert(author != NULL && date != NULL);
+
+    writer_close_commit(writer);
+
+    int author_index = writer_intern(writer, author);
+    int date_index = writer_intern(writer, date);
+    if (author_index < 0 || date_index < 0 ||
+        append_bytes(&writer->records, &writer->records_size, &writer->records_capacity,
+                     oid->hash, OID_RAW_SIZE) != 0 ||
+        append_varint(&writer->records, &writer->records_size, &writer->records_capacity,
+                      (uint64_t)author_index) != 0 ||
+        append_varint(&writer->records, &writer->records_size, &writer->records_capacity,
+                      (uint64_t)date_index) != 0) {
+        writer->failed = 1;
+        return;
+    }
+
+    writer->in_commit = 1;
+    writer->commit_count++;
+}
+
+/**
+ * Add a numstat entry to the open commit record
+ */
+void history_cache_writer_add_file(HistoryCacheWriter *writer, const LogFileChange *change) {
+    assert(writer != NULL && change != NULL);
+
+    if (!writer->in_commit || writer->failed) return;
+
+    /* Path indexes are stored plus one; zero terminates the commit */
+    int path_index = writer_intern(writer, change->path);
+    if (path_index < 0 ||
+        append_varint(&writer->records, &writer->records_size, &writer->records_capacity,
+                      (uint64_t)path_index + 1) != 0 ||
+        append_varint(&writer->records, &writer->records_size, &writer->records_capacity,
+                      (uint64_t)(change->lines_added > 0 ? change->lines_added : 0)) != 0 ||
+        append_varint(&writer->records, &writer->records_size, &writer->records_capacity,
+                      (uint64_t)(change->lines_deleted > 0 ? change->lines_deleted : 0)) != 0) {
+        writer->failed = 1;
+    }
+}
+
+/**
+ * Write the segment, appending to base or replacing the file
+ */
+int history_cache_write(HistoryCacheWriter *writer, const char *path, const char *context,
+                        const HistoryCache *base, const GitRef *tips, int tip_count) {
+    assert(writer != NULL && path != NULL && context != NULL);
+    assert(tips != NULL || tip_count == 0);
+
+#ifdef _WIN32
+    (void)base;
+    return -1;
+#else
+    writer_close_commit(writer);
+    if (writer->failed) {
+        return -1;
+    }
+
+    /* Tips and table sizes make up the rest of the body */
+    unsigned char *head = NULL;
+    int head_size = 0;
+    int head_capacity = 0;
+    int result = append_varint(&head, &head_size, &head_capacity, (uint64_t)tip_count);
+    for (int i = 0; result == 0 && i < tip_count; i++) {
+        result = append_bytes(&head, &head_size, &head_capacity, tips[i].oid.hash, OID_RAW_SIZE);
+        if (result == 0) {
+            result = append_bytes(&head, &head_size, &head_capacity, tips[i].name, strlen(tips[i].name) + 1);
+        }
+    }
+    if (result == 0) {
+        result = append_varint(&head, &head_size, &head_capacity, (uint64_t)writer->string_count);
+    }
+
+    unsigned char commit_count[VARINT_MAX_SIZE];
+    size_t count_size = encode_varint(commit_count, (uint64_t)writer->commit_count);
+    if (result != 0) {
+        free(head);
+        return -1;
+    }
+
+    uint64_t body_size = (uint64_t)head_size + (uint64_t)writer->strings_size +
+                         count_size + (uint64_t)writer->records_size;
+    unsigned char segment_header[CACHE_SEGMENT_HEADER_SIZE];
+    memcpy(segment_header, CACHE_SEGMENT_MAGIC, CACHE_SEGMENT_MAGIC_SIZE); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    for (int i = 0; i < 8; i++) {
+        segment_header[CACHE_SEGMENT_MAGIC_SIZE + i] = (unsigned char)(body_size >> (8 * i));
+    }
+
+    /* Serialize writers through a lock file next to the cache */
+    char directory[MAX_PATH_LENGTH];
+    char lock_path[MAX_PATH_LENGTH + 8];
+    char temp_path[MAX_PATH_LENGTH + 8];
+    safe_string_copy(directory, path, sizeof(directory));
+    char *slash = strrchr(directory, '/');
+    if (slash != NULL) *slash = '\0';
+    int ret = snprintf(lock_path, sizeof(lock_path), "%s/lock", directory);
+    int temp_ret = snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    if (slash == NULL || ret < 0 || ret >= (int)sizeof(lock_path) ||
+        temp_ret < 0 || temp_ret >= (int)sizeof(temp_path)) {
+        free(head);
+        return -1;
+    }
+
+    if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+        free(head);
+        return -1;
+    }
+
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (lock_fd < 0) {
+        free(head);
+        return -1;
+    }
+    if (flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        /* Another run is updating the cache; it will cover these commits */
+        close(lock_fd);
+        free(head);
+        return 0;
+    }
+
+    int fd;
+    if (base != NULL) {
+        /* Drop any partial segment left behind, then append */
+        fd = open(path, O_WRONLY | O_CLOEXEC);
+        if (fd >= 0 && (ftruncate(fd, (off_t)base->valid_size) != 0 ||
+                        lseek(fd, 0, SEEK_END) < 0)) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    }
+
+    result = (fd >= 0) ? 0 : -1;
+    if (result == 0 && base == NULL) {
+        unsigned char version[VARINT_MAX_SIZE];
+        size_t version_size = encode_varint(version, CACHE_FORMAT_VERSION);
+        if (write_all(fd, CACHE_FILE_MAGIC, CACHE_FILE_MAGIC_SIZE) != 0 ||
+            write_all(fd, version, version_size) != 0 ||
+            write_all(fd, context, strlen(context) + 1) != 0) {
+            result = -1;
+        }
+    }
+    if (result == 0 &&
+        (write_all(fd, segment_header, sizeof(segment_header)) != 0 ||
+         write_all(fd, head, (size_t)head_size) != 0 ||
+         write_all(fd, writer->strings, (size_t)writer->strings_size) != 0 ||
+         write_all(fd, commit_count, count_size) != 0 ||
+         write_all(fd, writer->records, (size_t)writer->records_size) != 0)) {
+        result = -1;
+    }
+    if (fd >= 0 && close(fd) != 0) {
+        result = -1;
+    }
+
+    if (base == NULL) {
+        if (result == 0 && rename(temp_path, path) != 0) {
+            result = -1;
+        }
+        if (result != 0) {
+            unlink(temp_path);
+        }
+    }
+
+    close(lock_fd);
+    free(head);
+    return result;
+#endif
+}
+
+/**
+ * Release a segment writer
+ */
+void history_cache_writer_free(HistoryCacheWriter *writer) {
+    assert(writer != NULL);
+
+    free(writer->strings);
+    free(writer->records);
+    hash_map_free(&writer->string_index);
+    memset(writer, 0, sizeof(HistoryCacheWriter));
+}
+
+/**
+ * Decode one segment body, optionally replaying it and returning its tips
+ */
+static int parse_segment(const unsigned char *body, size_t size, const LogStreamHandler *handler,
+                         GitRef **tips, int *tip_count, long *commit_count) {
+    CacheCursor cursor = { body, body + size, 0 };
+
+    uint64_t tips_in_segment = read_varint(&cursor);
+    if (cursor.failed || tips_in_segment > size / (OID_RAW_SIZE + 1)) {
+        return -1;
+    }
+
+    if (tips != NULL) {
+        *tips = calloc((size_t)tips_in_segment + 1, sizeof(GitRef));
+        if (*tips == NULL) return -1;
+    }
+    for (uint64_t i = 0; i < tips_in_segment; i++) {
+        const unsigned char *oid = (cursor.end - cursor.p >= OID_RAW_SIZE) ? cursor.p : NULL;
+        if (oid == NULL) return -1;
+        cursor.p += OID_RAW_SIZE;
+        const char *name = read_string(&cursor);
+        if (cursor.failed) return -1;
+
+        if (tips != NULL) {
+            (*tips)[i].name = strdup(name);
+            if ((*tips)[i].name == NULL) return -1;
+            memcpy((*tips)[i].oid.hash, oid, OID_RAW_SIZE); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+            (*tip_count)++;
+        }
+    }
+
+    uint64_t string_count = read_varint(&cursor);
+    if (cursor.failed || string_count > (uint64_t)(cursor.end - cursor.p)) {
+        return -1;
+    }
+    const char **strings = malloc(sizeof(char *) * ((size_t)string_count + 1));
+    if (strings == NULL) {
+        return -1;
+    }
+    for (uint64_t i = 0; i < string_count && !cursor.failed; i++) {
+        strings[i] = read_string(&cursor);
+    }
+
+    uint64_t commits = read_varint(&cursor);
+    for (uint64_t i = 0; i < commits && !cursor.failed; i++) {
+        if (cursor.end - cursor.p < OID_RAW_SIZE) {
+            cursor.failed = 1;
+            break;
+        }
+        const unsigned char *oid = cursor.p;
+        cursor.p += OID_RAW_SIZE;
+
+        uint64_t author = read_varint(&cursor);
+        uint64_t date = read_varint(&cursor);
+        if (cursor.failed || author >= string_count || date >= string_count) {
+            cursor.failed = 1;
+            break;
+        }
+        if (handler != NULL && handler->on_commit != NULL) {
+            ObjectId id;
+            char hex[OID_HEX_SIZE + 1];
+            memcpy(id.hash, oid, OID_RAW_SIZE); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+            oid_to_hex(&id, hex);
+            LogCommit commit = { hex, strings[author], strings[date] };
+            handler->on_commit(&commit, handler->ctx);
+        }
+
+        for (;;) {
+            uint64_t path = read_varint(&cursor);
+            if (cursor.failed || path == 0) break;
+            uint64_t added = read_varint(&cursor);
+            uint64_t deleted = read_varint(&cursor);
+            if (cursor.failed || path > string_count || added > INT_MAX || deleted > INT_MAX) {
+                cursor.failed = 1;
+                break;
+            }
+            if (handler != NULL && handler->on_file != NULL) {
+                LogFileChange change = { strings[path - 1], (int)added, (int)deleted };
+                handler->on_file(&change, handler->ctx);
+            }
+        }
+    }
+
+    free(strings);
+
+    if (cursor.failed || cursor.p != cursor.end) {
+        return -1;
+    }
+    if (commit_count != NULL) {
+        *commit_count = (long)commits;
+    }
+    return 0;
+}
+
+/**
+ * Read an unsigned LEB128 varint
+ */
+static uint64_t read_varint(CacheCursor *cursor) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (cursor->p >= cursor->end) break;
+        unsigned char byte = *cursor->p++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    cursor->failed = 1;
+    return 0;
+}
+
+/**
+ * Read a NUL-terminated string in place
+ */
+static const char* read_string(CacheCursor *cursor) {
+    const unsigned char *nul = (cursor->p < cursor->end)
+                                   ? memchr(cursor->p, '\0', (size_t)(cursor->end - cursor->p))
+                                   : NULL;
+    if (nul == NULL) {
+        cursor->failed = 1;
+        return "";
+    }
+    const char *string = (const char *)cursor->p;
+    cursor->p = nul + 1;
+    return string;
+}
+
+/**
+ * Append raw bytes to a growable buffer
+ */
+static int append_bytes(unsigned char **data, int *size, int *capacity, const void *bytes, size_t length) {
+    if (length > (size_t)(INT_MAX - *size)) {
+        return -1;
+    }
+    if (*size + (int)length > *capacity) {
+        if (vector_reserve((void **)data, capacity, *size + (int)length, 1) != 0) {
+            return -1;
+        }
+    }
+    memcpy(*data + *size, bytes, length); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    *size += (int)length;
+    return 0;
+}
+
+/**
+ * Encode an unsigned LEB128 varint
+ * @return Number of bytes written (at most VARINT_MAX_SIZE)
+ */
+static size_t encode_varint(unsigned char *encoded, uint64_t value) {
+    size_t length = 0;
+    do {
+        unsigned char byte = value & 0x7f;
+        value >>= 7;
+        encoded[length++] = (unsigned char)(byte | (value != 0 ? 0x80 : 0));
+    } while (value != 0);
+    return length;
+}
+
+/**
+ * Append an unsigned LEB128 varint
+ */
+static int append_varint(unsigned char **data, int *size, int *capacity, uint64_t value) {
+    unsigned char encoded[VARINT_MAX_SIZE];
+    return append_bytes(data, size, capacity, encoded, encode_varint(encoded, value));
+}
+
+/**
+ * Return the string table index for a string, adding it on first use
+ */
+static int writer_intern(HistoryCacheWriter *writer, const char *string) {
+    int inserted;
+    int *position = hash_map_upsert(&writer->string_index, string, writer->string_count, &inserted);
+    if (position == NULL) {
+        return -1;
+    }
+    if (inserted) {
+        if (append_bytes(&writer->strings, &writer->strings_size, &writer->strings_capacity,
+                         string, strlen(string) + 1) != 0) {
+            *position = -1;
+            return -1;
+        }
+        writer->string_count++;
+    }
+    return *position;
+}
+
+/**
+ * Terminate the open commit record's file list
+ */
+static void writer_close_commit(HistoryCacheWriter *writer) {
+    if (!writer->in_commit) return;
+
+    if (append_varint(&writer->records, &writer->records_size, &writer->records_capacity, 0) != 0) {
+        writer->failed = 1;
+    }
+    writer->in_commit = 0;
+}
+
+/**
+ * Write a whole buffer to a descriptor
+ */
+static int write_all(int fd, const void *data, size_t size) {
+    const unsigned char *p = (const unsigned char *)data;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#ifndef HISTORY_CACHE_H
+#define HISTORY_CACHE_H
+
+#include "git_repo.h"
+#include "hash_map.h"
+#include "log_stream.h"
+
+/**
+ * Per-commit history facts cached under <git-dir>/git-stat/cache
+ *
+ * The file is a header followed by append-only segments. Each segment
+ * holds the ref tips it was computed from, a string table (authors, dates
+ * and paths) and one record per commit: object id, author, date and the
+ * numstat entries. The tips of the newest complete segment describe the
+ * history the whole file covers; a segment cut short by an interrupted
+ * write is ignored and overwritten by the next append.
+ */
+typedef struct {
+    unsigned char *data;    /* Whole file contents */
+    size_t size;
+    size_t valid_size;      /* Header plus all complete, well-formed segments */
+    GitRef *tips;           /* Tips recorded by the newest segment */
+    int tip_count;
+    long commit_count;
+} HistoryCache;
+
+/**
+ * Encoder for one new segment
+ */
+typedef struct {
+    unsigned char *strings;
+    int strings_size;
+    int strings_capacity;
+    unsigned char *records;
+    int records_size;
+    int records_capacity;
+    HashMap string_index;   /* String -> index in the segment's table */
+    int string_count;
+    long commit_count;
+    int in_commit;          /* A commit record is open for file entries */
+    int failed;
+} HistoryCacheWriter;
+
+/**
+ * Build the path of the cache file for a repository
+ * @param repo Open repository
+ * @param path Output buffer
+ * @param path_size Size of the output buffer
+ * @return 0 on success, -1 if the path does not fit
+ */
+int history_cache_path(const GitRepository *repo, char *path, size_t path_size);
+
+/**
+ * Describe inputs that change author names (the .mailmap) so a cache
+ * built under different ones is discarded
+ * @param context Output buffer
+ * @param context_size Size of the output buffer
+ */
+void history_cache_context(char *context, size_t context_size);
+
+/**
+ * Load and validate a cache file
+ * A missing, foreign or corrupt file loads as an empty cache.
+ * @param cache Cache to initialize
+ * @param path Cache file path
+ * @param context Expected context string
+ * @return 0 on success, -1 on allocation failure
+ */
+int history_cache_load(HistoryCache *cache, const char *path, const char *context);
+
+/**
+ * Feed every cached commit and file change to a log stream handler
+ * @param cache Loaded cache
+ * @param handler Callbacks to invoke
+ */
+void history_cache_replay(const HistoryCache *cache, const LogStreamHandler *handler);
+
+/**
+ * Release a loaded cache
+ * @param cache Cache to free
+ */
+void history_cache_free(HistoryCache *cache);
+
+/**
+ * Start encoding a segment
+ * @param writer Writer to initialize
+ * @return 0 on success, -1 on allocation failure
+ */
+int history_cache_writer_init(HistoryCacheWriter *writer);
+
+/**
+ * Begin a commit record; file entries added next belong to it
+ * @param writer Segment writer
+ * @param oid Commit id
+ * @param author Author name
+ * @param date Author date (YYYY-MM-DD)
+ */
+void history_cache_writer_add_commit(HistoryCacheWriter *writer, const ObjectId *oid,
+                                     const char *author, const char *date);
+
+/**
+ * Add a numstat entry to the open commit record
+ * @param writer Segment writer
+ * @param change Resolved file change
+ */
+void history_cache_writer_add_file(HistoryCacheWriter *writer, const LogFileChange *change);
+
+/**
+ * Write the segment, appending to base or replacing the file
+ * Skipped without error when another process holds the cache lock.
+ * @param writer Segment writer
+ * @param path Cache file path
+ * @param context Context string for a new file header
+ * @param base Cache the segment extends, or NULL to start a new file
+ * @param tips Tips the cache covers after this segment
+ * @param tip_count Number of tips
+ * @return 0 on success, -1 on error
+ */
+int history_cache_write(HistoryCacheWriter *writer, const char *path, const char *context,
+                        const HistoryCache *base, const GitRef *tips, int tip_count);
+
+/**
+ * Release a segment writer
+ * @param writer Writer to free
+ */
+void history_cache_writer_free(HistoryCacheWriter *writer);
+
+#endif /* HISTORY_CACHE_H */
@@ -0,0 +1,96 @@
+#include "hyperloglog.h"
+#include "hash_map.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+/**
+ * Create an empty sketch
+ */
+int hyperloglog_init(HyperLogLog *hll, int precision) {
+    assert(hll != NULL);
+    assert(precision >= HYPERLOGLOG_MIN_PRECISION && precision <= HYPERLOGLOG_MAX_PRECISION);
+
+    hll->precision = precision;
+    hll->registers = calloc(hyperloglog_size(precision), 1);
+    return (hll->registers != NULL) ? 0 : -1;
+}
+
+/**
+ * Add a string to the sketch
+ * The top `precision` bits of the hash pick a register, which keeps the
+ * longest run of leading zeros seen in the remaining bits, plus one.
+ */
+void hyperloglog_add(HyperLogLog *hll, const char *value) {
+    assert(hll != NULL && hll->registers != NULL);
+    assert(value != NULL);
+
+    uint64_t hash = hash_map_mix(hash_map_hash(value));
+    size_t index = (size_t)(hash >> (64 - hll->precision));
+
+    /* A sentinel bit caps the run at the bits that remain */
+    uint64_t rest = (hash << hll->precision) | ((uint64_t)1 << (hll->precision - 1));
+    uint8_t rank = (uint8_t)(__builtin_clzll(rest) + 1);
+
+    if (rank > hll->registers[index]) {
+        hll->registers[index] = rank;
+    }
+}
+
+/**
+ * Estimate the number of distinct strings added
+ * Below 2.5 estimates per register the raw estimate is biased high, so
+ * while registers are still empty linear counting over them is used
+ * instead. 64-bit hashes need no large-range correction.
+ */
+double hyperloglog_estimate(const HyperLogLog *hll) {
+    assert(hll != NULL && hll->registers != NULL);
+
+    size_t count = hyperloglog_size(hll->precision);
+    double m = (double)count;
+
+    double sum = 0.0;
+    size_t empty = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += ldexp(1.0, -(int)hll->registers[i]);
+        if (hll->registers[i] == 0) empty++;
+    }
+
+    double alpha;
+    switch (count) {
+        case 16: alpha = 0.673; break;
+        case 32: alpha = 0.697; break;
+        case 64: alpha = 0.709; break;
+        default: alpha = 0.7213 / (1.0 + 1.079 / m); break;
+    }
+    double raw = alpha * m * m / sum;
+
+    if (raw <= 2.5 * m && empty > 0) {
+        return m * log(m / (double)empty);
+    }
+    return raw;
+}
+
+/**
+ * Relative standard error of the estimates of a precision
+ */
+double hyperloglog_standard_error(int precision) {
+    return 1.04 / sqrt((double)hyperloglog_size(precision));
+}
+
+/**
+ * Memory used by a sketch of a precision
+ */
+size_t hyperloglog_size(int precision) {
+    return (size_t)1 << precision;
+}
+
+/**
+ * Release a sketch
+ */
+void hyperloglog_free(HyperLogLog *hll) {
+    assert(hll != NULL);
+
+    free(hll->registers);
+    hll->registers = NULL;
+}
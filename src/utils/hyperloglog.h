@@ -0,0 +1,66 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Accepted register index widths; 2^precision registers of one byte each */
+#define HYPERLOGLOG_MIN_PRECISION 4
+#define HYPERLOGLOG_MAX_PRECISION 18
+#define HYPERLOGLOG_DEFAULT_PRECISION 14
+
+/**
+ * HyperLogLog distinct-count sketch (Flajolet et al.)
+ * Memory is fixed at 2^precision bytes however many values are added, and
+ * the estimate has a relative standard error of about
+ * 1.04 / sqrt(2^precision): 0.8% at the default precision of 14.
+ */
+typedef struct {
+    int precision;
+    uint8_t *registers;
+} HyperLogLog;
+
+/**
+ * Create an empty sketch
+ * @param hll Sketch to initialize
+ * @param precision Register index bits, HYPERLOGLOG_MIN_PRECISION to
+ *                  HYPERLOGLOG_MAX_PRECISION
+ * @return 0 on success, -1 on allocation failure
+ */
+int hyperloglog_init(HyperLogLog *hll, int precision);
+
+/**
+ * Add a string to the sketch
+ * @param hll Initialized sketch
+ * @param value NUL-terminated string
+ */
+void hyperloglog_add(HyperLogLog *hll, const char *value);
+
+/**
+ * Estimate the number of distinct strings added
+ * @param hll Initialized sketch
+ * @return Estimated cardinality
+ */
+double hyperloglog_estimate(const HyperLogLog *hll);
+
+/**
+ * Relative standard error of the estimates of a precision
+ * @param precision Register index bits
+ * @return Standard error as a fraction of the estimate
+ */
+double hyperloglog_standard_error(int precision);
+
+/**
+ * Memory used by a sketch of a precision
+ * @param precision Register index bits
+ * @return Bytes of registers
+ */
+size_t hyperloglog_size(int precision);
+
+/**
+ * Release a sketch
+ * @param hll Sketch to free
+ */
+void hyperloglog_free(HyperLogLog *hll);
+
+#endif /* HYPERLOGLOG_H */
@@ -0,0 +1,192 @@
+#define _GNU_SOURCE
+#include "line_count.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define LINE_COUNT_X86 1
+#include <immintrin.h>
+#endif
+
+/* Files at least this large are mapped instead of read */
+#define LINE_COUNT_MMAP_THRESHOLD (256 * 1024)
+
+/* Block size for the buffered read path */
+#define LINE_COUNT_BLOCK_SIZE (64 * 1024)
+
+/* Vector iterations before byte counters are folded (each lane counts to 255) */
+#define LINE_COUNT_FOLD_INTERVAL 255
+
+/* Forward declarations */
+static size_t count_newlines_scalar(const unsigned char *p, size_t size);
+static long count_mapped(FILE *file, size_t size);
+static long count_buffered(FILE *file);
+
+#ifdef LINE_COUNT_X86
+/**
+ * SSE2 kernel: compare 16 bytes per step, accumulating matches per byte lane
+ */
+__attribute__((target("sse2")))
+static size_t count_newlines_sse2(const unsigned char *p, size_t size) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+    size_t i = 0;
+
+    while (size - i >= 16) {
+        size_t steps = (size - i) / 16;
+        if (steps > LINE_COUNT_FOLD_INTERVAL) steps = LINE_COUNT_FOLD_INTERVAL;
+
+        /* Equal bytes compare to 0xff (-1), so subtracting adds one per match */
+        __m128i lanes = zero;
+        for (size_t step = 0; step < steps; step++, i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *)(p + i));
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(block, newline));
+        }
+
+        __m128i sums = _mm_sad_epu8(lanes, zero);
+        count += (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_extract_epi16(sums, 4);
+    }
+
+    return count + count_newlines_scalar(p + i, size - i);
+}
+
+/**
+ * AVX2 kernel: same scheme as the SSE2 kernel on 32-byte blocks
+ */
+__attribute__((target("avx2")))
+static size_t count_newlines_avx2(const unsigned char *p, size_t size) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    size_t count = 0;
+    size_t i = 0;
+
+    while (size - i >= 32) {
+        size_t steps = (size - i) / 32;
+        if (steps > LINE_COUNT_FOLD_INTERVAL) steps = LINE_COUNT_FOLD_INTERVAL;
+
+        __m256i lanes = zero;
+        for (size_t step = 0; step < steps; step++, i += 32) {
+            __m256i block = _mm256_loadu_si256((const __m256i *)(p + i));
+            lanes = _mm256_sub_epi8(lanes, _mm256_cmpeq_epi8(block, newline));
+        }
+
+        /* Four 64-bit partial sums of at most 8 * 255 each */
+        __m256i sums = _mm256_sad_epu8(lanes, zero);
+        __m128i folded = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        count += (size_t)_mm_cvtsi128_si32(folded) + (size_t)_mm_extract_epi16(folded, 4);
+    }
+
+    return count + count_newlines_scalar(p + i, size - i);
+}
+#endif
+
+/**
+ * Count '\n' bytes in a buffer
+ */
+size_t count_newlines(const void *data, size_t size) {
+    assert(data != NULL || size == 0);
+
+    const unsigned char *p = (const unsigned char *)data;
+#ifdef LINE_COUNT_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return count_newlines_avx2(p, size);
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return count_newlines_sse2(p, size);
+    }
+#endif
+    return count_newlines_scalar(p, size);
+}
+
+/**
+ * Name of the kernel count_newlines() uses on this CPU
+ */
+const char* newline_kernel_name(void) {
+#ifdef LINE_COUNT_X86
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    if (__builtin_cpu_supports("sse2")) return "sse2";
+#endif
+    return "scalar";
+}
+
+/**
+ * Count lines in a file
+ */
+long count_file_lines(const char *filename) {
+    assert(filename != NULL);
+
+    /* Binary mode so the count matches the bytes git stores */
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    long lines;
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) &&
+        st.st_size >= LINE_COUNT_MMAP_THRESHOLD) {
+        lines = count_mapped(file, (size_t)st.st_size);
+    } else {
+        lines = count_buffered(file);
+    }
+
+    fclose(file);
+    return lines;
+}
+
+/**
+ * Portable fallback kernel
+ */
+static size_t count_newlines_scalar(const unsigned char *p, size_t size) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++) {
+        count += (p[i] == '\n');
+    }
+    return count;
+}
+
+/**
+ * Count lines through a read-only mapping, falling back to reads
+ */
+static long count_mapped(FILE *file, size_t size) {
+#ifndef _WIN32
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (data != MAP_FAILED) {
+        madvise(data, size, MADV_SEQUENTIAL);
+        size_t lines = count_newlines(data, size);
+        munmap(data, size);
+        profile_count_file_bytes(size);
+        return (long)lines;
+    }
+#else
+    (void)size;
+#endif
+    return count_buffered(file);
+}
+
+/**
+ * Count lines by reading the file in large blocks
+ */
+static long count_buffered(FILE *file) {
+    unsigned char buffer[LINE_COUNT_BLOCK_SIZE];
+    size_t lines = 0;
+    size_t bytes;
+
+    while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        lines += count_newlines(buffer, bytes);
+        profile_count_file_bytes(bytes);
+    }
+
+    if (ferror(file)) {
+        return -1;
+    }
+    return (long)lines;
+}
@@ -0,0 +1,30 @@
+#ifndef LINE_COUNT_H
+#define LINE_COUNT_H
+
+#include <stddef.h>
+
+/**
+ * Count '\n' bytes in a buffer
+ * Uses an AVX2 or SSE2 kernel when the running CPU supports it and a
+ * scalar loop otherwise; the choice is made at runtime.
+ * @param data Buffer to scan
+ * @param size Buffer size in bytes
+ * @return Number of newline bytes
+ */
+size_t count_newlines(const void *data, size_t size);
+
+/**
+ * Name of the kernel count_newlines() uses on this CPU
+ * @return "avx2", "sse2" or "scalar"
+ */
+const char* newline_kernel_name(void);
+
+/**
+ * Count lines in a file
+ * Large files are memory-mapped, small ones are read in large blocks.
+ * @param filename Path to the file
+ * @return Number of lines, or -1 on error
+ */
+long count_file_lines(const char *filename);
+
+#endif /* LINE_COUNT_H */
@@ -0,0 +1,523 @@
+#define _GNU_SOURCE
+#include "log_stream.h"
+#include "history_cache.h"
+#include "revwalk.h"
+#include "subprocess.h"
+#include "git_commands.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* Record and field separators emitted by the pretty format below */
+#define LOG_RECORD_MARKER '\x1e'
+#define LOG_FIELD_SEPARATOR '\x1f'
+
+#define LOG_STREAM_FORMAT "--pretty=tformat:%x1e%H%x1f%aN%x1f%ad"
+
+/**
+ * Destination of parsed log lines
+ */
+typedef struct {
+    const LogStreamHandler *handler;
+    HistoryCacheWriter *writer;     /* Also records commits in the cache, or NULL */
+} LogLineSink;
+
+/**
+ * Passes on only the records of commits reachable from HEAD
+ */
+typedef struct {
+    const LogStreamHandler *inner;
+    ObjectIdSet reachable;
+    int keep;           /* The current commit is reachable */
+} HeadFilter;
+
+/* Forward declarations */
+static void hand_over_tips(GitRef *tips, int tip_count, GitRef **covered, int *covered_count);
+static int collect_history_tips(GitRepository *repo, GitRef **tips, int *tip_count);
+static int tips_still_reachable(const GitRef *seen, int seen_count, const GitRef *tips, int tip_count);
+static int stream_new_commits(const LogStreamHandler *handler, HistoryCacheWriter *writer,
+                              const GitRef *tips, int tip_count, const GitRef *seen, int seen_count);
+static char* format_revisions(const GitRef *include, int include_count,
+                              const GitRef *exclude, int exclude_count, size_t *size);
+static int dispatch_log_line(char *line, size_t length, void *ctx);
+static int keep_count_line(char *line, size_t length, void *ctx);
+static int parse_commit_header(char *line, LogCommit *commit);
+static int parse_numstat_line(char *line, LogFileChange *change);
+static void resolve_rename_path(char *path);
+static int resolve_head(ObjectId *head);
+static int collect_head_history(const ObjectId *head, ObjectIdSet *reachable);
+static int add_reachable_commit(const CommitInfo *commit, void *ctx);
+static void filter_head_commit(const LogCommit *commit, void *ctx);
+static void filter_head_file(const LogFileChange *change, void *ctx);
+
+/**
+ * Walk the history of all refs once and dispatch parsed records
+ */
+int stream_git_log(const LogStreamHandler *handler, const CollectOptions *options, LogScope scope) {
+    assert(handler != NULL);
+    assert(options != NULL);
+
+    ObjectId head;
+    if (scope == LOG_SCOPE_HEAD && resolve_head(&head) != 0) {
+        return 0; /* Unborn HEAD: no history yet */
+    }
+
+    /* The cache keeps no committer dates, and git prunes a windowed walk
+       itself, so a date window always takes the plain walk */
+    int windowed = (options->since > 0 || options->until > 0);
+    if (options->use_cache && !windowed) {
+        if (scope == LOG_SCOPE_ALL && stream_cached_history(handler, NULL, NULL) == 0) {
+            return 0;
+        }
+
+        HeadFilter filter = {handler, {0}, 0};
+        if (scope == LOG_SCOPE_HEAD && collect_head_history(&head, &filter.reachable) == 0) {
+            LogStreamHandler filtered = {filter_head_commit, filter_head_file, &filter};
+            int cached = stream_cached_history(&filtered, NULL, NULL);
+            oid_set_free(&filter.reachable);
+            if (cached == 0) {
+                return 0;
+            }
+        }
+    }
+
+    HistoryWindowArgs window;
+    const char *argv[9] = {"git", "log", (scope == LOG_SCOPE_HEAD) ? "HEAD" : "--all", "--numstat",
+                           "--date=short", LOG_STREAM_FORMAT, NULL};
+    append_history_window(options, &window, argv, 6);
+    LogLineSink sink = {handler, NULL};
+    return (subprocess_stream(argv, NULL, 0, '\n', dispatch_log_line, &sink) == 0) ? 0 : -1;
+}
+
+/**
+ * Resolve HEAD to a commit
+ * @return 0 on success, -1 if HEAD is unborn or not a commit
+ */
+static int resolve_head(ObjectId *head) {
+    const char *const argv[] = {"git", "rev-parse", "--verify", "-q", "HEAD^{commit}", NULL};
+    char *hex = execute_git_command(argv);
+    int result = (hex != NULL && oid_from_hex(hex, head) == 0) ? 0 : -1;
+    free(hex);
+    return result;
+}
+
+/**
+ * Collect the commits reachable from HEAD, read in-process
+ * @return 0 on success, -1 if the repository cannot be walked
+ */
+static int collect_head_history(const ObjectId *head, ObjectIdSet *reachable) {
+    GitRepository repo;
+    if (git_repository_open(&repo) != 0) {
+        return -1;
+    }
+    if (oid_set_init(reachable) != 0) {
+        git_repository_close(&repo);
+        return -1;
+    }
+
+    int result = revwalk(&repo, head, 1, add_reachable_commit, reachable, NULL);
+    git_repository_close(&repo);
+    if (result != 0) {
+        oid_set_free(reachable);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Record one commit of the HEAD walk
+ */
+static int add_reachable_commit(const CommitInfo *commit, void *ctx) {
+    return (oid_set_insert((ObjectIdSet *)ctx, &commit->oid) < 0) ? -1 : 0;
+}
+
+/**
+ * Pass on a commit reachable from HEAD and remember whether it was
+ */
+static void filter_head_commit(const LogCommit *commit, void *ctx) {
+    HeadFilter *filter = (HeadFilter *)ctx;
+
+    ObjectId oid;
+    filter->keep = (oid_from_hex(commit->id, &oid) == 0 && oid_set_contains(&filter->reachable, &oid));
+    if (filter->keep && filter->inner->on_commit != NULL) {
+        filter->inner->on_commit(commit, filter->inner->ctx);
+    }
+}
+
+/**
+ * Pass on a file change of a commit reachable from HEAD
+ */
+static void filter_head_file(const LogFileChange *change, void *ctx) {
+    HeadFilter *filter = (HeadFilter *)ctx;
+
+    if (filter->keep && filter->inner->on_file != NULL) {
+        filter->inner->on_file(change, filter->inner->ctx);
+    }
+}
+
+/**
+ * Resolve the current history tips
+ */
+int log_stream_tips(GitRef **tips, int *tip_count) {
+    assert(tips != NULL && tip_count != NULL);
+
+    GitRepository repo;
+    if (git_repository_open(&repo) != 0) {
+        return -1;
+    }
+    int result = collect_history_tips(&repo, tips, tip_count);
+    git_repository_close(&repo);
+    return result;
+}
+
+/**
+ * Log the commits reachable from tips but not from seen
+ */
+int stream_git_log_between(const LogStreamHandler *handler, const GitRef *seen, int seen_count,
+                           const GitRef *tips, int tip_count) {
+    assert(handler != NULL);
+    assert(seen != NULL || seen_count == 0);
+    assert(tips != NULL || tip_count == 0);
+
+    if (seen_count > 0 && !tips_still_reachable(seen, seen_count, tips, tip_count)) {
+        return 1;
+    }
+    return (stream_new_commits(handler, NULL, tips, tip_count, seen, seen_count) == 0) ? 0 : -1;
+}
+
+/**
+ * Serve the walk from the history cache, logging only commits added since
+ * the cached tips and appending them to the cache
+ */
+int stream_cached_history(const LogStreamHandler *handler, GitRef **covered, int *covered_count) {
+    assert(handler != NULL);
+    assert((covered == NULL) == (covered_count == NULL));
+
+    GitRepository repo;
+    if (git_repository_open(&repo) != 0) {
+        return -1;
+    }
+
+    /* Deepening a shallow clone adds history behind the cached tips */
+    GitRef *tips;
+    int tip_count;
+    char path[MAX_PATH_LENGTH];
+    if (repo.shallow.count > 0 || history_cache_path(&repo, path, sizeof(path)) != 0 ||
+        collect_history_tips(&repo, &tips, &tip_count) != 0) {
+        git_repository_close(&repo);
+        return -1;
+    }
+    git_repository_close(&repo);
+
+    char context[MAX_LINE_LENGTH];
+    history_cache_context(context, sizeof(context));
+
+    HistoryCache cache;
+    if (history_cache_load(&cache, path, context) != 0) {
+        git_refs_free(tips, tip_count);
+        return -1;
+    }
+
+    /* Extend the cache only if everything it covers is still in history */
+    int extend = (cache.valid_size > 0 &&
+                  tips_still_reachable(cache.tips, cache.tip_count, tips, tip_count));
+    if (extend && git_refs_equal(cache.tips, cache.tip_count, tips, tip_count)) {
+        history_cache_replay(&cache, handler);
+        history_cache_free(&cache);
+        hand_over_tips(tips, tip_count, covered, covered_count);
+        return 0;
+    }
+
+    HistoryCacheWriter writer;
+    int result = history_cache_writer_init(&writer);
+    if (result == 0) {
+        result = stream_new_commits(handler, &writer, tips, tip_count,
+                                    extend ? cache.tips : NULL, extend ? cache.tip_count : 0);
+    }
+
+    if (result >= 0) {
+        if (extend) {
+            history_cache_replay(&cache, handler);
+        }
+        /* A failed write only costs the next run a longer walk */
+        if (result == 0) {
+            history_cache_write(&writer, path, context, extend ? &cache : NULL, tips, tip_count);
+        }
+    }
+
+    history_cache_writer_free(&writer);
+    history_cache_free(&cache);
+    if (result >= 0) {
+        hand_over_tips(tips, tip_count, covered, covered_count);
+        return 0;
+    }
+    git_refs_free(tips, tip_count);
+    return -1;
+}
+
+/**
+ * Give a walk's tips to a caller that asked for them, else release them
+ */
+static void hand_over_tips(GitRef *tips, int tip_count, GitRef **covered, int *covered_count) {
+    if (covered == NULL) {
+        git_refs_free(tips, tip_count);
+        return;
+    }
+    *covered = tips;
+    *covered_count = tip_count;
+}
+
+/**
+ * Resolve every ref (and a detached HEAD) to the commit git log starts from
+ * Fails for repositories with replace refs, which rewrite history in place.
+ */
+static int collect_history_tips(GitRepository *repo, GitRef **tips, int *tip_count) {
+    GitRef *refs;
+    int ref_count;
+    if (git_repository_list_refs(repo, "refs/", 1, &refs, &ref_count) != 0) {
+        return -1;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < ref_count; i++) {
+        if (strncmp(refs[i].name, "refs/replace/", 13) == 0) {
+            git_refs_free(refs, ref_count);
+            return -1;
+        }
+
+        /* Refs to trees or blobs carry no history */
+        ObjectId commit;
+        if (peel_to_commit(repo, &refs[i].oid, &commit) != 0) {
+            free(refs[i].name);
+            continue;
+        }
+        refs[kept].name = refs[i].name;
+        refs[kept].oid = commit;
+        kept++;
+    }
+
+    *tips = refs;
+    *tip_count = kept;
+    return 0;
+}
+
+/**
+ * Check that every previously seen tip is reachable from the current tips
+ * Tips that are still current need no check; the rest (deleted or
+ * rewound refs) are tested with one `git rev-list --count`.
+ * @return 1 if the seen history is still fully reachable, 0 otherwise
+ */
+static int tips_still_reachable(const GitRef *seen, int seen_count, const GitRef *tips, int tip_count) {
+    ObjectIdSet current;
+    if (oid_set_init(&current) != 0) {
+        return 0;
+    }
+
+    int missing = 0;
+    for (int i = 0; i < tip_count && missing >= 0; i++) {
+        if (oid_set_insert(&current, &tips[i].oid) < 0) missing = -1;
+    }
+    for (int i = 0; i < seen_count && missing >= 0; i++) {
+        if (!oid_set_contains(&current, &seen[i].oid)) missing++;
+    }
+    oid_set_free(&current);
+
+    if (missing <= 0) {
+        return missing == 0;
+    }
+
+    /* Count commits reachable from the old tips but from none of the new */
+    size_t input_size;
+    char *input = format_revisions(seen, seen_count, tips, tip_count, &input_size);
+    if (input == NULL) {
+        return 0;
+    }
+
+    const char *const argv[] = {"git", "rev-list", "--count", "--stdin", NULL};
+    long count = -1;
+    int status = subprocess_stream(argv, input, input_size, '\n', keep_count_line, &count);
+    free(input);
+    return (status == 0 && count == 0);
+}
+
+/**
+ * Log commits reachable from tips but not from seen, feeding both the
+ * handler and the cache writer
+ * @return 0 on success, 1 if git failed part way, -1 if it could not start
+ */
+static int stream_new_commits(const LogStreamHandler *handler, HistoryCacheWriter *writer,
+                              const GitRef *tips, int tip_count, const GitRef *seen, int seen_count) {
+    if (tip_count == 0) {
+        return 0; /* No refs yet, so no history */
+    }
+
+    /* git reads every revision before it starts printing */
+    size_t input_size;
+    char *input = format_revisions(tips, tip_count, seen, seen_count, &input_size);
+    if (input == NULL) {
+        return -1;
+    }
+
+    const char *const argv[] = {"git", "log", "--stdin", "--numstat", "--date=short",
+                                LOG_STREAM_FORMAT, NULL};
+    LogLineSink sink = {handler, writer};
+    int status = subprocess_stream(argv, input, input_size, '\n', dispatch_log_line, &sink);
+    free(input);
+    return (status == 0) ? 0 : 1;
+}
+
+/**
+ * Build "<oid>\n" lines for include and "^<oid>\n" lines for exclude, the
+ * revision list read by git --stdin
+ * @return Allocated list, or NULL on allocation failure
+ */
+static char* format_revisions(const GitRef *include, int include_count,
+                              const GitRef *exclude, int exclude_count, size_t *size) {
+    size_t capacity = ((size_t)include_count + (size_t)exclude_count) * (OID_HEX_SIZE + 2) + 1;
+    char *list = malloc(capacity);
+    if (list == NULL) {
+        return NULL;
+    }
+
+    char *out = list;
+    for (int i = 0; i < include_count; i++) {
+        oid_to_hex(&include[i].oid, out);
+        out += OID_HEX_SIZE;
+        *out++ = '\n';
+    }
+    for (int i = 0; i < exclude_count; i++) {
+        *out++ = '^';
+        oid_to_hex(&exclude[i].oid, out);
+        out += OID_HEX_SIZE;
+        *out++ = '\n';
+    }
+
+    *size = (size_t)(out - list);
+    return list;
+}
+
+/**
+ * Parse one line of log output and feed the handler (and cache writer)
+ */
+static int dispatch_log_line(char *line, size_t length, void *ctx) {
+    LogLineSink *sink = ctx;
+    const LogStreamHandler *handler = sink->handler;
+    HistoryCacheWriter *writer = sink->writer;
+
+    if (length == 0) {
+        return 0;
+    }
+
+    if (line[0] == LOG_RECORD_MARKER) {
+        LogCommit commit;
+        ObjectId oid;
+        if (parse_commit_header(line + 1, &commit) != 0 ||
+            (writer != NULL && oid_from_hex(commit.id, &oid) != 0)) {
+            if (writer != NULL) writer->failed = 1;
+            return 0;
+        }
+        if (handler->on_commit != NULL) {
+            handler->on_commit(&commit, handler->ctx);
+        }
+        if (writer != NULL) {
+            history_cache_writer_add_commit(writer, &oid, commit.author, commit.date);
+        }
+        return 0;
+    }
+
+    LogFileChange change;
+    if (parse_numstat_line(line, &change) != 0) {
+        return 0;
+    }
+    if (handler->on_file != NULL) {
+        handler->on_file(&change, handler->ctx);
+    }
+    if (writer != NULL) {
+        history_cache_writer_add_file(writer, &change);
+    }
+    return 0;
+}
+
+/**
+ * Parse the single count printed by `git rev-list --count`
+ */
+static int keep_count_line(char *line, size_t length, void *ctx) {
+    long *count = ctx;
+    char *end;
+    long value = strtol(line, &end, 10);
+    *count = (length > 0 && *end == '\0' && value >= 0) ? value : -1;
+    return 0;
+}
+
+/**
+ * Parse "hash<US>author<US>date" commit header
+ * @return 0 on success, -1 if the header is malformed
+ */
+static int parse_commit_header(char *line, LogCommit *commit) {
+    char *author = strchr(line, LOG_FIELD_SEPARATOR);
+    if (author == NULL) return -1;
+    *author++ = '\0';
+
+    char *date = strchr(author, LOG_FIELD_SEPARATOR);
+    if (date == NULL) return -1;
+    *date++ = '\0';
+
+    commit->id = line;
+    commit->author = author;
+    commit->date = date;
+    return 0;
+}
+
+/**
+ * Parse "added<TAB>deleted<TAB>path" numstat line
+ * Binary files report "-" for both counts and are treated as zero
+ * @return 0 on success, -1 if the line is malformed
+ */
+static int parse_numstat_line(char *line, LogFileChange *change) {
+    char *deleted = strchr(line, '\t');
+    if (deleted == NULL) return -1;
+    *deleted++ = '\0';
+
+    char *path = strchr(deleted, '\t');
+    if (path == NULL) return -1;
+    *path++ = '\0';
+
+    resolve_rename_path(path);
+
+    change->path = path;
+    change->lines_added = (line[0] == '-') ? 0 : (int)strtol(line, NULL, 10);
+    change->lines_deleted = (deleted[0] == '-') ? 0 : (int)strtol(deleted, NULL, 10);
+    return 0;
+}
+
+/**
+ * Rewrite a numstat rename ("old => new" or "dir/{old => new}/file")
+ * in place to the destination path
+ */
+static void resolve_rename_path(char *path) {
+    char *arrow = strstr(path, " => ");
+    if (arrow == NULL) return;
+
+    char *open = strchr(path, '{');
+    char *close = (open != NULL) ? strchr(arrow, '}') : NULL;
+
+    if (open == NULL || close == NULL || open > arrow) {
+        /* Whole path renamed: keep the part after the arrow */
+        memmove(path, arrow + 4, strlen(arrow + 4) + 1);
+        return;
+    }
+
+    /* prefix{old => new}suffix -> prefix + new + suffix */
+    const char *new_part = arrow + 4;
+    size_t new_length = (size_t)(close - new_part);
+    const char *suffix = close + 1;
+
+    /* "dir/{old => }/file" must not produce "dir//file" */
+    if (new_length == 0 && suffix[0] == '/' && (open == path || open[-1] == '/')) {
+        suffix++;
+    }
+
+    memmove(open, new_part, new_length);
+    memmove(open + new_length, suffix, strlen(suffix) + 1);
+}
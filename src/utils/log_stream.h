@@ -0,0 +1,99 @@
+#ifndef LOG_STREAM_H
+#define LOG_STREAM_H
+
+#include "../git_stats.h"
+#include "git_repo.h"
+
+/**
+ * Commit header parsed from the git log stream
+ */
+typedef struct {
+    const char *id;     /* Hex commit id */
+    const char *author;
+    const char *date;   /* YYYY-MM-DD */
+} LogCommit;
+
+/**
+ * Per-file line change parsed from a --numstat line
+ * Binary files are reported with zero added and deleted lines
+ */
+typedef struct {
+    const char *path;   /* Post-rename path */
+    int lines_added;
+    int lines_deleted;
+} LogFileChange;
+
+/**
+ * History a walk covers
+ */
+typedef enum {
+    LOG_SCOPE_ALL,      /* Every ref and a detached HEAD (git log --all) */
+    LOG_SCOPE_HEAD      /* Only commits reachable from HEAD (git log HEAD) */
+} LogScope;
+
+/**
+ * Callbacks invoked while streaming git log output
+ * on_file is always called after the on_commit of the commit it belongs to.
+ * Either callback may be NULL. Strings are only valid during the call.
+ */
+typedef struct {
+    void (*on_commit)(const LogCommit *commit, void *ctx);
+    void (*on_file)(const LogFileChange *change, void *ctx);
+    void *ctx;
+} LogStreamHandler;
+
+/**
+ * Walk history once with `git log --numstat` and dispatch every commit
+ * and file change to the handler
+ * With options->use_cache, cached commits are replayed from
+ * .git/git-stat/cache and only commits added since are logged. Records
+ * then arrive in no particular order. The cache covers every ref, so a
+ * LOG_SCOPE_HEAD walk replays only the cached commits reachable from HEAD.
+ * An unborn HEAD has no history to stream.
+ * @param handler Callbacks to invoke for each parsed record
+ * @param options Collection options
+ * @param scope History to cover
+ * @return 0 on success, -1 if git could not be started
+ */
+int stream_git_log(const LogStreamHandler *handler, const CollectOptions *options, LogScope scope);
+
+/**
+ * Walk the history of all refs through the history cache, as
+ * stream_git_log() does with options->use_cache
+ * Cached commits are replayed and only commits added since are logged
+ * (and appended to the cache).
+ * @param handler Callbacks to invoke for each parsed record
+ * @param covered Receives the tips the walk covered, sorted by name
+ *                (release with git_refs_free()), or NULL
+ * @param covered_count Receives the number of tips, or NULL
+ * @return 0 on success, -1 if the cache cannot be used (nothing was streamed)
+ */
+int stream_cached_history(const LogStreamHandler *handler, GitRef **covered, int *covered_count);
+
+/**
+ * Resolve the tips a full history walk starts from: every ref and a
+ * detached HEAD, peeled to commits and sorted by name
+ * Release the list with git_refs_free().
+ * @param tips Receives the allocated tip list
+ * @param tip_count Receives the number of tips
+ * @return 0 on success, -1 if the repository cannot be read in-process or
+ *         uses replace refs
+ */
+int log_stream_tips(GitRef **tips, int *tip_count);
+
+/**
+ * Log only the commits reachable from tips but not from seen, so history
+ * that has already been streamed is not walked again
+ * Records arrive in no particular order. Pass no seen tips for a full walk.
+ * @param handler Callbacks to invoke for each parsed record
+ * @param seen Tips of the history already streamed
+ * @param seen_count Number of seen tips
+ * @param tips Current tips, from log_stream_tips()
+ * @param tip_count Number of current tips
+ * @return 0 on success, 1 if some seen history is no longer reachable
+ *         (nothing was streamed), -1 if git failed
+ */
+int stream_git_log_between(const LogStreamHandler *handler, const GitRef *seen, int seen_count,
+                           const GitRef *tips, int tip_count);
+
+#endif /* LOG_STREAM_H */
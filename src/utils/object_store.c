@@ -0,0 +1,921 @@
+#define _GNU_SOURCE
+#include "object_store.h"
+#include "vector.h"
+#include "profile.h"
+#include "../git_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/* Pack index version 2 header: "\377tOc" magic followed by version */
+#define PACK_INDEX_MAGIC 0xff744f63U
+#define PACK_INDEX_VERSION 2
+#define PACK_INDEX_HEADER_SIZE 8
+#define PACK_FANOUT_SIZE (256 * 4)
+#define PACK_HEADER_SIZE 12
+
+/* Deepest delta chain followed before giving up */
+#define MAX_DELTA_DEPTH 10000
+
+/* Objects larger than this are not kept in the delta base cache */
+#define DELTA_CACHE_MAX_OBJECT (4 * 1024 * 1024)
+
+/* Forward declarations */
+static int add_object_dir(ObjectStore *store, const char *path);
+static void load_alternates(ObjectStore *store, const char *objects_dir);
+static int load_packs(ObjectStore *store, const char *objects_dir);
+static int open_pack(PackFile *pack, const char *index_path);
+static int find_in_pack(const PackFile *pack, const ObjectId *oid, uint64_t *offset);
+static int read_object(ObjectStore *store, const ObjectId *oid, int depth,
+                       ObjectType *type, unsigned char **data, size_t *size);
+static int read_pack_object(ObjectStore *store, const PackFile *pack, uint64_t offset, int depth,
+                            ObjectType *type, unsigned char **data, size_t *size);
+static int read_loose_object(const char *objects_dir, const ObjectId *oid,
+                             ObjectType *type, unsigned char **data, size_t *size);
+static int inflate_exact(const unsigned char *in, size_t in_size, unsigned char *out, size_t out_size);
+static int apply_delta(const unsigned char *base, size_t base_size,
+                       const unsigned char *delta, size_t delta_size,
+                       unsigned char **result, size_t *result_size);
+static uint32_t read_be32(const unsigned char *p);
+
+/**
+ * Open an object database
+ */
+int object_store_open(ObjectStore *store, const char *objects_dir) {
+    assert(store != NULL);
+    assert(objects_dir != NULL);
+
+    memset(store, 0, sizeof(ObjectStore));
+
+#ifdef _WIN32
+    /* Packs are memory-mapped; callers fall back to the git CLI */
+    return -1;
+#else
+    struct stat st;
+    if (stat(objects_dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return -1;
+    }
+
+    store->delta_cache = calloc(DELTA_BASE_CACHE_SIZE, sizeof(DeltaBaseEntry));
+    if (store->delta_cache == NULL || add_object_dir(store, objects_dir) != 0) {
+        object_store_close(store);
+        return -1;
+    }
+    load_alternates(store, objects_dir);
+
+    /* Directories may be added while iterating, so use the live count */
+    for (int i = 0; i < store->object_dir_count; i++) {
+        if (load_packs(store, store->object_dirs[i]) != 0) {
+            object_store_close(store);
+            return -1;
+        }
+    }
+
+    return 0;
+#endif
+}
+
+/**
+ * Unmap all packs and release the store
+ */
+void object_store_close(ObjectStore *store) {
+    assert(store != NULL);
+
+    for (int i = 0; i < store->pack_count; i++) {
+        object_file_unmap(store->packs[i].index, store->packs[i].index_size);
+        object_file_unmap(store->packs[i].pack, store->packs[i].pack_size);
+    }
+    free(store->packs);
+
+    for (int i = 0; i < store->object_dir_count; i++) {
+        free(store->object_dirs[i]);
+    }
+    free(store->object_dirs);
+
+    if (store->delta_cache != NULL) {
+        for (int i = 0; i < DELTA_BASE_CACHE_SIZE; i++) {
+            free(store->delta_cache[i].data);
+        }
+        free(store->delta_cache);
+    }
+
+    memset(store, 0, sizeof(ObjectStore));
+}
+
+/**
+ * Read and fully resolve an object
+ */
+int object_store_read(ObjectStore *store, const ObjectId *oid,
+                      ObjectType *type, unsigned char **data, size_t *size) {
+    assert(store != NULL);
+    assert(oid != NULL);
+    assert(type != NULL && data != NULL && size != NULL);
+
+    return read_object(store, oid, 0, type, data, size);
+}
+
+/**
+ * Read an object as the base of a delta chain `depth` links long
+ * REF_DELTA bases come back through here, so the chain limit holds for
+ * them as it does for OFS_DELTA bases, and a cycle fails instead of
+ * recursing without end.
+ */
+static int read_object(ObjectStore *store, const ObjectId *oid, int depth,
+                       ObjectType *type, unsigned char **data, size_t *size) {
+    /* Packed objects are the common case in established repositories */
+    for (int i = 0; i < store->pack_count; i++) {
+        uint64_t offset;
+        if (find_in_pack(&store->packs[i], oid, &offset) == 0) {
+            return read_pack_object(store, &store->packs[i], offset, depth, type, data, size);
+        }
+    }
+
+    for (int i = 0; i < store->object_dir_count; i++) {
+        if (read_loose_object(store->object_dirs[i], oid, type, data, size) == 0) {
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Parse a 40-character hex object id
+ */
+int oid_from_hex(const char *hex, ObjectId *oid) {
+    assert(hex != NULL);
+    assert(oid != NULL);
+
+    for (int i = 0; i < OID_RAW_SIZE; i++) {
+        int value = 0;
+        for (int j = 0; j < 2; j++) {
+            char c = hex[i * 2 + j];
+            int digit;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+            else return -1;
+            value = value * 16 + digit;
+        }
+        oid->hash[i] = (unsigned char)value;
+    }
+
+    return 0;
+}
+
+/**
+ * Format an object id as hex
+ */
+void oid_to_hex(const ObjectId *oid, char *hex) {
+    assert(oid != NULL);
+    assert(hex != NULL);
+
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < OID_RAW_SIZE; i++) {
+        hex[i * 2] = digits[oid->hash[i] >> 4];
+        hex[i * 2 + 1] = digits[oid->hash[i] & 0x0f];
+    }
+    hex[OID_HEX_SIZE] = '\0';
+}
+
+/**
+ * Register an objects directory
+ */
+static int add_object_dir(ObjectStore *store, const char *path) {
+    char **grown = realloc(store->object_dirs, sizeof(char *) * (size_t)(store->object_dir_count + 1));
+    if (grown == NULL) {
+        return -1;
+    }
+    store->object_dirs = grown;
+
+    store->object_dirs[store->object_dir_count] = strdup(path);
+    if (store->object_dirs[store->object_dir_count] == NULL) {
+        return -1;
+    }
+    store->object_dir_count++;
+
+    return 0;
+}
+
+/**
+ * Add directories listed in objects/info/alternates
+ */
+static void load_alternates(ObjectStore *store, const char *objects_dir) {
+    char path[MAX_PATH_LENGTH];
+    int ret = snprintf(path, sizeof(path), "%s/info/alternates", objects_dir);
+    if (ret < 0 || ret >= (int)sizeof(path)) return;
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return;
+
+    char line[MAX_PATH_LENGTH];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        /* Relative alternates are relative to the objects directory */
+        char alternate[MAX_PATH_LENGTH];
+        if (line[0] == '/') {
+            ret = snprintf(alternate, sizeof(alternate), "%s", line);
+        } else {
+            ret = snprintf(alternate, sizeof(alternate), "%s/%s", objects_dir, line);
+        }
+        if (ret > 0 && ret < (int)sizeof(alternate)) {
+            add_object_dir(store, alternate);
+        }
+    }
+
+    fclose(file);
+}
+
+/**
+ * Map every pack-*.idx found in objects/pack
+ */
+static int load_packs(ObjectStore *store, const char *objects_dir) {
+    char pack_dir[MAX_PATH_LENGTH];
+    int ret = snprintf(pack_dir, sizeof(pack_dir), "%s/pack", objects_dir);
+    if (ret < 0 || ret >= (int)sizeof(pack_dir)) return -1;
+
+    DIR *dir = opendir(pack_dir);
+    if (dir == NULL) {
+        return 0; /* No packs yet */
+    }
+
+    const struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length < 4 || strcmp(entry->d_name + length - 4, ".idx") != 0) continue;
+
+        char index_path[MAX_PATH_LENGTH];
+        ret = snprintf(index_path, sizeof(index_path), "%s/%s", pack_dir, entry->d_name);
+        if (ret < 0 || ret >= (int)sizeof(index_path)) continue;
+
+        if (VECTOR_RESERVE(store->packs, store->pack_capacity, store->pack_count + 1) != 0) {
+            closedir(dir);
+            return -1;
+        }
+
+        /* Unreadable or unsupported packs are skipped; lookups then fail cleanly */
+        if (open_pack(&store->packs[store->pack_count], index_path) == 0) {
+            store->pack_count++;
+        }
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+/**
+ * Map a version 2 pack index and its pack
+ */
+static int open_pack(PackFile *pack, const char *index_path) {
+    memset(pack, 0, sizeof(PackFile));
+
+    pack->index = object_file_map(index_path, &pack->index_size);
+    if (pack->index == NULL) {
+        return -1;
+    }
+
+    if (pack->index_size < PACK_INDEX_HEADER_SIZE + PACK_FANOUT_SIZE ||
+        read_be32(pack->index) != PACK_INDEX_MAGIC ||
+        read_be32(pack->index + 4) != PACK_INDEX_VERSION) {
+        object_file_unmap(pack->index, pack->index_size);
+        return -1;
+    }
+
+    const unsigned char *fanout = pack->index + PACK_INDEX_HEADER_SIZE;
+    pack->object_count = read_be32(fanout + 255 * 4);
+    pack->oid_table = fanout + PACK_FANOUT_SIZE;
+
+    /* Fanout must be cumulative, so no bucket reaches past object_count */
+    int valid = 1;
+    for (int i = 1; valid && i < 256; i++) {
+        if (read_be32(fanout + i * 4) < read_be32(fanout + (i - 1) * 4)) {
+            valid = 0;
+        }
+    }
+
+    /* Layout: oids, CRC32s, 32-bit offsets, then 64-bit offsets */
+    size_t count = pack->object_count;
+    size_t minimum = PACK_INDEX_HEADER_SIZE + PACK_FANOUT_SIZE + count * (OID_RAW_SIZE + 4 + 4);
+    if (!valid || pack->index_size < minimum) {
+        object_file_unmap(pack->index, pack->index_size);
+        return -1;
+    }
+    pack->offset_table = pack->oid_table + count * (OID_RAW_SIZE + 4);
+    pack->large_offset_table = pack->offset_table + count * 4;
+
+    char pack_path[MAX_PATH_LENGTH];
+    int ret = snprintf(pack_path, sizeof(pack_path), "%.*s.pack",
+                       (int)(strlen(index_path) - 4), index_path);
+    if (ret < 0 || ret >= (int)sizeof(pack_path)) {
+        object_file_unmap(pack->index, pack->index_size);
+        return -1;
+    }
+
+    pack->pack = object_file_map(pack_path, &pack->pack_size);
+    if (pack->pack == NULL || pack->pack_size < PACK_HEADER_SIZE ||
+        memcmp(pack->pack, "PACK", 4) != 0) {
+        object_file_unmap(pack->pack, pack->pack_size);
+        object_file_unmap(pack->index, pack->index_size);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Map a whole file read-only
+ */
+const unsigned char* object_file_map(const char *path, size_t *size) {
+#ifdef _WIN32
+    (void)path;
+    *size = 0;
+    return NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = (size_t)st.st_size;
+    return (const unsigned char *)data;
+#endif
+}
+
+/**
+ * Release a mapping made by object_file_map()
+ */
+void object_file_unmap(const unsigned char *data, size_t size) {
+#ifndef _WIN32
+    if (data != NULL) {
+        munmap((void *)data, size);
+    }
+#else
+    (void)data;
+    (void)size;
+#endif
+}
+
+/**
+ * Binary search a pack index for an object
+ */
+static int find_in_pack(const PackFile *pack, const ObjectId *oid, uint64_t *offset) {
+    const unsigned char *fanout = pack->index + PACK_INDEX_HEADER_SIZE;
+    unsigned first = oid->hash[0];
+
+    uint32_t low = (first == 0) ? 0 : read_be32(fanout + (first - 1) * 4);
+    uint32_t high = read_be32(fanout + first * 4);
+    if (high > pack->object_count) {
+        high = pack->object_count;
+    }
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        int cmp = memcmp(pack->oid_table + (size_t)middle * OID_RAW_SIZE, oid->hash, OID_RAW_SIZE);
+        if (cmp == 0) {
+            uint32_t small = read_be32(pack->offset_table + (size_t)middle * 4);
+            if (small & 0x80000000U) {
+                /* Bound the entry number before forming a pointer to it */
+                size_t large_index = small & 0x7fffffffU;
+                size_t large_count = (pack->index_size -
+                                      (size_t)(pack->large_offset_table - pack->index)) / 8;
+                if (large_index >= large_count) return -1;
+                const unsigned char *large = pack->large_offset_table + large_index * 8;
+                *offset = ((uint64_t)read_be32(large) << 32) | read_be32(large + 4);
+            } else {
+                *offset = small;
+            }
+            return 0;
+        }
+        if (cmp < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Copy a cached delta base, if present
+ */
+static int delta_cache_get(ObjectStore *store, const PackFile *pack, uint64_t offset,
+                           ObjectType *type, unsigned char **data, size_t *size) {
+    const DeltaBaseEntry *entry = &store->delta_cache[(offset ^ (offset >> 12)) % DELTA_BASE_CACHE_SIZE];
+    if (entry->data == NULL || entry->pack != pack || entry->offset != offset) {
+        return -1;
+    }
+
+    *data = malloc(entry->size + 1);
+    if (*data == NULL) {
+        return -1;
+    }
+    memcpy(*data, entry->data, entry->size); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    (*data)[entry->size] = '\0';
+    *type = entry->type;
+    *size = entry->size;
+
+    return 0;
+}
+
+/**
+ * Remember a resolved delta base
+ */
+static void delta_cache_put(ObjectStore *store, const PackFile *pack, uint64_t offset,
+                            ObjectType type, const unsigned char *data, size_t size) {
+    if (size > DELTA_CACHE_MAX_OBJECT) return;
+
+    DeltaBaseEntry *entry = &store->delta_cache[(offset ^ (offset >> 12)) % DELTA_BASE_CACHE_SIZE];
+    unsigned char *copy = malloc(size + 1);
+    if (copy == NULL) return;
+    memcpy(copy, data, size); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+
+    free(entry->data);
+    entry->pack = pack;
+    entry->offset = offset;
+    entry->type = type;
+    entry->data = copy;
+    entry->size = size;
+}
+
+/**
+ * Read the object stored at a pack offset, resolving delta chains
+ */
+static int read_pack_object(ObjectStore *store, const PackFile *pack, uint64_t offset, int depth,
+                            ObjectType *type, unsigned char **data, size_t *size) {
+    if (depth > MAX_DELTA_DEPTH || offset >= pack->pack_size) {
+        return -1;
+    }
+
+    const unsigned char *p = pack->pack + offset;
+    const unsigned char *end = pack->pack + pack->pack_size;
+
+    /* Entry header: 3-bit type and variable-length inflated size */
+    unsigned c = *p++;
+    ObjectType entry_type = (ObjectType)((c >> 4) & 7);
+    uint64_t entry_size = c & 15;
+    int shift = 4;
+    while (c & 0x80) {
+        if (p >= end || shift > 57) return -1;
+        c = *p++;
+        entry_size |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    }
+
+    uint64_t base_offset = 0;
+    ObjectId base_oid;
+
+    if (entry_type == OBJECT_OFS_DELTA) {
+        /* Negative offset to the base, in git's offset encoding */
+        if (p >= end) return -1;
+        c = *p++;
+        uint64_t distance = c & 0x7f;
+        while (c & 0x80) {
+            if (p >= end) return -1;
+            c = *p++;
+            distance = ((distance + 1) << 7) | (c & 0x7f);
+        }
+        if (distance == 0 || distance > offset) return -1;
+        base_offset = offset - distance;
+    } else if (entry_type == OBJECT_REF_DELTA) {
+        if (p + OID_RAW_SIZE > end) return -1;
+        memcpy(base_oid.hash, p, OID_RAW_SIZE); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+        p += OID_RAW_SIZE;
+    } else if (entry_type < OBJECT_COMMIT || entry_type > OBJECT_TAG) {
+        return -1;
+    }
+
+    if (entry_size > SIZE_MAX - 1) return -1;
+    unsigned char *inflated = malloc((size_t)entry_size + 1);
+    if (inflated == NULL) {
+        return -1;
+    }
+    if (inflate_exact(p, (size_t)(end - p), inflated, (size_t)entry_size) != 0) {
+        free(inflated);
+        return -1;
+    }
+    inflated[entry_size] = '\0';
+
+    if (entry_type != OBJECT_OFS_DELTA && entry_type != OBJECT_REF_DELTA) {
+        *type = entry_type;
+        *data = inflated;
+        *size = (size_t)entry_size;
+        return 0;
+    }
+
+    /* Resolve the base, then apply the delta on top of it */
+    ObjectType base_type;
+    unsigned char *base;
+    size_t base_size;
+    int base_result;
+
+    if (entry_type == OBJECT_OFS_DELTA) {
+        base_result = delta_cache_get(store, pack, base_offset, &base_type, &base, &base_size);
+        if (base_result != 0) {
+            base_result = read_pack_object(store, pack, base_offset, depth + 1, &base_type, &base, &base_size);
+            if (base_result == 0) {
+                delta_cache_put(store, pack, base_offset, base_type, base, base_size);
+            }
+        }
+    } else {
+        base_result = read_object(store, &base_oid, depth + 1, &base_type, &base, &base_size);
+    }
+
+    if (base_result != 0) {
+        free(inflated);
+        return -1;
+    }
+
+    int result = apply_delta(base, base_size, inflated, (size_t)entry_size, data, size);
+    free(base);
+    free(inflated);
+    if (result != 0) {
+        return -1;
+    }
+
+    *type = base_type;
+    return 0;
+}
+
+/**
+ * Read a zlib-compressed loose object from objects/xx/yyyy...
+ */
+static int read_loose_object(const char *objects_dir, const ObjectId *oid,
+                             ObjectType *type, unsigned char **data, size_t *size) {
+    char hex[OID_HEX_SIZE + 1];
+    oid_to_hex(oid, hex);
+
+    char path[MAX_PATH_LENGTH];
+    int ret = snprintf(path, sizeof(path), "%s/%.2s/%s", objects_dir, hex, hex + 2);
+    if (ret < 0 || ret >= (int)sizeof(path)) return -1;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || st.st_size <= 0) {
+        fclose(file);
+        return -1;
+    }
+
+    size_t compressed_size = (size_t)st.st_size;
+    unsigned char *compressed = malloc(compressed_size);
+    if (compressed == NULL) {
+        fclose(file);
+        return -1;
+    }
+    size_t read_size = fread(compressed, 1, compressed_size, file);
+    fclose(file);
+    profile_count_file_bytes(read_size);
+    if (read_size != compressed_size) {
+        free(compressed);
+        return -1;
+    }
+
+    /* Inflate just enough to read the "<type> <size>\0" header */
+    unsigned char header[64];
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        free(compressed);
+        return -1;
+    }
+    stream.next_in = compressed;
+    stream.avail_in = (uInt)compressed_size;
+    stream.next_out = header;
+    stream.avail_out = sizeof(header);
+
+    int status = inflate(&stream, Z_SYNC_FLUSH);
+    size_t header_bytes = sizeof(header) - stream.avail_out;
+    const unsigned char *nul = memchr(header, '\0', header_bytes);
+    if ((status != Z_OK && status != Z_STREAM_END) || nul == NULL) {
+        inflateEnd(&stream);
+        free(compressed);
+        return -1;
+    }
+
+    char type_name[16];
+    unsigned long long object_size;
+    if (sscanf((const char *)header, "%15s %llu", type_name, &object_size) != 2 || // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+        object_size > SIZE_MAX - 1) {
+        inflateEnd(&stream);
+        free(compressed);
+        return -1;
+    }
+
+    if (strcmp(type_name, "commit") == 0) *type = OBJECT_COMMIT;
+    else if (strcmp(type_name, "tree") == 0) *type = OBJECT_TREE;
+    else if (strcmp(type_name, "blob") == 0) *type = OBJECT_BLOB;
+    else if (strcmp(type_name, "tag") == 0) *type = OBJECT_TAG;
+    else {
+        inflateEnd(&stream);
+        free(compressed);
+        return -1;
+    }
+
+    unsigned char *contents = malloc((size_t)object_size + 1);
+    if (contents == NULL) {
+        inflateEnd(&stream);
+        free(compressed);
+        return -1;
+    }
+
+    /* Body bytes that were inflated along with the header */
+    size_t already = header_bytes - (size_t)(nul + 1 - header);
+    if (already > object_size) already = (size_t)object_size;
+    memcpy(contents, nul + 1, already); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+
+    stream.next_out = contents + already;
+    stream.avail_out = (uInt)((size_t)object_size - already);
+    while (status != Z_STREAM_END && stream.avail_out > 0) {
+        status = inflate(&stream, Z_FINISH);
+        if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) break;
+        if (status == Z_BUF_ERROR && stream.avail_in == 0) break;
+    }
+    size_t total = (size_t)(stream.next_out - contents);
+
+    inflateEnd(&stream);
+    free(compressed);
+
+    if (total != object_size) {
+        free(contents);
+        return -1;
+    }
+
+    contents[object_size] = '\0';
+    *data = contents;
+    *size = (size_t)object_size;
+    return 0;
+}
+
+/**
+ * Inflate a zlib stream that must produce exactly out_size bytes
+ */
+static int inflate_exact(const unsigned char *in, size_t in_size, unsigned char *out, size_t out_size) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        return -1;
+    }
+
+    stream.next_in = (Bytef *)in;
+    stream.avail_in = (in_size > UINT_MAX) ? UINT_MAX : (uInt)in_size;
+    stream.next_out = out;
+    stream.avail_out = (out_size > UINT_MAX) ? UINT_MAX : (uInt)out_size;
+
+    int status;
+    do {
+        status = inflate(&stream, Z_FINISH);
+        if (stream.avail_out == 0 && (size_t)stream.total_out < out_size) {
+            size_t remaining = out_size - (size_t)stream.total_out;
+            stream.avail_out = (remaining > UINT_MAX) ? UINT_MAX : (uInt)remaining;
+        }
+    } while (status == Z_OK || (status == Z_BUF_ERROR && stream.avail_out > 0 && stream.avail_in > 0));
+
+    size_t produced = (size_t)stream.total_out;
+    profile_count_file_bytes((size_t)stream.total_in); /* Pack bytes touched through the mapping */
+    inflateEnd(&stream);
+
+    /* A full output buffer may stop short of the end marker; the size still has to match */
+    if (status == Z_DATA_ERROR || status == Z_MEM_ERROR || status == Z_STREAM_ERROR || status == Z_NEED_DICT) {
+        return -1;
+    }
+    return (produced == out_size) ? 0 : -1;
+}
+
+/**
+ * Read a delta header size (little-endian base-128)
+ */
+static int read_delta_size(const unsigned char **p, const unsigned char *end, size_t *value) {
+    size_t result = 0;
+    int shift = 0;
+    unsigned c;
+
+    do {
+        if (*p >= end || shift > 63) return -1;
+        c = *(*p)++;
+        result |= (size_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    *value = result;
+    return 0;
+}
+
+/**
+ * Apply a git delta (copy/insert instructions) to a base object
+ */
+static int apply_delta(const unsigned char *base, size_t base_size,
+                       const unsigned char *delta, size_t delta_size,
+                       unsigned char **result, size_t *result_size) {
+    const unsigned char *p = delta;
+    const unsigned char *end = delta + delta_size;
+    size_t expected_base;
+    size_t target_size;
+
+    if (read_delta_size(&p, end, &expected_base) != 0 || expected_base != base_size ||
+        read_delta_size(&p, end, &target_size) != 0 || target_size > SIZE_MAX - 1) {
+        return -1;
+    }
+
+    unsigned char *target = malloc(target_size + 1);
+    if (target == NULL) {
+        return -1;
+    }
+    size_t written = 0;
+
+    while (p < end) {
+        unsigned op = *p++;
+
+        if (op & 0x80) {
+            /* Copy from base: bits 0-3 select offset bytes, bits 4-6 size bytes */
+            size_t copy_offset = 0;
+            size_t copy_size = 0;
+            for (int i = 0; i < 4; i++) {
+                if (op & (1U << i)) {
+                    if (p >= end) goto fail;
+                    copy_offset |= (size_t)*p++ << (8 * i);
+                }
+            }
+            for (int i = 0; i < 3; i++) {
+                if (op & (0x10U << i)) {
+                    if (p >= end) goto fail;
+                    copy_size |= (size_t)*p++ << (8 * i);
+                }
+            }
+            if (copy_size == 0) copy_size = 0x10000;
+
+            if (copy_offset > base_size || copy_size > base_size - copy_offset ||
+                copy_size > target_size - written) {
+                goto fail;
+            }
+            memcpy(target + written, base + copy_offset, copy_size); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+            written += copy_size;
+        } else if (op != 0) {
+            /* Insert the next op bytes literally */
+            if ((size_t)(end - p) < op || op > target_size - written) goto fail;
+            memcpy(target + written, p, op); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+            written += op;
+            p += op;
+        } else {
+            goto fail; /* Reserved opcode */
+        }
+    }
+
+    if (written != target_size) goto fail;
+
+    target[target_size] = '\0';
+    *result = target;
+    *result_size = target_size;
+    return 0;
+
+fail:
+    free(target);
+    return -1;
+}
+
+/**
+ * Read a big-endian 32-bit value
+ */
+static uint32_t read_be32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/* Object id set */
+
+/**
+ * Hash an object id (already uniformly distributed)
+ */
+static size_t oid_hash(const ObjectId *oid) {
+    size_t hash;
+    memcpy(&hash, oid->hash, sizeof(hash)); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    return hash;
+}
+
+/**
+ * Initialize an empty set
+ */
+int oid_set_init(ObjectIdSet *set) {
+    assert(set != NULL);
+
+    set->capacity = 1024;
+    set->count = 0;
+    set->slots = malloc(sizeof(ObjectId) * set->capacity);
+    set->used = calloc(set->capacity, 1);
+    if (set->slots == NULL || set->used == NULL) {
+        oid_set_free(set);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Release the set
+ */
+void oid_set_free(ObjectIdSet *set) {
+    assert(set != NULL);
+
+    free(set->slots);
+    free(set->used);
+    memset(set, 0, sizeof(ObjectIdSet));
+}
+
+/**
+ * Place an id without growing or checking for duplicates
+ */
+static void oid_set_place(ObjectId *slots, unsigned char *used, size_t capacity, const ObjectId *oid) {
+    size_t index = oid_hash(oid) & (capacity - 1);
+    while (used[index]) {
+        index = (index + 1) & (capacity - 1);
+    }
+    slots[index] = *oid;
+    used[index] = 1;
+}
+
+/**
+ * Insert an id into the set
+ */
+int oid_set_insert(ObjectIdSet *set, const ObjectId *oid) {
+    assert(set != NULL);
+    assert(oid != NULL);
+
+    if (oid_set_contains(set, oid)) {
+        return 0;
+    }
+
+    /* Keep the load factor at or below 1/2 */
+    if ((set->count + 1) * 2 > set->capacity) {
+        size_t new_capacity = set->capacity * 2;
+        ObjectId *new_slots = malloc(sizeof(ObjectId) * new_capacity);
+        unsigned char *new_used = calloc(new_capacity, 1);
+        if (new_slots == NULL || new_used == NULL) {
+            free(new_slots);
+            free(new_used);
+            return -1;
+        }
+
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->used[i]) {
+                oid_set_place(new_slots, new_used, new_capacity, &set->slots[i]);
+            }
+        }
+
+        free(set->slots);
+        free(set->used);
+        set->slots = new_slots;
+        set->used = new_used;
+        set->capacity = new_capacity;
+    }
+
+    oid_set_place(set->slots, set->used, set->capacity, oid);
+    set->count++;
+    return 1;
+}
+
+/**
+ * Test whether an id is in the set
+ */
+int oid_set_contains(const ObjectIdSet *set, const ObjectId *oid) {
+    assert(set != NULL);
+    assert(oid != NULL);
+
+    if (set->capacity == 0) {
+        return 0;
+    }
+
+    size_t index = oid_hash(oid) & (set->capacity - 1);
+    while (set->used[index]) {
+        if (memcmp(set->slots[index].hash, oid->hash, OID_RAW_SIZE) == 0) {
+            return 1;
+        }
+        index = (index + 1) & (set->capacity - 1);
+    }
+
+    return 0;
+}
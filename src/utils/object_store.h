@@ -0,0 +1,163 @@
+#ifndef OBJECT_STORE_H
+#define OBJECT_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* SHA-1 object id sizes */
+#define OID_RAW_SIZE 20
+#define OID_HEX_SIZE 40
+
+/**
+ * Git object types as stored in packfiles
+ */
+typedef enum {
+    OBJECT_NONE = 0,
+    OBJECT_COMMIT = 1,
+    OBJECT_TREE = 2,
+    OBJECT_BLOB = 3,
+    OBJECT_TAG = 4,
+    OBJECT_OFS_DELTA = 6,
+    OBJECT_REF_DELTA = 7
+} ObjectType;
+
+/**
+ * Binary object id
+ */
+typedef struct {
+    unsigned char hash[OID_RAW_SIZE];
+} ObjectId;
+
+/**
+ * Memory-mapped pack and its version 2 index
+ */
+typedef struct {
+    const unsigned char *index;
+    size_t index_size;
+    const unsigned char *pack;
+    size_t pack_size;
+    uint32_t object_count;
+    const unsigned char *oid_table;
+    const unsigned char *offset_table;
+    const unsigned char *large_offset_table;
+} PackFile;
+
+/**
+ * Inflated delta base kept for reuse by later deltas
+ */
+typedef struct {
+    const PackFile *pack;
+    uint64_t offset;
+    ObjectType type;
+    unsigned char *data;
+    size_t size;
+} DeltaBaseEntry;
+
+/* Direct-mapped delta base cache size (entries) */
+#define DELTA_BASE_CACHE_SIZE 256
+
+/**
+ * In-process reader for loose objects and packfiles
+ * Handles zlib inflation and OFS/REF delta resolution. Not thread-safe:
+ * open one store per thread.
+ */
+typedef struct {
+    char **object_dirs;     /* objects/ plus any alternates */
+    int object_dir_count;
+    PackFile *packs;
+    int pack_count;
+    int pack_capacity;
+    DeltaBaseEntry *delta_cache;
+} ObjectStore;
+
+/**
+ * Open an object database
+ * @param store Store to initialize
+ * @param objects_dir Path to the objects directory (e.g. ".git/objects")
+ * @return 0 on success, -1 on error
+ */
+int object_store_open(ObjectStore *store, const char *objects_dir);
+
+/**
+ * Unmap all packs and release the store
+ * @param store Store to close
+ */
+void object_store_close(ObjectStore *store);
+
+/**
+ * Read and fully resolve an object
+ * Caller is responsible for freeing *data
+ * @param store Object store to read from
+ * @param oid Object to read
+ * @param type Receives the object type (commit, tree, blob or tag)
+ * @param data Receives the allocated object contents
+ * @param size Receives the content size in bytes
+ * @return 0 on success, -1 if the object is missing or corrupt
+ */
+int object_store_read(ObjectStore *store, const ObjectId *oid,
+                      ObjectType *type, unsigned char **data, size_t *size);
+
+/**
+ * Map a whole file read-only
+ * @param path File to map
+ * @param size Receives the file size
+ * @return Mapping, or NULL if the file is missing, empty or cannot be mapped
+ */
+const unsigned char* object_file_map(const char *path, size_t *size);
+
+/**
+ * Release a mapping made by object_file_map()
+ * @param data Mapping (NULL is ignored)
+ * @param size Size of the mapping
+ */
+void object_file_unmap(const unsigned char *data, size_t size);
+
+/**
+ * Parse a 40-character hex object id
+ * @param hex Hex string (at least 40 characters)
+ * @param oid Receives the binary id
+ * @return 0 on success, -1 if the string is not valid hex
+ */
+int oid_from_hex(const char *hex, ObjectId *oid);
+
+/**
+ * Format an object id as 40 hex characters plus terminator
+ * @param oid Object id to format
+ * @param hex Output buffer of at least OID_HEX_SIZE + 1 bytes
+ */
+void oid_to_hex(const ObjectId *oid, char *hex);
+
+/**
+ * Open-addressing set of object ids
+ */
+typedef struct {
+    ObjectId *slots;
+    unsigned char *used;
+    size_t capacity;    /* Always a power of two */
+    size_t count;
+} ObjectIdSet;
+
+/**
+ * Initialize an empty set
+ * @return 0 on success, -1 on allocation failure
+ */
+int oid_set_init(ObjectIdSet *set);
+
+/**
+ * Release the set
+ */
+void oid_set_free(ObjectIdSet *set);
+
+/**
+ * Insert an id into the set
+ * @return 1 if inserted, 0 if already present, -1 on allocation failure
+ */
+int oid_set_insert(ObjectIdSet *set, const ObjectId *oid);
+
+/**
+ * Test whether an id is in the set
+ * @return 1 if present, 0 otherwise
+ */
+int oid_set_contains(const ObjectIdSet *set, const ObjectId *oid);
+
+#endif /* OBJECT_STORE_H */
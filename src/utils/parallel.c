@@ -0,0 +1,94 @@
+#define _GNU_SOURCE
+#include "parallel.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+/**
+ * Per-thread start arguments
+ */
+typedef struct {
+    ParallelTask task;
+    void *ctx;
+    int worker_index;
+    ProfilePhase *phase;    /* Caller's --profile phase, inherited by the thread */
+} ParallelWorker;
+
+/**
+ * pthread entry point
+ */
+static void* parallel_thread_main(void *arg) {
+    const ParallelWorker *worker = (const ParallelWorker *)arg;
+    profile_thread_begin(worker->phase);
+    worker->task(worker->worker_index, worker->ctx);
+    profile_thread_end();
+    return NULL;
+}
+
+/**
+ * Number of online processors
+ */
+int parallel_default_jobs(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long processors = (long)info.dwNumberOfProcessors;
+#else
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (processors > 0 && processors < 1024) ? (int)processors : 1;
+}
+
+/**
+ * Run a task on a fixed number of threads and wait for all of them
+ */
+void parallel_run(int workers, ParallelTask task, void *ctx) {
+    assert(task != NULL);
+
+    if (workers <= 1) {
+        task(0, ctx);
+        return;
+    }
+
+    pthread_t *threads = malloc(sizeof(pthread_t) * (size_t)workers);
+    ParallelWorker *args = malloc(sizeof(ParallelWorker) * (size_t)workers);
+    unsigned char *started = calloc((size_t)workers, 1);
+    if (threads == NULL || args == NULL || started == NULL) {
+        /* Degrade to running every worker index sequentially */
+        for (int i = 0; i < workers; i++) {
+            task(i, ctx);
+        }
+        free(threads);
+        free(args);
+        free(started);
+        return;
+    }
+
+    for (int i = 1; i < workers; i++) {
+        args[i].task = task;
+        args[i].ctx = ctx;
+        args[i].worker_index = i;
+        args[i].phase = profile_current();
+        started[i] = (pthread_create(&threads[i], NULL, parallel_thread_main, &args[i]) == 0);
+    }
+
+    task(0, ctx);
+
+    for (int i = 1; i < workers; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            task(i, ctx);
+        }
+    }
+
+    free(threads);
+    free(args);
+    free(started);
+}
@@ -0,0 +1,27 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/**
+ * Task run by every worker of parallel_run()
+ * @param worker_index Index of the worker, from 0 to workers - 1
+ * @param ctx Context shared by all workers
+ */
+typedef void (*ParallelTask)(int worker_index, void *ctx);
+
+/**
+ * Number of online processors, used when no job count is given
+ * @return Processor count (at least 1)
+ */
+int parallel_default_jobs(void);
+
+/**
+ * Run a task on a fixed number of threads and wait for all of them
+ * Worker 0 runs on the calling thread. If a thread cannot be created its
+ * index is run on the calling thread instead, so every index runs once.
+ * @param workers Number of workers (values below 1 are treated as 1)
+ * @param task Function each worker runs
+ * @param ctx Context passed to every worker
+ */
+void parallel_run(int workers, ParallelTask task, void *ctx);
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,296 @@
+#define _GNU_SOURCE
+#include "profile.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+/**
+ * Recorded phase; counters are shared by every thread working in it
+ */
+struct ProfilePhase {
+    const char *name;
+    ProfilePhase *parent;
+    long long start_ns;
+    long long end_ns;
+    long peak_rss_kb;
+    atomic_int finished;
+    atomic_llong cpu_ns;
+    atomic_llong child_cpu_ns;
+    atomic_llong subprocesses;
+    atomic_llong pipe_bytes;
+    atomic_llong file_bytes;
+    atomic_long child_peak_rss_kb;
+};
+
+static atomic_int profile_on;
+static atomic_int phase_count;
+static ProfilePhase phases[PROFILE_MAX_PHASES];
+
+/* Encloses every top-level phase, so it accumulates the run's totals */
+static ProfilePhase run_phase;
+static long long run_cpu_start_ns;
+
+/* Phase of this thread and its CPU clock when last charged */
+static _Thread_local ProfilePhase *current_phase;
+static _Thread_local long long cpu_mark_ns;
+
+/* Forward declarations */
+static long long clock_ns(clockid_t clock);
+static long long process_cpu_ns(void);
+static long peak_rss_kb(void);
+static void charge_thread_cpu(void);
+static void raise_to(atomic_long *value, long candidate);
+static void fill_sample(ProfileSample *sample, const ProfilePhase *phase, long long end_ns);
+
+/**
+ * Start recording
+ */
+void profile_enable(void) {
+    run_phase.name = "total";
+    run_phase.start_ns = clock_ns(CLOCK_MONOTONIC);
+    run_cpu_start_ns = process_cpu_ns();
+    current_phase = &run_phase;
+    cpu_mark_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    atomic_store(&profile_on, 1);
+}
+
+/**
+ * Whether profile_enable() was called
+ */
+int profile_enabled(void) {
+    return atomic_load(&profile_on);
+}
+
+/**
+ * Enter a phase on the calling thread
+ */
+ProfilePhase* profile_begin(const char *name) {
+    assert(name != NULL);
+
+    if (!atomic_load(&profile_on)) {
+        return NULL;
+    }
+
+    int slot = atomic_fetch_add(&phase_count, 1);
+    if (slot >= PROFILE_MAX_PHASES) {
+        return NULL;
+    }
+
+    /* Time so far belongs to the enclosing phase */
+    charge_thread_cpu();
+
+    ProfilePhase *phase = &phases[slot];
+    phase->name = name;
+    phase->parent = current_phase;
+    phase->start_ns = clock_ns(CLOCK_MONOTONIC);
+    current_phase = phase;
+    return phase;
+}
+
+/**
+ * Leave a phase on the thread that entered it
+ */
+void profile_end(ProfilePhase *phase) {
+    if (phase == NULL) {
+        return;
+    }
+
+    charge_thread_cpu();
+    phase->end_ns = clock_ns(CLOCK_MONOTONIC);
+    phase->peak_rss_kb = peak_rss_kb();
+    atomic_store(&phase->finished, 1);
+    current_phase = phase->parent;
+}
+
+/**
+ * Phase of the calling thread
+ */
+ProfilePhase* profile_current(void) {
+    return current_phase;
+}
+
+/**
+ * Attribute a new thread's work to a phase
+ */
+void profile_thread_begin(ProfilePhase *phase) {
+    if (phase == NULL) {
+        return;
+    }
+    current_phase = phase;
+    cpu_mark_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+/**
+ * Charge the calling thread's CPU time and detach it
+ */
+void profile_thread_end(void) {
+    if (current_phase == NULL) {
+        return;
+    }
+    charge_thread_cpu();
+    current_phase = NULL;
+}
+
+/**
+ * Count one spawned subprocess
+ */
+void profile_count_spawn(void) {
+    for (ProfilePhase *p = current_phase; p != NULL; p = p->parent) {
+        atomic_fetch_add(&p->subprocesses, 1);
+    }
+}
+
+/**
+ * Count bytes read from a subprocess pipe
+ */
+void profile_count_pipe_bytes(size_t bytes) {
+    for (ProfilePhase *p = current_phase; p != NULL; p = p->parent) {
+        atomic_fetch_add(&p->pipe_bytes, (long long)bytes);
+    }
+}
+
+/**
+ * Count bytes read from a file or mapping
+ */
+void profile_count_file_bytes(size_t bytes) {
+    for (ProfilePhase *p = current_phase; p != NULL; p = p->parent) {
+        atomic_fetch_add(&p->file_bytes, (long long)bytes);
+    }
+}
+
+#ifndef _WIN32
+/**
+ * Charge a reaped subprocess's CPU time and memory
+ */
+void profile_count_child(const struct rusage *usage) {
+    assert(usage != NULL);
+
+    if (current_phase == NULL) {
+        return;
+    }
+
+    long long cpu_ns = ((long long)usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * 1000000000LL +
+                       ((long long)usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) * 1000LL;
+#ifdef __APPLE__
+    long rss_kb = usage->ru_maxrss / 1024; /* Bytes on macOS */
+#else
+    long rss_kb = usage->ru_maxrss;
+#endif
+
+    for (ProfilePhase *p = current_phase; p != NULL; p = p->parent) {
+        atomic_fetch_add(&p->child_cpu_ns, cpu_ns);
+        raise_to(&p->child_peak_rss_kb, rss_kb);
+    }
+}
+#endif
+
+/**
+ * Copy the finished phases in the order they started
+ */
+int profile_snapshot(ProfileSample *samples, int capacity) {
+    assert(samples != NULL || capacity == 0);
+
+    int count = atomic_load(&phase_count);
+    if (count > PROFILE_MAX_PHASES) count = PROFILE_MAX_PHASES;
+
+    int written = 0;
+    for (int i = 0; i < count && written < capacity; i++) {
+        const ProfilePhase *phase = &phases[i];
+        if (!atomic_load(&phase->finished)) {
+            continue;
+        }
+        fill_sample(&samples[written], phase, phase->end_ns);
+        samples[written].peak_rss_kb = phase->peak_rss_kb;
+        written++;
+    }
+    return written;
+}
+
+/**
+ * Costs of the whole run so far
+ */
+void profile_total(ProfileSample *total) {
+    assert(total != NULL);
+
+    fill_sample(total, &run_phase, clock_ns(CLOCK_MONOTONIC));
+    /* Threads that never joined a phase still count towards the process */
+    total->cpu_ms = (double)(process_cpu_ns() - run_cpu_start_ns) / 1e6;
+    total->peak_rss_kb = peak_rss_kb();
+}
+
+/**
+ * Read a clock in nanoseconds
+ */
+static long long clock_ns(clockid_t clock) {
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * CPU time of every thread in the process
+ */
+static long long process_cpu_ns(void) {
+    return clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+/**
+ * Resident set size high-water mark of the process in KiB
+ */
+static long peak_rss_kb(void) {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/**
+ * Charge this thread's CPU time since the last charge to its phase chain
+ */
+static void charge_thread_cpu(void) {
+    long long now = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    long long elapsed = now - cpu_mark_ns;
+    cpu_mark_ns = now;
+
+    for (ProfilePhase *p = current_phase; p != NULL; p = p->parent) {
+        atomic_fetch_add(&p->cpu_ns, elapsed);
+    }
+}
+
+/**
+ * Store candidate if it exceeds the current value
+ */
+static void raise_to(atomic_long *value, long candidate) {
+    long seen = atomic_load(value);
+    while (candidate > seen && !atomic_compare_exchange_weak(value, &seen, candidate)) {
+        /* seen was reloaded by the failed exchange */
+    }
+}
+
+/**
+ * Convert a phase's counters into a sample
+ */
+static void fill_sample(ProfileSample *sample, const ProfilePhase *phase, long long end_ns) {
+    memset(sample, 0, sizeof(*sample));
+    sample->name = phase->name;
+    sample->parent = (phase->parent != NULL && phase->parent != &run_phase) ? phase->parent->name : NULL;
+    sample->wall_ms = (double)(end_ns - phase->start_ns) / 1e6;
+    sample->cpu_ms = (double)atomic_load(&phase->cpu_ns) / 1e6;
+    sample->child_cpu_ms = (double)atomic_load(&phase->child_cpu_ns) / 1e6;
+    sample->subprocesses = atomic_load(&phase->subprocesses);
+    sample->pipe_bytes = atomic_load(&phase->pipe_bytes);
+    sample->file_bytes = atomic_load(&phase->file_bytes);
+    sample->child_peak_rss_kb = atomic_load(&phase->child_peak_rss_kb);
+}
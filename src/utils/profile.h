@@ -0,0 +1,119 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/* Phases recorded per run; later phases are not recorded */
+#define PROFILE_MAX_PHASES 32
+
+/**
+ * Per-phase cost accounting for --profile
+ *
+ * A phase is a named span of work, such as one collector. Costs are
+ * charged to the phase the calling thread is in and to every enclosing
+ * phase, so nested and concurrent phases each report their inclusive
+ * cost. Threads started by parallel_run() inherit the caller's phase.
+ * Until profile_enable() is called every hook returns immediately.
+ */
+typedef struct ProfilePhase ProfilePhase;
+
+/**
+ * Costs of a finished phase (or of the whole run)
+ */
+typedef struct {
+    const char *name;
+    const char *parent;         /* Enclosing phase, NULL at the top level */
+    double wall_ms;
+    double cpu_ms;              /* Our threads, user plus system */
+    double child_cpu_ms;        /* Subprocesses reaped during the phase */
+    long long subprocesses;     /* Subprocesses spawned */
+    long long pipe_bytes;       /* Read from subprocess pipes */
+    long long file_bytes;       /* Read from files and mappings */
+    long peak_rss_kb;           /* Process high-water mark when the phase ended */
+    long child_peak_rss_kb;     /* Largest subprocess high-water mark */
+} ProfileSample;
+
+/**
+ * Start recording; the run's totals are measured from here
+ */
+void profile_enable(void);
+
+/**
+ * Whether profile_enable() was called
+ * @return Non-zero when recording
+ */
+int profile_enabled(void);
+
+/**
+ * Enter a phase on the calling thread
+ * @param name Static phase name
+ * @return Phase to pass to profile_end(), NULL when not recording
+ */
+ProfilePhase* profile_begin(const char *name);
+
+/**
+ * Leave a phase entered with profile_begin() on the same thread
+ * @param phase Phase to end (NULL is ignored)
+ */
+void profile_end(ProfilePhase *phase);
+
+/**
+ * Phase of the calling thread, for handing to new threads
+ * @return Current phase or NULL
+ */
+ProfilePhase* profile_current(void);
+
+/**
+ * Attribute a new thread's work to a phase until profile_thread_end()
+ * @param phase Phase from profile_current() on the starting thread
+ */
+void profile_thread_begin(ProfilePhase *phase);
+
+/**
+ * Charge the calling thread's CPU time and detach it from its phase
+ */
+void profile_thread_end(void);
+
+/**
+ * Count one spawned subprocess
+ */
+void profile_count_spawn(void);
+
+/**
+ * Count bytes read from a subprocess pipe
+ * @param bytes Bytes read
+ */
+void profile_count_pipe_bytes(size_t bytes);
+
+/**
+ * Count bytes read from a file or mapping
+ * @param bytes Bytes read
+ */
+void profile_count_file_bytes(size_t bytes);
+
+#ifndef _WIN32
+/**
+ * Charge a reaped subprocess's CPU time and memory
+ * @param usage Resource usage reported by wait4()
+ */
+void profile_count_child(const struct rusage *usage);
+#endif
+
+/**
+ * Copy the finished phases in the order they started
+ * @param samples Output array
+ * @param capacity Entries available in samples
+ * @return Number of entries written
+ */
+int profile_snapshot(ProfileSample *samples, int capacity);
+
+/**
+ * Costs of the whole run so far, named "total"
+ * @param total Output sample
+ */
+void profile_total(ProfileSample *total);
+
+#endif /* PROFILE_H */
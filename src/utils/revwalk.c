@@ -0,0 +1,622 @@
+#define _GNU_SOURCE
+#include "revwalk.h"
+#include "vector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+/* Deepest tag-to-tag chain followed when peeling */
+#define MAX_TAG_DEPTH 16
+
+/* Tips whose reachability is propagated together (bits per mask word) */
+#define REACHABILITY_TIPS_PER_PASS 64
+
+/**
+ * Commit graph loaded for reachability counting
+ * Parent edges are stored as object ids while loading and resolved to
+ * node indexes afterwards.
+ */
+typedef struct {
+    ObjectId *oids;         /* Node id, in discovery order */
+    int *first_parent;      /* Offset into parents for each node */
+    int *parent_total;      /* Parent count for each node */
+    int node_count;
+    int node_capacity;
+    int first_parent_capacity;
+    int parent_total_capacity;
+    ObjectId *parent_oids;
+    int *parents;           /* Resolved node index, -1 if outside the graph */
+    int parent_count;
+    int parent_capacity;
+    unsigned char *counted; /* Whether each node falls inside the date window */
+    int counted_capacity;
+    long long until;
+    const ObjectIdSet *shallow;
+    int failed;
+} CommitGraph;
+
+/**
+ * Commit queued by a walk, with its commit-graph position when it has one
+ */
+typedef struct {
+    ObjectId oid;
+    uint32_t position;      /* COMMIT_GRAPH_NONE outside the graph */
+} WalkEntry;
+
+/**
+ * Commits already queued: a bitmap for graph positions, a set for the rest
+ */
+typedef struct {
+    unsigned char *graph_bits;
+    ObjectIdSet others;
+} WalkSeen;
+
+/**
+ * Node index paired with its id, for binary search
+ */
+typedef struct {
+    ObjectId oid;
+    int node;
+} GraphIndexEntry;
+
+/* Forward declarations */
+static const unsigned char* next_line(const unsigned char *p, const unsigned char *end);
+static void parse_signature(const unsigned char *p, const unsigned char *line_end,
+                            char *name, size_t name_size, long long *time);
+static int collect_graph_node(const CommitInfo *commit, void *ctx);
+static int compare_graph_entries(const void *a, const void *b);
+static int find_graph_node(const GraphIndexEntry *index, int count, const ObjectId *oid);
+static int* topological_order(const CommitGraph *graph);
+static int walk_commits(GitRepository *repo, const ObjectId *tips, int tip_count, int use_graph,
+                        long long since, long long until,
+                        RevwalkCallback callback, void *ctx, long *count);
+static int load_walk_commit(GitRepository *repo, const WalkEntry *entry, CommitInfo *commit,
+                            uint32_t *parent_positions);
+static int resolve_tip(GitRepository *repo, const ObjectId *tip, int use_graph, WalkEntry *entry);
+static int mark_seen(WalkSeen *seen, const WalkEntry *entry);
+
+/**
+ * Parse a raw commit object
+ */
+int parse_commit(const unsigned char *data, size_t size, CommitInfo *commit) {
+    assert(data != NULL);
+    assert(commit != NULL);
+
+    const unsigned char *p = data;
+    const unsigned char *end = data + size;
+
+    commit->parent_count = 0;
+    commit->author_name[0] = '\0';
+    commit->author_time = 0;
+    commit->commit_time = 0;
+
+    if (size < 5 || memcmp(p, "tree ", 5) != 0) {
+        return -1;
+    }
+
+    /* Header lines end at the first empty line */
+    while (p < end && *p != '\n') {
+        const unsigned char *line_end = next_line(p, end);
+
+        if ((size_t)(line_end - p) >= 7 + OID_HEX_SIZE && memcmp(p, "parent ", 7) == 0) {
+            if (commit->parent_count < MAX_COMMIT_PARENTS &&
+                oid_from_hex((const char *)p + 7, &commit->parents[commit->parent_count]) == 0) {
+                commit->parent_count++;
+            }
+        } else if (line_end - p > 7 && memcmp(p, "author ", 7) == 0) {
+            parse_signature(p + 7, line_end, commit->author_name, sizeof(commit->author_name),
+                            &commit->author_time);
+        } else if (line_end - p > 10 && memcmp(p, "committer ", 10) == 0) {
+            parse_signature(p + 10, line_end, NULL, 0, &commit->commit_time);
+        }
+
+        p = (line_end < end) ? line_end + 1 : end;
+    }
+
+    return 0;
+}
+
+/**
+ * Resolve an object id to a commit, peeling annotated tags
+ */
+int peel_to_commit(GitRepository *repo, const ObjectId *oid, ObjectId *commit) {
+    assert(repo != NULL);
+    assert(oid != NULL && commit != NULL);
+
+    ObjectId current = *oid;
+
+    for (int depth = 0; depth < MAX_TAG_DEPTH; depth++) {
+        ObjectType type;
+        unsigned char *data;
+        size_t size;
+
+        if (object_store_read(&repo->objects, &current, &type, &data, &size) != 0) {
+            return -1;
+        }
+
+        if (type == OBJECT_COMMIT) {
+            free(data);
+            *commit = current;
+            return 0;
+        }
+
+        /* Annotated tags start with "object <hex>" */
+        int peeled = (type == OBJECT_TAG && size > 7 + OID_HEX_SIZE &&
+                      memcmp(data, "object ", 7) == 0 &&
+                      oid_from_hex((const char *)data + 7, &current) == 0);
+        free(data);
+        if (!peeled) {
+            return -1;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Visit every commit reachable from the given tips exactly once
+ */
+int revwalk(GitRepository *repo, const ObjectId *tips, int tip_count,
+            RevwalkCallback callback, void *ctx, long *count) {
+    assert(repo != NULL);
+    assert(tips != NULL || tip_count == 0);
+
+    return walk_commits(repo, tips, tip_count, 0, 0, 0, callback, ctx, count);
+}
+
+/**
+ * Count the commits reachable from each of several tips in one walk
+ */
+int revwalk_count_reachable(GitRepository *repo, const ObjectId *tips, int tip_count,
+                            long long since, long long until, long *counts) {
+    assert(repo != NULL);
+    assert(tips != NULL || tip_count == 0);
+    assert(counts != NULL || tip_count == 0);
+
+    for (int i = 0; i < tip_count; i++) {
+        counts[i] = 0;
+    }
+    if (tip_count == 0) {
+        return 0;
+    }
+
+    CommitGraph graph;
+    memset(&graph, 0, sizeof(graph));
+    graph.shallow = &repo->shallow;
+    graph.until = until;
+
+    int result = walk_commits(repo, tips, tip_count, 1, since, until, collect_graph_node, &graph, NULL);
+    if (graph.failed) {
+        result = -1;
+    }
+
+    /* Resolve parent ids to node indexes through a sorted index */
+    GraphIndexEntry *index = NULL;
+    if (result == 0) {
+        index = malloc(sizeof(GraphIndexEntry) * (size_t)(graph.node_count > 0 ? graph.node_count : 1));
+        graph.parents = malloc(sizeof(int) * (size_t)(graph.parent_count > 0 ? graph.parent_count : 1));
+        if (index == NULL || graph.parents == NULL) {
+            result = -1;
+        }
+    }
+    if (result == 0) {
+        for (int i = 0; i < graph.node_count; i++) {
+            index[i].oid = graph.oids[i];
+            index[i].node = i;
+        }
+        qsort(index, (size_t)graph.node_count, sizeof(GraphIndexEntry), compare_graph_entries);
+        for (int i = 0; i < graph.parent_count; i++) {
+            graph.parents[i] = find_graph_node(index, graph.node_count, &graph.parent_oids[i]);
+        }
+    }
+
+    /* Map each tip to its commit's node */
+    int *tip_nodes = NULL;
+    if (result == 0) {
+        tip_nodes = malloc(sizeof(int) * (size_t)tip_count);
+        if (tip_nodes == NULL) {
+            result = -1;
+        }
+    }
+    for (int i = 0; result == 0 && i < tip_count; i++) {
+        WalkEntry tip;
+        tip_nodes[i] = (resolve_tip(repo, &tips[i], 1, &tip) == 0)
+                           ? find_graph_node(index, graph.node_count, &tip.oid)
+                           : -1;
+    }
+
+    int *order = (result == 0) ? topological_order(&graph) : NULL;
+    uint64_t *masks = (order != NULL)
+                          ? malloc(sizeof(uint64_t) * (size_t)(graph.node_count > 0 ? graph.node_count : 1))
+                          : NULL;
+    if (result == 0 && masks == NULL) {
+        result = -1;
+    }
+
+    /* Each pass pushes one bit per tip from children down to parents */
+    for (int base = 0; result == 0 && base < tip_count; base += REACHABILITY_TIPS_PER_PASS) {
+        int pass_tips = (tip_count - base < REACHABILITY_TIPS_PER_PASS)
+                            ? tip_count - base
+                            : REACHABILITY_TIPS_PER_PASS;
+
+        memset(masks, 0, sizeof(uint64_t) * (size_t)graph.node_count);
+        for (int bit = 0; bit < pass_tips; bit++) {
+            if (tip_nodes[base + bit] >= 0) {
+                masks[tip_nodes[base + bit]] |= (uint64_t)1 << bit;
+            }
+        }
+
+        for (int i = 0; i < graph.node_count; i++) {
+            int node = order[i];
+            uint64_t mask = masks[node];
+            if (mask == 0) continue;
+
+            const int *parents = graph.parents + graph.first_parent[node];
+            for (int p = 0; p < graph.parent_total[node]; p++) {
+                if (parents[p] >= 0) {
+                    masks[parents[p]] |= mask;
+                }
+            }
+
+            /* Commits newer than --until pass reachability on uncounted */
+            if (!graph.counted[node]) continue;
+            while (mask != 0) {
+                counts[base + __builtin_ctzll(mask)]++;
+                mask &= mask - 1;
+            }
+        }
+    }
+
+    free(masks);
+    free(order);
+    free(tip_nodes);
+    free(index);
+    free(graph.oids);
+    free(graph.first_parent);
+    free(graph.parent_total);
+    free(graph.parent_oids);
+    free(graph.parents);
+    free(graph.counted);
+    return result;
+}
+
+/**
+ * Count commits reachable from every ref plus a detached HEAD
+ */
+int revwalk_count_all(long long since, long long until, long *count) {
+    assert(count != NULL);
+
+    GitRepository repo;
+    if (git_repository_open(&repo) != 0) {
+        return -1;
+    }
+
+    GitRef *refs;
+    int ref_count;
+    if (git_repository_list_refs(&repo, "refs/", 1, &refs, &ref_count) != 0) {
+        git_repository_close(&repo);
+        return -1;
+    }
+
+    ObjectId *tips = malloc(sizeof(ObjectId) * (size_t)(ref_count > 0 ? ref_count : 1));
+    int result = -1;
+    if (tips != NULL) {
+        for (int i = 0; i < ref_count; i++) {
+            tips[i] = refs[i].oid;
+        }
+        result = walk_commits(&repo, tips, ref_count, 1, since, until, NULL, NULL, count);
+        free(tips);
+    }
+
+    git_refs_free(refs, ref_count);
+    git_repository_close(&repo);
+    return result;
+}
+
+/**
+ * Depth-first walk shared by revwalk() and the counting functions
+ * With use_graph, commits in the commit-graph are answered from it: the
+ * callback then sees their ids, parents and commit time, but no author.
+ * As in git, a commit dated before since (when non-zero) is dropped along
+ * with the history behind it, so the walk stops early in old history.
+ * Commits dated after until still lead to their parents and reach the
+ * callback, but are not counted.
+ */
+static int walk_commits(GitRepository *repo, const ObjectId *tips, int tip_count, int use_graph,
+                        long long since, long long until,
+                        RevwalkCallback callback, void *ctx, long *count) {
+    const CommitGraphFile *commit_graph = &repo->graph;
+    if (commit_graph->commit_count == 0) {
+        use_graph = 0;
+    }
+
+    WalkSeen seen;
+    seen.graph_bits = use_graph ? calloc((size_t)commit_graph->commit_count / 8 + 1, 1) : NULL;
+    if ((use_graph && seen.graph_bits == NULL) || oid_set_init(&seen.others) != 0) {
+        free(seen.graph_bits);
+        return -1;
+    }
+
+    WalkEntry *stack = NULL;
+    int stack_count = 0;
+    int stack_capacity = 0;
+    int result = 0;
+    long visited = 0;
+
+    for (int i = 0; i < tip_count; i++) {
+        WalkEntry tip;
+        if (resolve_tip(repo, &tips[i], use_graph, &tip) != 0) {
+            continue; /* Refs to trees or blobs carry no history */
+        }
+        int inserted = mark_seen(&seen, &tip);
+        if (inserted < 0 || VECTOR_RESERVE(stack, stack_capacity, stack_count + 1) != 0) {
+            result = -1;
+            break;
+        }
+        if (inserted == 1) {
+            stack[stack_count++] = tip;
+        }
+    }
+
+    CommitInfo *commit = malloc(sizeof(CommitInfo));
+    uint32_t parent_positions[MAX_COMMIT_PARENTS];
+    if (commit == NULL) {
+        result = -1;
+    }
+
+    while (result == 0 && stack_count > 0) {
+        WalkEntry entry = stack[--stack_count];
+        if (load_walk_commit(repo, &entry, commit, parent_positions) != 0) {
+            result = -1;
+            break;
+        }
+
+        if (since > 0 && commit->commit_time < since) {
+            continue;
+        }
+        if (until <= 0 || commit->commit_time <= until) {
+            visited++;
+        }
+        if (callback != NULL && callback(commit, ctx) != 0) {
+            break;
+        }
+
+        /* Shallow boundaries have parents that were never fetched */
+        if (entry.position == COMMIT_GRAPH_NONE && oid_set_contains(&repo->shallow, &commit->oid)) {
+            continue;
+        }
+
+        for (int i = 0; i < commit->parent_count; i++) {
+            WalkEntry parent = { commit->parents[i], COMMIT_GRAPH_NONE };
+            if (use_graph) {
+                /* Graph parents are always in the graph; look the others up */
+                parent.position = (entry.position != COMMIT_GRAPH_NONE)
+                                      ? parent_positions[i]
+                                      : commit_graph_find(commit_graph, &parent.oid);
+            }
+
+            int inserted = mark_seen(&seen, &parent);
+            if (inserted < 0 || VECTOR_RESERVE(stack, stack_capacity, stack_count + 1) != 0) {
+                result = -1;
+                break;
+            }
+            if (inserted == 1) {
+                stack[stack_count++] = parent;
+            }
+        }
+    }
+
+    free(commit);
+    free(stack);
+    free(seen.graph_bits);
+    oid_set_free(&seen.others);
+
+    if (count != NULL) {
+        *count = visited;
+    }
+    return result;
+}
+
+/**
+ * Fill in a queued commit from the commit-graph or its object
+ * @return 0 on success, -1 if the commit is missing or corrupt
+ */
+static int load_walk_commit(GitRepository *repo, const WalkEntry *entry, CommitInfo *commit,
+                            uint32_t *parent_positions) {
+    commit->oid = entry->oid;
+
+    if (entry->position != COMMIT_GRAPH_NONE) {
+        int parents = commit_graph_parents(&repo->graph, entry->position, parent_positions,
+                                           MAX_COMMIT_PARENTS);
+        if (parents < 0) {
+            return -1;
+        }
+        for (int i = 0; i < parents; i++) {
+            commit_graph_oid(&repo->graph, parent_positions[i], &commit->parents[i]);
+        }
+        commit->parent_count = parents;
+        commit->author_name[0] = '\0';
+        commit->author_time = 0;
+        commit->commit_time = commit_graph_commit_time(&repo->graph, entry->position);
+        return 0;
+    }
+
+    ObjectType type;
+    unsigned char *data;
+    size_t size;
+    if (object_store_read(&repo->objects, &commit->oid, &type, &data, &size) != 0) {
+        return -1;
+    }
+
+    int parsed = (type == OBJECT_COMMIT) ? parse_commit(data, size, commit) : -1;
+    free(data);
+    return parsed;
+}
+
+/**
+ * Resolve a walk's starting object to a commit
+ * A tip found in the commit-graph is known to be a commit, which saves
+ * reading its object to peel it.
+ */
+static int resolve_tip(GitRepository *repo, const ObjectId *tip, int use_graph, WalkEntry *entry) {
+    if (use_graph) {
+        entry->position = commit_graph_find(&repo->graph, tip);
+        if (entry->position != COMMIT_GRAPH_NONE) {
+            entry->oid = *tip;
+            return 0;
+        }
+    }
+
+    if (peel_to_commit(repo, tip, &entry->oid) != 0) {
+        return -1;
+    }
+    entry->position = use_graph ? commit_graph_find(&repo->graph, &entry->oid) : COMMIT_GRAPH_NONE;
+    return 0;
+}
+
+/**
+ * Record a commit as queued
+ * @return 1 if newly marked, 0 if already seen, -1 on allocation failure
+ */
+static int mark_seen(WalkSeen *seen, const WalkEntry *entry) {
+    if (entry->position == COMMIT_GRAPH_NONE) {
+        return oid_set_insert(&seen->others, &entry->oid);
+    }
+
+    unsigned char bit = (unsigned char)(1u << (entry->position % 8));
+    unsigned char *byte = &seen->graph_bits[entry->position / 8];
+    if (*byte & bit) {
+        return 0;
+    }
+    *byte |= bit;
+    return 1;
+}
+
+/**
+ * Revwalk callback: record a commit and its parent ids
+ */
+static int collect_graph_node(const CommitInfo *commit, void *ctx) {
+    CommitGraph *graph = (CommitGraph *)ctx;
+
+    /* Shallow boundaries keep no edges, as the walk does not follow them */
+    int parent_count = oid_set_contains(graph->shallow, &commit->oid) ? 0 : commit->parent_count;
+
+    if (VECTOR_RESERVE(graph->oids, graph->node_capacity, graph->node_count + 1) != 0 ||
+        VECTOR_RESERVE(graph->first_parent, graph->first_parent_capacity, graph->node_count + 1) != 0 ||
+        VECTOR_RESERVE(graph->parent_total, graph->parent_total_capacity, graph->node_count + 1) != 0 ||
+        VECTOR_RESERVE(graph->counted, graph->counted_capacity, graph->node_count + 1) != 0 ||
+        VECTOR_RESERVE(graph->parent_oids, graph->parent_capacity, graph->parent_count + parent_count) != 0) {
+        graph->failed = 1;
+        return 1;
+    }
+
+    graph->oids[graph->node_count] = commit->oid;
+    graph->first_parent[graph->node_count] = graph->parent_count;
+    graph->parent_total[graph->node_count] = parent_count;
+    graph->counted[graph->node_count] = (graph->until <= 0 || commit->commit_time <= graph->until);
+    graph->node_count++;
+
+    for (int i = 0; i < parent_count; i++) {
+        graph->parent_oids[graph->parent_count++] = commit->parents[i];
+    }
+    return 0;
+}
+
+/**
+ * Order graph index entries by object id
+ */
+static int compare_graph_entries(const void *a, const void *b) {
+    const GraphIndexEntry *entry_a = (const GraphIndexEntry *)a;
+    const GraphIndexEntry *entry_b = (const GraphIndexEntry *)b;
+    return memcmp(entry_a->oid.hash, entry_b->oid.hash, OID_RAW_SIZE);
+}
+
+/**
+ * Binary search the graph index
+ * @return Node index, or -1 if the commit is not in the graph
+ */
+static int find_graph_node(const GraphIndexEntry *index, int count, const ObjectId *oid) {
+    int low = 0;
+    int high = count - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        int cmp = memcmp(index[mid].oid.hash, oid->hash, OID_RAW_SIZE);
+        if (cmp == 0) return index[mid].node;
+        if (cmp < 0) low = mid + 1;
+        else high = mid - 1;
+    }
+    return -1;
+}
+
+/**
+ * Order nodes so every commit comes before its parents (Kahn's algorithm)
+ * Caller is responsible for freeing the returned array
+ */
+static int* topological_order(const CommitGraph *graph) {
+    size_t nodes = (size_t)(graph->node_count > 0 ? graph->node_count : 1);
+    int *order = malloc(sizeof(int) * nodes);
+    int *children = calloc(nodes, sizeof(int));
+    if (order == NULL || children == NULL) {
+        free(order);
+        free(children);
+        return NULL;
+    }
+
+    for (int i = 0; i < graph->parent_count; i++) {
+        if (graph->parents[i] >= 0) {
+            children[graph->parents[i]]++;
+        }
+    }
+
+    /* order doubles as the queue: [head, tail) are ready but unprocessed */
+    int tail = 0;
+    for (int i = 0; i < graph->node_count; i++) {
+        if (children[i] == 0) {
+            order[tail++] = i;
+        }
+    }
+    for (int head = 0; head < tail; head++) {
+        int node = order[head];
+        const int *parents = graph->parents + graph->first_parent[node];
+        for (int p = 0; p < graph->parent_total[node]; p++) {
+            if (parents[p] >= 0 && --children[parents[p]] == 0) {
+                order[tail++] = parents[p];
+            }
+        }
+    }
+
+    free(children);
+    return order;
+}
+
+/**
+ * Return the end of the current line (the newline or end of buffer)
+ */
+static const unsigned char* next_line(const unsigned char *p, const unsigned char *end) {
+    const unsigned char *newline = memchr(p, '\n', (size_t)(end - p));
+    return (newline != NULL) ? newline : end;
+}
+
+/**
+ * Parse "Name <email> timestamp tz" into name and timestamp
+ */
+static void parse_signature(const unsigned char *p, const unsigned char *line_end,
+                            char *name, size_t name_size, long long *time) {
+    const unsigned char *email_start = memchr(p, '<', (size_t)(line_end - p));
+    if (email_start == NULL) return;
+
+    if (name != NULL && name_size > 0) {
+        size_t length = (size_t)(email_start - p);
+        while (length > 0 && p[length - 1] == ' ') length--;
+        if (length >= name_size) length = name_size - 1;
+        memcpy(name, p, length); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+        name[length] = '\0';
+    }
+
+    const unsigned char *email_end = memchr(email_start, '>', (size_t)(line_end - email_start));
+    if (email_end == NULL) return;
+
+    *time = strtoll((const char *)email_end + 1, NULL, 10);
+}
@@ -0,0 +1,89 @@
+#ifndef REVWALK_H
+#define REVWALK_H
+
+#include "git_repo.h"
+
+/* Most parents recorded per commit; octopus merges beyond this are truncated */
+#define MAX_COMMIT_PARENTS 64
+
+/**
+ * Commit fields needed by the collectors
+ */
+typedef struct {
+    ObjectId oid;
+    ObjectId parents[MAX_COMMIT_PARENTS];
+    int parent_count;
+    char author_name[MAX_NAME_LENGTH];
+    long long author_time;      /* Seconds since the epoch */
+    long long commit_time;
+} CommitInfo;
+
+/**
+ * Called once for every commit reached by a walk
+ * @return 0 to continue, non-zero to stop the walk
+ */
+typedef int (*RevwalkCallback)(const CommitInfo *commit, void *ctx);
+
+/**
+ * Parse a raw commit object
+ * @param data Commit object contents
+ * @param size Size of the contents
+ * @param commit Receives the parsed fields (oid is left untouched)
+ * @return 0 on success, -1 if the object is malformed
+ */
+int parse_commit(const unsigned char *data, size_t size, CommitInfo *commit);
+
+/**
+ * Resolve an object id to a commit, peeling annotated tags
+ * @param repo Repository to read from
+ * @param oid Object to peel
+ * @param commit Receives the commit id
+ * @return 0 on success, -1 if the object does not lead to a commit
+ */
+int peel_to_commit(GitRepository *repo, const ObjectId *oid, ObjectId *commit);
+
+/**
+ * Visit every commit reachable from the given tips exactly once
+ * Parents of shallow commits are not followed, matching git rev-list.
+ * @param repo Repository to walk
+ * @param tips Starting objects (tags are peeled, non-commits ignored)
+ * @param tip_count Number of starting objects
+ * @param callback Function invoked per commit (may be NULL)
+ * @param ctx Context passed to the callback
+ * @param count Receives the number of commits visited (may be NULL)
+ * @return 0 on success, -1 if an object is missing or corrupt
+ */
+int revwalk(GitRepository *repo, const ObjectId *tips, int tip_count,
+            RevwalkCallback callback, void *ctx, long *count);
+
+/**
+ * Count the commits reachable from each of several tips in one walk
+ * The commit graph is loaded once and reachability is propagated from
+ * children to parents in topological order, 64 tips per pass, instead of
+ * walking shared history again for every tip. Parents of commits in the
+ * repository's commit-graph come from the graph rather than the objects.
+ * A date window counts only commits whose committer date lies in it, and
+ * stops the walk at commits older than since, as `git rev-list --since`.
+ * @param repo Repository to walk
+ * @param tips Starting objects (tags are peeled)
+ * @param tip_count Number of starting objects
+ * @param since Oldest committer date counted in epoch seconds, 0 for none
+ * @param until Newest committer date counted in epoch seconds, 0 for none
+ * @param counts Receives one count per tip (0 for tips that are not commits)
+ * @return 0 on success, -1 if an object is missing or corrupt
+ */
+int revwalk_count_reachable(GitRepository *repo, const ObjectId *tips, int tip_count,
+                            long long since, long long until, long *counts);
+
+/**
+ * Count commits reachable from every ref plus a detached HEAD
+ * Equivalent to `git rev-list --all --count`. Commits covered by a
+ * commit-graph are counted from it without reading their objects.
+ * @param since Oldest committer date counted in epoch seconds, 0 for none
+ * @param until Newest committer date counted in epoch seconds, 0 for none
+ * @param count Receives the number of reachable commits
+ * @return 0 on success, -1 if the repository cannot be read in-process
+ */
+int revwalk_count_all(long long since, long long until, long *count);
+
+#endif /* REVWALK_H */
@@ -0,0 +1,61 @@
+#include "string_pool.h"
+#include "vector.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Initialize an empty pool
+ */
+int string_pool_init(StringPool *pool, size_t expected) {
+    assert(pool != NULL);
+
+    memset(pool, 0, sizeof(StringPool));
+    return hash_map_init(&pool->index, expected);
+}
+
+/**
+ * Release the pool and every string in it
+ */
+void string_pool_free(StringPool *pool) {
+    assert(pool != NULL);
+
+    hash_map_free(&pool->index);
+    free(pool->strings);
+    memset(pool, 0, sizeof(StringPool));
+}
+
+/**
+ * Look up a string, adding it when absent
+ */
+int string_pool_intern(StringPool *pool, const char *string, StringId *id) {
+    assert(pool != NULL);
+    assert(string != NULL && id != NULL);
+
+    /* Reserve first so a string is never indexed without its id slot */
+    if (VECTOR_RESERVE(pool->strings, pool->capacity, pool->count + 1) != 0) {
+        return -1;
+    }
+
+    int inserted;
+    int *value = hash_map_upsert(&pool->index, string, pool->count, &inserted);
+    if (value == NULL) {
+        return -1;
+    }
+
+    if (inserted) {
+        pool->strings[pool->count++] = hash_map_key_of(value);
+    }
+    *id = (StringId)*value;
+    return inserted;
+}
+
+/**
+ * String of an id
+ */
+const char* string_pool_get(const StringPool *pool, StringId id) {
+    assert(pool != NULL);
+    assert((int)id < pool->count);
+
+    return pool->strings[id];
+}
@@ -0,0 +1,60 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include "hash_map.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compact reference to a string stored in a StringPool
+ */
+typedef uint32_t StringId;
+
+/**
+ * Intern pool: each distinct string is stored once in block storage and
+ * named by a 4-byte id
+ * Ids are handed out densely from 0 in insertion order, so an aggregator
+ * that creates one record per new string can use the id as the record's
+ * index while streaming. Interned strings never move until the pool is
+ * freed.
+ */
+typedef struct {
+    HashMap index;          /* String -> id; its key blocks hold the strings */
+    const char **strings;   /* Id -> interned string */
+    int count;
+    int capacity;
+} StringPool;
+
+/**
+ * Initialize an empty pool
+ * @param pool Pool to initialize
+ * @param expected Expected number of strings (0 for default)
+ * @return 0 on success, -1 on allocation failure
+ */
+int string_pool_init(StringPool *pool, size_t expected);
+
+/**
+ * Release the pool and every string in it
+ * A zero-initialized pool may be freed.
+ * @param pool Pool to free
+ */
+void string_pool_free(StringPool *pool);
+
+/**
+ * Look up a string, adding it when absent
+ * @param pool Initialized pool
+ * @param string String to intern (copied on insertion)
+ * @param id Receives the string's id
+ * @return 1 if the string was added, 0 if it was present, -1 on allocation failure
+ */
+int string_pool_intern(StringPool *pool, const char *string, StringId *id);
+
+/**
+ * String of an id
+ * @param pool Pool the id came from
+ * @param id Id returned by string_pool_intern()
+ * @return Interned string
+ */
+const char* string_pool_get(const StringPool *pool, StringId id);
+
+#endif /* STRING_POOL_H */
@@ -1,6 +1,12 @@
+#define _GNU_SOURCE
 #include "string_utils.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
 #include <assert.h>
 #include <time.h>
 
@@ -79,3 +85,130 @@ int calculate_days_since_commit(const char* commit_date) {
 
     return (days < 0) ? 0 : days;
 }
+
+/**
+ * Parse a --since/--until date
+ */
+int parse_date_expression(const char* text, time_t now, long long* seconds) {
+    assert(text != NULL);
+    assert(seconds != NULL);
+
+    char *end;
+
+    /* Raw epoch seconds, as git's "@<seconds>" */
+    if (text[0] == '@') {
+        long long value = strtoll(text + 1, &end, 10);
+        if (end == text + 1 || *end != '\0' || value < 0) return -1;
+        *seconds = value;
+        return 0;
+    }
+
+    /* Absolute date, optionally with a time of day */
+    int year, month, day, consumed = 0;
+    if (sscanf(text, "%4d-%2d-%2d%n", &year, &month, &day, &consumed) == 3 && consumed == 10) { // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+        int hour = 0, minute = 0, second = 0;
+        const char *rest = text + consumed;
+        if (*rest == 'T' || *rest == ' ') {
+            int fields = sscanf(rest + 1, "%2d:%2d:%2d%n", &hour, &minute, &second, &consumed); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+            if (fields == 2) {
+                second = 0;
+                fields = sscanf(rest + 1, "%2d:%2d%n", &hour, &minute, &consumed); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+            }
+            if (fields < 2) return -1;
+            rest += 1 + consumed;
+        }
+        if (*rest != '\0' || month < 1 || month > 12 || day < 1 || day > 31 ||
+            hour > 23 || minute > 59 || second > 60) {
+            return -1;
+        }
+
+        struct tm date = {0};
+        date.tm_year = year - 1900;
+        date.tm_mon = month - 1;
+        date.tm_mday = day;
+        date.tm_hour = hour;
+        date.tm_min = minute;
+        date.tm_sec = second;
+        date.tm_isdst = -1;
+        time_t value = mktime(&date);
+        if (value == (time_t)-1) return -1;
+        *seconds = (long long)value;
+        return 0;
+    }
+
+    /* Relative age: "<count> <unit>[s] [ago]", words split by spaces or dots */
+    long count = strtol(text, &end, 10);
+    if (end == text || count < 0 || count > 100000) return -1;
+    while (*end == ' ' || *end == '.') end++;
+
+    char unit[16];
+    size_t length = 0;
+    while (isalpha((unsigned char)end[length]) && length + 1 < sizeof(unit)) {
+        unit[length] = (char)tolower((unsigned char)end[length]);
+        length++;
+    }
+    unit[length] = '\0';
+    const char *rest = end + length;
+    while (*rest == ' ' || *rest == '.') rest++;
+    if (strcmp(rest, "ago") != 0 && *rest != '\0') return -1;
+    if (length > 1 && unit[length - 1] == 's') unit[--length] = '\0';
+
+    static const struct {
+        const char *name;
+        long long seconds;
+    } UNITS[] = {
+        { "second", 1 }, { "minute", 60 }, { "hour", 3600 }, { "day", 86400 }, { "week", 604800 },
+    };
+    for (size_t i = 0; i < sizeof(UNITS) / sizeof(UNITS[0]); i++) {
+        if (strcmp(unit, UNITS[i].name) == 0) {
+            *seconds = (long long)now - count * UNITS[i].seconds;
+            return 0;
+        }
+    }
+
+    /* Months and years step the calendar, so "1 month ago" keeps the day */
+    struct tm date;
+    if ((strcmp(unit, "month") != 0 && strcmp(unit, "year") != 0) || localtime_r(&now, &date) == NULL) {
+        return -1;
+    }
+    if (strcmp(unit, "month") == 0) {
+        date.tm_mon -= (int)count;
+    } else {
+        date.tm_year -= (int)count;
+    }
+    date.tm_isdst = -1;
+    time_t value = mktime(&date);
+    if (value == (time_t)-1) return -1;
+    *seconds = (long long)value;
+    return 0;
+}
+
+/**
+ * Parse a byte count such as "64M"
+ */
+int parse_byte_size(const char* text, size_t* bytes) {
+    assert(text != NULL && bytes != NULL);
+
+    if (!isdigit((unsigned char)text[0])) return -1;
+
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (errno == ERANGE) return -1;
+
+    unsigned long long scale = 1;
+    switch (toupper((unsigned char)*end)) {
+        case 'K': scale = 1ULL << 10; end++; break;
+        case 'M': scale = 1ULL << 20; end++; break;
+        case 'G': scale = 1ULL << 30; end++; break;
+        default: break;
+    }
+    if (scale > 1 && (strcasecmp(end, "B") == 0 || strcasecmp(end, "iB") == 0)) {
+        end += strlen(end);
+    }
+    if (*end != '\0' && !(scale == 1 && strcasecmp(end, "B") == 0)) return -1;
+    if (value > (unsigned long long)SIZE_MAX / scale) return -1;
+
+    *bytes = (size_t)(value * scale);
+    return 0;
+}
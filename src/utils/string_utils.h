@@ -2,6 +2,7 @@
 #define STRING_UTILS_H
 
 #include <stddef.h>
+#include <time.h>
 
 /**
  * Safe string copy with bounds checking
@@ -32,4 +33,26 @@ void get_file_extension(const char* filename, char* extension, size_t extension_
  */
 int calculate_days_since_commit(const char* commit_date);
 
+/**
+ * Parse a --since/--until date
+ * Accepts "@<seconds>", "YYYY-MM-DD" with an optional "HH:MM[:SS]" (local
+ * time, as git reads it) and relative ages such as "90 days ago" or
+ * "3.months.ago" in seconds, minutes, hours, days, weeks, months or years.
+ * @param text Date expression
+ * @param now Reference time for relative ages
+ * @param seconds Receives seconds since the epoch
+ * @return 0 on success, -1 if the expression is not understood
+ */
+int parse_date_expression(const char* text, time_t now, long long* seconds);
+
+/**
+ * Parse a byte count such as "64M"
+ * A K, M or G suffix (optionally followed by "B" or "iB") multiplies by
+ * 1024, 1024^2 or 1024^3.
+ * @param text Size expression
+ * @param bytes Receives the byte count
+ * @return 0 on success, -1 if the expression is not understood or overflows
+ */
+int parse_byte_size(const char* text, size_t* bytes);
+
 #endif /* STRING_UTILS_H */
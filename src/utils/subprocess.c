@@ -0,0 +1,301 @@
+#define _GNU_SOURCE
+#include "subprocess.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+extern char **environ;
+
+/* Serializes pipe creation with spawning: where pipes cannot be created
+ * close-on-exec atomically, a child spawned by another thread in between
+ * would otherwise inherit them and hold them open */
+static pthread_mutex_t spawn_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Forward declarations */
+#ifndef _WIN32
+static int init_spawn_attributes(posix_spawnattr_t *attributes);
+static int open_pipe(int fds[2]);
+static void close_pipe(int fds[2]);
+static int write_all(int fd, const char *data, size_t size);
+static int read_records(int fd, char delimiter, SubprocessRecordCallback callback, void *ctx);
+#endif
+
+/**
+ * Start a program with posix_spawnp() and an argument vector (no shell)
+ */
+int subprocess_start(Subprocess *proc, const char *const argv[], int flags) {
+    assert(proc != NULL);
+    assert(argv != NULL && argv[0] != NULL);
+
+    proc->pid = -1;
+    proc->input_fd = -1;
+    proc->output_fd = -1;
+
+#ifdef _WIN32
+    (void)flags;
+    return -1;
+#else
+    int to_child[2] = {-1, -1};
+    int from_child[2] = {-1, -1};
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    if (init_spawn_attributes(&attributes) != 0) {
+        return -1;
+    }
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        posix_spawnattr_destroy(&attributes);
+        return -1;
+    }
+
+    pthread_mutex_lock(&spawn_lock);
+
+    int failed = (((flags & SUBPROCESS_STDIN) && open_pipe(to_child) != 0) ||
+                  open_pipe(from_child) != 0);
+
+    /* dup2 clears close-on-exec on the child's copies only */
+    if (!failed && (flags & SUBPROCESS_STDIN)) {
+        failed = posix_spawn_file_actions_adddup2(&actions, to_child[0], STDIN_FILENO) != 0;
+    }
+    if (!failed) {
+        failed = posix_spawn_file_actions_adddup2(&actions, from_child[1], STDOUT_FILENO) != 0;
+    }
+    if (!failed && (flags & SUBPROCESS_QUIET)) {
+        failed = posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                                  O_WRONLY, 0) != 0;
+    }
+
+    pid_t child = -1;
+    if (!failed) {
+        failed = posix_spawnp(&child, argv[0], &actions, &attributes,
+                              (char *const *)argv, environ) != 0;
+    }
+
+    pthread_mutex_unlock(&spawn_lock);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+
+    if (failed) {
+        close_pipe(to_child);
+        close_pipe(from_child);
+        return -1;
+    }
+
+    if (flags & SUBPROCESS_STDIN) {
+        close(to_child[0]);
+        proc->input_fd = to_child[1];
+    }
+    close(from_child[1]);
+    proc->output_fd = from_child[0];
+    proc->pid = child;
+    profile_count_spawn();
+    return 0;
+#endif
+}
+
+/**
+ * Wait for a child to exit
+ * wait4() also reports the child's resource usage for --profile.
+ */
+int subprocess_wait(const Subprocess *proc) {
+    assert(proc != NULL);
+
+#ifdef _WIN32
+    return -1;
+#else
+    if (proc->pid <= 0) {
+        return -1;
+    }
+
+    int status;
+    struct rusage usage;
+    while (wait4(proc->pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    profile_count_child(&usage);
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+#endif
+}
+
+/**
+ * Run a program and hand each delimited record of its stdout to a callback
+ */
+int subprocess_stream(const char *const argv[], const char *input, size_t input_size,
+                      char delimiter, SubprocessRecordCallback callback, void *ctx) {
+    assert(argv != NULL);
+    assert(callback != NULL);
+
+#ifdef _WIN32
+    (void)input;
+    (void)input_size;
+    (void)delimiter;
+    (void)ctx;
+    return -1;
+#else
+    Subprocess proc;
+    int flags = SUBPROCESS_QUIET | ((input != NULL) ? SUBPROCESS_STDIN : 0);
+    if (subprocess_start(&proc, argv, flags) != 0) {
+        return -1;
+    }
+
+    int input_failed = 0;
+    if (input != NULL) {
+        input_failed = (write_all(proc.input_fd, input, input_size) != 0);
+        close(proc.input_fd);
+    }
+
+    /* Closing the pipe early makes the child exit on EPIPE */
+    int result = read_records(proc.output_fd, delimiter, callback, ctx);
+    close(proc.output_fd);
+
+    int status = subprocess_wait(&proc);
+    if (result != 0) {
+        return result;
+    }
+    return (status == 0 && !input_failed) ? 0 : -1;
+#endif
+}
+
+#ifndef _WIN32
+/**
+ * Restore default SIGPIPE handling in children
+ * The parent ignores SIGPIPE, and ignored signals survive exec; git should
+ * still stop quietly when its reader goes away.
+ */
+static int init_spawn_attributes(posix_spawnattr_t *attributes) {
+    if (posix_spawnattr_init(attributes) != 0) {
+        return -1;
+    }
+
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    if (posix_spawnattr_setsigdefault(attributes, &defaults) != 0 ||
+        posix_spawnattr_setflags(attributes, POSIX_SPAWN_SETSIGDEF) != 0) {
+        posix_spawnattr_destroy(attributes);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Create a pipe whose ends are both close-on-exec
+ */
+static int open_pipe(int fds[2]) {
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC);
+#else
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    if (fcntl(fds[0], F_SETFD, FD_CLOEXEC) != 0 || fcntl(fds[1], F_SETFD, FD_CLOEXEC) != 0) {
+        close_pipe(fds);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+/**
+ * Close both ends of a pipe that may not have been opened
+ */
+static void close_pipe(int fds[2]) {
+    if (fds[0] >= 0) close(fds[0]);
+    if (fds[1] >= 0) close(fds[1]);
+    fds[0] = -1;
+    fds[1] = -1;
+}
+
+/**
+ * Write a whole buffer, retrying short writes and interrupts
+ */
+static int write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+/**
+ * Read a descriptor to EOF in large blocks, splitting records in place
+ * A record longer than the buffer grows it; the unfinished tail of each
+ * block is moved to the front before the next read.
+ * @return 0 at EOF, 1 if the callback stopped, -1 on error
+ */
+static int read_records(int fd, char delimiter, SubprocessRecordCallback callback, void *ctx) {
+    size_t capacity = SUBPROCESS_READ_BLOCK;
+    char *buffer = malloc(capacity + 1);
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    size_t used = 0;
+    int result = 0;
+
+    for (;;) {
+        if (capacity - used < SUBPROCESS_READ_BLOCK / 2) {
+            char *grown = realloc(buffer, capacity * 2 + 1);
+            if (grown == NULL) {
+                result = -1;
+                break;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+
+        ssize_t got = read(fd, buffer + used, capacity - used);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            result = -1;
+            break;
+        }
+        profile_count_pipe_bytes((size_t)got);
+
+        if (got == 0) {
+            /* Final record without a trailing delimiter */
+            if (used > 0) {
+                buffer[used] = '\0';
+                if (callback(buffer, used, ctx) != 0) result = 1;
+            }
+            break;
+        }
+
+        /* The carried-over tail holds no delimiter, so scan only new bytes */
+        size_t start = 0;
+        size_t scan = used;
+        size_t end = used + (size_t)got;
+        char *found;
+        while (result == 0 &&
+               (found = memchr(buffer + scan, delimiter, end - scan)) != NULL) {
+            *found = '\0';
+            size_t length = (size_t)(found - (buffer + start));
+            if (callback(buffer + start, length, ctx) != 0) result = 1;
+            start += length + 1;
+            scan = start;
+        }
+        if (result != 0) break;
+
+        used = end - start;
+        memmove(buffer, buffer + start, used);
+    }
+
+    free(buffer);
+    return result;
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef SUBPROCESS_H
+#define SUBPROCESS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Flags for subprocess_start() */
+#define SUBPROCESS_STDIN 0x1    /* Open a pipe to the child's stdin */
+#define SUBPROCESS_QUIET 0x2    /* Send the child's stderr to /dev/null */
+
+/* Size of the blocks read from a child's stdout */
+#define SUBPROCESS_READ_BLOCK (64 * 1024)
+
+/**
+ * Child process started without a shell
+ */
+typedef struct {
+    pid_t pid;
+    int input_fd;       /* Write end of the child's stdin, or -1 */
+    int output_fd;      /* Read end of the child's stdout */
+} Subprocess;
+
+/**
+ * Receives one delimited record of a child's output
+ * The record is NUL-terminated in place of its delimiter and may be
+ * modified; it is only valid during the call.
+ * @param record Record contents
+ * @param length Length of the record
+ * @param ctx Caller context
+ * @return 0 to continue, non-zero to stop reading
+ */
+typedef int (*SubprocessRecordCallback)(char *record, size_t length, void *ctx);
+
+/**
+ * Start a program with posix_spawnp() and an argument vector (no shell)
+ * Pipe descriptors are close-on-exec, so concurrently started children do
+ * not inherit each other's pipes.
+ * @param proc Process to initialize
+ * @param argv NULL-terminated argument vector; argv[0] is looked up in PATH
+ * @param flags Combination of SUBPROCESS_* flags
+ * @return 0 on success, -1 on error
+ */
+int subprocess_start(Subprocess *proc, const char *const argv[], int flags);
+
+/**
+ * Wait for a child to exit
+ * Close (or fdopen and fclose) its pipes first.
+ * @param proc Started process
+ * @return 0 if it exited with status 0, -1 otherwise
+ */
+int subprocess_wait(const Subprocess *proc);
+
+/**
+ * Run a program and hand each delimited record of its stdout to a callback
+ * Output is read in SUBPROCESS_READ_BLOCK blocks and split in place; a
+ * final record without a delimiter is delivered too. The child's stderr is
+ * discarded. Input, if any, is written in full before output is read, so
+ * it suits programs that consume all of stdin first (git --stdin).
+ * @param argv NULL-terminated argument vector
+ * @param input Bytes for the child's stdin, or NULL for no stdin pipe
+ * @param input_size Number of input bytes
+ * @param delimiter Record delimiter ('\n' or '\0')
+ * @param callback Record callback
+ * @param ctx Context passed to the callback
+ * @return 0 if the child exited with status 0, 1 if the callback stopped
+ *         the stream, -1 on error
+ */
+int subprocess_stream(const char *const argv[], const char *input, size_t input_size,
+                      char delimiter, SubprocessRecordCallback callback, void *ctx);
+
+#endif /* SUBPROCESS_H */
@@ -0,0 +1,60 @@
+#include "top_k.h"
+#include <assert.h>
+#include <stddef.h>
+
+/* Forward declarations */
+static void sift_down(int *heap, int size, int root, TopKRanksBefore ranks_before, void *ctx);
+
+/**
+ * Select the k best of count items, best first
+ */
+int top_k_select(int count, int k, TopKRanksBefore ranks_before, void *ctx, int *order) {
+    assert(ranks_before != NULL);
+    assert(order != NULL || k <= 0 || count <= 0);
+
+    if (k > count) k = count;
+    if (k <= 0) return 0;
+
+    /* Heap with the worst kept item at the root */
+    for (int i = 0; i < k; i++) {
+        order[i] = i;
+    }
+    for (int i = k / 2 - 1; i >= 0; i--) {
+        sift_down(order, k, i, ranks_before, ctx);
+    }
+
+    for (int i = k; i < count; i++) {
+        if (ranks_before(i, order[0], ctx)) {
+            order[0] = i;
+            sift_down(order, k, 0, ranks_before, ctx);
+        }
+    }
+
+    /* Move the worst to the back repeatedly, leaving the best first */
+    for (int size = k - 1; size > 0; size--) {
+        int worst = order[0];
+        order[0] = order[size];
+        order[size] = worst;
+        sift_down(order, size, 0, ranks_before, ctx);
+    }
+
+    return k;
+}
+
+/**
+ * Restore the heap below root: every parent ranks after its children
+ */
+static void sift_down(int *heap, int size, int root, TopKRanksBefore ranks_before, void *ctx) {
+    int item = heap[root];
+    for (;;) {
+        int child = 2 * root + 1;
+        if (child >= size) break;
+        if (child + 1 < size && ranks_before(heap[child], heap[child + 1], ctx)) {
+            child++;
+        }
+        if (!ranks_before(item, heap[child], ctx)) break;
+        heap[root] = heap[child];
+        root = child;
+    }
+    heap[root] = item;
+}
@@ -0,0 +1,29 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+/**
+ * Ranking order between two items
+ * @param a Index of the first item
+ * @param b Index of the second item
+ * @param ctx Caller context
+ * @return Non-zero if item a ranks strictly before item b
+ */
+typedef int (*TopKRanksBefore)(int a, int b, void *ctx);
+
+/**
+ * Select the k best of count items, best first
+ * A bounded heap keeps the k best seen so far, so selecting the top rows
+ * of n items costs O(n log k) instead of a full sort; k == count sorts
+ * everything. ranks_before must be a strict total order for the result
+ * to be deterministic.
+ * @param count Number of items, indexed 0 .. count-1
+ * @param k Items to select (clamped to count)
+ * @param ranks_before Ranking order
+ * @param ctx Context passed to ranks_before
+ * @param order Receives min(k, count) item indexes in rank order; also
+ *              serves as the heap, so no memory is allocated
+ * @return Number of indexes written
+ */
+int top_k_select(int count, int k, TopKRanksBefore ranks_before, void *ctx, int *order);
+
+#endif /* TOP_K_H */
@@ -0,0 +1,35 @@
+#include "vector.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+
+/**
+ * Ensure a heap-allocated array can hold at least `needed` elements
+ */
+int vector_reserve(void **items, int *capacity, int needed, size_t element_size) {
+    assert(items != NULL);
+    assert(capacity != NULL);
+    assert(element_size > 0);
+
+    if (needed <= *capacity) {
+        return 0;
+    }
+
+    int new_capacity = (*capacity > 0) ? *capacity : VECTOR_INITIAL_CAPACITY;
+    while (new_capacity < needed) {
+        if (new_capacity > INT_MAX / 2) {
+            new_capacity = needed;
+            break;
+        }
+        new_capacity *= 2;
+    }
+
+    void *grown = realloc(*items, element_size * (size_t)new_capacity);
+    if (grown == NULL) {
+        return -1;
+    }
+
+    *items = grown;
+    *capacity = new_capacity;
+    return 0;
+}
@@ -0,0 +1,27 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stddef.h>
+
+/* Capacity given to a vector on its first growth */
+#define VECTOR_INITIAL_CAPACITY 16
+
+/**
+ * Ensure a heap-allocated array can hold at least `needed` elements
+ * Capacity grows geometrically, so appending n elements costs O(n).
+ * @param items Address of the array pointer (may point to NULL)
+ * @param capacity Address of the current capacity in elements
+ * @param needed Minimum number of elements required
+ * @param element_size Size of one element in bytes
+ * @return 0 on success, -1 on allocation failure (array left untouched)
+ */
+int vector_reserve(void **items, int *capacity, int needed, size_t element_size);
+
+/**
+ * Type-safe wrapper around vector_reserve() for a typed array field
+ * Example: VECTOR_RESERVE(stats->authors, stats->author_capacity, n + 1)
+ */
+#define VECTOR_RESERVE(array, capacity, needed) \
+    vector_reserve((void **)&(array), &(capacity), (needed), sizeof(*(array)))
+
+#endif /* VECTOR_H */
@@ -0,0 +1,846 @@
+#define _GNU_SOURCE
+#include "../src/git_stats.h"
+#include "../src/analysis/hotspots.h"
+#include "../src/analysis/line_estimate.h"
+#include "../src/utils/git_index.h"
+#include "../src/utils/hash_map.h"
+#include "../src/utils/hyperloglog.h"
+#include "../src/utils/object_store.h"
+#include "../src/utils/subprocess.h"
+#include "../src/utils/vector.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * Correctness checks against git and exact counts
+ *
+ * Usage: check REPO...
+ * Checks the hash map and HyperLogLog sketch on synthetic keys, a
+ * hand-built pack whose REF_DELTA objects are each other's base and packs
+ * with damaged indexes, then,
+ * in each repository: the object store against `git cat-file`, the index
+ * reader against `git ls-files` and stat(), exact and approximate
+ * hotspots against `git log --numstat`, and estimated line counts against
+ * the exact ones. Repositories are modified (index version, skip-worktree
+ * bits, scratch files in .git), so pass generated ones (see `make check`).
+ * Prints one line per check and exits non-zero if any failed.
+ */
+
+/* Synthetic hash map keys: every key is upserted DUPLICATES times */
+#define MAP_KEYS 50000
+#define MAP_DUPLICATES 3
+
+/* HyperLogLog estimates must fall within this many standard errors */
+#define HLL_TOLERANCE 4.0
+
+/* Index prefixes tried in full at the start and end of the file, and the
+ * stride between prefixes in the middle */
+#define INDEX_EDGE_BYTES 256
+#define INDEX_TRUNCATE_STRIDE 61
+
+static int failures = 0;
+
+/**
+ * Report one check
+ */
+static void report(int passed, const char *name, const char *detail) {
+    if (passed) {
+        printf("ok   %s\n", name);
+    } else {
+        printf("FAIL %s: %s\n", name, detail);
+        failures++;
+    }
+}
+
+/**
+ * Upsert every key several times and compare the map with the exact counts
+ */
+static void check_hash_map(void) {
+    HashMap map;
+    int *counts = calloc(MAP_KEYS, sizeof(int));
+    if (counts == NULL || hash_map_init(&map, 0) != 0) {
+        free(counts);
+        report(0, "hash_map", "out of memory");
+        return;
+    }
+
+    char key[64];
+    const char *problem = NULL;
+    for (int round = 0; round < MAP_DUPLICATES && problem == NULL; round++) {
+        for (int i = 0; i < MAP_KEYS; i++) {
+            snprintf(key, sizeof(key), "src/module%d/file%d.c", i % 97, i);
+            int inserted;
+            int *value = hash_map_upsert(&map, key, i, &inserted);
+            if (value == NULL) {
+                problem = "upsert failed";
+                break;
+            }
+            if (*value != i || inserted != (round == 0)) {
+                problem = "upsert returned another key's value";
+                break;
+            }
+            counts[*value]++;
+        }
+    }
+
+    for (int i = 0; i < MAP_KEYS && problem == NULL; i++) {
+        snprintf(key, sizeof(key), "src/module%d/file%d.c", i % 97, i);
+        int *value = hash_map_find(&map, key);
+        if (value == NULL || *value != i || strcmp(hash_map_key_of(value), key) != 0) {
+            problem = "a key was lost or mapped to another value";
+        } else if (counts[i] != MAP_DUPLICATES) {
+            problem = "upserts of a key did not all reach its value";
+        }
+        snprintf(key, sizeof(key), "src/module%d/file%d.h", i % 97, i);
+        if (problem == NULL && hash_map_find(&map, key) != NULL) {
+            problem = "an absent key was found";
+        }
+    }
+    if (problem == NULL && map.count != MAP_KEYS) {
+        problem = "count differs from the number of distinct keys";
+    }
+
+    report(problem == NULL, "hash_map", problem);
+    hash_map_free(&map);
+    free(counts);
+}
+
+/**
+ * Compare HyperLogLog estimates with exact distinct counts
+ */
+static void check_hyperloglog(void) {
+    static const int precisions[] = {HYPERLOGLOG_MIN_PRECISION + 6, HYPERLOGLOG_DEFAULT_PRECISION};
+    static const int cardinalities[] = {10, 1000, 50000, 300000};
+
+    for (size_t p = 0; p < sizeof(precisions) / sizeof(precisions[0]); p++) {
+        for (size_t c = 0; c < sizeof(cardinalities) / sizeof(cardinalities[0]); c++) {
+            HyperLogLog hll;
+            if (hyperloglog_init(&hll, precisions[p]) != 0) {
+                report(0, "hyperloglog", "out of memory");
+                return;
+            }
+
+            /* Every value twice: duplicates must not move the estimate */
+            char value[64];
+            for (int round = 0; round < 2; round++) {
+                for (int i = 0; i < cardinalities[c]; i++) {
+                    snprintf(value, sizeof(value), "author%d@example.com", i);
+                    hyperloglog_add(&hll, value);
+                }
+            }
+
+            double exact = cardinalities[c];
+            double estimate = hyperloglog_estimate(&hll);
+            double allowed = HLL_TOLERANCE * hyperloglog_standard_error(precisions[p]) * exact;
+            char name[64];
+            char detail[128];
+            snprintf(name, sizeof(name), "hyperloglog p=%d n=%d", precisions[p], cardinalities[c]);
+            snprintf(detail, sizeof(detail), "estimated %.1f, outside %.0f +/- %.1f",
+                     estimate, exact, allowed);
+            report(fabs(estimate - exact) <= allowed + 0.5, name, detail);
+            hyperloglog_free(&hll);
+        }
+    }
+}
+
+/**
+ * Append a pack entry header (type and inflated size) to buf
+ */
+static size_t write_pack_entry_header(unsigned char *buf, ObjectType type, size_t size) {
+    size_t length = 0;
+    unsigned char c = (unsigned char)((type << 4) | (size & 15));
+    size >>= 4;
+    while (size > 0) {
+        buf[length++] = c | 0x80;
+        c = size & 0x7f;
+        size >>= 7;
+    }
+    buf[length++] = c;
+    return length;
+}
+
+/**
+ * Write a big-endian 32-bit value
+ */
+static void write_be32(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+}
+
+/**
+ * Write a file in one piece
+ */
+static int write_file(const char *path, const unsigned char *data, size_t size) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+    int result = (fwrite(data, 1, size, file) == size) ? 0 : -1;
+    if (fclose(file) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+/**
+ * Read objects from a pack of two REF_DELTA objects based on each other
+ * Resolving either one never reaches a whole object, so the read must
+ * fail at the delta depth limit instead of recursing until the stack
+ * runs out.
+ */
+static void check_delta_cycle(void) {
+    char dir[] = "/tmp/git-stat-check.XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        report(0, "object_store REF_DELTA cycle", "cannot create a scratch directory");
+        return;
+    }
+
+    char pack_dir[MAX_PATH_LENGTH];
+    char pack_path[MAX_PATH_LENGTH];
+    char index_path[MAX_PATH_LENGTH];
+    int ret = snprintf(pack_dir, sizeof(pack_dir), "%s/pack", dir);
+    if (ret < 0 || ret >= (int)sizeof(pack_dir) ||
+        snprintf(pack_path, sizeof(pack_path), "%s/pack-cycle.pack", pack_dir) >= (int)sizeof(pack_path) ||
+        snprintf(index_path, sizeof(index_path), "%s/pack-cycle.idx", pack_dir) >= (int)sizeof(index_path)) {
+        rmdir(dir);
+        report(0, "object_store REF_DELTA cycle", "scratch path too long");
+        return;
+    }
+
+    ObjectId ids[2];
+    memset(ids[0].hash, 0x11, OID_RAW_SIZE);
+    memset(ids[1].hash, 0x22, OID_RAW_SIZE);
+
+    /* Delta: base size 1, result size 1, insert one byte */
+    static const unsigned char delta[] = {0x01, 0x01, 0x01, 'x'};
+    unsigned char compressed[64];
+    uLongf compressed_size = sizeof(compressed);
+    const char *problem = NULL;
+    if (compress(compressed, &compressed_size, delta, sizeof(delta)) != Z_OK) {
+        problem = "cannot compress the delta";
+    }
+
+    unsigned char pack[256];
+    uint32_t offsets[2];
+    size_t pack_size = 0;
+    if (problem == NULL) {
+        memcpy(pack, "PACK", 4);
+        write_be32(pack + 4, 2);
+        write_be32(pack + 8, 2);
+        pack_size = 12;
+        for (int i = 0; i < 2; i++) {
+            offsets[i] = (uint32_t)pack_size;
+            pack_size += write_pack_entry_header(pack + pack_size, OBJECT_REF_DELTA, sizeof(delta));
+            memcpy(pack + pack_size, ids[1 - i].hash, OID_RAW_SIZE);
+            pack_size += OID_RAW_SIZE;
+            memcpy(pack + pack_size, compressed, compressed_size);
+            pack_size += compressed_size;
+        }
+        memset(pack + pack_size, 0, OID_RAW_SIZE); /* Checksum, not verified */
+        pack_size += OID_RAW_SIZE;
+    }
+
+    /* Version 2 index: header, fanout, ids, CRCs, offsets */
+    size_t index_size = 8 + 256 * 4 + 2 * (OID_RAW_SIZE + 4 + 4) + 2 * OID_RAW_SIZE;
+    unsigned char *index = calloc(1, index_size);
+    if (problem == NULL && index == NULL) {
+        problem = "out of memory";
+    }
+    if (problem == NULL) {
+        write_be32(index, 0xff744f63U);
+        write_be32(index + 4, 2);
+        for (int b = 0; b < 256; b++) {
+            write_be32(index + 8 + b * 4, (uint32_t)((b >= 0x11) + (b >= 0x22)));
+        }
+        unsigned char *p = index + 8 + 256 * 4;
+        for (int i = 0; i < 2; i++) {
+            memcpy(p + i * OID_RAW_SIZE, ids[i].hash, OID_RAW_SIZE);
+            write_be32(p + 2 * (OID_RAW_SIZE + 4) + i * 4, offsets[i]);
+        }
+
+        if (mkdir(pack_dir, 0700) != 0 || write_file(pack_path, pack, pack_size) != 0 ||
+            write_file(index_path, index, index_size) != 0) {
+            problem = "cannot write the pack";
+        }
+    }
+
+    ObjectStore store;
+    if (problem == NULL && object_store_open(&store, dir) != 0) {
+        problem = "cannot open the object store";
+    } else if (problem == NULL) {
+        if (store.pack_count != 1) {
+            problem = "the pack was not loaded";
+        }
+        for (int i = 0; i < 2 && problem == NULL; i++) {
+            ObjectType type;
+            unsigned char *data;
+            size_t size;
+            if (object_store_read(&store, &ids[i], &type, &data, &size) == 0) {
+                free(data);
+                problem = "a cyclic delta was resolved";
+            }
+        }
+        object_store_close(&store);
+    }
+
+    report(problem == NULL, "object_store REF_DELTA cycle", problem);
+    free(index);
+    unlink(pack_path);
+    unlink(index_path);
+    rmdir(pack_dir);
+    rmdir(dir);
+}
+
+/**
+ * Open a pack of one blob whose index is damaged in two ways
+ * An index whose fanout decreases must be refused when the store opens,
+ * and an offset naming a 64-bit entry past the end of the index must make
+ * the lookup fail, not read outside the mapping.
+ */
+static void check_corrupt_pack_index(void) {
+    static const char *const cases[] = {"decreasing fanout", "large offset out of range"};
+    ObjectId id;
+    memset(id.hash, 0x33, OID_RAW_SIZE);
+
+    for (int c = 0; c < 2; c++) {
+        char name[96];
+        snprintf(name, sizeof(name), "object_store %s", cases[c]);
+
+        char dir[] = "/tmp/git-stat-check.XXXXXX";
+        if (mkdtemp(dir) == NULL) {
+            report(0, name, "cannot create a scratch directory");
+            return;
+        }
+        char pack_dir[MAX_PATH_LENGTH];
+        char pack_path[MAX_PATH_LENGTH];
+        char index_path[MAX_PATH_LENGTH];
+        int ret = snprintf(pack_dir, sizeof(pack_dir), "%s/pack", dir);
+        if (ret < 0 || ret >= (int)sizeof(pack_dir) ||
+            snprintf(pack_path, sizeof(pack_path), "%s/pack-corrupt.pack", pack_dir) >= (int)sizeof(pack_path) ||
+            snprintf(index_path, sizeof(index_path), "%s/pack-corrupt.idx", pack_dir) >= (int)sizeof(index_path)) {
+            rmdir(dir);
+            report(0, name, "scratch path too long");
+            return;
+        }
+
+        /* The blob itself is never reached, only its header must be valid */
+        unsigned char pack[12 + OID_RAW_SIZE] = {0};
+        memcpy(pack, "PACK", 4);
+        write_be32(pack + 4, 2);
+        write_be32(pack + 8, 1);
+
+        unsigned char index[8 + 256 * 4 + OID_RAW_SIZE + 4 + 4 + OID_RAW_SIZE] = {0};
+        write_be32(index, 0xff744f63U);
+        write_be32(index + 4, 2);
+        for (int b = 0; b < 256; b++) {
+            write_be32(index + 8 + b * 4, (uint32_t)(b >= 0x33));
+        }
+        if (c == 0) {
+            write_be32(index + 8 + 0x20 * 4, 1000); /* Bucket 0x20 past every later one */
+        }
+        unsigned char *p = index + 8 + 256 * 4;
+        memcpy(p, id.hash, OID_RAW_SIZE);
+        write_be32(p + OID_RAW_SIZE + 4, (c == 1) ? 0x80001000U : 12);
+
+        const char *problem = NULL;
+        ObjectStore store;
+        if (mkdir(pack_dir, 0700) != 0 || write_file(pack_path, pack, sizeof(pack)) != 0 ||
+            write_file(index_path, index, sizeof(index)) != 0) {
+            problem = "cannot write the pack";
+        } else if (object_store_open(&store, dir) != 0) {
+            problem = "cannot open the object store";
+        } else {
+            ObjectType type;
+            unsigned char *data;
+            size_t size;
+            if (c == 0 && store.pack_count != 0) {
+                problem = "the pack was loaded";
+            } else if (c == 1 && store.pack_count != 1) {
+                problem = "the pack was not loaded";
+            } else if (object_store_read(&store, &id, &type, &data, &size) == 0) {
+                free(data);
+                problem = "an object was read through the damaged index";
+            }
+            object_store_close(&store);
+        }
+
+        report(problem == NULL, name, problem);
+        unlink(pack_path);
+        unlink(index_path);
+        rmdir(pack_dir);
+        rmdir(dir);
+    }
+}
+
+/**
+ * Compare every object of the repository with `git cat-file --batch`
+ */
+static void check_object_store(void) {
+    ObjectStore store;
+    if (object_store_open(&store, ".git/objects") != 0) {
+        report(0, "object_store", "cannot open .git/objects");
+        return;
+    }
+
+    static const char *const type_names[] = {"", "commit", "tree", "blob", "tag"};
+    const char *const argv[] = {"git", "cat-file", "--batch-all-objects", "--batch", NULL};
+    Subprocess proc;
+    FILE *output = NULL;
+    if (subprocess_start(&proc, argv, SUBPROCESS_QUIET) == 0) {
+        output = fdopen(proc.output_fd, "r");
+    }
+    if (output == NULL) {
+        object_store_close(&store);
+        report(0, "object_store", "cannot run git cat-file");
+        return;
+    }
+
+    /* Each object: "<oid> <type> <size>\n<contents>\n" */
+    const char *problem = NULL;
+    char header[256];
+    long objects = 0;
+    unsigned char *expected = NULL;
+    size_t expected_capacity = 0;
+    while (problem == NULL && fgets(header, sizeof(header), output) != NULL) {
+        char hex[OID_HEX_SIZE + 1];
+        char type_name[16];
+        size_t size;
+        ObjectId oid;
+        if (sscanf(header, "%40s %15s %zu", hex, type_name, &size) != 3 ||
+            oid_from_hex(hex, &oid) != 0) {
+            problem = "unexpected cat-file output";
+            break;
+        }
+        if (size + 1 > expected_capacity) {
+            unsigned char *grown = realloc(expected, size + 1);
+            if (grown == NULL) {
+                problem = "out of memory";
+                break;
+            }
+            expected = grown;
+            expected_capacity = size + 1;
+        }
+        if (fread(expected, 1, size + 1, output) != size + 1) {
+            problem = "short cat-file output";
+            break;
+        }
+
+        ObjectType type;
+        unsigned char *data;
+        size_t data_size;
+        if (object_store_read(&store, &oid, &type, &data, &data_size) != 0) {
+            problem = "an object git can read could not be read";
+            fprintf(stderr, "  %s\n", hex);
+            break;
+        }
+        if (type < OBJECT_COMMIT || type > OBJECT_TAG || strcmp(type_names[type], type_name) != 0 ||
+            data_size != size || memcmp(data, expected, size) != 0) {
+            problem = "an object differs from git's copy";
+            fprintf(stderr, "  %s\n", hex);
+        }
+        free(data);
+        objects++;
+    }
+
+    fclose(output);
+    if (subprocess_wait(&proc) != 0 && problem == NULL) {
+        problem = "git cat-file failed";
+    }
+    if (problem == NULL && objects == 0) {
+        problem = "no objects were compared";
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "object_store (%ld objects)", objects);
+    report(problem == NULL, name, problem);
+    free(expected);
+    object_store_close(&store);
+}
+
+/**
+ * Index entries or `git ls-files` paths, in order
+ */
+typedef struct {
+    char **paths;
+    uint32_t *sizes;
+    int count;
+    int path_capacity;
+    int size_capacity;
+} PathList;
+
+static void path_list_free(PathList *list) {
+    for (int i = 0; i < list->count; i++) free(list->paths[i]);
+    free(list->paths);
+    free(list->sizes);
+    memset(list, 0, sizeof(PathList));
+}
+
+static int append_path(PathList *list, const char *path, uint32_t size) {
+    if (VECTOR_RESERVE(list->paths, list->path_capacity, list->count + 1) != 0 ||
+        VECTOR_RESERVE(list->sizes, list->size_capacity, list->count + 1) != 0) {
+        return 1;
+    }
+    list->paths[list->count] = strdup(path);
+    if (list->paths[list->count] == NULL) {
+        return 1;
+    }
+    list->sizes[list->count] = size;
+    list->count++;
+    return 0;
+}
+
+static int on_index_entry(const char *path, uint32_t mode, uint32_t size, void *ctx) {
+    (void)mode;
+    return append_path(ctx, path, size);
+}
+
+static int on_listed_path(char *path, size_t length, void *ctx) {
+    if (length == 0) return 0;
+    struct stat st;
+    uint32_t size = (stat(path, &st) == 0) ? (uint32_t)st.st_size : 0;
+    return append_path(ctx, path, size);
+}
+
+/**
+ * Whether two lists hold the same paths and sizes in the same order
+ */
+static int path_lists_equal(const PathList *a, const PathList *b) {
+    if (a->count != b->count) return 0;
+    for (int i = 0; i < a->count; i++) {
+        if (strcmp(a->paths[i], b->paths[i]) != 0 || a->sizes[i] != b->sizes[i]) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Run git with the arguments given, discarding its output
+ */
+static int run_git(const char *const argv[]) {
+    Subprocess proc;
+    if (subprocess_start(&proc, argv, SUBPROCESS_QUIET) != 0) {
+        return -1;
+    }
+    char buffer[4096];
+    while (read(proc.output_fd, buffer, sizeof(buffer)) > 0) {}
+    close(proc.output_fd);
+    return subprocess_wait(&proc);
+}
+
+/**
+ * Read the index at each version and every damaged copy of it
+ * Versions 2 to 4 must list what `git ls-files` lists, with the sizes
+ * stat() gives (modulo 2^32). A truncated copy must be refused, or, when
+ * the cut leaves every entry intact, read in full.
+ */
+static void check_git_index(void) {
+    PathList listed = {0};
+    const char *const ls_files[] = {"git", "ls-files", "-z", NULL};
+    if (subprocess_stream(ls_files, NULL, 0, '\0', on_listed_path, &listed) != 0 || listed.count < 2) {
+        report(0, "git_index", "cannot list the tracked files");
+        path_list_free(&listed);
+        return;
+    }
+
+    /* Version 3 is only written with an extended flag such as skip-worktree,
+     * which in turn keeps git from writing version 2 */
+    const char *const skip[] = {"git", "update-index", "--skip-worktree", listed.paths[1], NULL};
+    const char *const unskip[] = {"git", "update-index", "--no-skip-worktree", listed.paths[1], NULL};
+    const char *const refresh[] = {"git", "update-index", "--refresh", NULL};
+    if (run_git(unskip) != 0 || run_git(refresh) != 0) {
+        report(0, "git_index", "cannot prepare the index");
+        path_list_free(&listed);
+        return;
+    }
+
+    static const char *const versions[] = {"2", "3", "4"};
+    for (int v = 0; v < 3; v++) {
+        const char *const set_version[] = {"git", "update-index", "--index-version", versions[v], NULL};
+        char name[64];
+        snprintf(name, sizeof(name), "git_index version %s", versions[v]);
+        if ((v == 1 && run_git(skip) != 0) || run_git(set_version) != 0) {
+            report(0, name, "git update-index failed");
+            continue;
+        }
+
+        unsigned char header[8] = {0};
+        FILE *file = fopen(".git/index", "rb");
+        if (file != NULL) {
+            if (fread(header, 1, sizeof(header), file) != sizeof(header)) memset(header, 0, sizeof(header));
+            fclose(file);
+        }
+        PathList read = {0};
+        int result = git_index_read(".git", on_index_entry, &read);
+        if (header[7] != (unsigned char)(versions[v][0] - '0')) {
+            report(0, name, "git wrote another version");
+        } else if (result != 0) {
+            report(0, name, "the index was refused");
+        } else {
+            report(path_lists_equal(&read, &listed), name, "entries differ from git ls-files");
+        }
+        path_list_free(&read);
+    }
+
+    /* Truncate a copy from the end, checking each prefix on the way down */
+    const char *copy = ".git/check-index";
+    size_t size = 0;
+    const unsigned char *data = object_file_map(".git/index", &size);
+    const char *problem = NULL;
+    if (data == NULL || write_file(copy, data, size) != 0 || setenv("GIT_INDEX_FILE", copy, 1) != 0) {
+        problem = "cannot copy the index";
+    }
+    object_file_unmap(data, size);
+
+    int refused = 0;
+    for (size_t length = size; problem == NULL && length-- > 0;) {
+        if (length > INDEX_EDGE_BYTES && length < size - INDEX_EDGE_BYTES &&
+            length % INDEX_TRUNCATE_STRIDE != 0) {
+            continue;
+        }
+        if (truncate(copy, (off_t)length) != 0) {
+            problem = "cannot truncate the copy";
+            break;
+        }
+        PathList read = {0};
+        int result = git_index_read(".git", on_index_entry, &read);
+        if (result == 0 && !path_lists_equal(&read, &listed)) {
+            problem = "a truncated index was read with wrong entries";
+        } else if (result != 0 && result != -1) {
+            problem = "a truncated index returned an unexpected status";
+        }
+        refused += (result == -1);
+        path_list_free(&read);
+    }
+    unsetenv("GIT_INDEX_FILE");
+    unlink(copy);
+    if (problem == NULL && refused == 0) {
+        problem = "no truncated index was refused";
+    }
+    report(problem == NULL, "git_index truncated", problem);
+
+    run_git(unskip);
+    path_list_free(&listed);
+}
+
+/**
+ * Exact per-path churn from `git log --numstat`
+ */
+typedef struct {
+    HashMap paths;
+    int *commits;
+    int *lines_added;
+    int *lines_deleted;
+    int count;
+    int commits_capacity;
+    int added_capacity;
+    int deleted_capacity;
+} ChurnTruth;
+
+static int on_numstat_line(char *line, size_t length, void *ctx) {
+    ChurnTruth *truth = ctx;
+    char *deleted = memchr(line, '\t', length);
+    char *path = (deleted != NULL) ? strchr(deleted + 1, '\t') : NULL;
+    if (path == NULL) return 0;
+    path++;
+
+    int inserted;
+    int *id = hash_map_upsert(&truth->paths, path, truth->count, &inserted);
+    if (id == NULL) return 1;
+    if (inserted) {
+        if (VECTOR_RESERVE(truth->commits, truth->commits_capacity, truth->count + 1) != 0 ||
+            VECTOR_RESERVE(truth->lines_added, truth->added_capacity, truth->count + 1) != 0 ||
+            VECTOR_RESERVE(truth->lines_deleted, truth->deleted_capacity, truth->count + 1) != 0) {
+            return 1;
+        }
+        truth->commits[*id] = 0;
+        truth->lines_added[*id] = 0;
+        truth->lines_deleted[*id] = 0;
+        truth->count++;
+    }
+    truth->commits[*id]++;
+    truth->lines_added[*id] += (line[0] == '-') ? 0 : (int)strtol(line, NULL, 10);
+    truth->lines_deleted[*id] += (deleted[1] == '-') ? 0 : (int)strtol(deleted + 1, NULL, 10);
+    return 0;
+}
+
+static void churn_truth_free(ChurnTruth *truth) {
+    hash_map_free(&truth->paths);
+    free(truth->commits);
+    free(truth->lines_added);
+    free(truth->lines_deleted);
+}
+
+/**
+ * Compare exact hotspots, and the Space-Saving bounds of approximate
+ * ones, with the churn git reports for the history of HEAD
+ */
+static void check_hotspots(void) {
+    ChurnTruth truth;
+    memset(&truth, 0, sizeof(truth));
+    const char *const argv[] = {"git", "log", "HEAD", "--numstat", "--format=", NULL};
+    if (hash_map_init(&truth.paths, 0) != 0 ||
+        subprocess_stream(argv, NULL, 0, '\n', on_numstat_line, &truth) != 0 || truth.count == 0) {
+        report(0, "hotspots", "cannot read git log");
+        churn_truth_free(&truth);
+        return;
+    }
+
+    for (int approximate = 0; approximate <= 1; approximate++) {
+        GitStats stats;
+        init_git_stats(&stats);
+        stats.options.limit = LIMIT_ALL;
+        stats.options.approximate_hotspots = approximate;
+        stats.options.memory_budget = MIN_MEMORY_BUDGET;
+        const char *name = approximate ? "hotspots approximate" : "hotspots exact";
+        if (get_hotspot_stats(&stats) != 0) {
+            report(0, name, "collection failed");
+            free_git_stats(&stats);
+            continue;
+        }
+
+        const HotspotAccuracy *accuracy = &stats.hotspot_accuracy;
+        const char *problem = NULL;
+        char *listed = calloc((size_t)truth.count, 1);
+        if (listed == NULL) problem = "out of memory";
+        if (problem == NULL && !approximate && stats.hotspot_count != truth.count) {
+            problem = "path count differs from git log";
+        }
+        if (problem == NULL && approximate && accuracy->evictions == 0) {
+            problem = "the repository is too small to evict any path";
+        }
+
+        GIT_STATS_FOR_EACH(const FileHotspot, hotspot, stats.hotspots, stats.hotspot_count) {
+            if (problem != NULL) break;
+            int *id = hash_map_find(&truth.paths, string_pool_get(&stats.hotspot_paths, hotspot->filename));
+            if (id == NULL) {
+                problem = "a path git log never reported was ranked";
+                break;
+            }
+            listed[*id] = 1;
+            int commits = truth.commits[*id];
+            int added = truth.lines_added[*id];
+            int deleted = truth.lines_deleted[*id];
+            if (!approximate) {
+                if (hotspot->commit_count != commits || hotspot->lines_added != added ||
+                    hotspot->lines_deleted != deleted || hotspot->commit_error != 0) {
+                    problem = "a path's churn differs from git log";
+                }
+            } else if (hotspot->commit_count < commits ||
+                       hotspot->commit_count - hotspot->commit_error > commits) {
+                problem = "a path's commits fall outside its error bounds";
+            } else if (hotspot->lines_added > added || hotspot->lines_deleted > deleted) {
+                problem = "a path's lines exceed the true counts";
+            } else if (hotspot->commit_error == 0 &&
+                       (hotspot->lines_added != added || hotspot->lines_deleted != deleted)) {
+                problem = "a path with exact commits has inexact lines";
+            }
+        }
+
+        for (int i = 0; i < truth.count && problem == NULL && approximate; i++) {
+            if (!listed[i] && truth.commits[i] > accuracy->max_unmonitored_commits) {
+                problem = "an unmonitored path exceeds max_unmonitored_commits";
+            }
+        }
+
+        char label[96];
+        if (approximate) {
+            snprintf(label, sizeof(label), "%s (%d counters, %lld evictions)", name,
+                     accuracy->counters, accuracy->evictions);
+            name = label;
+        }
+        report(problem == NULL, name, problem);
+        free(listed);
+        free_git_stats(&stats);
+    }
+    churn_truth_free(&truth);
+}
+
+/**
+ * Estimate lines with a sample that covers every file, which must give
+ * the exact counts, from the working tree and from HEAD's tree
+ */
+static void check_line_estimate(void) {
+    static const char *const revs[] = {NULL, "HEAD"};
+    for (int r = 0; r < 2; r++) {
+        const char *name = (revs[r] == NULL) ? "line_estimate working tree" : "line_estimate HEAD";
+        GitStats exact;
+        GitStats estimated;
+        init_git_stats(&exact);
+        init_git_stats(&estimated);
+        exact.options.rev = revs[r];
+        estimated.options.rev = revs[r];
+        estimated.options.estimate_lines = 1;
+        estimated.options.sample_size = MAX_LINE_SAMPLE_SIZE;
+
+        const char *problem = NULL;
+        if (get_file_stats(&exact) != 0 || get_file_stats(&estimated) != 0) {
+            problem = "collection failed";
+        } else if (estimated.total_files != exact.total_files ||
+                   estimated.total_lines != exact.total_lines ||
+                   estimated.line_estimate.lines_margin != 0 ||
+                   estimated.file_type_count != exact.file_type_count) {
+            problem = "totals differ from the exact count";
+        }
+        for (int i = 0; i < exact.file_type_count && problem == NULL; i++) {
+            const FileType *type = &exact.file_types[i];
+            const FileType *match = NULL;
+            GIT_STATS_FOR_EACH(const FileType, candidate, estimated.file_types, estimated.file_type_count) {
+                if (strcmp(candidate->extension, type->extension) == 0) match = candidate;
+            }
+            if (match == NULL || match->count != type->count || match->total_lines != type->total_lines ||
+                match->sampled != type->count || match->lines_margin != 0) {
+                problem = "a file type differs from the exact count";
+            }
+        }
+
+        report(problem == NULL, name, problem);
+        free_git_stats(&exact);
+        free_git_stats(&estimated);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s REPO...\n", argv[0]);
+        return 1;
+    }
+
+    char start_dir[MAX_PATH_LENGTH];
+    if (getcwd(start_dir, sizeof(start_dir)) == NULL) {
+        perror("getcwd");
+        return 1;
+    }
+
+    /* Keep the results so far if a check crashes */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    check_hash_map();
+    check_hyperloglog();
+    check_delta_cycle();
+    check_corrupt_pack_index();
+
+    for (int i = 1; i < argc; i++) {
+        printf("# %s\n", argv[i]);
+        if (chdir(argv[i]) != 0) {
+            report(0, argv[i], "cannot enter the repository");
+            continue;
+        }
+        check_object_store();
+        check_git_index();
+        check_hotspots();
+        check_line_estimate();
+        if (chdir(start_dir) != 0) {
+            perror("chdir");
+            return 1;
+        }
+    }
+
+    printf("%s\n", (failures == 0) ? "All checks passed" : "Some checks failed");
+    return (failures == 0) ? 0 : 1;
+}